@@ -0,0 +1,88 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// State handed to a benchmark function on each repetition. The function should perform exactly `iterations`
+// operations between its entry and exit, and may pause the clock around any setup that shouldn't be measured.
+class BenchmarkState
+{
+public:
+  explicit BenchmarkState(size_t iterations);
+
+  BenchmarkState(const BenchmarkState &) = delete;
+  BenchmarkState(BenchmarkState &&) = delete;
+  ~BenchmarkState() = default;
+  BenchmarkState &operator=(const BenchmarkState &) = delete;
+  BenchmarkState &operator=(BenchmarkState &&) = delete;
+
+  size_t get_iterations() const { return iterations; }
+
+  // Stop and restart the clock.
+  void pause();
+  void resume();
+
+  // Report the number of items processed by this repetition, for benchmarks whose iterations each process several.
+  // Defaults to the number of iterations.
+  void set_items_processed(uint64_t items) { items_processed = items; }
+
+  uint64_t get_items_processed() const { return items_processed; }
+
+  uint64_t get_elapsed_ns() const { return elapsed_ns; }
+
+  // Report an additional named measurement, such as memory consumption. The median of each counter across
+  // repetitions is reported.
+  void set_counter(const std::string &name, double value) { counters.emplace_back(name, value); }
+
+private:
+  size_t iterations;
+  uint64_t items_processed;
+
+  uint64_t elapsed_ns;
+  uint64_t resumed_at;
+  bool running;
+
+  std::vector<std::pair<std::string, double>> counters;
+
+  friend class BenchmarkRunner;
+};
+
+using BenchmarkFunction = std::function<void(BenchmarkState &)>;
+
+// Register a benchmark to be run with a fixed number of iterations. Workloads are never calibrated at runtime, so
+// the same build on the same machine performs exactly the same work on every run.
+void register_benchmark(std::string &&name, size_t iterations, BenchmarkFunction &&function);
+
+// Benchmark suites. Each registers its benchmarks when called.
+void register_queue_benchmarks();
+void register_message_buffer_benchmarks();
+void register_polling_benchmarks();
+void register_heavy_hitters_benchmarks();
+void register_glob_benchmarks();
+#ifdef __linux__
+void register_cookie_jar_benchmarks();
+void register_inotify_benchmarks();
+
+// Register a benchmark that replays the inotify capture at `capture_path`, either as quickly as possible or with its
+// original timing.
+void register_replay_benchmark(const std::string &capture_path, bool real_time);
+#endif
+
+// Create a fresh, empty temporary directory for benchmark fixtures and return its path.
+std::string make_fixture_dir();
+
+// Recursively delete a fixture directory created by `make_fixture_dir()`.
+void remove_fixture_dir(const std::string &path);
+
+// Prevent the compiler from discarding a computed value.
+template <class T>
+inline void do_not_optimize(const T &value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#endif
@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include "../src/message.h"
+#include "../src/message_buffer.h"
+#include "../src/worker/linux/cookie_jar.h"
+#include "bench.h"
+
+using std::string;
+using std::to_string;
+
+// Number of inotify events assumed to arrive in each read(). The jar is flushed once per batch.
+static const size_t COOKIE_BATCH_SIZE = 64;
+
+// Observe `iterations` IN_MOVED_FROM events. `density` percent of them are followed by a matching IN_MOVED_TO event
+// within the same batch; the rest expire from the jar as deletions.
+static void correlate(BenchmarkState &state, unsigned density)
+{
+  std::mt19937 random(0x5eed);
+  std::uniform_int_distribution<unsigned> percent(0, 99);
+
+  MessageBuffer messages;
+  CookieJar jar;
+  string old_path("/some/path/to/a/file.txt");
+  string new_path("/some/path/to/another/file.txt");
+
+  for (size_t i = 0; i < state.get_iterations(); i++) {
+    auto cookie = static_cast<uint32_t>(i + 1);
+    jar.moved_from(messages, 1, cookie, string(old_path), KIND_FILE);
+    if (percent(random) < density) {
+      jar.moved_to(messages, 1, cookie, string(new_path), KIND_FILE);
+    }
+
+    if (i % COOKIE_BATCH_SIZE == COOKIE_BATCH_SIZE - 1) jar.flush_oldest_batch(messages);
+  }
+  jar.flush_oldest_batch(messages);
+  jar.flush_oldest_batch(messages);
+  do_not_optimize(messages.size());
+
+  state.pause();
+}
+
+void register_cookie_jar_benchmarks()
+{
+  for (unsigned density : {0, 10, 50, 90, 100}) {
+    register_benchmark("cookie_jar/correlate/density:" + to_string(density),
+      1 << 17,
+      [density](BenchmarkState &state) { correlate(state, density); });
+  }
+}
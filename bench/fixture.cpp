@@ -0,0 +1,46 @@
+#include <string>
+#include <uv.h>
+
+#include "../src/helper/common.h"
+#include "bench.h"
+
+using std::string;
+
+string make_fixture_dir()
+{
+  char tmp[1024];
+  size_t tmp_size = sizeof(tmp);
+  if (uv_os_tmpdir(tmp, &tmp_size) != 0) return string();
+
+  string dir_template(path_join(string(tmp, tmp_size), "watcher-bench-XXXXXX"));
+
+  uv_fs_t req{};
+  int err = uv_fs_mkdtemp(nullptr, &req, dir_template.c_str(), nullptr);
+  string path(err == 0 ? req.path : "");
+  uv_fs_req_cleanup(&req);
+  return path;
+}
+
+void remove_fixture_dir(const string &path)
+{
+  uv_fs_t scan_req{};
+  int err = uv_fs_scandir(nullptr, &scan_req, path.c_str(), 0, nullptr);
+  if (err >= 0) {
+    uv_dirent_t dirent{};
+    while (uv_fs_scandir_next(&scan_req, &dirent) != UV_EOF) {
+      string child(path_join(path, dirent.name));
+      if (dirent.type == UV_DIRENT_DIR) {
+        remove_fixture_dir(child);
+      } else {
+        uv_fs_t unlink_req{};
+        uv_fs_unlink(nullptr, &unlink_req, child.c_str(), nullptr);
+        uv_fs_req_cleanup(&unlink_req);
+      }
+    }
+  }
+  uv_fs_req_cleanup(&scan_req);
+
+  uv_fs_t rmdir_req{};
+  uv_fs_rmdir(nullptr, &rmdir_req, path.c_str(), nullptr);
+  uv_fs_req_cleanup(&rmdir_req);
+}
@@ -0,0 +1,51 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/glob.h"
+#include "bench.h"
+
+using std::shared_ptr;
+using std::string;
+using std::to_string;
+using std::vector;
+
+static const char *const ROOT = "/home/user/project";
+
+// Match `iterations` event paths, a quarter of which lie within excluded subtrees, against `pattern_count` patterns in
+// the mix that a typical project excludes: unanchored directory names, anchored paths, and extension wildcards.
+static void match(BenchmarkState &state, size_t pattern_count)
+{
+  state.pause();
+  vector<string> patterns{"node_modules", ".git", "build/out", "**/*.log"};
+  for (size_t i = patterns.size(); i < pattern_count; i++) {
+    patterns.push_back("vendor/package" + to_string(i) + "/**");
+  }
+  shared_ptr<const GlobSet> globs = GlobSet::compile(ROOT, patterns).get_value();
+
+  vector<string> paths;
+  for (size_t i = 0; i < 64; i++) {
+    string path(ROOT);
+    if (i % 4 == 0) path += "/node_modules/package" + to_string(i);
+    path += "/src/components/module" + to_string(i) + "/file.js";
+    paths.push_back(move(path));
+  }
+  state.resume();
+
+  size_t matched = 0;
+  for (size_t i = 0; i < state.get_iterations(); i++) {
+    if (globs->matches(paths[i % paths.size()])) matched++;
+  }
+
+  state.pause();
+  do_not_optimize(matched);
+}
+
+void register_glob_benchmarks()
+{
+  for (size_t patterns : {4, 32, 256}) {
+    register_benchmark("glob/match/patterns:" + to_string(patterns),
+      1 << 18,
+      [patterns](BenchmarkState &state) { match(state, patterns); });
+  }
+}
@@ -0,0 +1,42 @@
+#include <string>
+#include <vector>
+
+#include "../src/heavy_hitters.h"
+#include "bench.h"
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+// Record `iterations` events spread across `directories` distinct parent directories. One directory in eight
+// receives half of all events, so the candidate list sees both steady hitters and churn.
+static void record(BenchmarkState &state, size_t directories)
+{
+  state.pause();
+  vector<string> paths;
+  paths.reserve(directories);
+  for (size_t i = 0; i < directories; i++) {
+    paths.push_back("/home/user/project/node_modules/package" + to_string(i) + "/lib/file.js");
+  }
+  HeavyHitters hitters;
+  state.resume();
+
+  for (size_t i = 0; i < state.get_iterations(); i++) {
+    size_t index = (i % 2 == 0) ? (i / 2) % ((directories + 7) / 8) * 8 % directories : (i * 7919) % directories;
+    hitters.record(paths[index]);
+  }
+
+  state.pause();
+  vector<HotDirectory> hot;
+  hitters.collect(hot);
+  do_not_optimize(hot.size());
+}
+
+void register_heavy_hitters_benchmarks()
+{
+  for (size_t directories : {10, 1000, 100000}) {
+    register_benchmark("heavy_hitters/record/directories:" + to_string(directories),
+      1 << 18,
+      [directories](BenchmarkState &state) { record(state, directories); });
+  }
+}
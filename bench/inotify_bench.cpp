@@ -0,0 +1,88 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/inotify.h>
+#include <vector>
+
+#include "../src/message.h"
+#include "../src/message_buffer.h"
+#include "../src/worker/linux/cookie_jar.h"
+#include "../src/worker/linux/side_effect.h"
+#include "../src/worker/linux/watch_registry.h"
+#include "bench.h"
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+// Number of events in each synthetic read() buffer.
+static const size_t INOTIFY_BUFFER_EVENTS = 2048;
+
+// Length of the name field of each synthetic event, including padding, as the kernel aligns it.
+static const size_t INOTIFY_NAME_LENGTH = 16;
+
+// Append a synthetic inotify event for an entry named `name` to `buffer`.
+static void append_event(vector<char> &buffer, int wd, uint32_t mask, uint32_t cookie, const string &name)
+{
+  size_t offset = buffer.size();
+  buffer.resize(offset + sizeof(inotify_event) + INOTIFY_NAME_LENGTH, '\0');
+
+  inotify_event event{};
+  event.wd = wd;
+  event.mask = mask;
+  event.cookie = cookie;
+  event.len = INOTIFY_NAME_LENGTH;
+  memcpy(buffer.data() + offset, &event, sizeof(inotify_event));
+  memcpy(buffer.data() + offset + sizeof(inotify_event), name.c_str(), name.size());
+}
+
+// Interpret `iterations` buffers of synthetic events delivered to a real watch descriptor. `rename_percent` of the
+// events are halves of renames; the rest are modifications.
+static void interpret(BenchmarkState &state, unsigned rename_percent)
+{
+  state.pause();
+  string fixture = make_fixture_dir();
+  vector<string> poll;
+  MessageBuffer setup;
+  WatchRegistry registry;
+  registry.add(1, string(fixture), false, nullptr, nullptr, poll);
+
+  // A freshly initialized inotify instance assigns watch descriptors starting from 1.
+  const int wd = 1;
+
+  vector<char> buffer;
+  buffer.reserve(INOTIFY_BUFFER_EVENTS * (sizeof(inotify_event) + INOTIFY_NAME_LENGTH));
+  size_t renames = INOTIFY_BUFFER_EVENTS * rename_percent / 100 / 2;
+  for (size_t i = 0; i < renames; i++) {
+    auto cookie = static_cast<uint32_t>(i + 1);
+    append_event(buffer, wd, IN_MOVED_FROM, cookie, "from" + to_string(i));
+    append_event(buffer, wd, IN_MOVED_TO, cookie, "to" + to_string(i));
+  }
+  for (size_t i = renames * 2; i < INOTIFY_BUFFER_EVENTS; i++) {
+    append_event(buffer, wd, IN_MODIFY, 0, "file" + to_string(i));
+  }
+  state.resume();
+
+  CookieJar jar;
+  size_t events = 0;
+  for (size_t i = 0; i < state.get_iterations(); i++) {
+    MessageBuffer messages;
+    SideEffect side;
+    events += registry.interpret(messages, jar, side, buffer.data(), buffer.size());
+    jar.flush_oldest_batch(messages);
+    do_not_optimize(messages.size());
+  }
+
+  state.pause();
+  state.set_items_processed(events);
+  remove_fixture_dir(fixture);
+}
+
+void register_inotify_benchmarks()
+{
+  for (unsigned rename_percent : {0, 50}) {
+    register_benchmark("inotify/interpret/renames:" + to_string(rename_percent),
+      256,
+      [rename_percent](BenchmarkState &state) { interpret(state, rename_percent); });
+  }
+}
@@ -0,0 +1,381 @@
+#!/usr/bin/env node
+
+// End-to-end load generator for watchPath().
+//
+// A child process churns a temporary directory tree at a target rate while this process watches it. Each delivered
+// event is matched against the operation that should have produced it, and the results are written to stdout as JSON.
+//
+// Usage: node bench/load.js [options]
+//
+// * `--poll` watches the tree with the polling thread instead of the native event source.
+// * `--duration <s>` is the number of seconds to generate load for. Defaults to 10.
+// * `--rate <ops/s>` is the target number of filesystem operations per second. Defaults to 1000.
+// * `--fanout <n>` and `--depth <n>` determine the shape of the directory tree: each directory contains `fanout`
+//   subdirectories down to `depth` levels. Default to 4 and 2.
+// * `--files <n>` is the number of files created in each directory before watching begins. Defaults to 10.
+// * `--mix <c:w:r:d>` weighs the relative frequency of creates, writes, renames and deletes. Defaults to 4:3:2:1.
+// * `--settle <ms>` is the time to wait for straggling events after load stops. Defaults to 2000.
+// * `--seed <n>` seeds the operation sequence, so that runs with the same options perform the same operations.
+
+const path = require('path')
+const os = require('os')
+const fs = require('fs-extra')
+const {fork} = require('child_process')
+
+const OPTION_DEFAULTS = {
+  poll: false,
+  duration: 10,
+  rate: 1000,
+  fanout: 4,
+  depth: 2,
+  files: 10,
+  mix: '4:3:2:1',
+  settle: 2000,
+  seed: 1
+}
+
+// Interval at which the generator issues each slice of operations, in milliseconds.
+const TICK = 10
+
+function parseArgs (argv) {
+  const options = Object.assign({}, OPTION_DEFAULTS)
+  for (let i = 0; i < argv.length; i++) {
+    const arg = argv[i]
+    if (arg === '--poll') {
+      options.poll = true
+    } else if (arg === '--generate') {
+      options.generate = argv[++i]
+    } else if (arg.startsWith('--') && Object.prototype.hasOwnProperty.call(OPTION_DEFAULTS, arg.slice(2))) {
+      const key = arg.slice(2)
+      options[key] = key === 'mix' ? argv[++i] : Number(argv[++i])
+    } else {
+      throw new Error(`Unrecognized argument: ${arg}`)
+    }
+  }
+
+  const weights = options.mix.split(':').map(Number)
+  if (weights.length !== 4 || weights.some(w => isNaN(w) || w < 0)) {
+    throw new Error('--mix must be four non-negative weights separated by colons')
+  }
+  options.weights = weights
+
+  return options
+}
+
+// Small, fast, seedable PRNG (mulberry32), so that operation sequences are reproducible.
+function random (seed) {
+  let state = seed >>> 0
+  return function () {
+    state = (state + 0x6D2B79F5) >>> 0
+    let t = state
+    t = Math.imul(t ^ (t >>> 15), t | 1)
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61)
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296
+  }
+}
+
+function now () {
+  const [s, ns] = process.hrtime()
+  return s * 1e3 + ns / 1e6
+}
+
+async function buildTree (root, options) {
+  const directories = [root]
+  let level = [root]
+  for (let d = 0; d < options.depth; d++) {
+    const next = []
+    for (const parent of level) {
+      for (let f = 0; f < options.fanout; f++) {
+        const dir = path.join(parent, `d${f}`)
+        await fs.mkdir(dir)
+        next.push(dir)
+      }
+    }
+    directories.push(...next)
+    level = next
+  }
+
+  for (const dir of directories) {
+    for (let f = 0; f < options.files; f++) {
+      await fs.writeFile(path.join(dir, `initial${f}.txt`), '')
+    }
+  }
+
+  return directories
+}
+
+// Child process: perform operations against the tree and report each one to the parent as an
+// `[action, path, oldPath, completedAt]` tuple, in batches once per tick.
+function generate (options) {
+  const root = options.generate
+  const next = random(options.seed)
+  const totalWeight = options.weights.reduce((a, b) => a + b, 0)
+
+  const directories = [root]
+  const files = []
+  const walk = dir => {
+    for (const entry of fs.readdirSync(dir)) {
+      const full = path.join(dir, entry)
+      if (fs.statSync(full).isDirectory()) {
+        directories.push(full)
+        walk(full)
+      } else {
+        files.push(full)
+      }
+    }
+  }
+  walk(root)
+
+  let counter = 0
+  const pick = list => list[Math.floor(next() * list.length)]
+  const takeFile = () => {
+    const index = Math.floor(next() * files.length)
+    const file = files[index]
+    files[index] = files[files.length - 1]
+    files.pop()
+    return file
+  }
+
+  const operate = () => {
+    let roll = next() * totalWeight
+    let kind = 0
+    while (kind < 3 && roll >= options.weights[kind]) {
+      roll -= options.weights[kind]
+      kind++
+    }
+    if (files.length === 0) kind = 0
+
+    if (kind === 0) {
+      const file = path.join(pick(directories), `f${counter++}.txt`)
+      fs.closeSync(fs.openSync(file, 'w'))
+      files.push(file)
+      return ['created', file, null]
+    } else if (kind === 1) {
+      const file = pick(files)
+      fs.appendFileSync(file, 'x')
+      return ['modified', file, null]
+    } else if (kind === 2) {
+      const oldPath = takeFile()
+      const file = path.join(path.dirname(oldPath), `r${counter++}.txt`)
+      fs.renameSync(oldPath, file)
+      files.push(file)
+      return ['renamed', file, oldPath]
+    } else {
+      const file = takeFile()
+      fs.unlinkSync(file)
+      return ['deleted', file, null]
+    }
+  }
+
+  const perTick = options.rate * TICK / 1000
+  const start = now()
+  let issued = 0
+
+  const tick = () => {
+    const elapsed = now() - start
+    if (elapsed >= options.duration * 1000) {
+      process.send({done: true, issued, elapsed}, () => process.exit(0))
+      return
+    }
+
+    const batch = []
+    const due = Math.floor((elapsed + TICK) / TICK * perTick)
+    while (issued < due) {
+      const op = operate()
+      op.push(now())
+      batch.push(op)
+      issued++
+    }
+    process.send({batch})
+
+    setTimeout(tick, Math.max(0, start + (Math.floor(elapsed / TICK) + 1) * TICK - now()))
+  }
+  tick()
+}
+
+function percentile (sorted, p) {
+  if (sorted.length === 0) return 0
+  return sorted[Math.min(sorted.length - 1, Math.ceil(sorted.length * p / 100) - 1)]
+}
+
+function round (value) {
+  return Math.round(value * 1000) / 1000
+}
+
+async function run (options) {
+  const watcher = require('../lib')
+
+  const root = await fs.realpath(await fs.mkdtemp(path.join(os.tmpdir(), 'watcher-load-')))
+  process.stderr.write(`Building tree in ${root}.\n`)
+  const directories = await buildTree(root, options)
+
+  // Operations awaiting their event, and events that arrived before the parent heard about their operation, keyed by
+  // action and path. Each holds a queue of timestamps.
+  const pending = new Map()
+  const unclaimed = new Map()
+  const delivered = new Set()
+  const latencies = []
+  let generated = 0
+  let received = 0
+  let matched = 0
+
+  const enqueue = (map, key, at) => {
+    const queue = map.get(key)
+    if (queue) {
+      queue.push(at)
+    } else {
+      map.set(key, [at])
+    }
+  }
+
+  const dequeue = (map, key) => {
+    const queue = map.get(key)
+    if (!queue) return null
+    const at = queue.shift()
+    if (queue.length === 0) map.delete(key)
+    return at
+  }
+
+  const match = (key, issuedAt, deliveredAt) => {
+    latencies.push(deliveredAt - issuedAt)
+    delivered.add(key)
+    matched++
+  }
+
+  // Operations are reported by the generator in batches, so their events may already have been delivered. Events
+  // delivered before the operation completed can't have been caused by it.
+  const expect = (key, issuedAt) => {
+    const queue = unclaimed.get(key)
+    const index = queue ? queue.findIndex(deliveredAt => deliveredAt >= issuedAt) : -1
+    if (index !== -1) {
+      match(key, issuedAt, queue[index])
+      queue.splice(index, 1)
+      if (queue.length === 0) unclaimed.delete(key)
+    } else {
+      enqueue(pending, key, issuedAt)
+    }
+  }
+
+  const onEvents = events => {
+    const at = now()
+    for (const event of events) {
+      received++
+      const key = event.action === 'renamed'
+        ? `renamed ${event.oldPath} ${event.path}`
+        : `${event.action} ${event.path}`
+
+      const issuedAt = dequeue(pending, key)
+      if (issuedAt !== null) {
+        match(key, issuedAt, at)
+      } else {
+        enqueue(unclaimed, key, at)
+      }
+    }
+  }
+
+  const w = await watcher.watchPath(root, {poll: options.poll, recursive: true}, onEvents)
+  watcher.status({reset: true})
+  process.stderr.write(`Watching ${directories.length} directories ${options.poll ? 'by polling' : 'natively'}.\n`)
+
+  const cpuStart = process.cpuUsage()
+  let peakRss = process.memoryUsage().rss
+  const rssTimer = setInterval(() => {
+    peakRss = Math.max(peakRss, process.memoryUsage().rss)
+  }, 100)
+
+  const args = ['--generate', root]
+  for (const key of Object.keys(OPTION_DEFAULTS)) {
+    if (key !== 'poll') args.push(`--${key}`, String(options[key]))
+  }
+  const child = fork(__filename, args)
+
+  const summary = await new Promise((resolve, reject) => {
+    child.on('message', message => {
+      if (message.batch) {
+        for (const [action, file, oldPath, issuedAt] of message.batch) {
+          generated++
+          expect(action === 'renamed' ? `renamed ${oldPath} ${file}` : `${action} ${file}`, issuedAt)
+        }
+      }
+      if (message.done) resolve(message)
+    })
+    child.on('error', reject)
+    child.on('exit', code => {
+      if (code !== 0) reject(new Error(`Load generator exited with code ${code}`))
+    })
+  })
+
+  process.stderr.write(`Generated ${generated} operations. Waiting ${options.settle}ms for events to settle.\n`)
+  await new Promise(resolve => setTimeout(resolve, options.settle))
+
+  const cpu = process.cpuUsage(cpuStart)
+  clearInterval(rssTimer)
+  const nativeStatus = watcher.status()
+
+  w.dispose()
+  await fs.remove(root)
+
+  let missing = 0
+  for (const queue of pending.values()) missing += queue.length
+
+  // Events left unclaimed either repeat an event that was already matched or correspond to no generated operation.
+  let duplicated = 0
+  let unexpected = 0
+  for (const [key, queue] of unclaimed) {
+    if (delivered.has(key)) {
+      duplicated += queue.length
+    } else {
+      unexpected += queue.length
+    }
+  }
+
+  latencies.sort((a, b) => a - b)
+  const seconds = summary.elapsed / 1000
+
+  return {
+    options: {
+      poll: options.poll,
+      duration: options.duration,
+      rate: options.rate,
+      fanout: options.fanout,
+      depth: options.depth,
+      files: options.files,
+      mix: options.mix,
+      seed: options.seed
+    },
+    directories: directories.length,
+    operations: generated,
+    operationsPerSecond: round(generated / seconds),
+    events: received,
+    eventsPerSecond: round(received / seconds),
+    matched,
+    missing,
+    duplicated,
+    unexpected,
+    latencyMs: {
+      p50: round(percentile(latencies, 50)),
+      p90: round(percentile(latencies, 90)),
+      p99: round(percentile(latencies, 99)),
+      max: round(percentile(latencies, 100))
+    },
+    cpuMs: {user: round(cpu.user / 1000), system: round(cpu.system / 1000)},
+    peakRssBytes: peakRss,
+    status: nativeStatus
+  }
+}
+
+const options = parseArgs(process.argv.slice(2))
+if (options.generate) {
+  generate(options)
+} else {
+  run(options).then(
+    result => {
+      process.stdout.write(JSON.stringify(result, null, 2) + '\n')
+      process.exit(0)
+    },
+    err => {
+      process.stderr.write(`${err.stack}\n`)
+      process.exit(1)
+    }
+  )
+}
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <uv.h>
+#include <vector>
+
+#include "bench.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::move;
+using std::string;
+using std::vector;
+
+struct RegisteredBenchmark
+{
+  string name;
+  size_t iterations;
+  BenchmarkFunction function;
+};
+
+static vector<RegisteredBenchmark> &registry()
+{
+  static vector<RegisteredBenchmark> benchmarks;
+  return benchmarks;
+}
+
+void register_benchmark(string &&name, size_t iterations, BenchmarkFunction &&function)
+{
+  registry().push_back(RegisteredBenchmark{move(name), iterations, move(function)});
+}
+
+BenchmarkState::BenchmarkState(size_t iterations) :
+  iterations{iterations},
+  items_processed{iterations},
+  elapsed_ns{0},
+  resumed_at{0},
+  running{false}
+{
+  //
+}
+
+void BenchmarkState::pause()
+{
+  if (!running) return;
+  elapsed_ns += uv_hrtime() - resumed_at;
+  running = false;
+}
+
+void BenchmarkState::resume()
+{
+  if (running) return;
+  resumed_at = uv_hrtime();
+  running = true;
+}
+
+class BenchmarkRunner
+{
+public:
+  static void run(const RegisteredBenchmark &benchmark, size_t repetitions, bool first)
+  {
+    vector<double> ns_per_op;
+    vector<double> items_per_second;
+    vector<string> counter_names;
+    vector<vector<double>> counter_values;
+
+    for (size_t i = 0; i < repetitions; i++) {
+      BenchmarkState state(benchmark.iterations);
+      state.resume();
+      benchmark.function(state);
+      state.pause();
+
+      double elapsed = static_cast<double>(state.elapsed_ns > 0 ? state.elapsed_ns : 1);
+      ns_per_op.push_back(elapsed / static_cast<double>(benchmark.iterations));
+      items_per_second.push_back(static_cast<double>(state.items_processed) * 1e9 / elapsed);
+
+      for (auto &counter : state.counters) {
+        size_t index = 0;
+        while (index < counter_names.size() && counter_names[index] != counter.first) index++;
+        if (index == counter_names.size()) {
+          counter_names.push_back(counter.first);
+          counter_values.emplace_back();
+        }
+        counter_values[index].push_back(counter.second);
+      }
+    }
+
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+    std::sort(items_per_second.begin(), items_per_second.end());
+
+    cout << (first ? "" : ",") << "\n    {\"name\": \"" << benchmark.name << "\", \"iterations\": " << benchmark.iterations
+         << ", \"repetitions\": " << repetitions << ", \"ns_per_op\": {\"min\": " << ns_per_op.front()
+         << ", \"median\": " << ns_per_op[ns_per_op.size() / 2] << ", \"max\": " << ns_per_op.back()
+         << "}, \"items_per_second\": " << items_per_second[items_per_second.size() / 2];
+    if (!counter_names.empty()) {
+      cout << ", \"counters\": {";
+      for (size_t i = 0; i < counter_names.size(); i++) {
+        vector<double> &values = counter_values[i];
+        std::sort(values.begin(), values.end());
+        cout << (i == 0 ? "" : ", ") << "\"" << counter_names[i] << "\": " << values[values.size() / 2];
+      }
+      cout << "}";
+    }
+    cout << "}" << std::flush;
+
+    cerr << benchmark.name << ": " << ns_per_op[ns_per_op.size() / 2] << " ns/op" << endl;
+  }
+};
+
+static void usage(const char *program)
+{
+  cerr << "Usage: " << program << " [--filter <substring>] [--repetitions <count>] [--list]" << endl;
+  cerr << "       " << program << " --replay <capture file> [--real-time] [--repetitions <count>]" << endl;
+}
+
+int main(int argc, char **argv)
+{
+  string filter;
+  size_t repetitions = 5;
+  bool list = false;
+  string replay;
+  bool real_time = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+      repetitions = static_cast<size_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (strcmp(argv[i], "--list") == 0) {
+      list = true;
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay = argv[++i];
+    } else if (strcmp(argv[i], "--real-time") == 0) {
+      real_time = true;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (repetitions == 0) repetitions = 1;
+
+  if (!replay.empty()) {
+#ifdef __linux__
+    register_replay_benchmark(replay, real_time);
+#else
+    cerr << "Replaying captures is only supported on Linux." << endl;
+    return 1;
+#endif
+  } else {
+    register_queue_benchmarks();
+    register_message_buffer_benchmarks();
+    register_polling_benchmarks();
+    register_heavy_hitters_benchmarks();
+    register_glob_benchmarks();
+#ifdef __linux__
+    register_cookie_jar_benchmarks();
+    register_inotify_benchmarks();
+#endif
+  }
+
+  if (list) {
+    for (const RegisteredBenchmark &benchmark : registry()) {
+      cout << benchmark.name << "\n";
+    }
+    return 0;
+  }
+
+  cout << "{\n  \"benchmarks\": [";
+  bool first = true;
+  for (const RegisteredBenchmark &benchmark : registry()) {
+    if (!filter.empty() && benchmark.name.find(filter) == string::npos) continue;
+
+    BenchmarkRunner::run(benchmark, repetitions, first);
+    first = false;
+  }
+  cout << "\n  ]\n}" << endl;
+
+  return 0;
+}
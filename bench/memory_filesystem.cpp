@@ -0,0 +1,302 @@
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <utility>
+#include <uv.h>
+#include <vector>
+
+#include "../src/helper/common.h"
+#include "memory_filesystem.h"
+
+using std::shared_ptr;
+using std::string;
+using std::to_string;
+using std::unique_ptr;
+using std::vector;
+
+// Read the children of a directory node in name order, resuming after the last name read so that the directory may
+// change between chunks.
+class MemoryDirectoryReader : public DirectoryReader
+{
+public:
+  MemoryDirectoryReader(MemoryFileSystem &filesystem, const shared_ptr<MemoryFileSystem::Node> &directory) :
+    filesystem{filesystem},
+    directory{directory},
+    started{false}
+  {
+    //
+  }
+
+  ~MemoryDirectoryReader() override = default;
+
+  int read(size_t max_entries, const EntryCallback &callback) override
+  {
+    filesystem.read_calls++;
+    filesystem.charge();
+
+    auto it = started ? directory->children.upper_bound(last_name) : directory->children.begin();
+    int read_count = 0;
+    while (it != directory->children.end() && static_cast<size_t>(read_count) < max_entries) {
+      callback(it->first.c_str(), it->second->directory ? UV_DIRENT_DIR : UV_DIRENT_FILE);
+      last_name = it->first;
+      started = true;
+      read_count++;
+      ++it;
+    }
+    return read_count;
+  }
+
+  MemoryDirectoryReader(const MemoryDirectoryReader &) = delete;
+  MemoryDirectoryReader(MemoryDirectoryReader &&) = delete;
+  MemoryDirectoryReader &operator=(const MemoryDirectoryReader &) = delete;
+  MemoryDirectoryReader &operator=(MemoryDirectoryReader &&) = delete;
+
+private:
+  MemoryFileSystem &filesystem;
+  shared_ptr<MemoryFileSystem::Node> directory;
+  string last_name;
+  bool started;
+};
+
+MemoryFileSystem::MemoryFileSystem() :
+  next_ino{1},
+  clock{1},
+  next_name{0},
+  latency{0},
+  sleep{false},
+  simulated_latency_ns{0},
+  open_calls{0},
+  read_calls{0},
+  lstat_calls{0}
+{
+  root = make_node(true, 0);
+}
+
+void MemoryFileSystem::make_directory(const string &path)
+{
+  shared_ptr<Node> current = root;
+  size_t start = 0;
+  while (start < path.size()) {
+    size_t end = path.find('/', start);
+    if (end == string::npos) end = path.size();
+
+    if (end > start) {
+      string component = path.substr(start, end - start);
+      auto existing = current->children.find(component);
+      if (existing == current->children.end()) {
+        shared_ptr<Node> created = make_node(true, 0);
+        current->children.emplace(component, created);
+        current->mtime = clock++;
+        current = created;
+      } else {
+        current = existing->second;
+      }
+    }
+    start = end + 1;
+  }
+}
+
+bool MemoryFileSystem::write_file(const string &path, uint64_t size)
+{
+  string name;
+  shared_ptr<Node> parent = find_parent(path, name);
+  if (!parent) return false;
+
+  auto existing = parent->children.find(name);
+  if (existing == parent->children.end()) {
+    parent->children.emplace(name, make_node(false, size));
+    parent->mtime = clock++;
+  } else {
+    existing->second->size = size;
+    existing->second->mtime = clock++;
+  }
+  return true;
+}
+
+bool MemoryFileSystem::remove(const string &path)
+{
+  string name;
+  shared_ptr<Node> parent = find_parent(path, name);
+  if (!parent || parent->children.erase(name) == 0) return false;
+
+  parent->mtime = clock++;
+  return true;
+}
+
+bool MemoryFileSystem::rename(const string &from, const string &to)
+{
+  string from_name;
+  shared_ptr<Node> from_parent = find_parent(from, from_name);
+  string to_name;
+  shared_ptr<Node> to_parent = find_parent(to, to_name);
+  if (!from_parent || !to_parent) return false;
+
+  auto moving = from_parent->children.find(from_name);
+  if (moving == from_parent->children.end()) return false;
+
+  shared_ptr<Node> node = moving->second;
+  from_parent->children.erase(moving);
+  to_parent->children[to_name] = node;
+
+  from_parent->mtime = clock++;
+  to_parent->mtime = clock++;
+  return true;
+}
+
+size_t MemoryFileSystem::populate(const string &root_path, size_t fanout, size_t depth, size_t files)
+{
+  make_directory(root_path);
+
+  size_t created = 0;
+  vector<string> level{root_path};
+  for (size_t d = 0; d <= depth; d++) {
+    vector<string> next_level;
+    for (string &dir : level) {
+      shared_ptr<Node> node = find(dir);
+      directories.emplace_back(dir, node);
+
+      for (size_t f = 0; f < files; f++) {
+        node->children.emplace("file" + to_string(f), make_node(false, f));
+        created++;
+      }
+
+      if (d == depth) continue;
+      for (size_t s = 0; s < fanout; s++) {
+        string name = "dir" + to_string(s);
+        node->children.emplace(name, make_node(true, 0));
+        next_level.push_back(path_join(dir, name));
+        created++;
+      }
+    }
+    level.swap(next_level);
+  }
+
+  return created;
+}
+
+void MemoryFileSystem::mutate(size_t count, std::mt19937 &random)
+{
+  if (directories.empty()) return;
+
+  std::uniform_int_distribution<size_t> pick_directory(0, directories.size() - 1);
+  std::uniform_int_distribution<unsigned> pick_operation(0, 9);
+
+  for (size_t i = 0; i < count; i++) {
+    auto &directory = directories[pick_directory(random)];
+    std::map<string, shared_ptr<Node>> &children = directory.second->children;
+    unsigned operation = pick_operation(random);
+
+    // Choose an existing file, if there is one.
+    auto chosen = children.end();
+    if (!children.empty()) {
+      std::uniform_int_distribution<size_t> pick_child(0, children.size() - 1);
+      chosen = std::next(children.begin(), static_cast<std::ptrdiff_t>(pick_child(random)));
+      if (chosen->second->directory) chosen = children.end();
+    }
+
+    if (operation == 7 || chosen == children.end()) {
+      children.emplace("new" + to_string(next_name++), make_node(false, 0));
+      directory.second->mtime = clock++;
+    } else if (operation == 8) {
+      children.erase(chosen);
+      directory.second->mtime = clock++;
+    } else if (operation == 9) {
+      shared_ptr<Node> node = chosen->second;
+      children.erase(chosen);
+      children.emplace("moved" + to_string(next_name++), node);
+      directory.second->mtime = clock++;
+    } else {
+      chosen->second->size++;
+      chosen->second->mtime = clock++;
+    }
+  }
+}
+
+void MemoryFileSystem::set_latency(std::chrono::nanoseconds latency, bool sleep)
+{
+  this->latency = latency;
+  this->sleep = sleep;
+}
+
+int MemoryFileSystem::open_directory(const string &path, unique_ptr<DirectoryReader> &reader)
+{
+  open_calls++;
+  charge();
+
+  shared_ptr<Node> node = find(path);
+  if (!node) return UV_ENOENT;
+  if (!node->directory) return UV_ENOTDIR;
+
+  reader.reset(new MemoryDirectoryReader(*this, node));
+  return 0;
+}
+
+int MemoryFileSystem::lstat(const string &path, uv_stat_t &stat)
+{
+  lstat_calls++;
+  charge();
+
+  shared_ptr<Node> node = find(path);
+  if (!node) return UV_ENOENT;
+
+  stat = uv_stat_t{};
+  stat.st_ino = node->ino;
+  stat.st_size = node->size;
+  stat.st_mode = node->directory ? (S_IFDIR | 0755) : (S_IFREG | 0644);
+  stat.st_nlink = 1;
+  stat.st_mtim.tv_sec = static_cast<long>(node->mtime);
+  stat.st_ctim = stat.st_mtim;
+  stat.st_birthtim = stat.st_mtim;
+  return 0;
+}
+
+shared_ptr<MemoryFileSystem::Node> MemoryFileSystem::find(const string &path)
+{
+  shared_ptr<Node> current = root;
+  size_t start = 0;
+  while (start < path.size() && current) {
+    size_t end = path.find('/', start);
+    if (end == string::npos) end = path.size();
+
+    if (end > start) {
+      auto child = current->children.find(path.substr(start, end - start));
+      current = child == current->children.end() ? nullptr : child->second;
+    }
+    start = end + 1;
+  }
+  return current;
+}
+
+shared_ptr<MemoryFileSystem::Node> MemoryFileSystem::find_parent(const string &path, string &name)
+{
+  size_t slash = path.find_last_of('/');
+  if (slash == string::npos) return nullptr;
+
+  name = path.substr(slash + 1);
+  shared_ptr<Node> parent = find(path.substr(0, slash));
+  if (!parent || !parent->directory || name.empty()) return nullptr;
+  return parent;
+}
+
+shared_ptr<MemoryFileSystem::Node> MemoryFileSystem::make_node(bool directory, uint64_t size)
+{
+  shared_ptr<Node> node(new Node());
+  node->ino = next_ino++;
+  node->size = size;
+  node->mtime = clock;
+  node->directory = directory;
+  return node;
+}
+
+void MemoryFileSystem::charge()
+{
+  if (latency.count() == 0) return;
+
+  simulated_latency_ns += static_cast<uint64_t>(latency.count());
+  if (sleep) std::this_thread::sleep_for(latency);
+}
@@ -0,0 +1,112 @@
+#ifndef MEMORY_FILESYSTEM_H
+#define MEMORY_FILESYSTEM_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/polling/filesystem.h"
+
+// Simulated filesystem tree held entirely in memory, for benchmarking the polling engine at scales and latencies that
+// would be slow and noisy to reproduce on a real disk. Every result is deterministic: inode numbers and timestamps come
+// from counters rather than the clock.
+//
+// Not thread-safe. Mutate the tree between calls to `PolledRoot::advance()` on the same thread.
+class MemoryFileSystem : public FileSystem
+{
+public:
+  MemoryFileSystem();
+
+  ~MemoryFileSystem() override = default;
+
+  // Create a directory at `path`, along with any missing parents.
+  void make_directory(const std::string &path);
+
+  // Create a file of `size` bytes at `path`, or update its size and modification time if it already exists. Its parent
+  // directory must exist.
+  bool write_file(const std::string &path, uint64_t size);
+
+  // Remove the entry at `path` and everything beneath it.
+  bool remove(const std::string &path);
+
+  // Move the entry at `from` to `to`, replacing any existing entry there. The inode number is preserved.
+  bool rename(const std::string &from, const std::string &to);
+
+  // Build a tree beneath `root` in which each directory contains `fanout` subdirectories, down to `depth` levels, and
+  // `files` files. Return the number of entries created.
+  size_t populate(const std::string &root, size_t fanout, size_t depth, size_t files);
+
+  // Perform `count` random operations on files beneath the directories created so far: modifications, creations,
+  // deletions and renames in the ratio 70:10:10:10.
+  void mutate(size_t count, std::mt19937 &random);
+
+  // Charge `latency` to every filesystem call, to model a remote or userspace filesystem. If `sleep` is `true`, each
+  // call blocks for that long; otherwise the latency is only accumulated, so that the time a pass would have taken can
+  // be computed without waiting for it.
+  void set_latency(std::chrono::nanoseconds latency, bool sleep);
+
+  uint64_t get_simulated_latency_ns() const { return simulated_latency_ns; }
+
+  uint64_t get_open_calls() const { return open_calls; }
+
+  uint64_t get_read_calls() const { return read_calls; }
+
+  uint64_t get_lstat_calls() const { return lstat_calls; }
+
+  int open_directory(const std::string &path, std::unique_ptr<DirectoryReader> &reader) override;
+
+  int lstat(const std::string &path, uv_stat_t &stat) override;
+
+  MemoryFileSystem(const MemoryFileSystem &) = delete;
+  MemoryFileSystem(MemoryFileSystem &&) = delete;
+  MemoryFileSystem &operator=(const MemoryFileSystem &) = delete;
+  MemoryFileSystem &operator=(MemoryFileSystem &&) = delete;
+
+  struct Node
+  {
+    uint64_t ino;
+    uint64_t size;
+    uint64_t mtime;
+    bool directory;
+
+    // Directory streams hold a reference to the node they're reading, so a directory removed mid-scan stays valid.
+    std::map<std::string, std::shared_ptr<Node>> children;
+  };
+
+private:
+  // Return the node at `path`, or `nullptr` if it doesn't exist.
+  std::shared_ptr<Node> find(const std::string &path);
+
+  // Return the parent directory of `path` and store its final component in `name`, or `nullptr` if the parent doesn't
+  // exist or isn't a directory.
+  std::shared_ptr<Node> find_parent(const std::string &path, std::string &name);
+
+  std::shared_ptr<Node> make_node(bool directory, uint64_t size);
+
+  void charge();
+
+  std::shared_ptr<Node> root;
+
+  // Directories created by `populate()`, paired with their paths, for `mutate()` to choose among.
+  std::vector<std::pair<std::string, std::shared_ptr<Node>>> directories;
+
+  uint64_t next_ino;
+  uint64_t clock;
+  uint64_t next_name;
+
+  std::chrono::nanoseconds latency;
+  bool sleep;
+  uint64_t simulated_latency_ns;
+
+  uint64_t open_calls;
+  uint64_t read_calls;
+  uint64_t lstat_calls;
+
+  friend class MemoryDirectoryReader;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#include <string>
+
+#include "../src/message.h"
+#include "../src/message_buffer.h"
+#include "bench.h"
+
+using std::string;
+
+void register_message_buffer_benchmarks()
+{
+  register_benchmark("message_buffer/created", 1 << 18, [](BenchmarkState &state) {
+    MessageBuffer buffer;
+    ChannelMessageBuffer channel_buffer(buffer, 1);
+    string path("/some/path/to/a/file.txt");
+
+    for (size_t i = 0; i < state.get_iterations(); i++) {
+      channel_buffer.created(string(path), KIND_FILE);
+    }
+    do_not_optimize(buffer.size());
+
+    // Exclude the destruction of the buffered messages.
+    state.pause();
+  });
+
+  register_benchmark("message_buffer/renamed", 1 << 18, [](BenchmarkState &state) {
+    MessageBuffer buffer;
+    ChannelMessageBuffer channel_buffer(buffer, 1);
+    string old_path("/some/path/to/a/file.txt");
+    string path("/some/path/to/another/file.txt");
+
+    for (size_t i = 0; i < state.get_iterations(); i++) {
+      channel_buffer.renamed(string(old_path), string(path), KIND_FILE);
+    }
+    do_not_optimize(buffer.size());
+    state.pause();
+  });
+}
@@ -0,0 +1,194 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <uv.h>
+
+#include "../src/helper/common.h"
+#include "../src/message.h"
+#include "../src/message_buffer.h"
+#include "../src/polling/polled_root.h"
+#include "bench.h"
+#include "memory_filesystem.h"
+
+using std::string;
+using std::to_string;
+
+// Shape of the synthetic tree: a root containing POLLING_DIRECTORIES subdirectories of POLLING_FILES files each.
+static const size_t POLLING_DIRECTORIES = 10;
+static const size_t POLLING_FILES = 500;
+
+static string file_path(const string &root, size_t directory, size_t file)
+{
+  return path_join(path_join(root, "dir" + to_string(directory)), "file" + to_string(file) + ".txt");
+}
+
+static void make_tree(const string &root)
+{
+  uv_fs_t req{};
+  for (size_t d = 0; d < POLLING_DIRECTORIES; d++) {
+    string directory = path_join(root, "dir" + to_string(d));
+    uv_fs_mkdir(nullptr, &req, directory.c_str(), 0755, nullptr);
+    uv_fs_req_cleanup(&req);
+
+    for (size_t f = 0; f < POLLING_FILES; f++) {
+      string path = file_path(root, d, f);
+      int fd = uv_fs_open(nullptr, &req, path.c_str(), UV_FS_O_CREAT | UV_FS_O_WRONLY, 0644, nullptr);
+      uv_fs_req_cleanup(&req);
+      if (fd >= 0) {
+        uv_fs_close(nullptr, &req, fd, nullptr);
+        uv_fs_req_cleanup(&req);
+      }
+    }
+  }
+}
+
+// Perform `iterations` complete passes over a synthetic tree. Before each pass, with the clock stopped, the
+// modification time of every `touch_stride`th file is moved forward. A stride of zero leaves the tree unchanged.
+static void diff(BenchmarkState &state, size_t touch_stride)
+{
+  state.pause();
+  string fixture = make_fixture_dir();
+  make_tree(fixture);
+
+  PolledRoot root(string(fixture), 1, true, std::chrono::milliseconds(0), std::chrono::milliseconds(0), string());
+  MessageBuffer populate;
+  while (!root.is_all_populated()) {
+    root.advance(populate, SIZE_MAX);
+  }
+
+  size_t operations = 0;
+  double mtime = 1000000000.0;
+  for (size_t i = 0; i < state.get_iterations(); i++) {
+    if (touch_stride > 0) {
+      mtime += 1.0;
+      uv_fs_t req{};
+      for (size_t d = 0; d < POLLING_DIRECTORIES; d++) {
+        for (size_t f = (i % touch_stride); f < POLLING_FILES; f += touch_stride) {
+          string path = file_path(fixture, d, f);
+          uv_fs_utime(nullptr, &req, path.c_str(), mtime, mtime, nullptr);
+          uv_fs_req_cleanup(&req);
+        }
+      }
+    }
+
+    MessageBuffer buffer;
+    state.resume();
+    operations += root.advance(buffer, SIZE_MAX);
+    state.pause();
+    do_not_optimize(buffer.size());
+  }
+
+  state.set_items_processed(operations);
+  remove_fixture_dir(fixture);
+}
+
+// Root of every simulated tree.
+static const char *VIRTUAL_ROOT = "/virtual/root";
+
+// Complete the initial pass that populates a root's records from a simulated filesystem.
+static void populate_virtual_root(MemoryFileSystem &filesystem, PolledRoot &root)
+{
+  root.set_filesystem(filesystem);
+  MessageBuffer populate;
+  while (!root.is_all_populated()) {
+    root.advance(populate, SIZE_MAX);
+  }
+}
+
+// Perform `iterations` complete passes over a simulated tree, applying `mutations` random changes before each pass with
+// the clock stopped. Report the memory consumed by the root's records and the events produced per pass.
+static void virtual_diff(BenchmarkState &state, size_t fanout, size_t depth, size_t files, size_t mutations)
+{
+  state.pause();
+  MemoryFileSystem filesystem;
+  size_t entries = filesystem.populate(VIRTUAL_ROOT, fanout, depth, files);
+
+  // Resident memory only grows while the allocator has no freed pages to reuse, so measure the cost of a root's records
+  // once, on the first repetition.
+  static double rss_per_entry = -1.0;
+  size_t rss_before = 0;
+  uv_resident_set_memory(&rss_before);
+
+  PolledRoot root(string(VIRTUAL_ROOT), 1, true, std::chrono::milliseconds(0), std::chrono::milliseconds(0), string());
+  populate_virtual_root(filesystem, root);
+
+  size_t rss_after = 0;
+  uv_resident_set_memory(&rss_after);
+  if (rss_per_entry < 0.0) {
+    rss_per_entry = static_cast<double>(rss_after - rss_before) / static_cast<double>(entries);
+  }
+
+  std::mt19937 random(0x5eed);
+  size_t operations = 0;
+  size_t events = 0;
+  for (size_t i = 0; i < state.get_iterations(); i++) {
+    filesystem.mutate(mutations, random);
+
+    MessageBuffer buffer;
+    state.resume();
+    operations += root.advance(buffer, SIZE_MAX);
+    state.pause();
+    events += buffer.size();
+  }
+
+  state.set_items_processed(operations);
+  state.set_counter("entries", static_cast<double>(entries));
+  state.set_counter("rss_bytes_per_entry", rss_per_entry);
+  state.set_counter("events_per_pass", static_cast<double>(events) / static_cast<double>(state.get_iterations()));
+}
+
+// Advance a simulated tree `throttle` operations at a time, as the polling thread would, until `iterations` passes have
+// completed. Each filesystem call is charged `latency` without sleeping. Report the number of advances needed for each
+// pass and the time that a pass would take on a filesystem with that latency.
+static void virtual_throttled(BenchmarkState &state, size_t throttle, std::chrono::nanoseconds latency)
+{
+  state.pause();
+  MemoryFileSystem filesystem;
+  filesystem.populate(VIRTUAL_ROOT, 10, 2, 100);
+  PolledRoot root(string(VIRTUAL_ROOT), 1, true, std::chrono::milliseconds(0), std::chrono::milliseconds(0), string());
+  populate_virtual_root(filesystem, root);
+  filesystem.set_latency(latency, false);
+  uint64_t latency_before = filesystem.get_simulated_latency_ns();
+
+  std::mt19937 random(0x5eed);
+  size_t operations = 0;
+  size_t advances = 0;
+  state.resume();
+  for (size_t i = 0; i < state.get_iterations(); i++) {
+    size_t done = 0;
+    do {
+      MessageBuffer buffer;
+      done = root.advance(buffer, throttle);
+      operations += done;
+      advances++;
+
+      state.pause();
+      filesystem.mutate(1, random);
+      state.resume();
+    } while (done == throttle);
+  }
+  state.pause();
+
+  double passes = static_cast<double>(state.get_iterations());
+  state.set_items_processed(operations);
+  state.set_counter("advances_per_pass", static_cast<double>(advances) / passes);
+  state.set_counter("simulated_ms_per_pass",
+    static_cast<double>(filesystem.get_simulated_latency_ns() - latency_before) / 1e6 / passes);
+}
+
+void register_polling_benchmarks()
+{
+  register_benchmark("polling/full_pass/unchanged", 20, [](BenchmarkState &state) { diff(state, 0); });
+  register_benchmark("polling/full_pass/touched:10%", 20, [](BenchmarkState &state) { diff(state, 10); });
+
+  register_benchmark("polling/virtual/full_pass/entries:1M/unchanged",
+    3,
+    [](BenchmarkState &state) { virtual_diff(state, 10, 3, 900, 0); });
+  register_benchmark("polling/virtual/full_pass/entries:1M/mutations:1000",
+    3,
+    [](BenchmarkState &state) { virtual_diff(state, 10, 3, 900, 1000); });
+  register_benchmark("polling/virtual/throttled/throttle:1000/latency:1ms",
+    5,
+    [](BenchmarkState &state) { virtual_throttled(state, 1000, std::chrono::milliseconds(1)); });
+}
@@ -0,0 +1,82 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <uv.h>
+#include <vector>
+
+#include "../src/message.h"
+#include "../src/queue.h"
+#include "bench.h"
+
+using std::move;
+using std::string;
+using std::to_string;
+using std::unique_ptr;
+using std::vector;
+
+// Messages are enqueued in batches of this size, as the worker and polling threads do with `Thread::emit_all()`.
+static const size_t QUEUE_BATCH_SIZE = 64;
+
+struct Producer
+{
+  Queue *queue;
+  vector<vector<Message>> batches;
+};
+
+static void produce(void *arg)
+{
+  auto *producer = static_cast<Producer *>(arg);
+  for (vector<Message> &batch : producer->batches) {
+    producer->queue->enqueue_all(batch.begin(), batch.end());
+  }
+}
+
+// Enqueue `iterations` messages from `producer_count` threads at once while the calling thread accepts them.
+static void enqueue_accept(BenchmarkState &state, size_t producer_count)
+{
+  state.pause();
+  Queue queue;
+  vector<Producer> producers(producer_count);
+  size_t per_producer = state.get_iterations() / producer_count;
+  for (Producer &producer : producers) {
+    producer.queue = &queue;
+    for (size_t i = 0; i < per_producer; i += QUEUE_BATCH_SIZE) {
+      vector<Message> batch;
+      batch.reserve(QUEUE_BATCH_SIZE);
+      for (size_t j = 0; j < QUEUE_BATCH_SIZE; j++) {
+        batch.emplace_back(FileSystemPayload::modified(1, string("/some/path/to/a/file.txt"), KIND_FILE));
+      }
+      producer.batches.push_back(move(batch));
+    }
+  }
+  size_t expected = producer_count * producers[0].batches.size() * QUEUE_BATCH_SIZE;
+  vector<uv_thread_t> threads(producer_count);
+  state.resume();
+
+  for (size_t i = 0; i < producer_count; i++) {
+    uv_thread_create(&threads[i], &produce, &producers[i]);
+  }
+
+  size_t accepted = 0;
+  while (accepted < expected) {
+    Result<unique_ptr<vector<Message>>> ar = queue.accept_all();
+    if (ar.is_ok() && ar.get_value()) accepted += ar.get_value()->size();
+  }
+
+  for (uv_thread_t &thread : threads) {
+    uv_thread_join(&thread);
+  }
+
+  state.pause();
+  state.set_items_processed(accepted);
+}
+
+void register_queue_benchmarks()
+{
+  for (size_t producers : {1, 2, 4, 8}) {
+    register_benchmark("queue/enqueue_accept/producers:" + to_string(producers),
+      1 << 18,
+      [producers](BenchmarkState &state) { enqueue_accept(state, producers); });
+  }
+}
@@ -0,0 +1,38 @@
+#include <iostream>
+#include <string>
+#include <utility>
+
+#include "../src/message_buffer.h"
+#include "../src/result.h"
+#include "../src/worker/linux/event_capture.h"
+#include "bench.h"
+
+using std::cerr;
+using std::endl;
+using std::move;
+using std::string;
+
+// Replay an inotify capture recorded with the `workerCapture` configuration option once per iteration.
+void register_replay_benchmark(const string &capture_path, bool real_time)
+{
+  string name = string(real_time ? "replay/real_time/" : "replay/full_speed/") + capture_path;
+
+  register_benchmark(move(name), 1, [capture_path, real_time](BenchmarkState &state) {
+    state.pause();
+    EventReplay replay(capture_path);
+    if (!replay.is_healthy()) {
+      cerr << replay.get_error() << endl;
+      return;
+    }
+    state.resume();
+
+    Result<ReplayStats> r = replay.run(real_time, [](MessageBuffer &messages) { do_not_optimize(messages.size()); });
+
+    state.pause();
+    if (r.is_error()) {
+      cerr << r << endl;
+      return;
+    }
+    state.set_items_processed(r.get_value().events);
+  });
+}
@@ -4,6 +4,14 @@
         "sources": [
             "src/binding.cpp",
             "src/hub.cpp",
+            "src/burst_collapser.cpp",
+            "src/depth_limit.cpp",
+            "src/event_router.cpp",
+            "src/file_set.cpp",
+            "src/glob.cpp",
+            "src/ignore_rules.cpp",
+            "src/heavy_hitters.cpp",
+            "src/histogram.cpp",
             "src/log.cpp",
             "src/errable.cpp",
             "src/queue.cpp",
@@ -13,11 +21,15 @@
             "src/thread_starter.cpp",
             "src/thread.cpp",
             "src/status.cpp",
+            "src/trace.cpp",
             "src/worker/worker_thread.cpp",
             "src/polling/directory_record.cpp",
+            "src/polling/filesystem.cpp",
+            "src/polling/inode_index.cpp",
             "src/polling/polled_root.cpp",
             "src/polling/polling_iterator.cpp",
             "src/polling/polling_thread.cpp",
+            "src/polling/snapshot.cpp",
             "src/nan/all_callback.cpp",
             "src/nan/functional_callback.cpp",
             "src/nan/options.cpp"
@@ -61,6 +73,7 @@
                     "src/worker/linux/pipe.cpp",
                     "src/worker/linux/side_effect.cpp",
                     "src/worker/linux/cookie_jar.cpp",
+                    "src/worker/linux/event_capture.cpp",
                     "src/worker/linux/watched_directory.cpp",
                     "src/worker/linux/watch_registry.cpp",
                     "src/worker/linux/linux_worker_platform.cpp"
@@ -89,12 +102,22 @@
             }
         }
     }],
+    "variables": {
+        "watcher_trace%": 0,
+        "watcher_usdt%": "<!(node -e \"process.stdout.write(require('fs').existsSync('/usr/include/sys/sdt.h') ? '1' : '0')\")"
+    },
     "target_defaults": {
         "cflags_cc": [
             "-std=c++11",
             "-Wall"
         ],
         "conditions": [
+            ["watcher_trace==1", {
+                "defines": ["WATCHER_TRACE"]
+            }],
+            ["watcher_usdt==1", {
+                "defines": ["WATCHER_USDT"]
+            }],
             ['OS=="mac"', {
                 "xcode_settings": {
                     'CLANG_CXX_LIBRARY': 'libc++',
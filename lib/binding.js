@@ -51,6 +51,23 @@ function configure (options) {
 
   if (options.pollingThrottle) normalized.pollingThrottle = options.pollingThrottle
   if (options.pollingInterval) normalized.pollingInterval = options.pollingInterval
+  if (options.pollingCpuBudget !== undefined) normalized.pollingCpuBudget = options.pollingCpuBudget
+
+  if (options.latencyTracing !== undefined) {
+    normalized[options.latencyTracing ? 'latencyTracingEnable' : 'latencyTracingDisable'] = true
+  }
+
+  if (options.workerCapture === DISABLE) {
+    normalized.workerCaptureDisable = true
+  } else if (options.workerCapture) {
+    normalized.workerCaptureFile = options.workerCapture
+  }
+
+  if (options.pollingSnapshots === DISABLE) {
+    normalized.pollingSnapshotDisable = true
+  } else if (options.pollingSnapshots) {
+    normalized.pollingSnapshotDirectory = options.pollingSnapshots
+  }
 
   return new Promise((resolve, reject) => {
     watcher.configure(normalized, err => (err ? reject(err) : resolve(err)))
@@ -59,9 +76,17 @@ function configure (options) {
 
 module.exports = {
   watch: watcher.watch,
+  watchMany: watcher.watchMany,
   unwatch: watcher.unwatch,
+  expand: watcher.expand,
+  collapse: watcher.collapse,
+  subscribe: watcher.subscribe,
+  unsubscribe: watcher.unsubscribe,
   configure,
   status: watcher.status,
+  traceStart: watcher.traceStart,
+  traceStop: watcher.traceStop,
+  replayCapture: watcher.replayCapture,
 
   DISABLE,
   STDERR,
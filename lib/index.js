@@ -1,5 +1,9 @@
+const path = require('path')
+
 const {PathWatcherManager} = require('./path-watcher-manager')
-const {configure, status, DISABLE, STDERR, STDOUT} = require('./binding')
+const {NativeWatcher} = require('./native-watcher')
+const {commonDirectory} = require('./path-watcher')
+const {configure, status, traceStart, traceStop, DISABLE, STDERR, STDOUT} = require('./binding')
 
 // Extended: Invoke a callback with each filesystem event that occurs beneath a specified path.
 //
@@ -51,6 +55,73 @@ function watchPath (rootPath, options, eventCallback) {
   return watcher.getStartPromise().then(() => watcher)
 }
 
+// Extended: Invoke a callback with each filesystem event that affects one of a set of individual files.
+//
+// Each file is watched through its parent directory without recursing, and events for the directory's other entries
+// are discarded natively. A file that doesn't exist yet may be watched as long as its parent directory does. An editor
+// that saves by renaming a temporary file over the original produces a `"created"` event for it.
+//
+// * `filePaths` {Array} of absolute paths to the files to watch.
+// * `options` Control the watcher's behavior. See {watchPath}.
+// * `eventCallback` {Function} or other callable to be called each time a batch of filesystem events is observed. See
+//   {watchPath}.
+//
+// Returns a {Promise} that will resolve to a {PathWatcher} once it has started.
+function watchFiles (filePaths, options, eventCallback) {
+  const rootPath = commonDirectory(filePaths.map(filePath => path.dirname(filePath))) || filePaths[0]
+  return watchPath(rootPath, Object.assign({}, options, {files: filePaths}), eventCallback)
+}
+
+// Extended: Watch several root paths with the same options and callback at once.
+//
+// The native watchers that the roots require are started together: their roots are sent to the native side as a
+// single batch, sorted so that a root beneath another one re-uses the directories that were already crawled for it,
+// and the whole batch is acknowledged once. This is considerably cheaper than calling {watchPath} for each root when
+// a project opens many overlapping folders.
+//
+// * `rootPaths` {Array} of {String} absolute paths to the roots of the filesystem content to watch.
+// * `options` Control the watchers' behavior. See {watchPath}. The `files` option isn't accepted.
+// * `eventCallback` {Function} or other callable to be called each time a batch of filesystem events is observed
+//   beneath any of the roots. See {watchPath}.
+//
+// Returns a {Promise} that will resolve to an {Array} of {PathWatcher}, one for each root in the order given, once
+// all of them have started. A root that's given more than once maps to the same {PathWatcher}. If any root can't be
+// watched, the Promise is rejected and every watcher is disposed.
+async function watchMany (rootPaths, options, eventCallback) {
+  if (options && options.files) throw new Error('watchMany() does not accept the files option')
+
+  const manager = PathWatcherManager.instance()
+  const watchers = []
+
+  let failure = null
+  NativeWatcher.openBatch()
+  try {
+    for (const rootPath of Array.from(new Set(rootPaths)).sort()) {
+      watchers.push(manager.createWatcher(rootPath, options, eventCallback))
+    }
+
+    // Each watcher starts its native watcher just after attaching to it. Wait for every attachment to settle, so that
+    // none is left attaching behind a failure.
+    const errors = await Promise.all(watchers.map(watcher => watcher.getAttachedPromise().then(() => null, err => err)))
+    failure = errors.find(Boolean) || null
+    await new Promise(resolve => setImmediate(resolve))
+  } finally {
+    NativeWatcher.closeBatch()
+  }
+
+  if (!failure) {
+    failure = await Promise.all(watchers.map(watcher => watcher.getStartPromise())).then(() => null, err => err)
+  }
+
+  if (failure) {
+    for (const watcher of watchers) watcher.dispose()
+    throw failure
+  }
+
+  const byRoot = new Map(watchers.map(watcher => [watcher.watchedPath, watcher]))
+  return rootPaths.map(rootPath => byRoot.get(rootPath))
+}
+
 // Private: Return a Promise that resolves when all {NativeWatcher} instances associated with a FileSystemManager
 // have stopped listening. This is useful for `afterEach()` blocks in unit tests.
 function stopAllWatchers () {
@@ -68,11 +139,15 @@ function printWatchers () {
 
 module.exports = {
   watchPath,
+  watchFiles,
+  watchMany,
   stopAllWatchers,
   getRegistry,
   printWatchers,
   configure,
   status,
+  traceStart,
+  traceStop,
   DISABLE,
   STDERR,
   STDOUT
@@ -14,6 +14,7 @@ class NativeWatcherRegistry {
   // * `createNative` {Function} that will be called with a normalized filesystem path to create a new native
   //   filesystem watcher.
   constructor (createNative) {
+    this.createNative = createNative
     this.tree = new Tree([], createNative)
   }
 
@@ -26,9 +27,26 @@ class NativeWatcherRegistry {
   // be broadcast on each with the new parent watcher as an event payload to give child watchers a chance to attach to
   // the new watcher.
   //
+  // Watchers with a `pollingInterval` or `pollingStaleness`, `exclude` patterns, `respectIgnoreFiles`, `actions`,
+  // `ignoreAttrib`, `files`, `maxDepth` or `burstThreshold` are never consolidated. Each is given a {NativeWatcher} of
+  // its own, because they stop the native watcher from producing events that other watchers would need, or configure
+  // it in a way that a shared watcher's options would drop.
+  //
   // * `watcher` an unattached {PathWatcher}.
   async attach (watcher) {
     const normalizedDirectory = await watcher.getNormalizedPathPromise()
+    const options = watcher.getOptions()
+
+    const filtered = options.pollingInterval !== undefined || options.pollingStaleness !== undefined ||
+      (options.exclude && options.exclude.length > 0) || options.respectIgnoreFiles ||
+      (options.actions && options.actions.length > 0) || options.ignoreAttrib || options.files ||
+      options.maxDepth !== undefined || options.burstThreshold > 0
+    if (filtered) {
+      const native = this.createNative(normalizedDirectory, options)
+      watcher.attachToNative(native, normalizedDirectory, options)
+      return
+    }
+
     const pathSegments = normalizedDirectory.split(path.sep).filter(segment => segment.length > 0)
 
     this.tree.add(pathSegments, watcher.getOptions(), (native, nativePath, options) => {
@@ -5,15 +5,70 @@ const ACTIONS = new Map([
   [0, 'created'],
   [1, 'deleted'],
   [2, 'modified'],
-  [3, 'renamed']
+  [3, 'renamed'],
+  [4, 'changed']
 ])
 
 const ENTRIES = new Map([
   [0, 'file'],
   [1, 'directory'],
-  [2, 'unknown']
+  [2, 'unknown'],
+  [3, 'subtree']
 ])
 
+// Private: Convert a batch of events from the native representation to the one that's broadcast to subscribers.
+function translate (events) {
+  return events.map(event => {
+    const n = {
+      action: ACTIONS.get(event.action),
+      kind: ENTRIES.get(event.kind),
+      path: event.path
+    }
+
+    if (event.oldPath !== '') n.oldPath = event.oldPath
+    if (event.latency) n.latency = event.latency
+
+    return n
+  })
+}
+
+// Private: Number of batches opened by {NativeWatcher.openBatch} that haven't been closed yet.
+let batchDepth = 0
+
+// Private: Watchers that have asked to start while a batch was open, along with the callbacks that settle their
+// channel requests.
+let batchEntries = []
+
+// Private: Watch the roots of `entries`, which share their options, with a single native command. The events of each
+// channel are delivered to the watcher that requested it.
+function watchBatch (entries) {
+  const byChannel = new Map()
+  const onEvents = (err, events, channel) => {
+    const watcher = byChannel.get(channel)
+    if (watcher) watcher.onEvents(err, events)
+  }
+
+  const roots = entries.map(entry => entry.watcher.normalizedPath)
+  try {
+    binding.watchMany(roots, entries[0].watcher.options, (err, channels) => {
+      entries.forEach((entry, i) => {
+        const channel = channels ? channels[i] : null
+        if (channel === null || channel === undefined) {
+          entry.reject(err || new Error(`Unable to watch ${entry.watcher.normalizedPath}`))
+          return
+        }
+
+        byChannel.set(channel, entry.watcher)
+        entry.resolve(channel)
+      })
+    }, onEvents)
+  } catch (err) {
+    for (const entry of entries) {
+      entry.reject(err)
+    }
+  }
+}
+
 // Private: Possible states of a {NativeWatcher}.
 const STOPPED = Symbol('stopped')
 const STARTING = Symbol('starting')
@@ -22,6 +77,50 @@ const STOPPING = Symbol('stopping')
 
 // Private: Interface with and normalize events from a native OS filesystem watcher.
 class NativeWatcher {
+  // Private: Defer the native requests of watchers that start from now on until a matching {closeBatch} call. Batches
+  // may nest.
+  static openBatch () {
+    batchDepth++
+  }
+
+  // Private: Close the batch opened by the matching {openBatch} call. When the outermost batch closes, the watchers
+  // that started within it are sent to the native side together, one command for each distinct set of options, so
+  // that nested roots can share a single crawl and the batch is acknowledged once.
+  static closeBatch () {
+    batchDepth--
+    if (batchDepth > 0) return
+
+    const entries = batchEntries
+    batchEntries = []
+
+    const groups = new Map()
+    for (const entry of entries) {
+      const key = JSON.stringify(entry.watcher.options)
+      let group = groups.get(key)
+      if (!group) {
+        group = {entries: [], paths: new Set()}
+        groups.set(key, group)
+      }
+
+      // Identical roots would share a native channel, so any duplicate is watched on a channel of its own.
+      if (group.paths.has(entry.watcher.normalizedPath)) {
+        try {
+          entry.watcher.watchAlone(entry.resolve, entry.reject)
+        } catch (err) {
+          entry.reject(err)
+        }
+        continue
+      }
+
+      group.paths.add(entry.watcher.normalizedPath)
+      group.entries.push(entry)
+    }
+
+    for (const group of groups.values()) {
+      watchBatch(group.entries)
+    }
+  }
+
   // Private: Initialize a native watcher on a path.
   //
   // Events will not be produced until {start()} is called.
@@ -34,6 +133,9 @@ class NativeWatcher {
     this.channel = null
     this.state = STOPPED
 
+    // Subscriptions to the events within a subtree, which are routed natively. See {onDidChangeWithin}.
+    this.routes = new Set()
+
     this.onEvents = this.onEvents.bind(this)
     this.onError = this.onError.bind(this)
   }
@@ -53,21 +155,43 @@ class NativeWatcher {
 
     this.state = STARTING
 
-    this.channel = await new Promise((resolve, reject) => {
-      binding.watch(this.normalizedPath, this.options, (err, channel) => {
-        if (err) {
-          reject(err)
+    try {
+      this.channel = await new Promise((resolve, reject) => {
+        // File sets are never batched, because each one is watched through directories of its own.
+        if (batchDepth > 0 && !this.options.files) {
+          batchEntries.push({watcher: this, resolve, reject})
           return
         }
 
-        resolve(channel)
-      }, this.onEvents)
-    })
+        this.watchAlone(resolve, reject)
+      })
+    } catch (err) {
+      // Invalid options, like a malformed `exclude` pattern, are rejected before any native resources are allocated.
+      this.state = STOPPED
+      this.onError(err)
+      return
+    }
+
+    for (const route of this.routes) {
+      this.subscribeRoute(route)
+    }
 
     this.state = RUNNING
     this.emitter.emit('did-start')
   }
 
+  // Private: Request a native channel for this watcher alone. Settle `resolve` or `reject` with the outcome.
+  watchAlone (resolve, reject) {
+    binding.watch(this.normalizedPath, this.options, (err, channel) => {
+      if (err) {
+        reject(err)
+        return
+      }
+
+      resolve(channel)
+    }, this.onEvents)
+  }
+
   // Private: Return true if the underlying watcher is actively listening for filesystem events.
   isRunning () {
     return this.state === RUNNING
@@ -96,12 +220,57 @@ class NativeWatcher {
     const sub = this.emitter.on('did-change', callback)
     return new Disposable(() => {
       sub.dispose()
-      if (this.emitter.listenerCountForEventName('did-change') === 0) {
+      if (!this.hasSubscribers()) {
         this.stop()
       }
     })
   }
 
+  // Private: Register a callback to be invoked with the normalized filesystem events within `watchedPath`. Events are
+  // routed to the callback natively, so it's never invoked with events outside of its subtree, and renames across the
+  // edge of the subtree arrive as creations or deletions. Starts and stops the watcher like {onDidChange}. While any
+  // of these subscriptions exist, {onDidChange} callbacks receive no events.
+  //
+  // * `watchedPath` absolute path to the root of the subtree.
+  // * `recursive` if false, only events for `watchedPath` and its immediate children are delivered.
+  // * `callback` {Function} to be called with each batch of filesystem events.
+  //
+  // Returns: A {Disposable} to revoke the subscription.
+  onDidChangeWithin (watchedPath, recursive, callback) {
+    const route = {watchedPath, recursive, callback, id: null}
+    this.routes.add(route)
+    if (this.state === RUNNING) this.subscribeRoute(route)
+
+    this.start()
+
+    return new Disposable(() => {
+      this.routes.delete(route)
+      if (route.id !== null) {
+        binding.unsubscribe(route.id)
+        route.id = null
+      }
+      if (!this.hasSubscribers()) {
+        this.stop()
+      }
+    })
+  }
+
+  // Private: Register a route with the native watcher.
+  subscribeRoute (route) {
+    route.id = binding.subscribe(this.channel, route.watchedPath, route.recursive, (err, events) => {
+      if (err) {
+        return this.onError(err)
+      }
+
+      route.callback(translate(events))
+    })
+  }
+
+  // Private: Return true if any callbacks are registered for this watcher's events.
+  hasSubscribers () {
+    return this.emitter.listenerCountForEventName('did-change') > 0 || this.routes.size > 0
+  }
+
   // Private: Register a callback to be invoked when a {PathWatcher} should attach to a different {NativeWatcher}.
   //
   // Returns: A {Disposable} to revoke the subscription.
@@ -130,6 +299,42 @@ class NativeWatcher {
     return this.emitter.on('did-error', callback)
   }
 
+  // Private: Watch the directories up to `depth` levels beneath `dirPath` as well, on a watcher started with the
+  // `maxDepth` option. Expanding a directory again replaces its depth.
+  //
+  // * `dirPath` absolute path of a directory within the watched root.
+  // * `depth` non-negative {Number} of levels of subdirectories to watch beneath `dirPath`.
+  //
+  // Returns a {Promise} that resolves once the new directories are being watched.
+  async expand (dirPath, depth) {
+    await this.whenRunning('expand')
+    await new Promise((resolve, reject) => {
+      binding.expand(this.channel, dirPath, depth, err => (err ? reject(err) : resolve()))
+    })
+  }
+
+  // Private: Stop watching the directories that an earlier {expand} of `dirPath` watched, unless `maxDepth` or another
+  // expansion still covers them.
+  //
+  // Returns a {Promise} that resolves once they're no longer watched.
+  async collapse (dirPath) {
+    await this.whenRunning('collapse')
+    await new Promise((resolve, reject) => {
+      binding.collapse(this.channel, dirPath, err => (err ? reject(err) : resolve()))
+    })
+  }
+
+  // Private: Wait for a starting watcher to finish starting. Reject if it isn't running by then.
+  async whenRunning (operation) {
+    if (this.state === STARTING) {
+      await new Promise(resolve => this.emitter.once('did-start', resolve))
+    }
+
+    if (this.state !== RUNNING) {
+      throw new Error(`Unable to ${operation} ${this.normalizedPath}: the watcher is not running`)
+    }
+  }
+
   // Private: Broadcast an `onShouldDetach` event to prompt any {PathWatcher} instances bound here to attach to a new
   // {NativeWatcher} instead.
   //
@@ -170,6 +375,11 @@ class NativeWatcher {
     await new Promise((resolve, reject) => {
       binding.unwatch(this.channel, err => (err ? reject(err) : resolve()))
     })
+
+    // Unwatching the channel discards its native routes.
+    for (const route of this.routes) {
+      route.id = null
+    }
     this.channel = null
     this.state = STOPPED
 
@@ -185,19 +395,7 @@ class NativeWatcher {
       return this.onError(err)
     }
 
-    const translated = events.map(event => {
-      const n = {
-        action: ACTIONS.get(event.action),
-        kind: ENTRIES.get(event.kind),
-        path: event.path
-      }
-
-      if (event.oldPath !== '') n.oldPath = event.oldPath
-
-      return n
-    })
-
-    this.emitter.emit('did-change', translated)
+    this.emitter.emit('did-change', translate(events))
   }
 
   // Private: Callback function invoked by the native watcher when an error occurs.
@@ -3,6 +3,23 @@ const path = require('path')
 
 const {Emitter, CompositeDisposable, Disposable} = require('event-kit')
 
+// Private: Return the deepest directory that contains each of the absolute paths `directories`, or `null` if they
+// have none in common, like directories on separate Windows drives.
+function commonDirectory (directories) {
+  if (directories.length === 0) return null
+
+  let common = directories[0].split(path.sep)
+  for (const directory of directories.slice(1)) {
+    const segments = directory.split(path.sep)
+    let i = 0
+    while (i < common.length && i < segments.length && common[i] === segments[i]) i++
+    common = common.slice(0, i)
+  }
+
+  if (common.length === 0) return null
+  return common.length === 1 ? common[0] + path.sep : common.join(path.sep)
+}
+
 // Extended: Manage a subscription to filesystem events that occur beneath a root directory. Construct these by
 // calling `watchPath`.
 //
@@ -43,12 +60,23 @@ const {Emitter, CompositeDisposable, Disposable} = require('event-kit')
 //
 // `rootPath` {String} specifies the absolute path to the root of the filesystem content to watch.
 //
-// `options` Control the watcher's behavior. Currently a placeholder.
+// `options` Control the watcher's behavior. `exclude` is an {Array} of glob patterns matching paths beneath the root
+// to ignore entirely; see the README for their syntax. `respectIgnoreFiles` additionally ignores the paths matched by
+// `.gitignore` and `.ignore` files beneath the root. `actions` is an {Array} of the actions to report, and
+// `ignoreAttrib` drops modifications that only change an entry's attributes. `files` is an {Array} of paths, resolved
+// against the root, to watch instead of the root itself. Only the events of those files are reported, and a file that's
+// replaced by renaming another file over it is reported as created.
+// `maxDepth` is a non-negative integer that limits how many levels of directories beneath the root are watched, with
+// the root itself at depth zero. The entries of the deepest watched directories are reported, but nothing within them;
+// call {PathWatcher::expand} to watch more of the tree on demand.
+// `burstThreshold` is a positive integer: once more than that many events arrive from beneath one directory at once,
+// they're replaced by a single `"changed"` event for the directory, with the kind `"subtree"`.
 //
 // `eventCallback` {Function} to be called each time a batch of filesystem events is observed. Each event object has
 // the keys: `action`, a {String} describing the filesystem action that occurred, one of `"created"`, `"modified"`,
-// `"deleted"`, or `"renamed"`; `path`, a {String} containing the absolute path to the filesystem entry that was acted
-// upon; `kind`, a {String} describing the type of filesystem entry, one of `"file"`, `"directory"`, or `"unknown"`;
+// `"deleted"`, `"renamed"`, or `"changed"`; `path`, a {String} containing the absolute path to the filesystem entry
+// that was acted upon; `kind`, a {String} describing the type of filesystem entry, one of `"file"`, `"directory"`,
+// `"unknown"`, or `"subtree"`;
 // for rename events only, `oldPath`, a {String} containing the filesystem entry's former absolute path.
 class PathWatcher {
   // Private: Instantiate a new PathWatcher. Call {watchPath} instead.
@@ -59,9 +87,10 @@ class PathWatcher {
   constructor (nativeWatcherRegistry, watchedPath, options) {
     this.nativeWatcherRegistry = nativeWatcherRegistry
     this.watchedPath = watchedPath
-    this.options = Object.assign({recursive: true, include: () => true}, options)
+    this.options = Object.assign({recursive: true}, options)
 
     this.normalizedPath = null
+    this.routedPath = null
     this.native = null
     this.changeCallbacks = new Map()
 
@@ -77,16 +106,17 @@ class PathWatcher {
     })
     this.startPromise.catch(() => {})
 
-    this.normalizedPathPromise = Promise.all([
+    this.normalizedPathPromise = this.options.files ? this.normalizeFiles() : Promise.all([
       fs.realpath(watchedPath),
       fs.stat(watchedPath)
     ]).then(([real, stat]) => {
+      // A file is watched through its parent directory, but only its own events are delivered.
+      this.routedPath = real
       if (stat.isDirectory()) {
         this.normalizedPath = real
       } else {
         this.normalizedPath = path.dirname(real)
         this.options.recursive = false
-        this.options.include = p => p === real
       }
 
       return this.normalizedPath
@@ -102,6 +132,28 @@ class PathWatcher {
     return this.options
   }
 
+  // Private: Resolve the members of a watched file set through their parent directories, so that files that don't
+  // exist yet may be watched. The set is watched through the deepest directory that contains all of them.
+  //
+  // Returns a {Promise} that resolves with that directory.
+  async normalizeFiles () {
+    const files = this.options.files.map(file => path.resolve(this.watchedPath, file))
+    if (files.length === 0) throw new Error('At least one file must be watched')
+
+    this.options.files = await Promise.all(files.map(async file => {
+      const real = await fs.realpath(path.dirname(file))
+      return path.join(real, path.basename(file))
+    }))
+
+    const root = commonDirectory(this.options.files.map(file => path.dirname(file)))
+    if (root === null) throw new Error(`Watched files have no directory in common: ${files.join(', ')}`)
+
+    this.routedPath = root
+    this.normalizedPath = root
+    this.options.recursive = true
+    return root
+  }
+
   // Private: Return a {Promise} that will resolve with the normalized root path.
   getNormalizedPathPromise () {
     return this.normalizedPathPromise
@@ -144,6 +196,30 @@ class PathWatcher {
     return this.startPromise
   }
 
+  // Extended: Watch the directories up to `depth` levels beneath a directory as well, on a watcher created with the
+  // `maxDepth` option. The directory may lie anywhere beneath the root, including beyond `maxDepth`. Expanding a
+  // directory again replaces its depth. Has no effect on a watcher without `maxDepth`.
+  //
+  // * `subpath` {String} path of the directory to expand, resolved against the watched root.
+  // * `depth` non-negative {Number} of levels of subdirectories to watch beneath it. Defaults to 1.
+  //
+  // Returns a {Promise} that resolves once the newly covered directories are being watched.
+  async expand (subpath, depth = 1) {
+    await this.getStartPromise()
+    await this.native.expand(path.resolve(this.normalizedPath, subpath), depth)
+  }
+
+  // Extended: Stop watching the directories that an earlier {PathWatcher::expand} of a directory watched, unless
+  // `maxDepth` or another expansion still covers them. Entries within them are no longer reported.
+  //
+  // * `subpath` {String} path of the expanded directory, resolved against the watched root.
+  //
+  // Returns a {Promise} that resolves once they're no longer watched.
+  async collapse (subpath) {
+    await this.getStartPromise()
+    await this.native.collapse(path.resolve(this.normalizedPath, subpath))
+  }
+
   // Private: Attach another {Function} to be called with each batch of filesystem events. See {watchPath} for the
   // spec of the callback's argument.
   //
@@ -152,7 +228,7 @@ class PathWatcher {
   // Returns a {Disposable} that will stop the underlying watcher when all callbacks mapped to it have been disposed.
   onDidChange (callback) {
     if (this.native) {
-      const sub = this.native.onDidChange(events => this.onNativeEvents(events, callback))
+      const sub = this.subscribeToNative(this.native, callback)
       this.changeCallbacks.set(callback, sub)
 
       this.native.start()
@@ -197,7 +273,7 @@ class PathWatcher {
     this.getStartPromise().then(() => {
       if (this.native === native) {
         for (const [callback, formerSub] of this.changeCallbacks) {
-          const newSub = native.onDidChange(events => this.onNativeEvents(events, callback))
+          const newSub = this.subscribeToNative(native, callback)
           this.changeCallbacks.set(callback, newSub)
           formerSub.dispose()
         }
@@ -205,6 +281,8 @@ class PathWatcher {
     })
 
     this.subs.add(native.onDidError(err => {
+      // An error before the native watcher has started means that it never will.
+      this.rejectStartPromise(err)
       this.emitter.emit('did-error', err)
     }))
 
@@ -227,45 +305,11 @@ class PathWatcher {
     this.resolveAttachedPromise()
   }
 
-  // Private: Invoked when the attached native watcher creates a batch of native filesystem events. The native watcher's
-  // events may include events for paths above this watcher's root path, so filter them to only include the relevant
-  // ones, then re-broadcast them to our subscribers.
-  onNativeEvents (events, callback) {
-    const isWatchedPath = eventPath => {
-      if (!eventPath.startsWith(this.normalizedPath)) return false
-      if (!this.options.recursive) {
-        if (path.dirname(eventPath) !== this.normalizedPath && eventPath !== this.normalizedPath) return false
-      }
-      if (!this.options.include(eventPath)) return false
-
-      return true
-    }
-
-    const filtered = []
-    for (let i = 0; i < events.length; i++) {
-      const event = events[i]
-
-      if (event.action === 'renamed') {
-        const srcWatched = isWatchedPath(event.oldPath)
-        const destWatched = isWatchedPath(event.path)
-
-        if (srcWatched && destWatched) {
-          filtered.push(event)
-        } else if (srcWatched && !destWatched) {
-          filtered.push({action: 'deleted', kind: event.kind, path: event.oldPath})
-        } else if (!srcWatched && destWatched) {
-          filtered.push({action: 'created', kind: event.kind, path: event.path})
-        }
-      } else {
-        if (isWatchedPath(event.path)) {
-          filtered.push(event)
-        }
-      }
-    }
-
-    if (filtered.length > 0) {
-      callback(filtered)
-    }
+  // Private: Deliver the events within this watcher's root from a native watcher to `callback`. The native watcher
+  // may be watching a directory above this watcher's root, so its events are routed to the subscribers of each subtree
+  // natively rather than filtered here.
+  subscribeToNative (native, callback) {
+    return native.onDidChangeWithin(this.routedPath, this.options.recursive, callback)
   }
 
   // Extended: Unsubscribe all subscribers from filesystem events. Native resources will be release asynchronously,
@@ -296,4 +340,4 @@ class PathWatcher {
   }
 }
 
-module.exports = {PathWatcher}
+module.exports = {PathWatcher, commonDirectory}
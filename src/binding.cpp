@@ -3,7 +3,10 @@
 #include <string>
 #include <utility>
 #include <v8.h>
+#include <vector>
 
+#include "file_set.h"
+#include "glob.h"
 #include "hub.h"
 #include "nan/all_callback.h"
 #include "nan/options.h"
@@ -12,14 +15,20 @@ using std::move;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::vector;
+using v8::Array;
 using v8::Function;
 using v8::FunctionTemplate;
 using v8::Local;
+using v8::Number;
 using v8::Object;
 using v8::String;
 using v8::Uint32;
 using v8::Value;
 
+// Stands in for a numeric option that wasn't given, where zero is a meaningful value of its own.
+const uint_fast32_t OPTION_UNSET = UINT_FAST32_MAX;
+
 void configure(const Nan::FunctionCallbackInfo<Value> &info)
 {
   string main_log_file;
@@ -38,6 +47,13 @@ void configure(const Nan::FunctionCallbackInfo<Value> &info)
   bool polling_log_stdout = false;
   uint_fast32_t polling_interval = 0;
   uint_fast32_t polling_throttle = 0;
+  uint_fast32_t polling_cpu_budget = OPTION_UNSET;
+  string polling_snapshot_dir;
+  bool polling_snapshot_disable = false;
+  string worker_capture_file;
+  bool worker_capture_disable = false;
+  bool latency_tracing_enable = false;
+  bool latency_tracing_disable = false;
 
   Nan::MaybeLocal<Object> maybe_options = Nan::To<Object>(info[0]);
   if (maybe_options.IsEmpty()) {
@@ -55,6 +71,8 @@ void configure(const Nan::FunctionCallbackInfo<Value> &info)
   if (!get_bool_option(options, "workerLogDisable", worker_log_disable)) return;
   if (!get_bool_option(options, "workerLogStderr", worker_log_stderr)) return;
   if (!get_bool_option(options, "workerLogStdout", worker_log_stdout)) return;
+  if (!get_string_option(options, "workerCaptureFile", worker_capture_file)) return;
+  if (!get_bool_option(options, "workerCaptureDisable", worker_capture_disable)) return;
 
   if (!get_string_option(options, "pollingLogFile", polling_log_file)) return;
   if (!get_bool_option(options, "pollingLogDisable", polling_log_disable)) return;
@@ -62,6 +80,11 @@ void configure(const Nan::FunctionCallbackInfo<Value> &info)
   if (!get_bool_option(options, "pollingLogStdout", polling_log_stdout)) return;
   if (!get_uint_option(options, "pollingInterval", polling_interval)) return;
   if (!get_uint_option(options, "pollingThrottle", polling_throttle)) return;
+  if (!get_uint_option(options, "pollingCpuBudget", polling_cpu_budget)) return;
+  if (!get_string_option(options, "pollingSnapshotDirectory", polling_snapshot_dir)) return;
+  if (!get_bool_option(options, "pollingSnapshotDisable", polling_snapshot_disable)) return;
+  if (!get_bool_option(options, "latencyTracingEnable", latency_tracing_enable)) return;
+  if (!get_bool_option(options, "latencyTracingDisable", latency_tracing_disable)) return;
 
   unique_ptr<Nan::Callback> callback(new Nan::Callback(info[1].As<Function>()));
   shared_ptr<AllCallback> all = AllCallback::create(move(callback));
@@ -69,13 +92,23 @@ void configure(const Nan::FunctionCallbackInfo<Value> &info)
   if (main_log_disable) {
     Hub::get().disable_main_log();
   } else if (!main_log_file.empty()) {
-    Hub::get().use_main_log_file(move(main_log_file));
+    if (!Hub::get().use_main_log_file(main_log_file)) {
+      string msg("Unable to open log file " + main_log_file);
+      Nan::ThrowError(msg.c_str());
+      return;
+    }
   } else if (main_log_stderr) {
     Hub::get().use_main_log_stderr();
   } else if (main_log_stdout) {
     Hub::get().use_main_log_stdout();
   }
 
+  if (latency_tracing_disable) {
+    Hub::get().set_latency_tracing(false);
+  } else if (latency_tracing_enable) {
+    Hub::get().set_latency_tracing(true);
+  }
+
   Result<> r0 = ok_result();
   if (worker_log_disable) {
     r0 = Hub::get().disable_worker_log(all->create_callback());
@@ -108,9 +141,84 @@ void configure(const Nan::FunctionCallbackInfo<Value> &info)
     r3 = Hub::get().set_polling_throttle(polling_throttle, all->create_callback());
   }
 
+  Result<> r4 = ok_result();
+  if (polling_cpu_budget != OPTION_UNSET) {
+    r4 = Hub::get().set_polling_cpu_budget(polling_cpu_budget, all->create_callback());
+  }
+
+  Result<> r5 = ok_result();
+  if (polling_snapshot_disable) {
+    r5 = Hub::get().set_polling_snapshot_dir("", all->create_callback());
+  } else if (!polling_snapshot_dir.empty()) {
+    r5 = Hub::get().set_polling_snapshot_dir(move(polling_snapshot_dir), all->create_callback());
+  }
+
+  Result<> r6 = ok_result();
+  if (worker_capture_disable) {
+    r6 = Hub::get().set_worker_capture("", all->create_callback());
+  } else if (!worker_capture_file.empty()) {
+    r6 = Hub::get().set_worker_capture(move(worker_capture_file), all->create_callback());
+  }
+
   all->fire_if_empty();
 }
 
+// Options accepted by both `watch()` and `watchMany()`.
+struct WatchOptions
+{
+  bool poll = false;
+  bool recursive = true;
+  uint_fast32_t poll_interval = 0;
+  uint_fast32_t poll_staleness = 0;
+  bool respect_ignore_files = false;
+  vector<string> exclude_patterns;
+  ActionMask actions = ACTIONS_ALL;
+  vector<string> file_paths;
+  uint_fast32_t max_depth = UNLIMITED_DEPTH;
+  uint_fast32_t burst_threshold = 0;
+};
+
+// Read the options of a watch from `options` into `into`. Throw a JavaScript error and return false if any are
+// malformed.
+static bool get_watch_options(Local<Object> options, WatchOptions &into)
+{
+  if (!get_bool_option(options, "poll", into.poll)) return false;
+  if (!get_bool_option(options, "recursive", into.recursive)) return false;
+  if (!get_bool_option(options, "respectIgnoreFiles", into.respect_ignore_files)) return false;
+  if (!get_uint_option(options, "pollingInterval", into.poll_interval)) return false;
+  if (!get_uint_option(options, "pollingStaleness", into.poll_staleness)) return false;
+  if (!get_uint_option(options, "maxDepth", into.max_depth)) return false;
+  if (!get_uint_option(options, "burstThreshold", into.burst_threshold)) return false;
+  if (!get_string_array_option(options, "exclude", into.exclude_patterns)) return false;
+
+  vector<string> action_names;
+  bool ignore_attrib = false;
+  if (!get_string_array_option(options, "actions", action_names)) return false;
+  if (!get_bool_option(options, "ignoreAttrib", ignore_attrib)) return false;
+
+  if (!action_names.empty()) {
+    into.actions = ACTIONS_ATTRIBUTES;
+    for (const string &name : action_names) {
+      if (name == "created") {
+        into.actions |= action_mask(ACTION_CREATED);
+      } else if (name == "deleted") {
+        into.actions |= action_mask(ACTION_DELETED);
+      } else if (name == "modified") {
+        into.actions |= action_mask(ACTION_MODIFIED);
+      } else if (name == "renamed") {
+        into.actions |= action_mask(ACTION_RENAMED);
+      } else {
+        string msg("option actions contains the unknown action \"" + name + "\"");
+        Nan::ThrowError(msg.c_str());
+        return false;
+      }
+    }
+  }
+  if (ignore_attrib) into.actions &= ~ACTIONS_ATTRIBUTES;
+
+  return get_string_array_option(options, "files", into.file_paths);
+}
+
 void watch(const Nan::FunctionCallbackInfo<Value> &info)
 {
   if (info.Length() != 4) {
@@ -137,15 +245,107 @@ void watch(const Nan::FunctionCallbackInfo<Value> &info)
   }
   Local<Object> options = maybe_options.ToLocalChecked();
 
-  bool poll = false;
-  bool recursive = true;
-  if (!get_bool_option(options, "poll", poll)) return;
-  if (!get_bool_option(options, "recursive", recursive)) return;
+  WatchOptions watch_options;
+  if (!get_watch_options(options, watch_options)) return;
+
+  shared_ptr<const GlobSet> exclude;
+  if (!watch_options.exclude_patterns.empty()) {
+    Result<shared_ptr<const GlobSet>> er = GlobSet::compile(root_str, watch_options.exclude_patterns);
+    if (er.is_error()) {
+      Nan::ThrowError(er.get_error().c_str());
+      return;
+    }
+    exclude = er.get_value();
+  }
+
+  shared_ptr<const FileSet> files;
+  if (!watch_options.file_paths.empty()) {
+    Result<shared_ptr<const FileSet>> fr = FileSet::create(watch_options.file_paths);
+    if (fr.is_error()) {
+      Nan::ThrowError(fr.get_error().c_str());
+      return;
+    }
+    files = fr.get_value();
+  }
+
+  unique_ptr<Nan::Callback> ack_callback(new Nan::Callback(info[2].As<Function>()));
+  unique_ptr<Nan::Callback> event_callback(new Nan::Callback(info[3].As<Function>()));
+
+  Result<> r = Hub::get().watch(move(root_str),
+    watch_options.poll,
+    watch_options.recursive,
+    watch_options.poll_interval,
+    watch_options.poll_staleness,
+    move(exclude),
+    watch_options.respect_ignore_files,
+    watch_options.actions,
+    move(files),
+    watch_options.max_depth,
+    watch_options.burst_threshold,
+    move(ack_callback),
+    move(event_callback));
+  if (r.is_error()) {
+    Nan::ThrowError(r.get_error().c_str());
+  }
+}
+
+void watch_many(const Nan::FunctionCallbackInfo<Value> &info)
+{
+  if (info.Length() != 4) {
+    return Nan::ThrowError("watchMany() requires four arguments");
+  }
+
+  if (!info[0]->IsArray()) {
+    Nan::ThrowError("watchMany() requires an Array of Strings as argument one");
+    return;
+  }
+  Local<Array> js_roots = info[0].As<Array>();
+  vector<string> roots;
+  roots.reserve(js_roots->Length());
+  for (uint32_t i = 0; i < js_roots->Length(); i++) {
+    Nan::MaybeLocal<Value> maybe_root = Nan::Get(js_roots, i);
+    if (maybe_root.IsEmpty() || !maybe_root.ToLocalChecked()->IsString()) {
+      Nan::ThrowError("watchMany() requires an Array of Strings as argument one");
+      return;
+    }
+
+    Nan::Utf8String root_utf8(maybe_root.ToLocalChecked());
+    if (*root_utf8 == nullptr) {
+      Nan::ThrowError("watchMany() argument one must contain valid UTF-8 Strings");
+      return;
+    }
+    roots.emplace_back(*root_utf8, root_utf8.length());
+  }
+
+  Nan::MaybeLocal<Object> maybe_options = Nan::To<Object>(info[1]);
+  if (maybe_options.IsEmpty()) {
+    Nan::ThrowError("watchMany() requires an option object");
+    return;
+  }
+  Local<Object> options = maybe_options.ToLocalChecked();
+
+  WatchOptions watch_options;
+  if (!get_watch_options(options, watch_options)) return;
+  if (!watch_options.file_paths.empty()) {
+    Nan::ThrowError("watchMany() does not accept the files option");
+    return;
+  }
 
   unique_ptr<Nan::Callback> ack_callback(new Nan::Callback(info[2].As<Function>()));
   unique_ptr<Nan::Callback> event_callback(new Nan::Callback(info[3].As<Function>()));
 
-  Result<> r = Hub::get().watch(move(root_str), poll, recursive, move(ack_callback), move(event_callback));
+  Result<> r = Hub::get().watch_many(move(roots),
+    watch_options.poll,
+    watch_options.recursive,
+    watch_options.poll_interval,
+    watch_options.poll_staleness,
+    watch_options.exclude_patterns,
+    watch_options.respect_ignore_files,
+    watch_options.actions,
+    watch_options.max_depth,
+    watch_options.burst_threshold,
+    move(ack_callback),
+    move(event_callback));
   if (r.is_error()) {
     Nan::ThrowError(r.get_error().c_str());
   }
@@ -173,10 +373,167 @@ void unwatch(const Nan::FunctionCallbackInfo<Value> &info)
   }
 }
 
+// Read the channel ID and directory arguments shared by `expand()` and `collapse()`. Throw a JavaScript error and
+// return false if either is malformed.
+static bool get_channel_dir_args(const Nan::FunctionCallbackInfo<Value> &info,
+  const char *fn_name,
+  ChannelID &channel_id,
+  string &dir)
+{
+  Nan::Maybe<uint32_t> maybe_channel_id = Nan::To<uint32_t>(info[0]);
+  if (maybe_channel_id.IsNothing()) {
+    Nan::ThrowError((string(fn_name) + "() requires a channel ID as its first argument").c_str());
+    return false;
+  }
+  channel_id = static_cast<ChannelID>(maybe_channel_id.FromJust());
+
+  Nan::MaybeLocal<String> maybe_dir = Nan::To<String>(info[1]);
+  if (maybe_dir.IsEmpty()) {
+    Nan::ThrowError((string(fn_name) + "() requires a string as its second argument").c_str());
+    return false;
+  }
+  Nan::Utf8String dir_utf8(maybe_dir.ToLocalChecked());
+  if (*dir_utf8 == nullptr) {
+    Nan::ThrowError((string(fn_name) + "() argument two must be a valid UTF-8 string").c_str());
+    return false;
+  }
+  dir.assign(*dir_utf8, dir_utf8.length());
+  return true;
+}
+
+void expand(const Nan::FunctionCallbackInfo<Value> &info)
+{
+  if (info.Length() != 4) {
+    Nan::ThrowError("expand() requires four arguments");
+    return;
+  }
+
+  ChannelID channel_id = NULL_CHANNEL_ID;
+  string dir;
+  if (!get_channel_dir_args(info, "expand", channel_id, dir)) return;
+
+  if (!info[2]->IsUint32()) {
+    Nan::ThrowError("expand() requires a non-negative integer depth as its third argument");
+    return;
+  }
+  auto depth = static_cast<uint_fast32_t>(Nan::To<uint32_t>(info[2]).FromJust());
+
+  unique_ptr<Nan::Callback> ack_callback(new Nan::Callback(info[3].As<Function>()));
+
+  Result<> r = Hub::get().expand(channel_id, move(dir), depth, move(ack_callback));
+  if (r.is_error()) {
+    Nan::ThrowError(r.get_error().c_str());
+  }
+}
+
+void collapse(const Nan::FunctionCallbackInfo<Value> &info)
+{
+  if (info.Length() != 3) {
+    Nan::ThrowError("collapse() requires three arguments");
+    return;
+  }
+
+  ChannelID channel_id = NULL_CHANNEL_ID;
+  string dir;
+  if (!get_channel_dir_args(info, "collapse", channel_id, dir)) return;
+
+  unique_ptr<Nan::Callback> ack_callback(new Nan::Callback(info[2].As<Function>()));
+
+  Result<> r = Hub::get().collapse(channel_id, move(dir), move(ack_callback));
+  if (r.is_error()) {
+    Nan::ThrowError(r.get_error().c_str());
+  }
+}
+
+void subscribe(const Nan::FunctionCallbackInfo<Value> &info)
+{
+  if (info.Length() != 4) {
+    Nan::ThrowError("subscribe() requires four arguments");
+    return;
+  }
+
+  Nan::Maybe<uint32_t> maybe_channel_id = Nan::To<uint32_t>(info[0]);
+  if (maybe_channel_id.IsNothing()) {
+    Nan::ThrowError("subscribe() requires a channel ID as its first argument");
+    return;
+  }
+  auto channel_id = static_cast<ChannelID>(maybe_channel_id.FromJust());
+
+  Nan::MaybeLocal<String> maybe_path = Nan::To<String>(info[1]);
+  if (maybe_path.IsEmpty()) {
+    Nan::ThrowError("subscribe() requires a string as its second argument");
+    return;
+  }
+  Nan::Utf8String path_utf8(maybe_path.ToLocalChecked());
+  if (*path_utf8 == nullptr) {
+    Nan::ThrowError("subscribe() argument two must be a valid UTF-8 string");
+    return;
+  }
+  string path_str(*path_utf8, path_utf8.length());
+
+  bool recursive = Nan::To<bool>(info[2]).FromMaybe(true);
+
+  unique_ptr<Nan::Callback> callback(new Nan::Callback(info[3].As<Function>()));
+
+  Result<SubscriptionID> r = Hub::get().subscribe(channel_id, path_str, recursive, move(callback));
+  if (r.is_error()) {
+    Nan::ThrowError(r.get_error().c_str());
+    return;
+  }
+  info.GetReturnValue().Set(Nan::New<Uint32>(static_cast<uint32_t>(r.get_value())));
+}
+
+void unsubscribe(const Nan::FunctionCallbackInfo<Value> &info)
+{
+  Nan::Maybe<uint32_t> maybe_subscription_id = Nan::To<uint32_t>(info[0]);
+  if (maybe_subscription_id.IsNothing()) {
+    Nan::ThrowError("unsubscribe() requires a subscription ID as its first argument");
+    return;
+  }
+
+  Hub::get().unsubscribe(static_cast<SubscriptionID>(maybe_subscription_id.FromJust()));
+}
+
+Local<Object> histogram_object(const HistogramSummary &summary)
+{
+  Local<Object> histogram = Nan::New<Object>();
+  Nan::Set(histogram, Nan::New<String>("count").ToLocalChecked(), Nan::New<Number>(static_cast<double>(summary.count)));
+  Nan::Set(histogram, Nan::New<String>("min").ToLocalChecked(), Nan::New<Number>(static_cast<double>(summary.min)));
+  Nan::Set(histogram, Nan::New<String>("mean").ToLocalChecked(), Nan::New<Number>(static_cast<double>(summary.mean)));
+  Nan::Set(histogram, Nan::New<String>("p50").ToLocalChecked(), Nan::New<Number>(static_cast<double>(summary.p50)));
+  Nan::Set(histogram, Nan::New<String>("p90").ToLocalChecked(), Nan::New<Number>(static_cast<double>(summary.p90)));
+  Nan::Set(histogram, Nan::New<String>("p99").ToLocalChecked(), Nan::New<Number>(static_cast<double>(summary.p99)));
+  Nan::Set(histogram, Nan::New<String>("max").ToLocalChecked(), Nan::New<Number>(static_cast<double>(summary.max)));
+  return histogram;
+}
+
+Local<Array> hot_directories_array(const vector<HotDirectory> &directories)
+{
+  Local<Array> array = Nan::New<Array>(directories.size());
+  for (size_t i = 0; i < directories.size(); i++) {
+    const HotDirectory &directory = directories[i];
+    Local<Object> entry = Nan::New<Object>();
+    Nan::Set(entry, Nan::New<String>("path").ToLocalChecked(), Nan::New<String>(directory.path).ToLocalChecked());
+    Nan::Set(
+      entry, Nan::New<String>("events").ToLocalChecked(), Nan::New<Number>(static_cast<double>(directory.events)));
+    Nan::Set(entry, Nan::New<String>("recentRate").ToLocalChecked(), Nan::New<Number>(directory.recent_rate));
+    Nan::Set(entry, Nan::New<String>("rate").ToLocalChecked(), Nan::New<Number>(directory.rate));
+    Nan::Set(array, static_cast<uint32_t>(i), entry);
+  }
+  return array;
+}
+
 void status(const Nan::FunctionCallbackInfo<Value> &info)
 {
+  bool reset = false;
+  if (info.Length() > 0 && info[0]->IsObject()) {
+    Local<Object> options = Nan::To<Object>(info[0]).ToLocalChecked();
+    if (!get_bool_option(options, "reset", reset)) return;
+  }
+
   Status status;
   Hub::get().collect_status(status);
+  if (reset) Hub::get().reset_status();
 
   Local<Object> status_object = Nan::New<Object>();
   Nan::Set(status_object,
@@ -185,6 +542,21 @@ void status(const Nan::FunctionCallbackInfo<Value> &info)
   Nan::Set(status_object,
     Nan::New<String>("channelCallbackCount").ToLocalChecked(),
     Nan::New<Uint32>(static_cast<uint32_t>(status.channel_callback_count)));
+  Nan::Set(status_object,
+    Nan::New<String>("dispatchDuration").ToLocalChecked(),
+    histogram_object(status.dispatch_duration));
+  Nan::Set(status_object,
+    Nan::New<String>("callbackDuration").ToLocalChecked(),
+    histogram_object(status.callback_duration));
+  Nan::Set(status_object,
+    Nan::New<String>("channelBatchSize").ToLocalChecked(),
+    histogram_object(status.channel_batch));
+  Nan::Set(status_object, Nan::New<String>("latencyEmit").ToLocalChecked(), histogram_object(status.latency_emit));
+  Nan::Set(status_object, Nan::New<String>("latencyQueue").ToLocalChecked(), histogram_object(status.latency_queue));
+  Nan::Set(status_object,
+    Nan::New<String>("latencyDispatch").ToLocalChecked(),
+    histogram_object(status.latency_dispatch));
+  Nan::Set(status_object, Nan::New<String>("latencyTotal").ToLocalChecked(), histogram_object(status.latency_total));
   Nan::Set(status_object,
     Nan::New<String>("workerThreadState").ToLocalChecked(),
     Nan::New<String>(status.worker_thread_state).ToLocalChecked());
@@ -203,6 +575,24 @@ void status(const Nan::FunctionCallbackInfo<Value> &info)
   Nan::Set(status_object,
     Nan::New<String>("workerOutOk").ToLocalChecked(),
     Nan::New<String>(status.worker_out_ok).ToLocalChecked());
+  Nan::Set(status_object,
+    Nan::New<String>("workerInHighWater").ToLocalChecked(),
+    Nan::New<Number>(static_cast<double>(status.worker_in_high_water)));
+  Nan::Set(status_object,
+    Nan::New<String>("workerOutHighWater").ToLocalChecked(),
+    Nan::New<Number>(static_cast<double>(status.worker_out_high_water)));
+  Nan::Set(status_object,
+    Nan::New<String>("workerReadBatchSize").ToLocalChecked(),
+    histogram_object(status.worker_read_batch));
+  Nan::Set(status_object,
+    Nan::New<String>("workerKernelQueueDepth").ToLocalChecked(),
+    histogram_object(status.worker_kernel_queue_depth));
+  Nan::Set(status_object,
+    Nan::New<String>("workerOverflows").ToLocalChecked(),
+    Nan::New<Number>(static_cast<double>(status.worker_overflows)));
+  Nan::Set(status_object,
+    Nan::New<String>("workerHotDirectories").ToLocalChecked(),
+    hot_directories_array(status.worker_hot_directories));
   Nan::Set(status_object,
     Nan::New<String>("pollingThreadState").ToLocalChecked(),
     Nan::New<String>(status.polling_thread_state).ToLocalChecked());
@@ -221,9 +611,101 @@ void status(const Nan::FunctionCallbackInfo<Value> &info)
   Nan::Set(status_object,
     Nan::New<String>("pollingOutOk").ToLocalChecked(),
     Nan::New<String>(status.polling_out_ok).ToLocalChecked());
+  Nan::Set(status_object,
+    Nan::New<String>("pollingCpuBudget").ToLocalChecked(),
+    Nan::New<Number>(static_cast<double>(status.polling_cpu_budget)));
+  Nan::Set(status_object,
+    Nan::New<String>("pollingCpuUsage").ToLocalChecked(),
+    Nan::New<Number>(static_cast<double>(status.polling_cpu_usage)));
+  Nan::Set(status_object,
+    Nan::New<String>("pollingStaleness").ToLocalChecked(),
+    Nan::New<Number>(static_cast<double>(status.polling_staleness)));
+  Nan::Set(status_object,
+    Nan::New<String>("pollingSlaMisses").ToLocalChecked(),
+    Nan::New<Number>(static_cast<double>(status.polling_sla_misses)));
+  Nan::Set(status_object,
+    Nan::New<String>("pollingInHighWater").ToLocalChecked(),
+    Nan::New<Number>(static_cast<double>(status.polling_in_high_water)));
+  Nan::Set(status_object,
+    Nan::New<String>("pollingOutHighWater").ToLocalChecked(),
+    Nan::New<Number>(static_cast<double>(status.polling_out_high_water)));
+  Nan::Set(status_object,
+    Nan::New<String>("pollingCycleDuration").ToLocalChecked(),
+    histogram_object(status.polling_cycle_duration));
+  Nan::Set(status_object,
+    Nan::New<String>("pollingHotDirectories").ToLocalChecked(),
+    hot_directories_array(status.polling_hot_directories));
   info.GetReturnValue().Set(status_object);
 }
 
+void start_trace(const Nan::FunctionCallbackInfo<Value> & /*info*/)
+{
+  Hub::get().start_trace();
+}
+
+void stop_trace(const Nan::FunctionCallbackInfo<Value> &info)
+{
+  if (info.Length() != 1) {
+    Nan::ThrowError("traceStop() requires one argument");
+    return;
+  }
+
+  Nan::MaybeLocal<String> maybe_path = Nan::To<String>(info[0]);
+  if (maybe_path.IsEmpty()) {
+    Nan::ThrowError("traceStop() requires a string as argument one");
+    return;
+  }
+  Nan::Utf8String path_utf8(maybe_path.ToLocalChecked());
+  if (*path_utf8 == nullptr) {
+    Nan::ThrowError("traceStop() argument one must be a valid UTF-8 string");
+    return;
+  }
+  string path(*path_utf8, path_utf8.length());
+
+  Result<TraceSummary> r = Hub::get().stop_trace(path);
+  if (r.is_error()) {
+    Nan::ThrowError(r.get_error().c_str());
+    return;
+  }
+
+  Local<Object> summary = Nan::New<Object>();
+  Nan::Set(summary,
+    Nan::New<String>("spanCount").ToLocalChecked(),
+    Nan::New<Number>(static_cast<double>(r.get_value().span_count)));
+  Nan::Set(summary,
+    Nan::New<String>("droppedCount").ToLocalChecked(),
+    Nan::New<Number>(static_cast<double>(r.get_value().dropped_count)));
+  info.GetReturnValue().Set(summary);
+}
+
+void replay_capture(const Nan::FunctionCallbackInfo<Value> &info)
+{
+  if (info.Length() != 1) {
+    Nan::ThrowError("replayCapture() requires one argument");
+    return;
+  }
+
+  Nan::MaybeLocal<String> maybe_path = Nan::To<String>(info[0]);
+  if (maybe_path.IsEmpty()) {
+    Nan::ThrowError("replayCapture() requires a string as argument one");
+    return;
+  }
+  Nan::Utf8String path_utf8(maybe_path.ToLocalChecked());
+  if (*path_utf8 == nullptr) {
+    Nan::ThrowError("replayCapture() argument one must be a valid UTF-8 string");
+    return;
+  }
+  string path(*path_utf8, path_utf8.length());
+
+  Local<Object> js_events = Nan::New<Object>();
+  Result<> r = Hub::get().replay_capture(path, js_events);
+  if (r.is_error()) {
+    Nan::ThrowError(r.get_error().c_str());
+    return;
+  }
+  info.GetReturnValue().Set(js_events);
+}
+
 void initialize(Local<Object> exports)
 {
   Nan::Set(exports,
@@ -232,12 +714,36 @@ void initialize(Local<Object> exports)
   Nan::Set(exports,
     Nan::New<String>("watch").ToLocalChecked(),
     Nan::GetFunction(Nan::New<FunctionTemplate>(watch)).ToLocalChecked());
+  Nan::Set(exports,
+    Nan::New<String>("watchMany").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(watch_many)).ToLocalChecked());
   Nan::Set(exports,
     Nan::New<String>("unwatch").ToLocalChecked(),
     Nan::GetFunction(Nan::New<FunctionTemplate>(unwatch)).ToLocalChecked());
+  Nan::Set(exports,
+    Nan::New<String>("expand").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(expand)).ToLocalChecked());
+  Nan::Set(exports,
+    Nan::New<String>("collapse").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(collapse)).ToLocalChecked());
+  Nan::Set(exports,
+    Nan::New<String>("subscribe").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(subscribe)).ToLocalChecked());
+  Nan::Set(exports,
+    Nan::New<String>("unsubscribe").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(unsubscribe)).ToLocalChecked());
   Nan::Set(exports,
     Nan::New<String>("status").ToLocalChecked(),
     Nan::GetFunction(Nan::New<FunctionTemplate>(status)).ToLocalChecked());
+  Nan::Set(exports,
+    Nan::New<String>("traceStart").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(start_trace)).ToLocalChecked());
+  Nan::Set(exports,
+    Nan::New<String>("traceStop").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(stop_trace)).ToLocalChecked());
+  Nan::Set(exports,
+    Nan::New<String>("replayCapture").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(replay_capture)).ToLocalChecked());
 }
 
 NODE_MODULE(watcher, initialize);  // NOLINT
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "burst_collapser.h"
+#include "helper/common.h"
+#include "message.h"
+
+using std::map;
+using std::move;
+using std::pair;
+using std::set;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+// Order directories deepest first, so that each directory is tallied after everything beneath it.
+struct DeepestFirst
+{
+  bool operator()(const string &a, const string &b) const
+  {
+    if (a.size() != b.size()) return a.size() > b.size();
+    return a < b;
+  }
+};
+
+struct Tally
+{
+  uint64_t count{0};
+  bool collapsed{false};
+};
+
+void BurstCollapser::set_threshold(ChannelID channel_id, const string &root, uint_fast32_t threshold)
+{
+  if (threshold == 0) {
+    forget(channel_id);
+    return;
+  }
+
+  Channel &channel = channels[channel_id];
+  channel.threshold = threshold;
+
+  // Keep only the outermost roots, so that each directory is matched against the fewest.
+  vector<string> &roots = channel.roots;
+  for (const string &existing : roots) {
+    if (path_within(root, existing)) return;
+  }
+  auto within = [&root](const string &existing) { return path_within(existing, root); };
+  roots.erase(std::remove_if(roots.begin(), roots.end(), within), roots.end());
+  roots.push_back(root);
+}
+
+void BurstCollapser::forget(ChannelID channel_id)
+{
+  channels.erase(channel_id);
+}
+
+uint_fast32_t BurstCollapser::get_threshold(ChannelID channel_id) const
+{
+  auto it = channels.find(channel_id);
+  return it != channels.end() ? it->second.threshold : 0;
+}
+
+void BurstCollapser::collapse(vector<Message> &messages, uint64_t now)
+{
+  if (channels.empty()) return;
+
+  // Count each event against its directory, and carry each directory's count up to its parent.
+  unordered_map<ChannelID, map<string, Tally, DeepestFirst>> tallies;
+  vector<string> counted(messages.size());
+  bool any = false;
+
+  for (size_t i = 0; i < messages.size(); i++) {
+    const FileSystemPayload *fs = messages[i].as_filesystem();
+    if (fs == nullptr) continue;
+
+    auto channel = channels.find(fs->get_channel_id());
+    if (channel == channels.end()) continue;
+
+    string dir = counted_at(*fs);
+    if (!within_roots(channel->second, dir)) continue;
+
+    tallies[channel->first][dir].count++;
+    counted[i] = move(dir);
+    any = true;
+  }
+  if (!any) return;
+
+  for (auto &each : tallies) {
+    Channel &channel = channels[each.first];
+    map<string, Tally, DeepestFirst> &tally = each.second;
+
+    for (auto it = channel.bursting.begin(); it != channel.bursting.end();) {
+      if (it->second <= now) {
+        it = channel.bursting.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    // Parents sort after their children, so those inserted here are visited later in the same loop.
+    for (auto it = tally.begin(); it != tally.end(); ++it) {
+      Tally &t = it->second;
+      if (t.count > channel.threshold || channel.bursting.find(it->first) != channel.bursting.end()) {
+        t.collapsed = true;
+      }
+
+      string parent = path_parent(it->first);
+      if (parent == it->first || !within_roots(channel, parent)) continue;
+      tally[parent].count += t.collapsed ? 1 : t.count;
+    }
+  }
+
+  // Replace each counted event beneath a collapsed directory by a summary of the outermost such directory.
+  vector<Message> collapsed;
+  collapsed.reserve(messages.size());
+  set<pair<ChannelID, string>> summarized;
+
+  for (size_t i = 0; i < messages.size(); i++) {
+    if (counted[i].empty()) {
+      collapsed.emplace_back(move(messages[i]));
+      continue;
+    }
+
+    ChannelID channel_id = messages[i].as_filesystem()->get_channel_id();
+    Channel &channel = channels[channel_id];
+    map<string, Tally, DeepestFirst> &tally = tallies[channel_id];
+
+    string outermost;
+    string dir = move(counted[i]);
+    while (true) {
+      auto t = tally.find(dir);
+      if (t == tally.end()) break;
+      if (t->second.collapsed) outermost = dir;
+
+      string parent = path_parent(dir);
+      if (parent == dir || !within_roots(channel, parent)) break;
+      dir = move(parent);
+    }
+
+    if (outermost.empty()) {
+      collapsed.emplace_back(move(messages[i]));
+      continue;
+    }
+
+    channel.bursting[outermost] = now + BURST_QUIET_PERIOD;
+    if (summarized.emplace(channel_id, outermost).second) {
+      collapsed.emplace_back(FileSystemPayload::subtree_changed(channel_id, move(outermost)));
+    }
+  }
+
+  messages.swap(collapsed);
+}
+
+string BurstCollapser::counted_at(const FileSystemPayload &fs)
+{
+  string dir = path_parent(fs.get_path());
+  if (fs.get_filesystem_action() != ACTION_RENAMED) return dir;
+
+  string old_dir = path_parent(fs.get_old_path());
+  while (!path_within(old_dir, dir)) {
+    string parent = path_parent(dir);
+    if (parent == dir) return string();
+    dir = move(parent);
+  }
+  return dir;
+}
+
+bool BurstCollapser::within_roots(const Channel &channel, const string &dir)
+{
+  for (const string &root : channel.roots) {
+    if (path_within(dir, root)) return true;
+  }
+  return false;
+}
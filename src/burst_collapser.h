@@ -0,0 +1,79 @@
+#ifndef BURST_COLLAPSER_H
+#define BURST_COLLAPSER_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "message.h"
+
+// Once a directory's events have been collapsed, later events beneath it are folded into a fresh summary until it's
+// produced none for this long, in nanoseconds, so that a burst spread across several batches is still reported once
+// per batch.
+const uint64_t BURST_QUIET_PERIOD = 1000000000;
+
+// Replace bursts of filesystem events beneath a single directory with one `ACTION_CHANGED` event that summarizes the
+// directory's whole subtree, for the channels that ask for it.
+//
+// Each event is counted against its parent directory, and a rename against the deepest directory that holds both of
+// its paths. Directories are then visited deepest first: a directory's count is its own events plus the counts of its
+// subdirectories, and once that exceeds the channel's threshold, every event beneath it is replaced by a summary that
+// counts as a single event toward its parent. A channel therefore never receives more than its threshold of events
+// from beneath any one directory in a batch. Summaries are never placed above the roots the channel was added with.
+//
+// A collapser is only used by the thread that emits its events, so it isn't synchronized.
+class BurstCollapser
+{
+public:
+  BurstCollapser() = default;
+
+  ~BurstCollapser() = default;
+
+  // Collapse bursts of more than `threshold` events beneath any directory within `root` on the channel `channel_id`.
+  // A channel may collapse bursts within several roots, all with the same threshold. A threshold of zero forgets the
+  // channel instead.
+  void set_threshold(ChannelID channel_id, const std::string &root, uint_fast32_t threshold);
+
+  // Stop collapsing the events of the channel `channel_id`.
+  void forget(ChannelID channel_id);
+
+  // Return the threshold of the channel `channel_id`, or zero if its events are never collapsed.
+  uint_fast32_t get_threshold(ChannelID channel_id) const;
+
+  // Return true if no channel collapses its events, so that batches may be emitted untouched.
+  bool empty() const { return channels.empty(); }
+
+  // Replace the bursts within the batch `messages` in place. Each summary takes the position of the first event it
+  // replaces. Messages that aren't filesystem events are left as they are. `now` is a `uv_hrtime()` timestamp.
+  void collapse(std::vector<Message> &messages, uint64_t now);
+
+  BurstCollapser(const BurstCollapser &) = delete;
+  BurstCollapser(BurstCollapser &&) = delete;
+  BurstCollapser &operator=(const BurstCollapser &) = delete;
+  BurstCollapser &operator=(BurstCollapser &&) = delete;
+
+private:
+  struct Channel
+  {
+    uint_fast32_t threshold;
+
+    // Roots within which bursts are collapsed. None lies within another.
+    std::vector<std::string> roots;
+
+    // Directories whose events have been collapsed recently, mapped to the time at which they'll have been quiet for
+    // `BURST_QUIET_PERIOD`.
+    std::map<std::string, uint64_t> bursting;
+  };
+
+  // Return the directory that the event `fs` is counted against.
+  static std::string counted_at(const FileSystemPayload &fs);
+
+  // Return true if `dir` lies within one of `channel`'s roots.
+  static bool within_roots(const Channel &channel, const std::string &dir);
+
+  std::unordered_map<ChannelID, Channel> channels;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "depth_limit.h"
+#include "helper/common.h"
+
+using std::ostream;
+using std::string;
+
+DepthLimit::DepthLimit(const string &root, uint_fast32_t max_depth) : root(root), max_depth{max_depth}
+{
+  //
+}
+
+void DepthLimit::expand(const string &dir, uint_fast32_t depth)
+{
+  expansions[dir] = depth;
+}
+
+bool DepthLimit::collapse(const string &dir)
+{
+  return expansions.erase(dir) > 0;
+}
+
+int_fast64_t DepthLimit::levels_below(const string &dir) const
+{
+  int_fast64_t levels = -1;
+
+  int_fast64_t depth = depth_within(dir, root);
+  if (depth >= 0) levels = static_cast<int_fast64_t>(max_depth) - depth;
+
+  for (auto &expansion : expansions) {
+    int_fast64_t within = depth_within(dir, expansion.first);
+    if (within < 0) continue;
+
+    int_fast64_t expanded = static_cast<int_fast64_t>(expansion.second) - within;
+    if (expanded > levels) levels = expanded;
+  }
+
+  return levels < 0 ? -1 : levels;
+}
+
+bool DepthLimit::reaches(const string &dir) const
+{
+  if (covers(dir)) return true;
+
+  for (auto &expansion : expansions) {
+    if (depth_within(expansion.first, dir) >= 0) return true;
+  }
+  return false;
+}
+
+bool DepthLimit::reports(const string &path) const
+{
+  if (covers(path)) return true;
+
+  string parent = path_parent(path);
+  return parent != path && covers(parent);
+}
+
+int_fast64_t DepthLimit::depth_within(const string &path, const string &dir)
+{
+  if (path.size() < dir.size() || path.compare(0, dir.size(), dir) != 0) return -1;
+  if (path.size() == dir.size()) return 0;
+  if (!is_separator(dir.back()) && !is_separator(path[dir.size()])) return -1;
+
+  int_fast64_t depth = 0;
+  for (size_t i = dir.size(); i < path.size(); i++) {
+    if (!is_separator(path[i]) && (i == 0 || is_separator(path[i - 1]))) depth++;
+  }
+  return depth;
+}
+
+ostream &operator<<(ostream &out, const DepthLimit &limit)
+{
+  out << "depth " << limit.get_max_depth();
+  if (!limit.get_expansions().empty()) {
+    out << " expanded at";
+    for (auto &expansion : limit.get_expansions()) {
+      out << " " << expansion.first << " (" << expansion.second << ")";
+    }
+  }
+  return out;
+}
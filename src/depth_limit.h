@@ -0,0 +1,70 @@
+#ifndef DEPTH_LIMIT_H
+#define DEPTH_LIMIT_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+
+// Limit how deep beneath a recursively watched root directories are watched. Directories up to `max_depth` levels
+// beneath the root are watched, with the root itself at depth zero, and so are those within a chosen number of levels
+// of each directory that's been expanded, wherever it lies. Events are reported for the entries of every watched
+// directory, so the entries of the deepest watched directories are reported, but nothing within them.
+//
+// Unlike `GlobSet` and `FileSet`, a limit changes as directories are expanded and collapsed, so each thread keeps a
+// `DepthLimit` of its own.
+class DepthLimit
+{
+public:
+  DepthLimit(const std::string &root, uint_fast32_t max_depth);
+
+  ~DepthLimit() = default;
+
+  // Watch the directories up to `depth` levels beneath the absolute path `dir` as well. Expanding a directory again
+  // replaces its depth.
+  void expand(const std::string &dir, uint_fast32_t depth);
+
+  // Forget the expansion of `dir`. Return false if it wasn't expanded.
+  bool collapse(const std::string &dir);
+
+  // Return the number of levels of subdirectories beneath the absolute path `dir` that may be watched, or -1 if `dir`
+  // itself may not be.
+  int_fast64_t levels_below(const std::string &dir) const;
+
+  // Return true if the directory `dir` may be watched.
+  bool covers(const std::string &dir) const { return levels_below(dir) >= 0; }
+
+  // Return true if the directory `dir` may be watched, or if it contains a directory that's been expanded and must be
+  // traversed to reach it.
+  bool reaches(const std::string &dir) const;
+
+  // Return true if events for the entry at the absolute path `path` should be reported, because it or the directory
+  // that contains it is watched.
+  bool reports(const std::string &path) const;
+
+  const std::string &get_root() const { return root; }
+
+  uint_fast32_t get_max_depth() const { return max_depth; }
+
+  const std::map<std::string, uint_fast32_t> &get_expansions() const { return expansions; }
+
+  DepthLimit(const DepthLimit &) = delete;
+  DepthLimit(DepthLimit &&) = delete;
+  DepthLimit &operator=(const DepthLimit &) = delete;
+  DepthLimit &operator=(DepthLimit &&) = delete;
+
+private:
+  // Return the number of segments that `path` lies beneath `dir`, or -1 if it doesn't lie beneath it at all.
+  static int_fast64_t depth_within(const std::string &path, const std::string &dir);
+
+  std::string root;
+
+  uint_fast32_t max_depth;
+
+  // Depth watched beneath each expanded directory.
+  std::map<std::string, uint_fast32_t> expansions;
+};
+
+std::ostream &operator<<(std::ostream &out, const DepthLimit &limit);
+
+#endif
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "event_router.h"
+#include "helper/common.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+void EventRouter::add(SubscriptionID id, const string &path, bool recursive)
+{
+  vector<string> segments;
+  split(path, segments);
+
+  Node *node = &root;
+  for (string &segment : segments) {
+    unique_ptr<Node> &child = node->children[segment];
+    if (!child) child.reset(new Node());
+    node = child.get();
+  }
+
+  (recursive ? node->subtree : node->immediate).push_back(id);
+  by_id.emplace(id, Subscription{path, recursive});
+}
+
+bool EventRouter::remove(SubscriptionID id)
+{
+  auto found = by_id.find(id);
+  if (found == by_id.end()) return false;
+
+  vector<string> segments;
+  split(found->second.path, segments);
+  bool recursive = found->second.recursive;
+  by_id.erase(found);
+
+  // Remember the path taken so that nodes left empty can be pruned from the bottom up.
+  vector<Node *> trail{&root};
+  for (const string &segment : segments) {
+    auto child = trail.back()->children.find(segment);
+    if (child == trail.back()->children.end()) return true;
+    trail.push_back(child->second.get());
+  }
+
+  vector<SubscriptionID> &ids = recursive ? trail.back()->subtree : trail.back()->immediate;
+  ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+
+  for (size_t depth = segments.size(); depth > 0 && trail[depth]->empty(); depth--) {
+    trail[depth - 1]->children.erase(segments[depth - 1]);
+  }
+  return true;
+}
+
+void EventRouter::route(const string &path, vector<SubscriptionID> &into) const
+{
+  // Count the segments first, so that the parent of `path` can be recognized as the walk passes it.
+  size_t count = 0;
+  for (size_t i = 0; i < path.size(); i++) {
+    if (!is_separator(path[i]) && (i == 0 || is_separator(path[i - 1]))) count++;
+  }
+
+  const Node *node = &root;
+  size_t depth = 0;
+  size_t pos = 0;
+  string segment;
+  while (true) {
+    into.insert(into.end(), node->subtree.begin(), node->subtree.end());
+    if (depth + 1 >= count) into.insert(into.end(), node->immediate.begin(), node->immediate.end());
+    if (depth == count) return;
+
+    while (pos < path.size() && is_separator(path[pos])) pos++;
+    size_t end = pos;
+    while (end < path.size() && !is_separator(path[end])) end++;
+    segment.assign(path, pos, end - pos);
+    pos = end;
+
+    auto child = node->children.find(segment);
+    if (child == node->children.end()) return;
+    node = child->second.get();
+    depth++;
+  }
+}
+
+void EventRouter::route_subtree(const string &path, vector<SubscriptionID> &into) const
+{
+  route(path, into);
+
+  vector<string> segments;
+  split(path, segments);
+
+  const Node *node = &root;
+  for (const string &segment : segments) {
+    auto child = node->children.find(segment);
+    if (child == node->children.end()) return;
+    node = child->second.get();
+  }
+
+  // Every subscription rooted strictly beneath `path` receives part of the subtree.
+  vector<const Node *> pending;
+  for (auto &child : node->children) pending.push_back(child.second.get());
+  while (!pending.empty()) {
+    const Node *next = pending.back();
+    pending.pop_back();
+
+    into.insert(into.end(), next->subtree.begin(), next->subtree.end());
+    into.insert(into.end(), next->immediate.begin(), next->immediate.end());
+    for (auto &child : next->children) pending.push_back(child.second.get());
+  }
+}
+
+void EventRouter::split(const string &path, vector<string> &segments)
+{
+  size_t pos = 0;
+  while (pos < path.size()) {
+    while (pos < path.size() && is_separator(path[pos])) pos++;
+    size_t end = pos;
+    while (end < path.size() && !is_separator(path[end])) end++;
+    if (end > pos) segments.emplace_back(path, pos, end - pos);
+    pos = end;
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef EVENT_ROUTER_H
+#define EVENT_ROUTER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Uniquely identifies a subscription to a subtree of a channel's events.
+using SubscriptionID = uint_fast32_t;
+
+const SubscriptionID NULL_SUBSCRIPTION_ID = 0;
+
+// Route the events of a single channel to the subscriptions whose subtrees contain them. Subscribed paths are stored
+// in a trie keyed by path segment, so routing an event walks the event's path once, however many subscriptions the
+// channel has.
+//
+// A recursive subscription receives events for its path and everything beneath it. A non-recursive subscription
+// receives events for its path and its immediate children.
+class EventRouter
+{
+public:
+  EventRouter() = default;
+
+  ~EventRouter() = default;
+
+  // Deliver events beneath the absolute path `path` to the subscription `id`.
+  void add(SubscriptionID id, const std::string &path, bool recursive);
+
+  // Stop delivering events to the subscription `id`. Return false if it wasn't subscribed.
+  bool remove(SubscriptionID id);
+
+  // Append the subscriptions that receive events for the absolute path `path` to `into`.
+  void route(const std::string &path, std::vector<SubscriptionID> &into) const;
+
+  // Append the subscriptions that receive events for the absolute path `path`, or for anything beneath it, to `into`.
+  // Used for events that summarize a whole subtree.
+  void route_subtree(const std::string &path, std::vector<SubscriptionID> &into) const;
+
+  bool empty() const { return by_id.empty(); }
+
+  size_t size() const { return by_id.size(); }
+
+  EventRouter(const EventRouter &) = delete;
+  EventRouter(EventRouter &&) = default;
+  EventRouter &operator=(const EventRouter &) = delete;
+  EventRouter &operator=(EventRouter &&) = default;
+
+private:
+  struct Node
+  {
+    std::unordered_map<std::string, std::unique_ptr<Node>> children;
+
+    // Subscriptions rooted at this node, by whether they're recursive.
+    std::vector<SubscriptionID> subtree;
+    std::vector<SubscriptionID> immediate;
+
+    bool empty() const { return children.empty() && subtree.empty() && immediate.empty(); }
+  };
+
+  struct Subscription
+  {
+    std::string path;
+    bool recursive;
+  };
+
+  // Split `path` into its non-empty segments.
+  static void split(const std::string &path, std::vector<std::string> &segments);
+
+  Node root;
+
+  std::unordered_map<SubscriptionID, Subscription> by_id;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "file_set.h"
+#include "helper/common.h"
+#include "log.h"
+#include "result.h"
+
+using std::ostream;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+static bool is_absolute(const string &path)
+{
+#ifdef _WIN32
+  return (path.size() > 2 && path[1] == ':' && (path[2] == '\\' || path[2] == '/'))
+    || (path.size() > 1 && path[0] == '\\' && path[1] == '\\');
+#else
+  return !path.empty() && path[0] == '/';
+#endif
+}
+
+Result<shared_ptr<const FileSet>> FileSet::create(const vector<string> &paths)
+{
+  shared_ptr<FileSet> files(new FileSet());
+
+  for (const string &path : paths) {
+    string directory, name;
+    if (!is_absolute(path) || !split(path, directory, name) || name.empty()) {
+      return Result<shared_ptr<const FileSet>>::make_error("File \"" + path + "\" is not an absolute path");
+    }
+
+    if (files->directories[directory].insert(std::move(name)).second) files->count++;
+  }
+
+  return ok_result(shared_ptr<const FileSet>(std::move(files)));
+}
+
+FileSet::FileSet() : count{0}
+{
+  //
+}
+
+bool FileSet::contains(const string &path) const
+{
+  string directory, name;
+  if (!split(path, directory, name)) return false;
+
+  const Names *names = names_in(directory);
+  return names != nullptr && names->count(name) > 0;
+}
+
+const FileSet::Names *FileSet::names_in(const string &directory) const
+{
+  auto found = directories.find(directory);
+  return found != directories.end() ? &found->second : nullptr;
+}
+
+shared_ptr<const FileSet> FileSet::subset(const string &directory) const
+{
+  shared_ptr<FileSet> files(new FileSet());
+
+  const Names *names = names_in(directory);
+  if (names != nullptr) {
+    files->directories.emplace(directory, *names);
+    files->count = names->size();
+  }
+  return shared_ptr<const FileSet>(std::move(files));
+}
+
+string FileSet::common_root() const
+{
+  auto it = directories.begin();
+  if (it == directories.end()) return string();
+
+  string root(it->first);
+  for (++it; it != directories.end(); ++it) {
+    const string &directory = it->first;
+
+    // Shorten the root until it's an ancestor of this directory, too.
+    while (!root.empty()) {
+      if (path_within(directory, root)) break;
+
+      string parent, name;
+      if (!split(root, parent, name) || parent == root) {
+        root.clear();
+      } else {
+        root = parent;
+      }
+    }
+  }
+  return root;
+}
+
+bool FileSet::split(const string &path, string &directory, string &name)
+{
+  size_t separator = path.find_last_of(PATH_SEPARATORS);
+  if (separator == string::npos) return false;
+
+  // Keep the separator of a filesystem root, like `/` or `C:\`.
+  size_t length = separator;
+  if (separator == 0 || (separator > 0 && path[separator - 1] == ':')) length++;
+
+  directory.assign(path, 0, length);
+  name.assign(path, separator + 1, string::npos);
+  return true;
+}
+
+ostream &operator<<(ostream &out, const FileSet &files)
+{
+  return out << plural(static_cast<long>(files.size()), "file") << " in "
+             << plural(static_cast<long>(files.get_directories().size()), "directory", "directories");
+}
@@ -0,0 +1,64 @@
+#ifndef FILE_SET_H
+#define FILE_SET_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "result.h"
+
+// A set of individual files to watch, grouped by the directory that contains each of them. A file set is watched
+// through each of those directories without recursing, and events for their other entries are discarded as soon as
+// they're observed.
+//
+// Instances are immutable once created, so a single `FileSet` may be shared between threads.
+class FileSet
+{
+public:
+  // The names of the watched entries within a single directory.
+  using Names = std::unordered_set<std::string>;
+
+  // Group the absolute paths `paths` by directory. Fail if any of them isn't absolute.
+  static Result<std::shared_ptr<const FileSet>> create(const std::vector<std::string> &paths);
+
+  ~FileSet() = default;
+
+  // Return true if the absolute path `path` is a member of this set.
+  bool contains(const std::string &path) const;
+
+  // Return the names of the members of this set within `directory`, or null if there are none.
+  const Names *names_in(const std::string &directory) const;
+
+  // Create a file set that contains only the members of this set within `directory`.
+  std::shared_ptr<const FileSet> subset(const std::string &directory) const;
+
+  // Return the deepest directory that contains every member of this set, or an empty string if they have none in
+  // common, like files on separate Windows drives.
+  std::string common_root() const;
+
+  const std::unordered_map<std::string, Names> &get_directories() const { return directories; }
+
+  size_t size() const { return count; }
+
+  FileSet(const FileSet &) = delete;
+  FileSet(FileSet &&) = delete;
+  FileSet &operator=(const FileSet &) = delete;
+  FileSet &operator=(FileSet &&) = delete;
+
+private:
+  FileSet();
+
+  // Split `path` at its final separator. Return false if it has none.
+  static bool split(const std::string &path, std::string &directory, std::string &name);
+
+  std::unordered_map<std::string, Names> directories;
+
+  size_t count;
+};
+
+std::ostream &operator<<(std::ostream &out, const FileSet &files);
+
+#endif
@@ -0,0 +1,294 @@
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glob.h"
+#include "helper/common.h"
+#include "result.h"
+
+using std::ostream;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+// Return the index of the lowest set bit of a non-zero `bits`, with a de Bruijn multiplication that's portable to every
+// compiler we build with.
+static size_t lowest_bit(uint64_t bits)
+{
+  static const size_t positions[64] = {0, 1, 2, 53, 3, 7, 54, 27, 4, 38, 41, 8, 34, 55, 48, 28, 62, 5, 39, 46, 44, 42,
+    22, 9, 24, 35, 59, 56, 49, 18, 29, 11, 63, 52, 6, 26, 37, 40, 33, 47, 61, 45, 43, 21, 23, 58, 17, 10, 51, 25, 36,
+    32, 60, 20, 57, 16, 50, 31, 19, 15, 30, 14, 13, 12};
+  return positions[((bits & (~bits + 1)) * 0x022fdd63cc95386dull) >> 58];
+}
+
+// Return the index of the `]` that closes the character class opened at `open`, or `string::npos` if it's unterminated.
+// A `]` immediately following the `[` or its negation is a member of the class rather than its end.
+static size_t class_end(const string &pattern, size_t open)
+{
+  size_t i = open + 1;
+  if (i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^')) i++;
+  if (i < pattern.size() && pattern[i] == ']') i++;
+
+  while (i < pattern.size() && pattern[i] != ']') {
+    if (pattern[i] == '\\') i++;
+    i++;
+  }
+  return i < pattern.size() ? i : string::npos;
+}
+
+// Return true if `c` is a member of the character class spanning `pattern[open]` through `pattern[close]`.
+static bool class_contains(const string &pattern, size_t open, size_t close, char c)
+{
+  size_t i = open + 1;
+  bool negated = pattern[i] == '!' || pattern[i] == '^';
+  if (negated) i++;
+
+  auto uc = static_cast<unsigned char>(c);
+  bool found = false;
+  bool first = true;
+  while (i < close && (pattern[i] != ']' || first)) {
+    first = false;
+
+    if (pattern[i] == '\\') i++;
+    auto low = static_cast<unsigned char>(pattern[i]);
+    auto high = low;
+    i++;
+
+    if (i + 1 < close && pattern[i] == '-') {
+      i++;
+      if (pattern[i] == '\\') i++;
+      high = static_cast<unsigned char>(pattern[i]);
+      i++;
+    }
+
+    if (low <= uc && uc <= high) found = true;
+  }
+  return found != negated;
+}
+
+// Match the `length` characters at `name` against a single-segment pattern. A `*` that fails to match is retried
+// one character further along, which is linear for the patterns that appear in practice.
+static bool match_wildcard(const string &pattern, const char *name, size_t length)
+{
+  size_t p = 0;
+  size_t n = 0;
+  size_t star_p = string::npos;
+  size_t star_n = 0;
+
+  while (n < length) {
+    if (p < pattern.size()) {
+      char c = pattern[p];
+
+      if (c == '*') {
+        star_p = ++p;
+        star_n = n;
+        continue;
+      }
+
+      if (c == '?') {
+        p++;
+        n++;
+        continue;
+      }
+
+      if (c == '[') {
+        size_t close = class_end(pattern, p);
+        if (class_contains(pattern, p, close, name[n])) {
+          p = close + 1;
+          n++;
+          continue;
+        }
+      } else {
+        size_t literal = c == '\\' ? p + 1 : p;
+        if (pattern[literal] == name[n]) {
+          p = literal + 1;
+          n++;
+          continue;
+        }
+      }
+    }
+
+    if (star_p == string::npos) return false;
+    p = star_p;
+    n = ++star_n;
+  }
+
+  while (p < pattern.size() && pattern[p] == '*') p++;
+  return p == pattern.size();
+}
+
+// Validate a single segment of `pattern`. If it contains no wildcards, unescape it into `literal` and return true.
+static Result<bool> parse_segment(const string &pattern, const string &segment, string &literal)
+{
+  bool wild = false;
+  literal.clear();
+
+  for (size_t i = 0; i < segment.size(); i++) {
+    char c = segment[i];
+
+    if (c == '\\') {
+      if (i + 1 >= segment.size()) {
+        return Result<bool>::make_error("Exclude pattern \"" + pattern + "\" ends with an unescaped backslash");
+      }
+      literal += segment[++i];
+    } else if (c == '[') {
+      size_t close = class_end(segment, i);
+      if (close == string::npos) {
+        return Result<bool>::make_error("Exclude pattern \"" + pattern + "\" contains an unterminated character class");
+      }
+      wild = true;
+      i = close;
+    } else if (c == '*' || c == '?') {
+      wild = true;
+    } else {
+      literal += c;
+    }
+  }
+
+  return ok_result(!wild);
+}
+
+Result<shared_ptr<const GlobSet>> GlobSet::compile(const string &root, const vector<string> &patterns)
+{
+  shared_ptr<GlobSet> globs(new GlobSet(root, patterns));
+
+  for (const string &pattern : patterns) {
+    // A trailing separator is permitted, but any other separator anchors the pattern to the root.
+    size_t length = pattern.find_last_not_of('/');
+    length = length == string::npos ? 0 : length + 1;
+    bool anchored = pattern.find('/') < length;
+
+    vector<string> segments;
+    size_t start = 0;
+    while (start < length) {
+      size_t end = pattern.find('/', start);
+      if (end == string::npos || end > length) end = length;
+      if (end > start) segments.emplace_back(pattern, start, end - start);
+      start = end + 1;
+    }
+
+    if (segments.empty()) {
+      return Result<shared_ptr<const GlobSet>>::make_error("Exclude pattern \"" + pattern + "\" is empty");
+    }
+
+    size_t first = globs->states.size();
+    if (!anchored) globs->states.push_back(State{SEGMENT_ANY, "**", false});
+    for (string &segment : segments) {
+      if (segment == "**") {
+        // Consecutive `**` segments match nothing more than one does.
+        if (globs->states.size() > first && globs->states.back().kind == SEGMENT_ANY) continue;
+
+        globs->states.push_back(State{SEGMENT_ANY, move(segment), false});
+        continue;
+      }
+
+      string literal;
+      Result<bool> pr = parse_segment(pattern, segment, literal);
+      if (pr.is_error()) return pr.propagate<shared_ptr<const GlobSet>>();
+
+      if (pr.get_value()) {
+        globs->states.push_back(State{SEGMENT_LITERAL, move(literal), false});
+      } else {
+        globs->states.push_back(State{SEGMENT_WILDCARD, move(segment), false});
+      }
+    }
+    globs->states.back().last = true;
+
+    globs->initial.resize((globs->states.size() + 63) / 64, 0);
+    globs->activate(globs->initial, first);
+  }
+  globs->initial.resize((globs->states.size() + 63) / 64, 0);
+
+  return ok_result(shared_ptr<const GlobSet>(std::move(globs)));
+}
+
+GlobSet::GlobSet(const string &root, const vector<string> &patterns) : root(root), patterns(patterns)
+{
+  //
+}
+
+GlobSet::Match GlobSet::match(const string &path) const
+{
+  if (states.empty()) return MATCH_NONE;
+
+  // Locate the first segment beneath the root.
+  size_t pos = root.size();
+  if (path.size() <= pos || path.compare(0, root.size(), root) != 0) return MATCH_NONE;
+  if (root.empty() || !is_separator(root.back())) {
+    if (!is_separator(path[pos])) return MATCH_NONE;
+    pos++;
+  }
+
+  StateSet active(initial);
+  StateSet next(initial.size(), 0);
+
+  while (pos < path.size()) {
+    size_t end = pos;
+    while (end < path.size() && !is_separator(path[end])) end++;
+
+    if (end > pos) {
+      const char *segment = path.data() + pos;
+      size_t length = end - pos;
+      bool any = false;
+
+      for (uint64_t &word : next) word = 0;
+      for (size_t w = 0; w < active.size(); w++) {
+        uint64_t bits = active[w];
+        while (bits != 0) {
+          size_t s = w * 64 + lowest_bit(bits);
+          bits &= bits - 1;
+
+          const State &state = states[s];
+          bool consumed = false;
+          switch (state.kind) {
+            case SEGMENT_ANY: consumed = true; break;
+            case SEGMENT_LITERAL:
+              consumed = state.text.size() == length && state.text.compare(0, length, segment, length) == 0;
+              break;
+            case SEGMENT_WILDCARD: consumed = match_wildcard(state.text, segment, length); break;
+          }
+          if (!consumed) continue;
+
+          // This segment completes a match, so it and everything beneath it are matched.
+          if (state.last) {
+            size_t rest = end;
+            while (rest < path.size() && is_separator(path[rest])) rest++;
+            return rest == path.size() ? MATCH_PATH : MATCH_ANCESTOR;
+          }
+
+          activate(next, state.kind == SEGMENT_ANY ? s : s + 1);
+          any = true;
+        }
+      }
+
+      // No pattern can match anything deeper.
+      if (!any) return MATCH_NONE;
+      active.swap(next);
+    }
+
+    pos = end + 1;
+  }
+
+  return MATCH_NONE;
+}
+
+void GlobSet::activate(StateSet &set, size_t state) const
+{
+  set[state / 64] |= uint64_t(1) << (state % 64);
+  if (states[state].kind == SEGMENT_ANY && !states[state].last) activate(set, state + 1);
+}
+
+ostream &operator<<(ostream &out, const GlobSet &globs)
+{
+  out << "[";
+  bool first = true;
+  for (const string &pattern : globs.get_patterns()) {
+    if (!first) out << ", ";
+    first = false;
+    out << pattern;
+  }
+  return out << "]";
+}
@@ -0,0 +1,93 @@
+#ifndef GLOB_H
+#define GLOB_H
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "result.h"
+
+// A set of glob patterns compiled into a single automaton that consumes a path one segment at a time, used to exclude
+// whole subtrees beneath a watch root. Patterns are interpreted relative to the root:
+//
+// * `*` matches any run of characters within a segment, `?` matches any single character, and `[abc]`, `[a-z]` or
+//   `[!abc]` match one character from a class. A backslash escapes the character that follows it.
+// * A segment of exactly `**` matches any number of segments, including none.
+// * A pattern that contains no `/` matches an entry of that name at any depth. Other patterns are anchored at the root.
+//
+// A path is matched if it or any of its ancestors beneath the root is matched by a pattern, so matching a directory
+// matches everything within it.
+//
+// Instances are immutable once compiled, so a single `GlobSet` may be shared between threads.
+class GlobSet
+{
+public:
+  // Compile `patterns` into an automaton that matches paths beneath `root`. Fail if a pattern is malformed.
+  static Result<std::shared_ptr<const GlobSet>> compile(const std::string &root,
+    const std::vector<std::string> &patterns);
+
+  ~GlobSet() = default;
+
+  // How a path was matched by `match()`.
+  enum Match
+  {
+    MATCH_NONE,  // Neither the path nor any of its ancestors beneath the root matched a pattern.
+    MATCH_ANCESTOR,  // A directory containing the path matched a pattern.
+    MATCH_PATH  // The path itself matched a pattern.
+  };
+
+  // Determine whether the absolute path `path` lies beneath the root and it or any of its ancestors is matched by a
+  // pattern. The root itself is never matched. The shallowest match is reported.
+  Match match(const std::string &path) const;
+
+  bool matches(const std::string &path) const { return match(path) != MATCH_NONE; }
+
+  const std::string &get_root() const { return root; }
+
+  const std::vector<std::string> &get_patterns() const { return patterns; }
+
+  GlobSet(const GlobSet &) = delete;
+  GlobSet(GlobSet &&) = delete;
+  GlobSet &operator=(const GlobSet &) = delete;
+  GlobSet &operator=(GlobSet &&) = delete;
+
+private:
+  GlobSet(const std::string &root, const std::vector<std::string> &patterns);
+
+  enum SegmentKind
+  {
+    SEGMENT_LITERAL,  // Matches one segment equal to `text`.
+    SEGMENT_WILDCARD,  // Matches one segment against the single-segment pattern `text`.
+    SEGMENT_ANY  // Matches zero or more segments.
+  };
+
+  // One state of the automaton for each segment of each pattern. A pattern's states are stored contiguously, so a
+  // state that consumes a segment advances to the state that follows it.
+  struct State
+  {
+    SegmentKind kind;
+    std::string text;
+
+    // True if this is the final segment of its pattern, so consuming a segment here completes a match.
+    bool last;
+  };
+
+  using StateSet = std::vector<uint64_t>;
+
+  // Mark `state` as active within `set`, along with the state that follows any `**` that may match zero segments.
+  void activate(StateSet &set, size_t state) const;
+
+  std::string root;
+  std::vector<std::string> patterns;
+
+  std::vector<State> states;
+
+  // The states that are active before the first segment has been consumed.
+  StateSet initial;
+};
+
+std::ostream &operator<<(std::ostream &out, const GlobSet &globs);
+
+#endif
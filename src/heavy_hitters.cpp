@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <uv.h>
+#include <vector>
+
+#include "heavy_hitters.h"
+#include "lock.h"
+
+using std::ostream;
+using std::string;
+using std::vector;
+
+static const uint64_t SLOT_NS = HEAVY_HITTERS_SLOT_SECONDS * 1000000000ull;
+
+// Return the length of the prefix of `path` that names its parent directory.
+static size_t parent_length(const string &path)
+{
+#ifdef _WIN32
+  size_t separator = path.find_last_of("\\/");
+#else
+  size_t separator = path.find_last_of('/');
+#endif
+  if (separator == string::npos) return path.size();
+  return separator == 0 ? 1 : separator;
+}
+
+// FNV-1a. Each row of the sketch derives its column from a different combination of the two halves.
+static uint64_t hash_directory(const string &path, size_t length)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= static_cast<unsigned char>(path[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static size_t column(uint64_t hash, size_t row)
+{
+  uint64_t low = hash & 0xffffffffu;
+  uint64_t high = (hash >> 32) | 1u;
+  return static_cast<size_t>((low + row * high) % HEAVY_HITTERS_WIDTH);
+}
+
+ostream &operator<<(ostream &out, const HotDirectory &directory)
+{
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+
+  out << directory.path << " (" << directory.events << " events, " << std::fixed << std::setprecision(1)
+      << directory.recent_rate << "/s recently, " << directory.rate << "/s over the last minute)";
+
+  out.flags(flags);
+  out.precision(precision);
+  return out;
+}
+
+HeavyHitters::HeavyHitters() : counters{}, totals{}, current_slot{0}, started_at{0}
+{
+  uv_mutex_init(&mutex);
+  candidates.reserve(HEAVY_HITTERS_CANDIDATES);
+  reset();
+}
+
+HeavyHitters::~HeavyHitters()
+{
+  uv_mutex_destroy(&mutex);
+}
+
+void HeavyHitters::record(const string &path)
+{
+  Lock lock(mutex);
+  advance_to(uv_hrtime() / SLOT_NS);
+
+  size_t length = parent_length(path);
+  uint64_t hash = hash_directory(path, length);
+  for (size_t row = 0; row < HEAVY_HITTERS_DEPTH; row++) {
+    size_t col = column(hash, row);
+    counters[current_slot % HEAVY_HITTERS_SLOTS][row][col]++;
+    totals[row][col]++;
+  }
+  uint64_t count = estimate(hash, HEAVY_HITTERS_SLOTS);
+
+  Candidate *smallest = nullptr;
+  for (Candidate &candidate : candidates) {
+    if (candidate.hash == hash && candidate.path.size() == length && path.compare(0, length, candidate.path) == 0) {
+      candidate.estimate = count;
+      return;
+    }
+    if (smallest == nullptr || candidate.estimate < smallest->estimate) smallest = &candidate;
+  }
+
+  if (candidates.size() < HEAVY_HITTERS_CANDIDATES) {
+    candidates.push_back(Candidate{path.substr(0, length), hash, count});
+  } else if (smallest != nullptr && count > smallest->estimate) {
+    smallest->path.assign(path, 0, length);
+    smallest->hash = hash;
+    smallest->estimate = count;
+  }
+}
+
+void HeavyHitters::collect(vector<HotDirectory> &into)
+{
+  Lock lock(mutex);
+  uint64_t now = uv_hrtime();
+  advance_to(now / SLOT_NS);
+
+  vector<const Candidate *> ranked;
+  ranked.reserve(candidates.size());
+  for (const Candidate &candidate : candidates) {
+    ranked.push_back(&candidate);
+  }
+  std::sort(ranked.begin(), ranked.end(), [](const Candidate *a, const Candidate *b) {
+    return a->estimate > b->estimate;
+  });
+  if (ranked.size() > HEAVY_HITTERS_REPORTED) ranked.resize(HEAVY_HITTERS_REPORTED);
+
+  double recent_seconds = covered_seconds(now, HEAVY_HITTERS_RECENT_SLOTS);
+  double seconds = covered_seconds(now, HEAVY_HITTERS_SLOTS);
+  for (const Candidate *candidate : ranked) {
+    uint64_t recent_events = estimate(candidate->hash, HEAVY_HITTERS_RECENT_SLOTS);
+
+    HotDirectory directory;
+    directory.path = candidate->path;
+    directory.events = candidate->estimate;
+    directory.recent_rate = static_cast<double>(recent_events) / recent_seconds;
+    directory.rate = static_cast<double>(candidate->estimate) / seconds;
+    into.push_back(std::move(directory));
+  }
+}
+
+void HeavyHitters::reset()
+{
+  Lock lock(mutex);
+  memset(counters, 0, sizeof(counters));
+  memset(totals, 0, sizeof(totals));
+  candidates.clear();
+  started_at = uv_hrtime();
+  current_slot = started_at / SLOT_NS;
+}
+
+void HeavyHitters::advance_to(uint64_t now_slot)
+{
+  if (now_slot <= current_slot) return;
+
+  uint64_t stale = now_slot - current_slot;
+  if (stale >= HEAVY_HITTERS_SLOTS) {
+    memset(counters, 0, sizeof(counters));
+    memset(totals, 0, sizeof(totals));
+  } else {
+    for (uint64_t i = 1; i <= stale; i++) {
+      uint32_t(&expired)[HEAVY_HITTERS_DEPTH][HEAVY_HITTERS_WIDTH] = counters[(current_slot + i) % HEAVY_HITTERS_SLOTS];
+      for (size_t row = 0; row < HEAVY_HITTERS_DEPTH; row++) {
+        for (size_t col = 0; col < HEAVY_HITTERS_WIDTH; col++) {
+          totals[row][col] -= expired[row][col];
+        }
+      }
+      memset(expired, 0, sizeof(expired));
+    }
+  }
+  current_slot = now_slot;
+
+  // Directories that have gone quiet make room for new ones.
+  for (Candidate &candidate : candidates) {
+    candidate.estimate = estimate(candidate.hash, HEAVY_HITTERS_SLOTS);
+  }
+  candidates.erase(std::remove_if(candidates.begin(),
+                     candidates.end(),
+                     [](const Candidate &candidate) { return candidate.estimate == 0; }),
+    candidates.end());
+}
+
+uint64_t HeavyHitters::estimate(uint64_t hash, size_t slots) const
+{
+  uint64_t least = UINT64_MAX;
+  for (size_t row = 0; row < HEAVY_HITTERS_DEPTH; row++) {
+    size_t col = column(hash, row);
+    if (slots >= HEAVY_HITTERS_SLOTS) {
+      if (totals[row][col] < least) least = totals[row][col];
+      continue;
+    }
+
+    uint64_t sum = 0;
+    for (size_t back = 0; back < slots && back <= current_slot; back++) {
+      sum += counters[(current_slot - back) % HEAVY_HITTERS_SLOTS][row][col];
+    }
+    if (sum < least) least = sum;
+  }
+  return least;
+}
+
+double HeavyHitters::covered_seconds(uint64_t now, size_t slots) const
+{
+  uint64_t window_start = (current_slot + 1 - slots) * SLOT_NS;
+  if (window_start < started_at) window_start = started_at;
+
+  // Avoid reporting extreme rates from the first moments after a reset.
+  double seconds = static_cast<double>(now - window_start) / 1e9;
+  return seconds < 1.0 ? 1.0 : seconds;
+}
@@ -0,0 +1,101 @@
+#ifndef HEAVY_HITTERS_H
+#define HEAVY_HITTERS_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <uv.h>
+#include <vector>
+
+// Dimensions of the count-min sketch kept for each time slot. Estimates exceed the true count by at most
+// `e / HEAVY_HITTERS_WIDTH` of all events in the window with probability `1 - e ^ -HEAVY_HITTERS_DEPTH`.
+const size_t HEAVY_HITTERS_DEPTH = 4;
+const size_t HEAVY_HITTERS_WIDTH = 512;
+
+// Events are counted in `HEAVY_HITTERS_SLOTS` consecutive slots of `HEAVY_HITTERS_SLOT_SECONDS` each. The oldest slot
+// is cleared and reused as time advances, so the sketch always covers the most recent minute.
+const size_t HEAVY_HITTERS_SLOTS = 12;
+const uint64_t HEAVY_HITTERS_SLOT_SECONDS = 5;
+
+// The short window reported alongside the full minute spans this many of the most recent slots.
+const size_t HEAVY_HITTERS_RECENT_SLOTS = 2;
+
+// Number of directories tracked as candidates for the busiest, and the number reported.
+const size_t HEAVY_HITTERS_CANDIDATES = 32;
+const size_t HEAVY_HITTERS_REPORTED = 10;
+
+// Estimated event counts and rates for one busy directory.
+struct HotDirectory
+{
+  std::string path;
+
+  // Estimated number of events over the last minute.
+  uint64_t events{0};
+
+  // Estimated events per second over the last ten seconds and over the last minute.
+  double recent_rate{0};
+  double rate{0};
+};
+
+std::ostream &operator<<(std::ostream &out, const HotDirectory &directory);
+
+// Identify the directories that produce the most filesystem events in fixed memory, regardless of how many distinct
+// directories there are. Each event is counted against its parent directory in a count-min sketch, and the directories
+// with the largest estimates are kept in a small candidate list.
+//
+// Events are recorded on one thread and summarized on another, so every operation holds an uncontended mutex.
+class HeavyHitters
+{
+public:
+  HeavyHitters();
+
+  ~HeavyHitters();
+
+  // Count an event at `path` against its parent directory.
+  void record(const std::string &path);
+
+  // Append the busiest directories to `into`, most active first.
+  void collect(std::vector<HotDirectory> &into);
+
+  // Forget every event recorded so far.
+  void reset();
+
+  HeavyHitters(const HeavyHitters &) = delete;
+  HeavyHitters(HeavyHitters &&) = delete;
+  HeavyHitters &operator=(const HeavyHitters &) = delete;
+  HeavyHitters &operator=(HeavyHitters &&) = delete;
+
+private:
+  struct Candidate
+  {
+    std::string path;
+    uint64_t hash;
+    uint64_t estimate;
+  };
+
+  // Clear any slots that have fallen out of the window as of slot number `now_slot`, and refresh the candidates'
+  // estimates to match.
+  void advance_to(uint64_t now_slot);
+
+  // Estimate the number of events counted against the directory with hash `hash` in the `slots` most recent slots.
+  uint64_t estimate(uint64_t hash, size_t slots) const;
+
+  // Seconds of history covered by the `slots` most recent slots, as of `now` in nanoseconds.
+  double covered_seconds(uint64_t now, size_t slots) const;
+
+  uv_mutex_t mutex;
+
+  uint32_t counters[HEAVY_HITTERS_SLOTS][HEAVY_HITTERS_DEPTH][HEAVY_HITTERS_WIDTH];
+
+  // Sum of `counters` across every slot, maintained as slots are filled and cleared, so that estimates over the full
+  // window cost one lookup per row.
+  uint32_t totals[HEAVY_HITTERS_DEPTH][HEAVY_HITTERS_WIDTH];
+
+  // Absolute number of the most recent slot that has been written, and the time at which counting began.
+  uint64_t current_slot;
+  uint64_t started_at;
+
+  std::vector<Candidate> candidates;
+};
+
+#endif
@@ -1,10 +1,46 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
+// Characters that separate the components of a path. Windows accepts either slash.
+#ifdef _WIN32
+const char *const PATH_SEPARATORS = "\\/";
+#else
+const char *const PATH_SEPARATORS = "/";
+#endif
+
+// Return true if `c` is one of `PATH_SEPARATORS`.
+inline bool is_separator(char c)
+{
+#ifdef _WIN32
+  return c == '/' || c == '\\';
+#else
+  return c == '/';
+#endif
+}
+
 std::string path_join(const std::string &left, const std::string &right);
 
 std::wstring wpath_join(const std::wstring &left, const std::wstring &right);
 
+// Return the directory containing `path`, or `path` itself if it has none. The parent of an entry at the root of the
+// filesystem is the root itself.
+std::string path_parent(const std::string &path);
+
+// Return true if `path` is `dir` or lies beneath it.
+bool path_within(const std::string &path, const std::string &dir);
+
+// Report the processor time consumed by the calling thread so far, in microseconds.
+uint64_t thread_cpu_time_us();
+
+// Map the entire contents of the file at `path` into memory, read-only, and store its length in `size`. Return
+// `nullptr` if the file can't be opened or mapped, or if it's empty.
+const char *map_file(const std::string &path, size_t &size);
+
+// Release a mapping created by `map_file()`.
+void unmap_file(const char *data, size_t size);
+
 #endif
@@ -33,4 +33,17 @@ wstring wpath_join(const wstring &left, const wstring &right)  // NOLINT
   return _path_join_impl<wstring>(left, right, W_DIRECTORY_SEPARATOR);
 }
 
+string path_parent(const string &path)  // NOLINT
+{
+  size_t separator = path.find_last_of(PATH_SEPARATORS);
+  if (separator == string::npos) return path;
+  return path.substr(0, separator > 0 ? separator : 1);
+}
+
+bool path_within(const string &path, const string &dir)  // NOLINT
+{
+  if (dir.empty() || path.size() < dir.size() || path.compare(0, dir.size(), dir) != 0) return false;
+  return path.size() == dir.size() || is_separator(dir.back()) || is_separator(path[dir.size()]);
+}
+
 #endif
@@ -1,4 +1,43 @@
+#include <cstdint>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "common.h"
 #include "linux/constants.h"
 
 #include "common_impl.h"
+
+uint64_t thread_cpu_time_us()
+{
+  timespec ts{};
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000u + static_cast<uint64_t>(ts.tv_nsec) / 1000u;
+}
+
+const char *map_file(const std::string &path, size_t &size)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) return nullptr;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return nullptr;
+
+  size = static_cast<size_t>(st.st_size);
+  return static_cast<const char *>(data);
+}
+
+void unmap_file(const char *data, size_t size)
+{
+  munmap(const_cast<char *>(data), size);
+}
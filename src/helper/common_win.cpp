@@ -1,4 +1,57 @@
+#include <cstdint>
+#include <windows.h>
+
 #include "common.h"
 #include "windows/constants.h"
+#include "windows/helper.h"
 
 #include "common_impl.h"
+
+uint64_t thread_cpu_time_us()
+{
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time) == 0) return 0;
+
+  // FILETIMEs are measured in 100ns intervals.
+  uint64_t kernel = (static_cast<uint64_t>(kernel_time.dwHighDateTime) << 32) | kernel_time.dwLowDateTime;
+  uint64_t user = (static_cast<uint64_t>(user_time.dwHighDateTime) << 32) | user_time.dwLowDateTime;
+  return (kernel + user) / 10u;
+}
+
+const char *map_file(const std::string &path, size_t &size)
+{
+  Result<std::wstring> wpath = to_wchar(path);
+  if (wpath.is_error()) return nullptr;
+
+  HANDLE file = CreateFileW(wpath.get_value().c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ | FILE_SHARE_DELETE,
+    NULL,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    NULL);
+  if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+  LARGE_INTEGER file_size;
+  if (GetFileSizeEx(file, &file_size) == 0 || file_size.QuadPart <= 0) {
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL) return nullptr;
+
+  // The view keeps the mapping alive after its handle is closed.
+  void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (data == NULL) return nullptr;
+
+  size = static_cast<size_t>(file_size.QuadPart);
+  return static_cast<const char *>(data);
+}
+
+void unmap_file(const char *data, size_t /*size*/)
+{
+  UnmapViewOfFile(data);
+}
@@ -0,0 +1,120 @@
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+
+#include "histogram.h"
+
+using std::ostream;
+
+// Return the position of the most significant set bit of a nonzero value.
+static unsigned floor_log2(uint64_t value)
+{
+  unsigned result = 0;
+  for (unsigned shift = 32; shift > 0; shift /= 2) {
+    if ((value >> shift) != 0) {
+      value >>= shift;
+      result += shift;
+    }
+  }
+  return result;
+}
+
+ostream &operator<<(ostream &out, const HistogramSummary &summary)
+{
+  out << "n=" << summary.count << " min=" << summary.min << " mean=" << summary.mean << " p50=" << summary.p50
+      << " p90=" << summary.p90 << " p99=" << summary.p99 << " max=" << summary.max;
+  return out;
+}
+
+Histogram::Histogram() : total{0}, sum{0}, minimum{std::numeric_limits<uint64_t>::max()}, maximum{0}
+{
+  for (std::atomic<uint64_t> &count : counts) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::record(uint64_t value)
+{
+  counts[index_of(value)].fetch_add(1, std::memory_order_relaxed);
+  total.fetch_add(1, std::memory_order_relaxed);
+  sum.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t prior_min = minimum.load(std::memory_order_relaxed);
+  while (value < prior_min && !minimum.compare_exchange_weak(prior_min, value, std::memory_order_relaxed)) {
+  }
+
+  uint64_t prior_max = maximum.load(std::memory_order_relaxed);
+  while (value > prior_max && !maximum.compare_exchange_weak(prior_max, value, std::memory_order_relaxed)) {
+  }
+}
+
+HistogramSummary Histogram::summarize() const
+{
+  HistogramSummary summary;
+
+  uint64_t n = 0;
+  for (const std::atomic<uint64_t> &count : counts) {
+    n += count.load(std::memory_order_relaxed);
+  }
+  if (n == 0) return summary;
+
+  summary.count = n;
+  summary.min = minimum.load(std::memory_order_relaxed);
+  summary.max = maximum.load(std::memory_order_relaxed);
+  uint64_t recorded = total.load(std::memory_order_relaxed);
+  if (recorded > 0) summary.mean = sum.load(std::memory_order_relaxed) / recorded;
+
+  // Walk the buckets once, noting the bucket that contains each requested rank.
+  const uint64_t p50_rank = (n * 50 + 99) / 100;
+  const uint64_t p90_rank = (n * 90 + 99) / 100;
+  const uint64_t p99_rank = (n * 99 + 99) / 100;
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS && seen < p99_rank; i++) {
+    uint64_t count = counts[i].load(std::memory_order_relaxed);
+    if (count == 0) continue;
+
+    uint64_t before = seen;
+    seen += count;
+
+    uint64_t value = highest_equivalent(i);
+    if (value > summary.max) value = summary.max;
+
+    if (before < p50_rank && seen >= p50_rank) summary.p50 = value;
+    if (before < p90_rank && seen >= p90_rank) summary.p90 = value;
+    if (before < p99_rank && seen >= p99_rank) summary.p99 = value;
+  }
+
+  return summary;
+}
+
+void Histogram::reset()
+{
+  for (std::atomic<uint64_t> &count : counts) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  total.store(0, std::memory_order_relaxed);
+  sum.store(0, std::memory_order_relaxed);
+  minimum.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+  maximum.store(0, std::memory_order_relaxed);
+}
+
+size_t Histogram::index_of(uint64_t value)
+{
+  if (value < HISTOGRAM_SUB_BUCKETS) return static_cast<size_t>(value);
+
+  unsigned shift = floor_log2(value) - HISTOGRAM_PRECISION_BITS;
+  uint64_t sub_bucket = (value >> shift) - HISTOGRAM_SUB_BUCKETS;
+  return static_cast<size_t>((shift + 1) * HISTOGRAM_SUB_BUCKETS + sub_bucket);
+}
+
+uint64_t Histogram::highest_equivalent(size_t index)
+{
+  if (index < HISTOGRAM_SUB_BUCKETS) return index;
+
+  uint64_t shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+  uint64_t sub_bucket = index % HISTOGRAM_SUB_BUCKETS;
+  uint64_t lowest = (HISTOGRAM_SUB_BUCKETS + sub_bucket) << shift;
+  return lowest + ((uint64_t(1) << shift) - 1);
+}
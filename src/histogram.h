@@ -0,0 +1,91 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+
+// Number of bits of precision retained for each recorded value. Each power of two is divided into
+// `2 ^ HISTOGRAM_PRECISION_BITS` equally sized buckets, so every value is reported within 12.5% of its true value.
+const unsigned HISTOGRAM_PRECISION_BITS = 3;
+
+const uint64_t HISTOGRAM_SUB_BUCKETS = 1u << HISTOGRAM_PRECISION_BITS;
+
+const size_t HISTOGRAM_BUCKETS = (64 - HISTOGRAM_PRECISION_BITS + 1) * HISTOGRAM_SUB_BUCKETS;
+
+// Point-in-time summary of the distribution recorded by a `Histogram`.
+struct HistogramSummary
+{
+  uint64_t count{0};
+  uint64_t min{0};
+  uint64_t mean{0};
+  uint64_t p50{0};
+  uint64_t p90{0};
+  uint64_t p99{0};
+  uint64_t max{0};
+};
+
+std::ostream &operator<<(std::ostream &out, const HistogramSummary &summary);
+
+// Record the distribution of a non-negative quantity in constant space with log-linear buckets, in the style of an
+// HDR histogram. Recording is lock-free and costs a handful of relaxed atomic operations, so values may be recorded
+// on one thread while another summarizes or resets them. A summary taken concurrently with recording may be
+// slightly inconsistent.
+class Histogram
+{
+public:
+  Histogram();
+
+  Histogram(const Histogram &) = delete;
+  Histogram(Histogram &&) = delete;
+  ~Histogram() = default;
+  Histogram &operator=(const Histogram &) = delete;
+  Histogram &operator=(Histogram &&) = delete;
+
+  void record(uint64_t value);
+
+  HistogramSummary summarize() const;
+
+  void reset();
+
+private:
+  static size_t index_of(uint64_t value);
+
+  // Return the largest value that would be recorded in the bucket at `index`.
+  static uint64_t highest_equivalent(size_t index);
+
+  std::atomic<uint64_t> counts[HISTOGRAM_BUCKETS];
+  std::atomic<uint64_t> total;
+  std::atomic<uint64_t> sum;
+  std::atomic<uint64_t> minimum;
+  std::atomic<uint64_t> maximum;
+};
+
+// Track the greatest value observed of a quantity, such as the length of a queue.
+class HighWaterMark
+{
+public:
+  HighWaterMark() : mark{0} {}
+
+  HighWaterMark(const HighWaterMark &) = delete;
+  HighWaterMark(HighWaterMark &&) = delete;
+  ~HighWaterMark() = default;
+  HighWaterMark &operator=(const HighWaterMark &) = delete;
+  HighWaterMark &operator=(HighWaterMark &&) = delete;
+
+  void observe(uint64_t value)
+  {
+    uint64_t prior = mark.load(std::memory_order_relaxed);
+    while (value > prior && !mark.compare_exchange_weak(prior, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  uint64_t get() const { return mark.load(std::memory_order_relaxed); }
+
+  void reset() { mark.store(0, std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> mark;
+};
+
+#endif
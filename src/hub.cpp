@@ -1,19 +1,26 @@
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <nan.h>
 #include <set>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <uv.h>
 #include <v8.h>
 #include <vector>
 
+#include "event_router.h"
+#include "glob.h"
 #include "hub.h"
 #include "log.h"
 #include "message.h"
 #include "nan/all_callback.h"
 #include "polling/polling_thread.h"
+#include "probes.h"
 #include "result.h"
+#include "trace.h"
+#include "worker/worker_platform.h"
 #include "worker/worker_thread.h"
 
 using Nan::Callback;
@@ -21,6 +28,8 @@ using std::endl;
 using std::map;
 using std::move;
 using std::multimap;
+using std::ostringstream;
+using std::pair;
 using std::set;
 using std::shared_ptr;
 using std::string;
@@ -38,6 +47,19 @@ void handle_events_helper(uv_async_t * /*handle*/)
   Hub::get().handle_events();
 }
 
+static Local<Object> js_filesystem_event(FileSystemAction action,
+  EntryKind kind,
+  const string &old_path,
+  const string &path)
+{
+  Local<Object> js_event = Nan::New<Object>();
+  js_event->Set(Nan::New<String>("action").ToLocalChecked(), Nan::New<Number>(static_cast<int>(action)));
+  js_event->Set(Nan::New<String>("kind").ToLocalChecked(), Nan::New<Number>(static_cast<int>(kind)));
+  js_event->Set(Nan::New<String>("oldPath").ToLocalChecked(), Nan::New<String>(old_path).ToLocalChecked());
+  js_event->Set(Nan::New<String>("path").ToLocalChecked(), Nan::New<String>(path).ToLocalChecked());
+  return js_event;
+}
+
 Hub Hub::the_hub;
 
 Hub::Hub() : worker_thread(&event_handler), polling_thread(&event_handler)
@@ -46,6 +68,9 @@ Hub::Hub() : worker_thread(&event_handler), polling_thread(&event_handler)
 
   next_command_id = NULL_COMMAND_ID + 1;
   next_channel_id = NULL_CHANNEL_ID + 1;
+  next_subscription_id = NULL_SUBSCRIPTION_ID + 1;
+
+  trace_thread_name("main thread");
 
   err = uv_async_init(uv_default_loop(), &event_handler, handle_events_helper);
   if (err != 0) return;
@@ -56,6 +81,14 @@ Hub::Hub() : worker_thread(&event_handler), polling_thread(&event_handler)
 Result<> Hub::watch(string &&root,
   bool poll,
   bool recursive,
+  uint_fast32_t poll_interval,
+  uint_fast32_t poll_staleness,
+  shared_ptr<const GlobSet> exclude,
+  bool respect_ignore_files,
+  ActionMask actions,
+  shared_ptr<const FileSet> files,
+  uint_fast32_t max_depth,
+  uint_fast32_t burst_threshold,
   unique_ptr<Callback> ack_callback,
   unique_ptr<Callback> event_callback)
 {
@@ -64,13 +97,97 @@ Result<> Hub::watch(string &&root,
 
   channel_callbacks.emplace(channel_id, move(event_callback));
 
+  CommandPayloadBuilder builder = CommandPayloadBuilder::add(channel_id, move(root), recursive, 1);
+  builder.set_poll_interval(poll_interval)
+    .set_poll_staleness(poll_staleness)
+    .set_exclude(exclude)
+    .set_respect_ignore_files(respect_ignore_files)
+    .set_actions(actions)
+    .set_files(files)
+    .set_max_depth(max_depth)
+    .set_burst_threshold(burst_threshold);
+
   if (poll) {
-    return send_command(
-      polling_thread, CommandPayloadBuilder::add(channel_id, move(root), recursive, 1), move(ack_callback));
+    return send_command(polling_thread, move(builder), move(ack_callback));
+  }
+
+  return send_command(worker_thread, move(builder), move(ack_callback));
+}
+
+Result<> Hub::watch_many(vector<string> &&roots,
+  bool poll,
+  bool recursive,
+  uint_fast32_t poll_interval,
+  uint_fast32_t poll_staleness,
+  const vector<string> &exclude_patterns,
+  bool respect_ignore_files,
+  ActionMask actions,
+  uint_fast32_t max_depth,
+  uint_fast32_t burst_threshold,
+  unique_ptr<Callback> ack_callback,
+  unique_ptr<Callback> event_callback)
+{
+  // Ancestors sort ahead of their descendants, so each root is crawled after any root that contains it.
+  vector<string> sorted(roots);
+  std::sort(sorted.begin(), sorted.end());
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+  // Compile every exclusion before allocating any channel, so that a malformed pattern leaves nothing behind.
+  vector<shared_ptr<const GlobSet>> excludes(sorted.size());
+  if (!exclude_patterns.empty()) {
+    for (size_t i = 0; i < sorted.size(); i++) {
+      Result<shared_ptr<const GlobSet>> er = GlobSet::compile(sorted[i], exclude_patterns);
+      if (er.is_error()) return er.propagate();
+      excludes[i] = er.get_value();
+    }
   }
 
-  return send_command(
-    worker_thread, CommandPayloadBuilder::add(channel_id, move(root), recursive, 1), move(ack_callback));
+  shared_ptr<BatchAck> batch(new BatchAck{move(ack_callback), vector<ChannelID>(), vector<string>(), sorted.size()});
+  shared_ptr<Callback> shared_event_callback(move(event_callback));
+
+  map<string, ChannelID> channels_by_root;
+  vector<Message> commands;
+  commands.reserve(sorted.size());
+  for (size_t i = 0; i < sorted.size(); i++) {
+    ChannelID channel_id = next_channel_id;
+    next_channel_id++;
+    channels_by_root.emplace(sorted[i], channel_id);
+    channel_callbacks.emplace(channel_id, shared_event_callback);
+
+    CommandID command_id = next_command_id;
+    next_command_id++;
+    pending_batches.emplace(command_id, batch);
+
+    commands.emplace_back(CommandPayloadBuilder::add(channel_id, string(sorted[i]), recursive, 1)
+                            .set_id(command_id)
+                            .set_poll_interval(poll_interval)
+                            .set_poll_staleness(poll_staleness)
+                            .set_exclude(excludes[i])
+                            .set_respect_ignore_files(respect_ignore_files)
+                            .set_actions(actions)
+                            .set_max_depth(max_depth)
+                            .set_burst_threshold(burst_threshold)
+                            .build());
+  }
+
+  batch->channels.reserve(roots.size());
+  for (const string &root : roots) {
+    batch->channels.push_back(channels_by_root[root]);
+  }
+
+  if (commands.empty()) {
+    Local<Value> argv[] = {Nan::Null(), Nan::New<Array>(0)};
+    batch->callback->Call(2, argv);
+    return ok_result();
+  }
+
+  Thread &thread = poll ? static_cast<Thread &>(polling_thread) : static_cast<Thread &>(worker_thread);
+  LOGGER << "Sending a batch of " << plural(static_cast<long>(commands.size()), "ADD command") << " to " << thread
+         << "." << endl;
+  Result<bool> sr = thread.send_all(commands.begin(), commands.end());
+  if (sr.is_error()) return sr.propagate();
+  if (sr.get_value()) handle_events();
+  return ok_result();
 }
 
 Result<> Hub::unwatch(ChannelID channel_id, unique_ptr<Callback> &&ack_callback)
@@ -82,6 +199,15 @@ Result<> Hub::unwatch(ChannelID channel_id, unique_ptr<Callback> &&ack_callback)
   r &= send_command(worker_thread, CommandPayloadBuilder::remove(channel_id), all->create_callback());
   r &= send_command(polling_thread, CommandPayloadBuilder::remove(channel_id), all->create_callback());
 
+  channel_routers.erase(channel_id);
+  for (auto it = subscribers.begin(); it != subscribers.end();) {
+    if (it->second.channel_id == channel_id) {
+      it = subscribers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
   auto maybe_event_callback = channel_callbacks.find(channel_id);
   if (maybe_event_callback == channel_callbacks.end()) {
     LOGGER << "Channel " << channel_id << " already has no event callback." << endl;
@@ -91,21 +217,176 @@ Result<> Hub::unwatch(ChannelID channel_id, unique_ptr<Callback> &&ack_callback)
   return r;
 }
 
+Result<> Hub::expand(ChannelID channel_id, string &&dir, uint_fast32_t depth, unique_ptr<Callback> &&ack_callback)
+{
+  if (channel_callbacks.count(channel_id) == 0) {
+    ostringstream msg;
+    msg << "Channel " << channel_id << " is not being watched";
+    return error_result(msg.str());
+  }
+
+  // Either thread may be watching the channel, or both of them once the worker thread falls back to polling.
+  shared_ptr<AllCallback> all = AllCallback::create(move(ack_callback));
+
+  Result<> r = ok_result();
+  r &= send_command(
+    worker_thread, CommandPayloadBuilder::expand(channel_id, string(dir), depth), all->create_callback());
+  r &= send_command(
+    polling_thread, CommandPayloadBuilder::expand(channel_id, move(dir), depth), all->create_callback());
+  return r;
+}
+
+Result<> Hub::collapse(ChannelID channel_id, string &&dir, unique_ptr<Callback> &&ack_callback)
+{
+  if (channel_callbacks.count(channel_id) == 0) {
+    ostringstream msg;
+    msg << "Channel " << channel_id << " is not being watched";
+    return error_result(msg.str());
+  }
+
+  shared_ptr<AllCallback> all = AllCallback::create(move(ack_callback));
+
+  Result<> r = ok_result();
+  r &= send_command(worker_thread, CommandPayloadBuilder::collapse(channel_id, string(dir)), all->create_callback());
+  r &= send_command(polling_thread, CommandPayloadBuilder::collapse(channel_id, move(dir)), all->create_callback());
+  return r;
+}
+
+Result<SubscriptionID> Hub::subscribe(ChannelID channel_id,
+  const string &path,
+  bool recursive,
+  unique_ptr<Callback> callback)
+{
+  if (channel_callbacks.count(channel_id) == 0) {
+    ostringstream msg;
+    msg << "Channel " << channel_id << " is not being watched";
+    return Result<SubscriptionID>::make_error(msg.str());
+  }
+
+  SubscriptionID subscription_id = next_subscription_id;
+  next_subscription_id++;
+
+  subscribers.emplace(subscription_id, Subscriber{channel_id, shared_ptr<Callback>(move(callback))});
+  channel_routers[channel_id].add(subscription_id, path, recursive);
+
+  LOGGER << "Subscription " << subscription_id << " receives events within " << path
+         << (recursive ? "" : " (non-recursively)") << " on channel " << channel_id << "." << endl;
+  return ok_result(subscription_id);
+}
+
+void Hub::unsubscribe(SubscriptionID subscription_id)
+{
+  auto subscriber = subscribers.find(subscription_id);
+  if (subscriber == subscribers.end()) return;
+
+  auto router = channel_routers.find(subscriber->second.channel_id);
+  if (router != channel_routers.end()) {
+    router->second.remove(subscription_id);
+    if (router->second.empty()) channel_routers.erase(router);
+  }
+  subscribers.erase(subscriber);
+}
+
 void Hub::handle_events()
 {
+  TraceScope dispatch_trace("dispatch");
+  uint64_t start = uv_hrtime();
+
   handle_events_from(worker_thread);
   handle_events_from(polling_thread);
+
+  dispatch_duration.record((uv_hrtime() - start) / 1000);
+}
+
+Result<> Hub::replay_capture(const string &capture_path, Local<Object> js_events)
+{
+  map<ChannelID, vector<Local<Object>>> to_deliver;
+  Result<> r = WorkerPlatform::replay_capture(capture_path, [&to_deliver](MessageBuffer &messages) {
+    for (Message &message : messages) {
+      const FileSystemPayload *fs = message.as_filesystem();
+      if (fs == nullptr) continue;
+
+      to_deliver[fs->get_channel_id()].push_back(
+        js_filesystem_event(fs->get_filesystem_action(), fs->get_entry_kind(), fs->get_old_path(), fs->get_path()));
+    }
+  });
+  if (r.is_error()) return r;
+
+  for (auto &pair : to_deliver) {
+    vector<Local<Object>> &channel_events = pair.second;
+    Local<Array> js_array = Nan::New<Array>(channel_events.size());
+    for (size_t i = 0; i < channel_events.size(); i++) {
+      Nan::Set(js_array, i, channel_events[i]);
+    }
+    Nan::Set(js_events, Nan::New<Number>(pair.first), js_array);
+  }
+  return ok_result();
 }
 
 void Hub::collect_status(Status &status)
 {
   status.pending_callback_count = pending_callbacks.size();
   status.channel_callback_count = channel_callbacks.size();
+  status.dispatch_duration = dispatch_duration.summarize();
+  status.callback_duration = callback_duration.summarize();
+  status.channel_batch = channel_batch.summarize();
+  status.latency_emit = latency_emit.summarize();
+  status.latency_queue = latency_queue.summarize();
+  status.latency_dispatch = latency_dispatch.summarize();
+  status.latency_total = latency_total.summarize();
 
   worker_thread.collect_status(status);
   polling_thread.collect_status(status);
 }
 
+void Hub::reset_status()
+{
+  dispatch_duration.reset();
+  callback_duration.reset();
+  channel_batch.reset();
+  latency_emit.reset();
+  latency_queue.reset();
+  latency_dispatch.reset();
+  latency_total.reset();
+
+  worker_thread.reset_status();
+  polling_thread.reset_status();
+}
+
+void Hub::record_latency(vector<Local<Object>> &js_events,
+  const vector<pair<uint64_t, uint64_t>> &stamps,
+  uint64_t received_at)
+{
+  uint64_t delivered_at = uv_hrtime();
+
+  for (size_t i = 0; i < js_events.size() && i < stamps.size(); i++) {
+    uint64_t detected_at = stamps[i].first;
+    uint64_t emitted_at = stamps[i].second;
+
+    // Events detected before tracing was enabled carry no timestamps.
+    if (detected_at == 0 || emitted_at == 0) continue;
+
+    uint64_t emit_us = (emitted_at - detected_at) / 1000;
+    uint64_t queue_us = (received_at - emitted_at) / 1000;
+    uint64_t dispatch_us = (delivered_at - received_at) / 1000;
+    uint64_t total_us = (delivered_at - detected_at) / 1000;
+
+    latency_emit.record(emit_us);
+    latency_queue.record(queue_us);
+    latency_dispatch.record(dispatch_us);
+    latency_total.record(total_us);
+
+    Local<Object> js_latency = Nan::New<Object>();
+    Nan::Set(js_latency, Nan::New<String>("emit").ToLocalChecked(), Nan::New<Number>(static_cast<double>(emit_us)));
+    Nan::Set(js_latency, Nan::New<String>("queue").ToLocalChecked(), Nan::New<Number>(static_cast<double>(queue_us)));
+    Nan::Set(js_latency,
+      Nan::New<String>("dispatch").ToLocalChecked(),
+      Nan::New<Number>(static_cast<double>(dispatch_us)));
+    Nan::Set(js_latency, Nan::New<String>("total").ToLocalChecked(), Nan::New<Number>(static_cast<double>(total_us)));
+    Nan::Set(js_events[i], Nan::New<String>("latency").ToLocalChecked(), js_latency);
+  }
+}
+
 Result<> Hub::send_command(Thread &thread, CommandPayloadBuilder &&builder, std::unique_ptr<Nan::Callback> callback)
 {
   CommandID command_id = next_command_id;
@@ -138,15 +419,34 @@ void Hub::handle_events_from(Thread &thread)
     return;
   }
 
+  // Timestamps of the filesystem messages in `to_deliver`, collected while latency tracing is enabled.
+  bool tracing = is_latency_tracing();
+  uint64_t received_at = tracing ? uv_hrtime() : 0;
+  map<ChannelID, vector<pair<uint64_t, uint64_t>>> to_deliver_stamps;
+
   map<ChannelID, vector<Local<Object>>> to_deliver;
   multimap<ChannelID, Local<Value>> errors;
   set<ChannelID> to_unwatch;
 
+  // Events bound for channel subscriptions, and the subscriptions matched by the current event's paths.
+  map<SubscriptionID, vector<Local<Object>>> to_route;
+  map<SubscriptionID, vector<pair<uint64_t, uint64_t>>> to_route_stamps;
+  vector<SubscriptionID> matched;
+  vector<SubscriptionID> old_matched;
+
   for (Message &message : *accepted) {
     const AckPayload *ack = message.as_ack();
     if (ack != nullptr) {
       LOGGER << "Received ack message " << message << "." << endl;
 
+      auto maybe_batch = pending_batches.find(ack->get_key());
+      if (maybe_batch != pending_batches.end()) {
+        shared_ptr<BatchAck> batch = move(maybe_batch->second);
+        pending_batches.erase(maybe_batch);
+        batch_acked(*batch, *ack);
+        continue;
+      }
+
       auto maybe_callback = pending_callbacks.find(ack->get_key());
       if (maybe_callback == pending_callbacks.end()) {
         LOGGER << "Ignoring unexpected ack " << message << "." << endl;
@@ -175,20 +475,48 @@ void Hub::handle_events_from(Thread &thread)
 
     const FileSystemPayload *fs = message.as_filesystem();
     if (fs != nullptr) {
-      LOGGER << "Received filesystem event message " << message << "." << endl;
+      TRACE_LOGGER << "Received filesystem event message " << message << "." << endl;
 
       ChannelID channel_id = fs->get_channel_id();
+      FileSystemAction action = fs->get_filesystem_action();
+      EntryKind kind = fs->get_entry_kind();
+
+      auto router = channel_routers.find(channel_id);
+      if (router == channel_routers.end()) {
+        to_deliver[channel_id].push_back(js_filesystem_event(action, kind, fs->get_old_path(), fs->get_path()));
+        if (tracing) to_deliver_stamps[channel_id].emplace_back(fs->get_detected_at(), fs->get_emitted_at());
+        continue;
+      }
+
+      // Deliver the event only to the subscriptions whose subtrees contain it. A rename is split into a deletion or
+      // creation for subscriptions that contain only one of its paths. A summary of a subtree, or the deletion of a
+      // directory that may stand for everything deleted within it, reaches every subscription that overlaps it.
+      matched.clear();
+      old_matched.clear();
+      if (action == ACTION_CHANGED || (action == ACTION_DELETED && kind == KIND_DIRECTORY)) {
+        router->second.route_subtree(fs->get_path(), matched);
+      } else {
+        router->second.route(fs->get_path(), matched);
+      }
+      if (action == ACTION_RENAMED) router->second.route(fs->get_old_path(), old_matched);
+
+      for (SubscriptionID subscription_id : matched) {
+        bool both = action == ACTION_RENAMED
+          && std::find(old_matched.begin(), old_matched.end(), subscription_id) != old_matched.end();
 
-      Local<Object> js_event = Nan::New<Object>();
-      js_event->Set(
-        Nan::New<String>("action").ToLocalChecked(), Nan::New<Number>(static_cast<int>(fs->get_filesystem_action())));
-      js_event->Set(
-        Nan::New<String>("kind").ToLocalChecked(), Nan::New<Number>(static_cast<int>(fs->get_entry_kind())));
-      js_event->Set(
-        Nan::New<String>("oldPath").ToLocalChecked(), Nan::New<String>(fs->get_old_path()).ToLocalChecked());
-      js_event->Set(Nan::New<String>("path").ToLocalChecked(), Nan::New<String>(fs->get_path()).ToLocalChecked());
+        if (action == ACTION_RENAMED && !both) {
+          to_route[subscription_id].push_back(js_filesystem_event(ACTION_CREATED, kind, "", fs->get_path()));
+        } else {
+          to_route[subscription_id].push_back(js_filesystem_event(action, kind, fs->get_old_path(), fs->get_path()));
+        }
+        if (tracing) to_route_stamps[subscription_id].emplace_back(fs->get_detected_at(), fs->get_emitted_at());
+      }
+      for (SubscriptionID subscription_id : old_matched) {
+        if (std::find(matched.begin(), matched.end(), subscription_id) != matched.end()) continue;
 
-      to_deliver[channel_id].push_back(js_event);
+        to_route[subscription_id].push_back(js_filesystem_event(ACTION_DELETED, kind, "", fs->get_old_path()));
+        if (tracing) to_route_stamps[subscription_id].emplace_back(fs->get_detected_at(), fs->get_emitted_at());
+      }
       continue;
     }
 
@@ -244,17 +572,22 @@ void Hub::handle_events_from(Thread &thread)
 
     LOGGER << "Dispatching " << js_events.size() << " event(s) on channel " << channel_id << " to the node callback."
            << endl;
+    dispatch(channel_id, callback, js_events, to_deliver_stamps[channel_id], received_at);
+  }
 
-    Local<Array> js_array = Nan::New<Array>(js_events.size());
+  for (auto &pair : to_route) {
+    const SubscriptionID &subscription_id = pair.first;
+    vector<Local<Object>> &js_events = pair.second;
 
-    int index = 0;
-    for (auto &js_event : js_events) {
-      js_array->Set(index, js_event);
-      index++;
-    }
+    // An earlier callback in this batch may have unsubscribed.
+    auto subscriber = subscribers.find(subscription_id);
+    if (subscriber == subscribers.end()) continue;
+    ChannelID channel_id = subscriber->second.channel_id;
+    shared_ptr<Callback> callback = subscriber->second.callback;
 
-    Local<Value> argv[] = {Nan::Null(), js_array};
-    callback->Call(2, argv);
+    LOGGER << "Dispatching " << js_events.size() << " event(s) on channel " << channel_id << " to subscription "
+           << subscription_id << "." << endl;
+    dispatch(channel_id, callback, js_events, to_route_stamps[subscription_id], received_at);
   }
 
   for (auto &pair : errors) {
@@ -270,8 +603,8 @@ void Hub::handle_events_from(Thread &thread)
 
     LOGGER << "Report an error on channel " << channel_id << " to the node callback." << endl;
 
-    Local<Value> argv[] = {err};
-    callback->Call(1, argv);
+    Local<Value> argv[] = {err, Nan::Null(), Nan::New<Number>(channel_id)};
+    callback->Call(3, argv);
   }
 
   for (const ChannelID &channel_id : to_unwatch) {
@@ -281,3 +614,67 @@ void Hub::handle_events_from(Thread &thread)
 
   if (repeat) handle_events_from(thread);
 }
+
+void Hub::batch_acked(BatchAck &batch, const AckPayload &ack)
+{
+  if (!ack.was_successful()) {
+    ChannelID channel_id = ack.get_channel_id();
+    batch.errors.push_back(ack.get_message());
+    channel_callbacks.erase(channel_id);
+    std::replace(batch.channels.begin(), batch.channels.end(), channel_id, NULL_CHANNEL_ID);
+  }
+
+  batch.remaining--;
+  if (batch.remaining > 0) return;
+
+  Local<Array> js_channels = Nan::New<Array>(batch.channels.size());
+  for (size_t i = 0; i < batch.channels.size(); i++) {
+    ChannelID channel_id = batch.channels[i];
+    if (channel_id == NULL_CHANNEL_ID) {
+      Nan::Set(js_channels, i, Nan::Null());
+    } else {
+      Nan::Set(js_channels, i, Nan::New<Number>(channel_id));
+    }
+  }
+
+  Local<Value> err = Nan::Null();
+  if (!batch.errors.empty()) {
+    string message;
+    for (const string &error : batch.errors) {
+      if (!message.empty()) message += ", ";
+      message += error;
+    }
+    err = Nan::Error(message.c_str());
+  }
+
+  Local<Value> argv[] = {err, js_channels};
+  batch.callback->Call(2, argv);
+}
+
+void Hub::dispatch(ChannelID channel_id,
+  const shared_ptr<Callback> &callback,
+  vector<Local<Object>> &js_events,
+  const vector<pair<uint64_t, uint64_t>> &stamps,
+  uint64_t received_at)
+{
+  Local<Array> js_array = Nan::New<Array>(js_events.size());
+
+  int index = 0;
+  for (auto &js_event : js_events) {
+    js_array->Set(index, js_event);
+    index++;
+  }
+
+  channel_batch.record(js_events.size());
+  if (is_latency_tracing()) record_latency(js_events, stamps, received_at);
+
+  WATCHER_PROBE2(dispatch, channel_id, js_events.size());
+  TraceScope callback_trace("callback");
+  callback_trace.arg("channel", channel_id);
+  callback_trace.arg("events", js_events.size());
+
+  Local<Value> argv[] = {Nan::Null(), js_array, Nan::New<Number>(channel_id)};
+  uint64_t call_start = uv_hrtime();
+  callback->Call(3, argv);
+  callback_duration.record((uv_hrtime() - call_start) / 1000);
+}
@@ -7,11 +7,16 @@
 #include <unordered_map>
 #include <utility>
 #include <uv.h>
+#include <vector>
 
+#include "event_router.h"
+#include "file_set.h"
+#include "histogram.h"
 #include "log.h"
 #include "message.h"
 #include "polling/polling_thread.h"
 #include "result.h"
+#include "trace.h"
 #include "worker/worker_thread.h"
 
 class Hub
@@ -26,7 +31,7 @@ public:
   Hub &operator=(const Hub &) = delete;
   Hub &operator=(Hub &&) = delete;
 
-  void use_main_log_file(std::string &&main_log_file) { Logger::to_file(main_log_file.c_str()); }
+  bool use_main_log_file(const std::string &main_log_file) { return Logger::to_file(main_log_file.c_str()); }
 
   void use_main_log_stderr() { Logger::to_stderr(); }
 
@@ -34,6 +39,12 @@ public:
 
   void disable_main_log() { Logger::disable(); }
 
+  void set_latency_tracing(bool enabled) { ::set_latency_tracing(enabled); }
+
+  void start_trace() { trace_start(); }
+
+  Result<TraceSummary> stop_trace(const std::string &path) { return trace_stop(path); }
+
   Result<> use_worker_log_file(std::string &&worker_log_file, std::unique_ptr<Nan::Callback> callback)
   {
     return send_command(
@@ -86,18 +97,89 @@ public:
     return send_command(polling_thread, CommandPayloadBuilder::polling_throttle(throttle), std::move(callback));
   }
 
+  Result<> set_polling_cpu_budget(uint_fast32_t budget, std::unique_ptr<Nan::Callback> callback)
+  {
+    return send_command(polling_thread, CommandPayloadBuilder::polling_cpu_budget(budget), std::move(callback));
+  }
+
+  Result<> set_polling_snapshot_dir(std::string &&snapshot_dir, std::unique_ptr<Nan::Callback> callback)
+  {
+    return send_command(
+      polling_thread, CommandPayloadBuilder::polling_snapshots(std::move(snapshot_dir)), std::move(callback));
+  }
+
+  Result<> set_worker_capture(std::string &&capture_path, std::unique_ptr<Nan::Callback> callback)
+  {
+    return send_command(
+      worker_thread, CommandPayloadBuilder::worker_capture(std::move(capture_path)), std::move(callback));
+  }
+
   Result<> watch(std::string &&root,
     bool poll,
     bool recursive,
+    uint_fast32_t poll_interval,
+    uint_fast32_t poll_staleness,
+    std::shared_ptr<const GlobSet> exclude,
+    bool respect_ignore_files,
+    ActionMask actions,
+    std::shared_ptr<const FileSet> files,
+    uint_fast32_t max_depth,
+    uint_fast32_t burst_threshold,
+    std::unique_ptr<Nan::Callback> ack_callback,
+    std::unique_ptr<Nan::Callback> event_callback);
+
+  // Watch each of `roots` on a channel of its own, with the same options. Duplicate roots share a channel. The roots
+  // are sent to the thread as a single sorted batch, so that a root within another one can re-use its crawl. Once every
+  // channel has been acknowledged, `ack_callback` is called once with the channel of each root, in the order of
+  // `roots`, or null for a root that couldn't be watched. `event_callback` receives the events of every channel, along
+  // with the channel that produced them.
+  Result<> watch_many(std::vector<std::string> &&roots,
+    bool poll,
+    bool recursive,
+    uint_fast32_t poll_interval,
+    uint_fast32_t poll_staleness,
+    const std::vector<std::string> &exclude_patterns,
+    bool respect_ignore_files,
+    ActionMask actions,
+    uint_fast32_t max_depth,
+    uint_fast32_t burst_threshold,
     std::unique_ptr<Nan::Callback> ack_callback,
     std::unique_ptr<Nan::Callback> event_callback);
 
   Result<> unwatch(ChannelID channel_id, std::unique_ptr<Nan::Callback> &&ack_callback);
 
+  // Watch the directories up to `depth` levels beneath the absolute path `dir` on a channel that was watched with a
+  // maximum depth, in addition to those it already watches. Expanding a directory again replaces its depth.
+  Result<> expand(ChannelID channel_id,
+    std::string &&dir,
+    uint_fast32_t depth,
+    std::unique_ptr<Nan::Callback> &&ack_callback);
+
+  // Stop watching the directories that an earlier `expand()` of `dir` watched, unless the channel's maximum depth or
+  // another expansion still covers them.
+  Result<> collapse(ChannelID channel_id, std::string &&dir, std::unique_ptr<Nan::Callback> &&ack_callback);
+
+  // Deliver the events of a channel within the absolute path `path` to `callback` rather than to the channel's own
+  // callback. Renames across the edge of the subtree are reported as creations or deletions. Once a channel has any
+  // subscriptions, only its errors are reported to its own callback.
+  Result<SubscriptionID> subscribe(ChannelID channel_id,
+    const std::string &path,
+    bool recursive,
+    std::unique_ptr<Nan::Callback> callback);
+
+  void unsubscribe(SubscriptionID subscription_id);
+
   void handle_events();
 
+  // Replay a capture recorded with the `workerCapture` option on the calling thread, without a live filesystem, and
+  // collect the filesystem events it produces into `js_events`, as one array for each channel keyed by its ID.
+  Result<> replay_capture(const std::string &capture_path, v8::Local<v8::Object> js_events);
+
   void collect_status(Status &status);
 
+  // Clear the histograms and high-water marks reported by `collect_status()`.
+  void reset_status();
+
 private:
   Hub();
 
@@ -105,6 +187,34 @@ private:
 
   void handle_events_from(Thread &thread);
 
+  // Acknowledgements still expected for the channels created by a single `watch_many()` call.
+  struct BatchAck
+  {
+    std::unique_ptr<Nan::Callback> callback;
+
+    // Channel of each root, in the order that they were given. Cleared for roots that couldn't be watched.
+    std::vector<ChannelID> channels;
+
+    std::vector<std::string> errors;
+    size_t remaining;
+  };
+
+  // Record the acknowledgement of one channel of `batch`, and call its callback if it was the last one.
+  void batch_acked(BatchAck &batch, const AckPayload &ack);
+
+  // Call `callback` with a batch of events produced on `channel_id`, recording the time that it takes.
+  void dispatch(ChannelID channel_id,
+    const std::shared_ptr<Nan::Callback> &callback,
+    std::vector<v8::Local<v8::Object>> &js_events,
+    const std::vector<std::pair<uint64_t, uint64_t>> &stamps,
+    uint64_t received_at);
+
+  // Record the time spent by each event in `js_events` at each stage of its delivery, and attach the durations to it
+  // as a `latency` property. `stamps` holds the detection and emission timestamps of each event.
+  void record_latency(std::vector<v8::Local<v8::Object>> &js_events,
+    const std::vector<std::pair<uint64_t, uint64_t>> &stamps,
+    uint64_t received_at);
+
   static Hub the_hub;
 
   uv_async_t event_handler{};
@@ -116,7 +226,33 @@ private:
   ChannelID next_channel_id;
 
   std::unordered_map<CommandID, std::unique_ptr<Nan::Callback>> pending_callbacks;
+  std::unordered_map<CommandID, std::shared_ptr<BatchAck>> pending_batches;
   std::unordered_map<ChannelID, std::shared_ptr<Nan::Callback>> channel_callbacks;
+
+  struct Subscriber
+  {
+    ChannelID channel_id;
+    std::shared_ptr<Nan::Callback> callback;
+  };
+
+  SubscriptionID next_subscription_id;
+  std::unordered_map<SubscriptionID, Subscriber> subscribers;
+  std::unordered_map<ChannelID, EventRouter> channel_routers;
+
+  // Time spent handling each batch of messages from the worker and polling threads, and time spent within each
+  // event callback, in microseconds.
+  Histogram dispatch_duration;
+  Histogram callback_duration;
+
+  // Number of events delivered to each channel callback at once.
+  Histogram channel_batch;
+
+  // Microseconds spent by each event between detection and emission to the main thread, waiting in the output queue,
+  // waiting for its callback to be invoked, and in total. Only recorded while latency tracing is enabled.
+  Histogram latency_emit;
+  Histogram latency_queue;
+  Histogram latency_dispatch;
+  Histogram latency_total;
 };
 
 #endif
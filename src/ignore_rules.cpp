@@ -0,0 +1,155 @@
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glob.h"
+#include "helper/common.h"
+#include "ignore_rules.h"
+#include "result.h"
+
+using std::ifstream;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+// Ignore files in ascending order of precedence.
+static const char *const IGNORE_FILE_NAMES[] = {".gitignore", ".ignore"};
+
+IgnoreRules::IgnoreRules(const string &root) : root(root)
+{
+  //
+}
+
+bool IgnoreRules::is_ignore_file(const string &name)
+{
+  for (const char *ignore_file_name : IGNORE_FILE_NAMES) {
+    if (name == ignore_file_name) return true;
+  }
+  return false;
+}
+
+bool IgnoreRules::ignores(const string &path, bool directory)
+{
+  if (path.size() <= root.size() || path.compare(0, root.size(), root) != 0) return false;
+
+  // Consult each directory from the entry's parent up to the root, so that deeper rules take precedence.
+  string dir(path);
+  while (dir.size() > root.size()) {
+    size_t separator = dir.find_last_of(PATH_SEPARATORS);
+    if (separator == string::npos) break;
+    size_t length = separator > 0 ? separator : 1;
+    if (length < root.size()) break;
+    dir.resize(length);
+
+    const vector<Rule> &rules = rules_for(dir);
+    for (auto rule = rules.rbegin(); rule != rules.rend(); ++rule) {
+      GlobSet::Match match = rule->glob->match(path);
+      if (match == GlobSet::MATCH_NONE) continue;
+
+      // A match on an ancestor satisfies a directory-only rule, because ancestors are always directories.
+      if (rule->directory_only && match == GlobSet::MATCH_PATH && !directory) continue;
+
+      return !rule->negated;
+    }
+
+    if (length <= root.size()) break;
+  }
+
+  return false;
+}
+
+bool IgnoreRules::ignores_within(const string &path, bool directory)
+{
+  if (path.size() <= root.size() || path.compare(0, root.size(), root) != 0) return false;
+
+  size_t separator = path.find_first_of(PATH_SEPARATORS, root.size() + 1);
+  while (separator != string::npos) {
+    if (ignores(path.substr(0, separator), true)) return true;
+    separator = path.find_first_of(PATH_SEPARATORS, separator + 1);
+  }
+  return ignores(path, directory);
+}
+
+bool IgnoreRules::reload(const string &dir)
+{
+  vector<Rule> previous;
+  auto existing = by_directory.find(dir);
+  if (existing != by_directory.end()) {
+    previous = std::move(existing->second);
+    by_directory.erase(existing);
+  }
+
+  const vector<Rule> &current = rules_for(dir);
+  if (current.size() != previous.size()) return true;
+  for (size_t i = 0; i < current.size(); i++) {
+    const Rule &was = previous[i];
+    const Rule &is = current[i];
+    if (was.negated != is.negated || was.directory_only != is.directory_only
+      || was.glob->get_patterns() != is.glob->get_patterns()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void IgnoreRules::forget(const string &dir)
+{
+  by_directory.erase(dir);
+
+  string prefix(dir + "/");
+  auto it = by_directory.lower_bound(prefix);
+  while (it != by_directory.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+    it = by_directory.erase(it);
+  }
+#ifdef _WIN32
+  prefix.back() = '\\';
+  it = by_directory.lower_bound(prefix);
+  while (it != by_directory.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+    it = by_directory.erase(it);
+  }
+#endif
+}
+
+const vector<IgnoreRules::Rule> &IgnoreRules::rules_for(const string &dir)
+{
+  auto existing = by_directory.find(dir);
+  if (existing != by_directory.end()) return existing->second;
+
+  vector<Rule> &rules = by_directory[dir];
+  for (const char *ignore_file_name : IGNORE_FILE_NAMES) {
+    read_rules(dir, path_join(dir, ignore_file_name), rules);
+  }
+  return rules;
+}
+
+void IgnoreRules::read_rules(const string &dir, const string &path, vector<Rule> &into)
+{
+  ifstream in(path, std::ios::in);
+  if (!in) return;
+
+  string line;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+
+    // Trailing spaces are significant only when escaped.
+    size_t length = line.size();
+    while (length > 0 && line[length - 1] == ' ' && (length < 2 || line[length - 2] != '\\')) length--;
+    line.resize(length);
+
+    if (line.empty() || line[0] == '#') continue;
+
+    bool negated = line[0] == '!';
+    if (negated) line.erase(0, 1);
+
+    bool directory_only = !line.empty() && line.back() == '/';
+
+    // Malformed or empty patterns are skipped, as git does.
+    Result<shared_ptr<const GlobSet>> glob = GlobSet::compile(dir, vector<string>{line});
+    if (glob.is_error()) continue;
+
+    into.push_back(Rule{glob.get_value(), negated, directory_only});
+  }
+}
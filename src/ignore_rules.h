@@ -0,0 +1,76 @@
+#ifndef IGNORE_RULES_H
+#define IGNORE_RULES_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glob.h"
+
+// The rules of the `.gitignore` and `.ignore` files found beneath a watch root, used to skip ignored subtrees as they
+// are crawled, polled, and reported. Rules follow gitignore semantics:
+//
+// * Blank lines and lines beginning with `#` are skipped. Trailing spaces are removed unless escaped with a backslash.
+// * A leading `!` re-includes entries ignored by an earlier rule. A leading `\!` or `\#` is taken literally.
+// * A trailing `/` restricts a rule to directories.
+// * Patterns are interpreted as by `GlobSet`, relative to the directory containing the ignore file.
+//
+// The last matching rule within a file wins, rules in `.ignore` take precedence over those in `.gitignore`, and the
+// rules of a deeper directory take precedence over those of its ancestors. Entries within an ignored directory can't
+// be re-included.
+//
+// Each directory's ignore files are read the first time its rules are consulted and cached until `reload()` or
+// `forget()`. Instances are mutated as they're consulted, so each belongs to a single thread.
+class IgnoreRules
+{
+public:
+  explicit IgnoreRules(const std::string &root);
+
+  ~IgnoreRules() = default;
+
+  // Return true if `name` is the name of a file that holds ignore rules.
+  static bool is_ignore_file(const std::string &name);
+
+  // Return true if the entry at the absolute path `path`, a directory if `directory` is true, is ignored by the rules
+  // of the directories that contain it. Its ancestors are assumed not to be ignored.
+  bool ignores(const std::string &path, bool directory);
+
+  // Return true if the entry at the absolute path `path` or any of its ancestors beneath the root are ignored.
+  bool ignores_within(const std::string &path, bool directory);
+
+  // Re-read the ignore files of the directory `dir`. Return true if its rules have changed.
+  bool reload(const std::string &dir);
+
+  // Discard the cached rules of the directory `dir` and every directory beneath it, such as after it's been deleted.
+  void forget(const std::string &dir);
+
+  const std::string &get_root() const { return root; }
+
+  IgnoreRules(const IgnoreRules &) = delete;
+  IgnoreRules(IgnoreRules &&) = delete;
+  IgnoreRules &operator=(const IgnoreRules &) = delete;
+  IgnoreRules &operator=(IgnoreRules &&) = delete;
+
+private:
+  struct Rule
+  {
+    std::shared_ptr<const GlobSet> glob;
+    bool negated;
+    bool directory_only;
+  };
+
+  // Access the rules of the directory `dir`, reading its ignore files if they haven't been read yet. Rules are ordered
+  // from lowest to highest precedence.
+  const std::vector<Rule> &rules_for(const std::string &dir);
+
+  // Parse the ignore file at `path` and append its rules, anchored at `dir`, to `into`.
+  static void read_rules(const std::string &dir, const std::string &path, std::vector<Rule> &into);
+
+  std::string root;
+
+  // Rules of every directory consulted so far, including those without any ignore files.
+  std::map<std::string, std::vector<Rule>> by_directory;
+};
+
+#endif
@@ -1,7 +1,14 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <uv.h>
+#include <vector>
 
 #include "log.h"
 
@@ -14,83 +21,336 @@ using std::endl;
 using std::ofstream;
 using std::ostream;
 using std::setw;
+using std::shared_ptr;
 using std::string;
+using std::stringbuf;
 using std::to_string;
+using std::unique_ptr;
+using std::vector;
 
-class NullLogger : public Logger
+// Capacity of each logger's ring, in bytes.
+static const size_t LOG_RING_SIZE = 256 * 1024;
+
+// Longest that a record may wait in a ring before the writer thread picks it up, in milliseconds.
+static const uint64_t LOG_WRITER_INTERVAL = 20;
+
+static void write_prefix(ostream &out, const char *file, int line)
+{
+  out << "[" << setw(15) << file << ":" << setw(3) << dec << line << "] ";
+}
+
+// Bounded queue of formatted log records with a single producer (the thread that owns the logger) and a single
+// consumer (the writer thread). Each record is stored as a `uint32_t` byte count followed by its bytes, wrapping
+// around the end of the buffer. A record that doesn't fit is dropped and counted rather than blocking the producer.
+class LogRing
 {
 public:
-  NullLogger() = default;
+  LogRing() : data{new char[LOG_RING_SIZE]}, head{0}, tail{0}, dropped{0}
+  {
+    //
+  }
 
-  Logger *prefix(const char * /*file*/, int /*line*/) override { return this; }
+  LogRing(const LogRing &) = delete;
+  LogRing(LogRing &&) = delete;
+  ~LogRing() = default;
+  LogRing &operator=(const LogRing &) = delete;
+  LogRing &operator=(LogRing &&) = delete;
 
-  ostream &stream() override { return unopened; }
+  // Producer only. Return true if the ring is more than half full after the push.
+  bool push(const string &record)
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire);
+    size_t needed = sizeof(uint32_t) + record.size();
+
+    if (needed > LOG_RING_SIZE - (h - t)) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    auto length = static_cast<uint32_t>(record.size());
+    copy_in(h, reinterpret_cast<const char *>(&length), sizeof(uint32_t));
+    copy_in(h + sizeof(uint32_t), record.data(), record.size());
+    head.store(h + needed, std::memory_order_release);
+
+    return h + needed - t > LOG_RING_SIZE / 2;
+  }
+
+  // Consumer only. Return false if the ring is empty.
+  bool pop(string &record)
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    if (t == h) return false;
+
+    uint32_t length = 0;
+    copy_out(t, reinterpret_cast<char *>(&length), sizeof(uint32_t));
+    record.resize(length);
+    if (length > 0) copy_out(t + sizeof(uint32_t), &record[0], length);
+    tail.store(t + sizeof(uint32_t) + length, std::memory_order_release);
+
+    return true;
+  }
+
+  size_t take_dropped() { return dropped.exchange(0, std::memory_order_relaxed); }
 
 private:
-  ofstream unopened;
+  void copy_in(size_t position, const char *from, size_t count)
+  {
+    size_t offset = position % LOG_RING_SIZE;
+    size_t first = std::min(count, LOG_RING_SIZE - offset);
+    memcpy(data.get() + offset, from, first);
+    memcpy(data.get(), from + first, count - first);
+  }
+
+  void copy_out(size_t position, char *to, size_t count)
+  {
+    size_t offset = position % LOG_RING_SIZE;
+    size_t first = std::min(count, LOG_RING_SIZE - offset);
+    memcpy(to, data.get() + offset, first);
+    memcpy(to + first, data.get(), count - first);
+  }
+
+  unique_ptr<char[]> data;
+
+  // Monotonic byte positions. `head` is only written by the producer and `tail` only by the consumer.
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+
+  std::atomic<size_t> dropped;
 };
 
-class FileLogger : public Logger
+// Destination of an AsyncLogger's records. Shared between the logger and the writer thread, which performs all
+// output to the destination stream.
+class LogSink
 {
 public:
-  FileLogger(const char *filename) : log_stream{filename, std::ios::out | std::ios::app}
+  LogSink(unique_ptr<ostream> &&destination) :
+    out{*destination},
+    owned{std::move(destination)},
+    closed{false},
+    released{false}
   {
-    FileLogger::prefix(__FILE__, __LINE__);
-    log_stream << "FileLogger opened." << endl;
+    //
   }
 
-  Logger *prefix(const char *file, int line) override
+  LogSink(ostream &borrowed) : out{borrowed}, closed{false}, released{false}
   {
-    log_stream << "[" << setw(15) << file << ":" << setw(3) << dec << line << "] ";
-    return this;
+    //
+  }
+
+  LogSink(const LogSink &) = delete;
+  LogSink(LogSink &&) = delete;
+  ~LogSink() = default;
+  LogSink &operator=(const LogSink &) = delete;
+  LogSink &operator=(LogSink &&) = delete;
+
+  // Writer thread only.
+  void drain()
+  {
+    string record;
+    bool any = false;
+    while (ring.pop(record)) {
+      out << record;
+      any = true;
+    }
+
+    size_t dropped = ring.take_dropped();
+    if (dropped > 0) {
+      write_prefix(out, __FILE__, __LINE__);
+      out << plural(static_cast<long>(dropped), "log record") << " dropped." << endl;
+    } else if (any) {
+      out.flush();
+    }
+  }
+
+  ostream &out;
+  unique_ptr<ostream> owned;
+
+  LogRing ring;
+
+  // Set by the logger when it's destroyed. The writer thread drains the ring one last time, closes the destination,
+  // and sets `released`.
+  std::atomic<bool> closed;
+  bool released;
+};
+
+// The process-wide writer thread. Created on first use and never destroyed, so that it outlives every logger.
+class LogWriter
+{
+public:
+  static LogWriter &get()
+  {
+    static LogWriter *writer = new LogWriter();
+    return *writer;
+  }
+
+  LogWriter(const LogWriter &) = delete;
+  LogWriter(LogWriter &&) = delete;
+  ~LogWriter() = delete;
+  LogWriter &operator=(const LogWriter &) = delete;
+  LogWriter &operator=(LogWriter &&) = delete;
+
+  void add(const shared_ptr<LogSink> &sink)
+  {
+    uv_mutex_lock(&mutex);
+    sinks.push_back(sink);
+    if (!started) {
+      started = true;
+      uv_thread_create(&thread, &LogWriter::run, this);
+    }
+    uv_mutex_unlock(&mutex);
   }
 
-  ostream &stream() override { return log_stream; }
+  // Ask the writer thread to drain every ring now rather than at its next interval. Safe to call without holding
+  // the mutex.
+  void wake() { uv_cond_signal(&wakeup); }
+
+  // Close `sink` and block until the writer thread has written its remaining records and released its destination.
+  void remove(const shared_ptr<LogSink> &sink)
+  {
+    uv_mutex_lock(&mutex);
+    sink->closed.store(true, std::memory_order_release);
+    uv_cond_signal(&wakeup);
+    while (!sink->released) {
+      uv_cond_wait(&drained, &mutex);
+    }
+    uv_mutex_unlock(&mutex);
+  }
 
 private:
-  ofstream log_stream;
+  LogWriter() : started{false}
+  {
+    uv_mutex_init(&mutex);
+    uv_cond_init(&wakeup);
+    uv_cond_init(&drained);
+  }
+
+  static void run(void *arg)
+  {
+    auto *self = static_cast<LogWriter *>(arg);
+
+    uv_mutex_lock(&self->mutex);
+    while (true) {
+      bool any_released = false;
+
+      for (shared_ptr<LogSink> &sink : self->sinks) {
+        bool closing = sink->closed.load(std::memory_order_acquire);
+        sink->drain();
+
+        if (closing) {
+          sink->owned.reset();
+          sink->released = true;
+          any_released = true;
+        }
+      }
+
+      if (any_released) {
+        self->sinks.erase(std::remove_if(self->sinks.begin(),
+                            self->sinks.end(),
+                            [](const shared_ptr<LogSink> &sink) { return sink->released; }),
+          self->sinks.end());
+        uv_cond_broadcast(&self->drained);
+      }
+
+      uv_cond_timedwait(&self->wakeup, &self->mutex, LOG_WRITER_INTERVAL * 1000000);
+    }
+  }
+
+  uv_mutex_t mutex;
+  uv_cond_t wakeup;
+  uv_cond_t drained;
+  uv_thread_t thread{};
+  bool started;
+
+  vector<shared_ptr<LogSink>> sinks;
 };
 
-class StderrLogger : public Logger
+// Accumulates a single record. The record is complete when the stream is flushed, typically by `std::endl`.
+class RecordBuffer : public stringbuf
 {
 public:
-  StderrLogger()
+  RecordBuffer(const shared_ptr<LogSink> &sink) : sink{sink}
   {
-    StderrLogger::prefix(__FILE__, __LINE__);
-    cerr << "StderrLogger opened." << endl;
+    //
   }
 
-  Logger *prefix(const char *file, int line) override
+protected:
+  int sync() override
   {
-    cerr << "[" << setw(15) << file << ":" << setw(3) << dec << line << "] ";
-    return this;
+    if (pptr() != pbase()) {
+      if (sink->ring.push(str())) LogWriter::get().wake();
+      str(string());
+    }
+    return 0;
   }
 
-  ostream &stream() override { return cerr; }
+private:
+  shared_ptr<LogSink> sink;
+};
+
+class NullLogger : public Logger
+{
+public:
+  NullLogger() = default;
+
+  bool is_enabled() override { return false; }
+
+  Logger *prefix(const char * /*file*/, int /*line*/) override { return this; }
+
+  ostream &stream() override { return unopened; }
+
+private:
+  ofstream unopened;
 };
 
-class StdoutLogger : public Logger
+// Formats records on the logging thread and hands them to the writer thread, which performs all output.
+class AsyncLogger : public Logger
 {
 public:
-  StdoutLogger()
+  AsyncLogger(const shared_ptr<LogSink> &sink, const char *description) :
+    sink{sink},
+    buffer{sink},
+    record_stream{&buffer}
   {
-    StdoutLogger::prefix(__FILE__, __LINE__);
-    cout << "StdoutLogger opened." << endl;
+    LogWriter::get().add(sink);
+
+    write_prefix(record_stream, __FILE__, __LINE__);
+    record_stream << description << " opened." << endl;
+  }
+
+  AsyncLogger(const AsyncLogger &) = delete;
+  AsyncLogger(AsyncLogger &&) = delete;
+
+  ~AsyncLogger() override
+  {
+    record_stream.flush();
+    LogWriter::get().remove(sink);
   }
 
+  AsyncLogger &operator=(const AsyncLogger &) = delete;
+  AsyncLogger &operator=(AsyncLogger &&) = delete;
+
   Logger *prefix(const char *file, int line) override
   {
-    cout << "[" << setw(15) << file << ":" << setw(3) << dec << line << "] ";
+    write_prefix(record_stream, file, line);
     return this;
   }
 
-  ostream &stream() override { return cout; }
+  ostream &stream() override { return record_stream; }
+
+private:
+  shared_ptr<LogSink> sink;
+  RecordBuffer buffer;
+  ostream record_stream;
 };
 
 static uv_key_t current_logger_key;
 static NullLogger the_null_logger;
 static uv_once_t make_key_once = UV_ONCE_INIT;
 
+std::atomic<int> Logger::enabled_count{0};
+
 static void make_key()
 {
   uv_key_create(&current_logger_key);
@@ -110,29 +370,37 @@ Logger *Logger::current()
   return logger;
 }
 
-static void replace_logger(const Logger *new_logger)
+void Logger::replace_logger(Logger *new_logger)
 {
   Logger *prior = Logger::current();
   if (prior != &the_null_logger) {
+    enabled_count.fetch_sub(1, std::memory_order_relaxed);
     delete prior;
   }
 
-  uv_key_set(&current_logger_key, (void *) new_logger);
+  uv_key_set(&current_logger_key, static_cast<void *>(new_logger));
+  if (new_logger != &the_null_logger) {
+    enabled_count.fetch_add(1, std::memory_order_relaxed);
+  }
 }
 
-void Logger::to_file(const char *filename)
+bool Logger::to_file(const char *filename)
 {
-  replace_logger(new FileLogger(filename));
+  unique_ptr<ofstream> file(new ofstream(filename, std::ios::out | std::ios::app));
+  if (!file->is_open()) return false;
+
+  replace_logger(new AsyncLogger(shared_ptr<LogSink>(new LogSink(unique_ptr<ostream>(std::move(file)))), "FileLogger"));
+  return true;
 }
 
 void Logger::to_stderr()
 {
-  replace_logger(new StderrLogger());
+  replace_logger(new AsyncLogger(shared_ptr<LogSink>(new LogSink(cerr)), "StderrLogger"));
 }
 
 void Logger::to_stdout()
 {
-  replace_logger(new StdoutLogger());
+  replace_logger(new AsyncLogger(shared_ptr<LogSink>(new LogSink(cout)), "StdoutLogger"));
 }
 
 void Logger::disable()
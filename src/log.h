@@ -1,9 +1,13 @@
 #ifndef LOG_H
 #define LOG_H
 
+#include <atomic>
 #include <ostream>
 #include <string>
 
+// Each thread logs to its own Logger, which may be disabled, or may format records on the calling thread and hand
+// them to a dedicated writer thread through a lock-free ring. Console and file output is only ever performed by the
+// writer thread.
 class Logger
 {
 public:
@@ -13,21 +17,58 @@ public:
   virtual ~Logger() = default;
 
   static Logger *current();
-  static void to_file(const char *filename);
+
+  // Return false, leaving the current logger in place, if `filename` can't be opened for appending.
+  static bool to_file(const char *filename);
+
   static void to_stderr();
   static void to_stdout();
   static void disable();
 
+  // Return true if the calling thread's logger will record anything. While every thread's logger is disabled, this
+  // costs a single relaxed atomic load.
+  static bool enabled() { return enabled_count.load(std::memory_order_relaxed) > 0 && current()->is_enabled(); }
+
+  virtual bool is_enabled() { return true; }
   virtual Logger *prefix(const char *file, int line) = 0;
   virtual std::ostream &stream() = 0;
 
   Logger &operator=(const Logger &) = delete;
   Logger &operator=(Logger &&) = delete;
+
+private:
+  static void replace_logger(Logger *new_logger);
+
+  // Number of threads with an enabled logger.
+  static std::atomic<int> enabled_count;
+};
+
+// Discard the stream produced by a log statement, so that both branches of `LOGGER` have type `void`.
+class LogVoidify
+{
+public:
+  void operator&(std::ostream & /*stream*/) {}
 };
 
 std::string plural(long quantity, const std::string &singular_form, const std::string &plural_form);
 std::string plural(long quantity, const std::string &singular_form);
 
-#define LOGGER (Logger::current()->prefix(__FILE__, __LINE__)->stream())
+// Log a single line with `LOGGER << ... << std::endl;`. When the calling thread's logger is disabled, none of the
+// operands are evaluated.
+#define LOGGER \
+  !Logger::enabled() ? (void) 0 : LogVoidify() & Logger::current()->prefix(__FILE__, __LINE__)->stream()
+
+// The prefixed stream of the calling thread's logger, for lines that are assembled across several statements. Unlike
+// `LOGGER`, this is evaluated unconditionally, so check `Logger::enabled()` before formatting anything expensive.
+#define LOGGER_STREAM (Logger::current()->prefix(__FILE__, __LINE__)->stream())
+
+// Log per-event detail that's too expensive to format in production builds. Trace statements are compiled out
+// entirely unless the module is built with `WATCHER_TRACE` defined, e.g. with `node-gyp rebuild --watcher_trace=1`.
+#ifdef WATCHER_TRACE
+#define TRACE_LOGGER LOGGER
+#else
+#define TRACE_LOGGER \
+  while (false) LOGGER
+#endif
 
 #endif
@@ -1,13 +1,19 @@
+#include <atomic>
 #include <iomanip>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <utility>
+#include <uv.h>
 
+#include "file_set.h"
+#include "glob.h"
 #include "message.h"
 
 using std::move;
 using std::ostream;
 using std::ostringstream;
+using std::shared_ptr;
 using std::string;
 
 ostream &operator<<(ostream &out, FileSystemAction action)
@@ -17,22 +23,51 @@ ostream &operator<<(ostream &out, FileSystemAction action)
     case ACTION_DELETED: out << "deleted"; break;
     case ACTION_MODIFIED: out << "modified"; break;
     case ACTION_RENAMED: out << "renamed"; break;
+    case ACTION_CHANGED: out << "changed"; break;
     default: out << "!! FileSystemAction=" << static_cast<int>(action);
   }
   return out;
 }
 
+ostream &describe_actions(ostream &out, ActionMask actions)
+{
+  out << "[";
+  bool first = true;
+  for (int action = ACTION_MIN; action <= ACTION_MAX; action++) {
+    if ((actions & action_mask(static_cast<FileSystemAction>(action))) == 0) continue;
+    if (!first) out << ", ";
+    first = false;
+    out << static_cast<FileSystemAction>(action);
+  }
+  out << "]";
+  if ((actions & ACTIONS_ATTRIBUTES) == 0) out << " ignoring attributes";
+  return out;
+}
+
 ostream &operator<<(ostream &out, EntryKind kind)
 {
   switch (kind) {
     case KIND_FILE: out << "file"; break;
     case KIND_DIRECTORY: out << "directory"; break;
     case KIND_UNKNOWN: out << "unknown"; break;
+    case KIND_SUBTREE: out << "subtree"; break;
     default: out << "!! EntryKind=" << static_cast<int>(kind);
   }
   return out;
 }
 
+static std::atomic<bool> latency_tracing{false};
+
+void set_latency_tracing(bool enabled)
+{
+  latency_tracing.store(enabled, std::memory_order_relaxed);
+}
+
+bool is_latency_tracing()
+{
+  return latency_tracing.load(std::memory_order_relaxed);
+}
+
 bool kinds_are_different(EntryKind a, EntryKind b)
 {
   return a != KIND_UNKNOWN && b != KIND_UNKNOWN && a != b;
@@ -47,7 +82,9 @@ FileSystemPayload::FileSystemPayload(ChannelID channel_id,
   action{action},
   entry_kind{entry_kind},
   old_path{move(old_path)},
-  path{move(path)}
+  path{move(path)},
+  detected_at{is_latency_tracing() ? uv_hrtime() : 0},
+  emitted_at{0}
 {
   //
 }
@@ -57,7 +94,9 @@ FileSystemPayload::FileSystemPayload(FileSystemPayload &&original) noexcept :
   action{original.action},
   entry_kind{original.entry_kind},
   old_path{move(original.old_path)},
-  path{move(original.path)}
+  path{move(original.path)},
+  detected_at{original.detected_at},
+  emitted_at{original.emitted_at}
 {
   //
 }
@@ -81,13 +120,29 @@ CommandPayload::CommandPayload(CommandAction action,
   std::string &&root,
   uint_fast32_t arg,
   bool recursive,
-  size_t split_count) :
+  size_t split_count,
+  uint_fast32_t poll_interval,
+  uint_fast32_t poll_staleness,
+  shared_ptr<const GlobSet> &&exclude,
+  bool respect_ignore_files,
+  ActionMask actions,
+  shared_ptr<const FileSet> &&files,
+  uint_fast32_t max_depth,
+  uint_fast32_t burst_threshold) :
   id{id},
   action{action},
   root{move(root)},
   arg{arg},
   recursive{recursive},
-  split_count{split_count}
+  split_count{split_count},
+  poll_interval{poll_interval},
+  poll_staleness{poll_staleness},
+  exclude{move(exclude)},
+  respect_ignore_files{respect_ignore_files},
+  actions{actions},
+  files{move(files)},
+  max_depth{max_depth},
+  burst_threshold{burst_threshold}
 {
   //
 }
@@ -98,7 +153,15 @@ CommandPayload::CommandPayload(const CommandPayload &original) :
   root{original.root},
   arg{original.arg},
   recursive{original.recursive},
-  split_count{original.split_count}
+  split_count{original.split_count},
+  poll_interval{original.poll_interval},
+  poll_staleness{original.poll_staleness},
+  exclude{original.exclude},
+  respect_ignore_files{original.respect_ignore_files},
+  actions{original.actions},
+  files{original.files},
+  max_depth{original.max_depth},
+  burst_threshold{original.burst_threshold}
 {
   //
 }
@@ -109,7 +172,15 @@ CommandPayload::CommandPayload(CommandPayload &&original) noexcept :
   root{move(original.root)},
   arg{original.arg},
   recursive{original.recursive},
-  split_count{original.split_count}
+  split_count{original.split_count},
+  poll_interval{original.poll_interval},
+  poll_staleness{original.poll_staleness},
+  exclude{move(original.exclude)},
+  respect_ignore_files{original.respect_ignore_files},
+  actions{original.actions},
+  files{move(original.files)},
+  max_depth{original.max_depth},
+  burst_threshold{original.burst_threshold}
 {
   //
 }
@@ -123,12 +194,37 @@ string CommandPayload::describe() const
     case COMMAND_ADD:
       builder << "add " << root << " at channel " << arg;
       if (!recursive) builder << " (non-recursively)";
+      if (poll_interval > 0) builder << " polled every " << poll_interval << "ms";
+      if (poll_staleness > 0) builder << " stale after " << poll_staleness << "ms";
+      if (exclude) builder << " excluding " << *exclude;
+      if (respect_ignore_files) builder << " respecting ignore files";
+      if (actions != ACTIONS_ALL) describe_actions(builder << " reporting ", actions);
+      if (files) builder << " watching " << *files;
+      if (max_depth != UNLIMITED_DEPTH) builder << " to depth " << max_depth;
+      if (burst_threshold > 0) builder << " collapsing bursts over " << burst_threshold;
       break;
     case COMMAND_REMOVE: builder << "remove channel " << arg; break;
+    case COMMAND_EXPAND: builder << "expand " << root << " at channel " << arg << " to depth " << max_depth; break;
+    case COMMAND_COLLAPSE: builder << "collapse " << root << " at channel " << arg; break;
     case COMMAND_LOG_FILE: builder << "log to file " << root; break;
     case COMMAND_LOG_DISABLE: builder << "disable logging"; break;
     case COMMAND_POLLING_INTERVAL: builder << "polling interval " << arg; break;
     case COMMAND_POLLING_THROTTLE: builder << "polling throttle " << arg; break;
+    case COMMAND_POLLING_CPU_BUDGET: builder << "polling CPU budget " << arg << "us/s"; break;
+    case COMMAND_POLLING_SNAPSHOTS:
+      if (root.empty()) {
+        builder << "disable polling snapshots";
+      } else {
+        builder << "polling snapshots in " << root;
+      }
+      break;
+    case COMMAND_WORKER_CAPTURE:
+      if (root.empty()) {
+        builder << "stop worker capture";
+      } else {
+        builder << "worker capture to " << root;
+      }
+      break;
     case COMMAND_DRAIN: builder << "drain"; break;
     default: builder << "!!action=" << action; break;
   }
@@ -179,6 +275,11 @@ const FileSystemPayload *Message::as_filesystem() const
   return kind == MSG_FILESYSTEM ? &filesystem_payload : nullptr;
 }
 
+void Message::mark_emitted(uint64_t timestamp)
+{
+  if (kind == MSG_FILESYSTEM) filesystem_payload.set_emitted_at(timestamp);
+}
+
 const CommandPayload *Message::as_command() const
 {
   return kind == MSG_COMMAND ? &command_payload : nullptr;
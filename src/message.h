@@ -9,13 +9,17 @@
 
 #include "result.h"
 
+class FileSet;
+class GlobSet;
+
 enum EntryKind
 {
   KIND_FILE = 0,
   KIND_DIRECTORY = 1,
   KIND_UNKNOWN = 2,
+  KIND_SUBTREE = 3,  // A directory and everything beneath it, summarized by an `ACTION_CHANGED` event.
   KIND_MIN = KIND_FILE,
-  KIND_MAX = KIND_UNKNOWN
+  KIND_MAX = KIND_SUBTREE
 };
 
 std::ostream &operator<<(std::ostream &out, EntryKind kind);
@@ -34,12 +38,33 @@ enum FileSystemAction
   ACTION_DELETED = 1,
   ACTION_MODIFIED = 2,
   ACTION_RENAMED = 3,
+  ACTION_CHANGED = 4,  // Replaces a burst of events beneath a directory. See `BurstCollapser`.
   ACTION_MIN = ACTION_CREATED,
-  ACTION_MAX = ACTION_RENAMED
+  ACTION_MAX = ACTION_CHANGED
 };
 
 std::ostream &operator<<(std::ostream &out, FileSystemAction action);
 
+// A set of `FileSystemActions` reported by a watch, with one bit for each action. Modifications that only change an
+// entry's attributes, like its permissions or ownership, are reported only if `ACTIONS_ATTRIBUTES` is also set.
+using ActionMask = uint_fast32_t;
+
+inline ActionMask action_mask(FileSystemAction action)
+{
+  return ActionMask(1) << action;
+}
+
+const ActionMask ACTIONS_ATTRIBUTES = ActionMask(1) << (ACTION_MAX + 1);
+const ActionMask ACTIONS_ALL = (ActionMask(1) << (ACTION_MAX + 2)) - 1;
+
+std::ostream &describe_actions(std::ostream &out, ActionMask actions);
+
+// While latency tracing is enabled, each `FileSystemPayload` is stamped with the monotonic time, in nanoseconds, at
+// which it was detected and at which it was emitted to the main thread.
+void set_latency_tracing(bool enabled);
+
+bool is_latency_tracing();
+
 class FileSystemPayload
 {
 public:
@@ -66,6 +91,11 @@ public:
     return FileSystemPayload(channel_id, ACTION_RENAMED, kind, std::move(old_path), std::move(path));
   }
 
+  static FileSystemPayload subtree_changed(ChannelID channel_id, std::string &&path)
+  {
+    return FileSystemPayload(channel_id, ACTION_CHANGED, KIND_SUBTREE, "", std::move(path));
+  }
+
   FileSystemPayload(FileSystemPayload &&original) noexcept;
 
   ~FileSystemPayload() = default;
@@ -80,6 +110,13 @@ public:
 
   const std::string &get_path() const { return path; }
 
+  // Timestamps recorded while latency tracing was enabled, or zero.
+  uint64_t get_detected_at() const { return detected_at; }
+
+  uint64_t get_emitted_at() const { return emitted_at; }
+
+  void set_emitted_at(uint64_t timestamp) { emitted_at = timestamp; }
+
   std::string describe() const;
 
   FileSystemPayload(const FileSystemPayload &original) = delete;
@@ -98,18 +135,25 @@ private:
   const EntryKind entry_kind;
   std::string old_path;
   std::string path;
+  uint64_t detected_at;
+  uint64_t emitted_at;
 };
 
 enum CommandAction
 {
   COMMAND_ADD,
   COMMAND_REMOVE,
+  COMMAND_EXPAND,
+  COMMAND_COLLAPSE,
   COMMAND_LOG_FILE,
   COMMAND_LOG_STDERR,
   COMMAND_LOG_STDOUT,
   COMMAND_LOG_DISABLE,
   COMMAND_POLLING_INTERVAL,
   COMMAND_POLLING_THROTTLE,
+  COMMAND_POLLING_CPU_BUDGET,
+  COMMAND_POLLING_SNAPSHOTS,
+  COMMAND_WORKER_CAPTURE,
   COMMAND_DRAIN,
   COMMAND_MIN = COMMAND_ADD,
   COMMAND_MAX = COMMAND_DRAIN
@@ -119,6 +163,9 @@ using CommandID = uint_fast32_t;
 
 const CommandID NULL_COMMAND_ID = 0;
 
+// Maximum depth of a `COMMAND_ADD` that watches every directory beneath its root.
+const uint_fast32_t UNLIMITED_DEPTH = UINT_FAST32_MAX;
+
 class CommandPayload
 {
 public:
@@ -142,6 +189,38 @@ public:
 
   const size_t &get_split_count() const { return split_count; }
 
+  // Polling interval in milliseconds requested for a root by a `COMMAND_ADD`. Zero means "use the polling thread's
+  // configured default".
+  const uint_fast32_t &get_poll_interval() const { return poll_interval; }
+
+  // Maximum time in milliseconds that may elapse between successive checks of any entry beneath a polled root, as
+  // requested by a `COMMAND_ADD`. Zero means "no target".
+  const uint_fast32_t &get_poll_staleness() const { return poll_staleness; }
+
+  // Patterns matching the paths beneath the root that should not be watched, as requested by a `COMMAND_ADD`. Null if
+  // nothing is excluded.
+  const std::shared_ptr<const GlobSet> &get_exclude() const { return exclude; }
+
+  // If true, entries ignored by the `.gitignore` and `.ignore` files beneath the root should not be watched, as
+  // requested by a `COMMAND_ADD`.
+  const bool &get_respect_ignore_files() const { return respect_ignore_files; }
+
+  // Filesystem actions that should be reported beneath the root, as requested by a `COMMAND_ADD`.
+  const ActionMask &get_actions() const { return actions; }
+
+  // Individual files that should be watched instead of the root, as requested by a `COMMAND_ADD`. Null if the root is
+  // watched as a whole.
+  const std::shared_ptr<const FileSet> &get_files() const { return files; }
+
+  // Number of levels of directories beneath the root that should be watched, as requested by a recursive
+  // `COMMAND_ADD`, or beneath the expanded directory, as requested by a `COMMAND_EXPAND`. `UNLIMITED_DEPTH` if every
+  // directory should be watched.
+  const uint_fast32_t &get_max_depth() const { return max_depth; }
+
+  // Number of events beneath a single directory within one batch beyond which they're replaced by a summary, or zero
+  // if every event is delivered individually. See `BurstCollapser`.
+  const uint_fast32_t &get_burst_threshold() const { return burst_threshold; }
+
   std::string describe() const;
 
   CommandPayload &operator=(const CommandPayload &original) = delete;
@@ -153,7 +232,15 @@ private:
     std::string &&root,
     uint_fast32_t arg,
     bool recursive,
-    size_t split_count);
+    size_t split_count,
+    uint_fast32_t poll_interval,
+    uint_fast32_t poll_staleness,
+    std::shared_ptr<const GlobSet> &&exclude,
+    bool respect_ignore_files,
+    ActionMask actions,
+    std::shared_ptr<const FileSet> &&files,
+    uint_fast32_t max_depth,
+    uint_fast32_t burst_threshold);
 
   const CommandID id;
   const CommandAction action;
@@ -161,6 +248,14 @@ private:
   const uint_fast32_t arg;
   bool recursive;
   const size_t split_count;
+  const uint_fast32_t poll_interval;
+  const uint_fast32_t poll_staleness;
+  std::shared_ptr<const GlobSet> exclude;
+  const bool respect_ignore_files;
+  const ActionMask actions;
+  std::shared_ptr<const FileSet> files;
+  const uint_fast32_t max_depth;
+  const uint_fast32_t burst_threshold;
 
   friend class CommandPayloadBuilder;
 };
@@ -178,6 +273,18 @@ public:
     return CommandPayloadBuilder(COMMAND_REMOVE, "", channel_id, false, 1);
   }
 
+  static CommandPayloadBuilder expand(ChannelID channel_id, std::string &&dir, uint_fast32_t depth)
+  {
+    CommandPayloadBuilder builder(COMMAND_EXPAND, std::move(dir), channel_id, true, 1);
+    builder.set_max_depth(depth);
+    return builder;
+  }
+
+  static CommandPayloadBuilder collapse(ChannelID channel_id, std::string &&dir)
+  {
+    return CommandPayloadBuilder(COMMAND_COLLAPSE, std::move(dir), channel_id, true, 1);
+  }
+
   static CommandPayloadBuilder log_to_file(std::string &&log_file)
   {
     return CommandPayloadBuilder(COMMAND_LOG_FILE, std::move(log_file), NULL_CHANNEL_ID, false, 1);
@@ -208,6 +315,21 @@ public:
     return CommandPayloadBuilder(COMMAND_POLLING_THROTTLE, "", throttle, false, 1);
   }
 
+  static CommandPayloadBuilder polling_cpu_budget(const uint_fast32_t &budget)
+  {
+    return CommandPayloadBuilder(COMMAND_POLLING_CPU_BUDGET, "", budget, false, 1);
+  }
+
+  static CommandPayloadBuilder polling_snapshots(std::string &&snapshot_dir)
+  {
+    return CommandPayloadBuilder(COMMAND_POLLING_SNAPSHOTS, std::move(snapshot_dir), NULL_CHANNEL_ID, false, 1);
+  }
+
+  static CommandPayloadBuilder worker_capture(std::string &&capture_path)
+  {
+    return CommandPayloadBuilder(COMMAND_WORKER_CAPTURE, std::move(capture_path), NULL_CHANNEL_ID, false, 1);
+  }
+
   static CommandPayloadBuilder drain() { return CommandPayloadBuilder(COMMAND_DRAIN, "", NULL_CHANNEL_ID, false, 1); }
 
   CommandPayloadBuilder(CommandPayloadBuilder &&original) noexcept :
@@ -216,7 +338,15 @@ public:
     root{std::move(original.root)},
     arg{original.arg},
     recursive{original.recursive},
-    split_count{original.split_count}
+    split_count{original.split_count},
+    poll_interval{original.poll_interval},
+    poll_staleness{original.poll_staleness},
+    exclude{std::move(original.exclude)},
+    respect_ignore_files{original.respect_ignore_files},
+    actions{original.actions},
+    files{std::move(original.files)},
+    max_depth{original.max_depth},
+    burst_threshold{original.burst_threshold}
   {
     //
   }
@@ -229,10 +359,71 @@ public:
     return *this;
   }
 
+  CommandPayloadBuilder &set_poll_interval(uint_fast32_t poll_interval)
+  {
+    this->poll_interval = poll_interval;
+    return *this;
+  }
+
+  CommandPayloadBuilder &set_poll_staleness(uint_fast32_t poll_staleness)
+  {
+    this->poll_staleness = poll_staleness;
+    return *this;
+  }
+
+  CommandPayloadBuilder &set_exclude(const std::shared_ptr<const GlobSet> &exclude)
+  {
+    this->exclude = exclude;
+    return *this;
+  }
+
+  CommandPayloadBuilder &set_respect_ignore_files(bool respect_ignore_files)
+  {
+    this->respect_ignore_files = respect_ignore_files;
+    return *this;
+  }
+
+  CommandPayloadBuilder &set_actions(ActionMask actions)
+  {
+    this->actions = actions;
+    return *this;
+  }
+
+  CommandPayloadBuilder &set_files(const std::shared_ptr<const FileSet> &files)
+  {
+    this->files = files;
+    return *this;
+  }
+
+  CommandPayloadBuilder &set_max_depth(uint_fast32_t max_depth)
+  {
+    this->max_depth = max_depth;
+    return *this;
+  }
+
+  CommandPayloadBuilder &set_burst_threshold(uint_fast32_t burst_threshold)
+  {
+    this->burst_threshold = burst_threshold;
+    return *this;
+  }
+
   CommandPayload build()
   {
     assert(action >= COMMAND_MIN && action <= COMMAND_MAX);
-    return CommandPayload(action, id, std::move(root), arg, recursive, split_count);
+    return CommandPayload(action,
+      id,
+      std::move(root),
+      arg,
+      recursive,
+      split_count,
+      poll_interval,
+      poll_staleness,
+      std::move(exclude),
+      respect_ignore_files,
+      actions,
+      std::move(files),
+      max_depth,
+      burst_threshold);
   }
 
   CommandPayloadBuilder(const CommandPayloadBuilder &) = delete;
@@ -250,7 +441,13 @@ private:
     root{std::move(root)},
     arg{arg},
     recursive{recursive},
-    split_count{split_count}
+    split_count{split_count},
+    poll_interval{0},
+    poll_staleness{0},
+    respect_ignore_files{false},
+    actions{ACTIONS_ALL},
+    max_depth{UNLIMITED_DEPTH},
+    burst_threshold{0}
   {}
 
   CommandID id;
@@ -259,6 +456,14 @@ private:
   uint_fast32_t arg;
   bool recursive;
   size_t split_count;
+  uint_fast32_t poll_interval;
+  uint_fast32_t poll_staleness;
+  std::shared_ptr<const GlobSet> exclude;
+  bool respect_ignore_files;
+  ActionMask actions;
+  std::shared_ptr<const FileSet> files;
+  uint_fast32_t max_depth;
+  uint_fast32_t burst_threshold;
 };
 
 class AckPayload
@@ -355,6 +560,9 @@ public:
 
   const ErrorPayload *as_error() const;
 
+  // Stamp a filesystem message with the time that it's being emitted to the main thread. Other messages are unchanged.
+  void mark_emitted(uint64_t timestamp);
+
   std::string describe() const;
 
   Message(const Message &) = delete;
@@ -1,8 +1,11 @@
 #include <iostream>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "helper/common.h"
 #include "log.h"
 #include "message.h"
 #include "message_buffer.h"
@@ -10,32 +13,43 @@
 using std::endl;
 using std::move;
 using std::string;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
 
 void MessageBuffer::created(ChannelID channel_id, std::string &&path, const EntryKind &kind)
 {
+  if (!wants(channel_id, action_mask(ACTION_CREATED))) return;
+
   Message message(FileSystemPayload::created(channel_id, move(path), kind));
-  LOGGER << "Emitting filesystem message " << message << endl;
+  TRACE_LOGGER << "Emitting filesystem message " << message << endl;
   messages.push_back(move(message));
 }
 
 void MessageBuffer::modified(ChannelID channel_id, std::string &&path, const EntryKind &kind)
 {
+  if (!wants(channel_id, action_mask(ACTION_MODIFIED))) return;
+
   Message message(FileSystemPayload::modified(channel_id, move(path), kind));
-  LOGGER << "Emitting filesystem message " << message << endl;
+  TRACE_LOGGER << "Emitting filesystem message " << message << endl;
   messages.push_back(move(message));
 }
 
 void MessageBuffer::deleted(ChannelID channel_id, std::string &&path, const EntryKind &kind)
 {
+  if (!wants(channel_id, action_mask(ACTION_DELETED))) return;
+
   Message message(FileSystemPayload::deleted(channel_id, move(path), kind));
-  LOGGER << "Emitting filesystem message " << message << endl;
+  TRACE_LOGGER << "Emitting filesystem message " << message << endl;
   messages.push_back(move(message));
 }
 
 void MessageBuffer::renamed(ChannelID channel_id, std::string &&old_path, std::string &&path, const EntryKind &kind)
 {
+  if (!wants(channel_id, action_mask(ACTION_RENAMED))) return;
+
   Message message(FileSystemPayload::renamed(channel_id, move(old_path), move(path), kind));
-  LOGGER << "Emitting filesystem message " << message << endl;
+  TRACE_LOGGER << "Emitting filesystem message " << message << endl;
   messages.push_back(move(message));
 }
 
@@ -53,8 +67,105 @@ void MessageBuffer::error(ChannelID channel_id, string &&message, bool fatal)
   messages.push_back(move(m));
 }
 
-ChannelMessageBuffer::ChannelMessageBuffer(MessageBuffer &buffer, ChannelID channel_id) :
+size_t MessageBuffer::fold_deletions()
+{
+  // Walk the batch backwards. For each channel, `pending` maps each path whose deletion is still to come, and hasn't
+  // been undone by a creation or rename into it since the point being visited, to the index of that deletion. An
+  // earlier deletion at or beneath one of those paths describes the same incarnation of the tree and is folded into it.
+  unordered_map<ChannelID, unordered_map<string, size_t>> pending;
+  vector<bool> folded(messages.size(), false);
+  vector<bool> as_directory(messages.size(), false);
+  size_t folded_count = 0;
+
+  // Forget the deletions pending at or beneath `path`, which an earlier event brings into being.
+  auto undo = [](unordered_map<string, size_t> &channel_pending, const string &path) {
+    for (auto it = channel_pending.begin(); it != channel_pending.end();) {
+      if (path_within(it->first, path)) {
+        it = channel_pending.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  };
+
+  for (size_t i = messages.size(); i-- > 0;) {
+    const FileSystemPayload *fs = messages[i].as_filesystem();
+    if (fs == nullptr) continue;
+
+    FileSystemAction action = fs->get_filesystem_action();
+    if (action != ACTION_DELETED && action != ACTION_CREATED && action != ACTION_RENAMED) continue;
+
+    unordered_map<string, size_t> &channel_pending = pending[fs->get_channel_id()];
+    if (action == ACTION_CREATED || action == ACTION_RENAMED) {
+      undo(channel_pending, fs->get_path());
+      if (action == ACTION_RENAMED) undo(channel_pending, fs->get_old_path());
+      continue;
+    }
+    if (channel_pending.empty()) {
+      channel_pending.emplace(fs->get_path(), i);
+      continue;
+    }
+
+    // A directory's deletion may be reported both by its parent and by its own watch. Keep only the last.
+    auto same = channel_pending.find(fs->get_path());
+    if (same != channel_pending.end()) {
+      if (fs->get_entry_kind() == KIND_DIRECTORY) as_directory[same->second] = true;
+      folded[i] = true;
+      folded_count++;
+      continue;
+    }
+
+    // Otherwise, fold it into the deletion of the outermost directory above it that's still to come.
+    size_t top = messages.size();
+    string current = fs->get_path();
+    while (true) {
+      string parent = path_parent(current);
+      if (parent == current) break;
+      auto found = channel_pending.find(parent);
+      if (found != channel_pending.end()) top = found->second;
+      current = move(parent);
+    }
+
+    if (top != messages.size()) {
+      as_directory[top] = true;
+      folded[i] = true;
+      folded_count++;
+    } else {
+      channel_pending.emplace(fs->get_path(), i);
+    }
+  }
+  if (folded_count == 0) return 0;
+
+  vector<Message> kept;
+  kept.reserve(messages.size() - folded_count);
+  for (size_t i = 0; i < messages.size(); i++) {
+    if (folded[i]) continue;
+
+    // A directory's deletion reported by its own watch isn't marked as a directory.
+    const FileSystemPayload *fs = messages[i].as_filesystem();
+    if (as_directory[i] && fs->get_entry_kind() != KIND_DIRECTORY) {
+      kept.emplace_back(FileSystemPayload::deleted(fs->get_channel_id(), string(fs->get_path()), KIND_DIRECTORY));
+      continue;
+    }
+
+    kept.emplace_back(move(messages[i]));
+  }
+
+  messages.swap(kept);
+  return folded_count;
+}
+
+bool MessageBuffer::wants(ChannelID channel_id, ActionMask wanted) const
+{
+  if (actions == nullptr || actions->empty()) return true;
+
+  auto found = actions->find(channel_id);
+  return found == actions->end() || (found->second & wanted) == wanted;
+}
+
+ChannelMessageBuffer::ChannelMessageBuffer(MessageBuffer &buffer, ChannelID channel_id, ActionMask actions) :
   channel_id{channel_id},
-  buffer{buffer} {
+  buffer{buffer},
+  actions{actions} {
     //
   };
@@ -2,6 +2,7 @@
 #define MESSAGE_BUFFER_H
 
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -28,6 +29,20 @@ public:
 
   void error(ChannelID channel_id, std::string &&message, bool fatal);
 
+  // Discard filesystem events on any channel listed in `actions` whose action it doesn't report. Channels that aren't
+  // listed report every action. `actions` must outlive this buffer.
+  void set_actions(const std::unordered_map<ChannelID, ActionMask> *actions) { this->actions = actions; }
+
+  // Return true if `channel_id` reports every action in `wanted`.
+  bool wants(ChannelID channel_id, ActionMask wanted) const;
+
+  // Replace the deletions buffered for entries beneath a directory whose own deletion is buffered later on the same
+  // channel with a single deletion of the outermost such directory, as the removal of a whole tree produces. A creation
+  // or rename into a path in between ends the tree it belongs to, so deletions before it are never folded into ones
+  // after it. The remaining deletion takes the position of the directory's last. Return the number of deletions that
+  // were dropped.
+  size_t fold_deletions();
+
   void reserve(size_t capacity) { messages.reserve(capacity); }
 
   void add(Message &&message) { messages.emplace_back(std::move(message)); }
@@ -47,12 +62,14 @@ public:
 
 private:
   std::vector<Message> messages;
+  const std::unordered_map<ChannelID, ActionMask> *actions{nullptr};
 };
 
 class ChannelMessageBuffer
 {
 public:
-  ChannelMessageBuffer(MessageBuffer &buffer, ChannelID channel_id);
+  // Discard filesystem events whose action isn't among `actions`.
+  ChannelMessageBuffer(MessageBuffer &buffer, ChannelID channel_id, ActionMask actions = ACTIONS_ALL);
   ChannelMessageBuffer(const ChannelMessageBuffer &) = delete;
   ChannelMessageBuffer(ChannelMessageBuffer &&) = delete;
   ~ChannelMessageBuffer() = default;
@@ -60,15 +77,24 @@ public:
   ChannelMessageBuffer &operator=(const ChannelMessageBuffer &) = delete;
   ChannelMessageBuffer &operator=(ChannelMessageBuffer &&) = delete;
 
-  void created(std::string &&path, const EntryKind &kind) { buffer.created(channel_id, std::move(path), kind); }
+  void created(std::string &&path, const EntryKind &kind)
+  {
+    if (wants(action_mask(ACTION_CREATED))) buffer.created(channel_id, std::move(path), kind);
+  }
 
-  void modified(std::string &&path, const EntryKind &kind) { buffer.modified(channel_id, std::move(path), kind); }
+  void modified(std::string &&path, const EntryKind &kind)
+  {
+    if (wants(action_mask(ACTION_MODIFIED))) buffer.modified(channel_id, std::move(path), kind);
+  }
 
-  void deleted(std::string &&path, const EntryKind &kind) { buffer.deleted(channel_id, std::move(path), kind); }
+  void deleted(std::string &&path, const EntryKind &kind)
+  {
+    if (wants(action_mask(ACTION_DELETED))) buffer.deleted(channel_id, std::move(path), kind);
+  }
 
   void renamed(std::string &&old_path, std::string &&path, const EntryKind &kind)
   {
-    buffer.renamed(channel_id, std::move(old_path), std::move(path), kind);
+    if (wants(action_mask(ACTION_RENAMED))) buffer.renamed(channel_id, std::move(old_path), std::move(path), kind);
   }
 
   void ack(CommandID command_id, bool success, std::string &&msg)
@@ -90,9 +116,13 @@ public:
 
   ChannelID get_channel_id() { return channel_id; }
 
+  // Return true if this channel reports every action in `wanted`.
+  bool wants(ActionMask wanted) const { return (actions & wanted) == wanted; }
+
 private:
   ChannelID channel_id;
   MessageBuffer &buffer;
+  ActionMask actions;
 };
 
 #endif
@@ -2,17 +2,23 @@
 #include <iostream>
 #include <map>
 #include <memory>
-#include <set>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <uv.h>
+#include <vector>
 
+#include "../file_set.h"
+#include "../glob.h"
 #include "../helper/common.h"
+#include "../ignore_rules.h"
 #include "../log.h"
 #include "../message.h"
 #include "directory_record.h"
+#include "filesystem.h"
+#include "inode_index.h"
 #include "polling_iterator.h"
+#include "snapshot.h"
 
 using std::dec;
 using std::endl;
@@ -20,22 +26,9 @@ using std::hex;
 using std::move;
 using std::ostream;
 using std::ostringstream;
-using std::set;
 using std::shared_ptr;
 using std::string;
-
-struct FSReq
-{
-  uv_fs_t req{};
-
-  FSReq() = default;
-  FSReq(const FSReq &) = delete;
-  FSReq(FSReq &&) = delete;
-  ~FSReq() { uv_fs_req_cleanup(&req); }
-
-  FSReq &operator=(const FSReq &) = delete;
-  FSReq &operator=(FSReq &&) = delete;
-};
+using std::vector;
 
 ostream &operator<<(ostream &out, const uv_timespec_t &ts)
 {
@@ -52,15 +45,6 @@ ostream &operator<<(ostream &out, const uv_stat_t &stat)
   return out;
 }
 
-ostream &operator<<(ostream &out, const FSReq &r)
-{
-  if (r.req.result < 0) {
-    return out << "[" << uv_strerror(static_cast<int>(r.req.result)) << "]";
-  }
-
-  return out << r.req.statbuf;
-}
-
 inline bool ts_not_equal(const uv_timespec_t &left, const uv_timespec_t &right)
 {
   return left.tv_sec != right.tv_sec || left.tv_nsec != right.tv_nsec;
@@ -73,81 +57,125 @@ inline EntryKind kind_from_stat(const uv_stat_t &st)
   return KIND_UNKNOWN;
 }
 
-DirectoryRecord::DirectoryRecord(string &&prefix) : parent{nullptr}, name{move(prefix)}, populated{false}
+DirectoryRecord::DirectoryRecord(string &&prefix) :
+  parent{nullptr},
+  name{move(prefix)},
+  scan_generation{0},
+  scan_complete{false},
+  sweeping{false},
+  populated{false}
 {
   //
 }
 
+DirectoryRecord::~DirectoryRecord() = default;
+
 string DirectoryRecord::path() const
 {
   return parent == nullptr ? name : path_join(parent->path(), name);
 }
 
-void DirectoryRecord::scan(BoundPollingIterator *it)
+bool DirectoryRecord::scan(BoundPollingIterator *it)
 {
-  FSReq scan_req;
-  set<Entry> scanned_entries;
-
   string dir = path();
-  int scan_err = uv_fs_scandir(nullptr, &scan_req.req, dir.c_str(), 0, nullptr);
-  if (scan_err < 0) {
-    ostringstream msg;
-    msg << "Unable to scan directory " << dir << ": " << uv_strerror(scan_err);
 
-    if (scan_err == UV_ENOENT || scan_err == UV_ENOTDIR || scan_err == UV_EACCES) {
-      // It's probably fine. Just log it.
-      // TODO: Maybe report a deletion if this is the top-level record?
-      LOGGER << msg.str() << "." << endl;
-    } else {
-      it->get_buffer().error(msg.str(), false);
+  const Snapshot *snapshot = it->get_snapshot();
+  if (snapshot != nullptr && !populated && entries.empty()) restore(*snapshot, dir);
+
+  if (!scan_reader) {
+    int open_err = it->get_filesystem().open_directory(dir, scan_reader);
+    if (open_err < 0) {
+      ostringstream msg;
+      msg << "Unable to scan directory " << dir << ": " << uv_strerror(open_err);
+
+      if (open_err == UV_ENOENT || open_err == UV_ENOTDIR || open_err == UV_EACCES) {
+        // It's probably fine. Just log it.
+        // TODO: Maybe report a deletion if this is the top-level record?
+        LOGGER << msg.str() << "." << endl;
+      } else {
+        it->get_buffer().error(msg.str(), false);
+      }
+
+      return false;
     }
 
-    return;
+    scan_generation++;
+    scan_complete = false;
+    sweeping = false;
+  }
+
+  const GlobSet *exclude = it->get_exclude();
+  IgnoreRules *ignore_rules = it->get_ignore_rules();
+  const FileSet *files = it->get_files();
+  int read_count = scan_reader->read(
+    SCAN_CHUNK_SIZE, [this, it, exclude, ignore_rules, files, &dir](const char *entry_name, uv_dirent_type_t type) {
+      string name(entry_name);
+      if (exclude != nullptr || ignore_rules != nullptr || files != nullptr) {
+        string entry_path = path_join(dir, name);
+        if ((files != nullptr && !files->contains(entry_path)) || (exclude != nullptr && exclude->matches(entry_path))
+          || (ignore_rules != nullptr && ignore_rules->ignores(entry_path, type == UV_DIRENT_DIR))) {
+          // Forget anything recorded before this entry was excluded, such as entries restored from a snapshot or
+          // entries that an edited ignore file now covers, without reporting it.
+          entries.erase(name);
+          subdirectories.erase(name);
+          return;
+        }
+      }
+      entry_found(it, move(name), type);
+    });
+  if (read_count < 0) {
+    ostringstream msg;
+    msg << "Unable to list entries in directory " << dir << ": " << uv_strerror(read_count);
+    it->get_buffer().error(msg.str(), false);
+
+    scan_reader.reset();
+    return false;
   }
 
-  uv_dirent_t dirent{};
-  int next_err = uv_fs_scandir_next(&scan_req.req, &dirent);
-  while (next_err == 0) {
-    string entry_name(dirent.name);
+  if (read_count > 0) return true;
 
-    EntryKind entry_kind = KIND_UNKNOWN;
-    if (dirent.type == UV_DIRENT_FILE) entry_kind = KIND_FILE;
-    if (dirent.type == UV_DIRENT_DIR) entry_kind = KIND_DIRECTORY;
+  scan_reader.reset();
+  scan_complete = true;
+  return false;
+}
 
-    it->push_entry(string(entry_name), entry_kind);
-    if (populated) scanned_entries.emplace(move(entry_name), entry_kind);
+bool DirectoryRecord::sweep(BoundPollingIterator *it)
+{
+  if (!scan_complete) return false;
 
-    next_err = uv_fs_scandir_next(&scan_req.req, &dirent);
+  if (!sweeping) {
+    sweep_position = entries.begin();
+    sweeping = true;
   }
 
-  if (next_err != UV_EOF) {
-    ostringstream msg;
-    msg << "Unable to list entries in directory " << dir << ": " << uv_strerror(next_err);
-
-    it->get_buffer().error(msg.str(), false);
-  } else {
-    // Report entries that were present the last time we scanned this directory, but aren't included in this
-    // scan.
-    auto previous = entries.begin();
-    while (previous != entries.end()) {
-      const string &previous_entry_name = previous->first;
-      const string previous_entry_path(path_join(dir, previous_entry_name));
-      EntryKind previous_entry_kind = kind_from_stat(previous->second);
-      Entry previous_entry(previous_entry_name, previous_entry_kind);
-      Entry unknown_entry(previous_entry_name, KIND_UNKNOWN);
-
-      if (scanned_entries.count(previous_entry) == 0 && scanned_entries.count(unknown_entry) == 0) {
-        entry_deleted(it, previous_entry_path, previous_entry_kind);
-        auto former = previous;
-        ++previous;
-
-        subdirectories.erase(previous_entry_name);
-        entries.erase(former);
-      } else {
-        ++previous;
-      }
+  // Report entries that were present the last time we scanned this directory, but weren't found by this scan.
+  string dir = path();
+  size_t checked = 0;
+  while (sweep_position != entries.end() && checked < SCAN_CHUNK_SIZE) {
+    auto previous = sweep_position;
+    ++sweep_position;
+    checked++;
+
+    if (previous->second.generation == scan_generation) continue;
+
+    const string &previous_entry_name = previous->first;
+    shared_ptr<DirectoryRecord> subdir;
+    auto former = subdirectories.find(previous_entry_name);
+    if (former != subdirectories.end()) {
+      subdir = former->second;
+      subdirectories.erase(former);
     }
+
+    const uv_stat_t &previous_stat = previous->second.stat;
+    entry_deleted(it, path_join(dir, previous_entry_name), kind_from_stat(previous_stat), previous_stat, subdir);
+    entries.erase(previous);
   }
+
+  if (sweep_position != entries.end()) return true;
+
+  sweeping = false;
+  scan_complete = false;
+  return false;
 }
 
 void DirectoryRecord::entry(BoundPollingIterator *it,
@@ -155,11 +183,11 @@ void DirectoryRecord::entry(BoundPollingIterator *it,
   const string &entry_path,
   EntryKind scan_kind)
 {
-  FSReq lstat_req;
+  uv_stat_t current_stat{};
   EntryKind previous_kind = scan_kind;
   EntryKind current_kind = scan_kind;
 
-  int lstat_err = uv_fs_lstat(nullptr, &lstat_req.req, entry_path.c_str(), nullptr);
+  int lstat_err = it->get_filesystem().lstat(entry_path, current_stat);
   if (lstat_err != 0 && lstat_err != UV_ENOENT && lstat_err != UV_EACCES) {
     ostringstream msg;
     msg << "Unable to stat " << entry_path << ": " << uv_strerror(lstat_err);
@@ -171,28 +199,62 @@ void DirectoryRecord::entry(BoundPollingIterator *it,
   bool existed_before = previous != entries.end();
   bool exists_now = lstat_err == 0;
 
-  if (existed_before) previous_kind = kind_from_stat(previous->second);
-  if (exists_now) current_kind = kind_from_stat(lstat_req.req.statbuf);
+  if (existed_before) previous_kind = kind_from_stat(previous->second.stat);
+  if (exists_now) current_kind = kind_from_stat(current_stat);
 
+  // Update subdirectories if this is or was a subdirectory. The record of a subdirectory that has been deleted or
+  // replaced is detached and reported along with its deletion, so that it can be transplanted if it was renamed.
+  shared_ptr<DirectoryRecord> former_subdir;
+  shared_ptr<DirectoryRecord> subdir;
+  auto dir = subdirectories.find(entry_name);
+  if (dir != subdirectories.end()) {
+    if (!exists_now || (current_kind != KIND_DIRECTORY && current_kind != KIND_UNKNOWN)) {
+      former_subdir = dir->second;
+      subdirectories.erase(dir);
+    } else {
+      subdir = dir->second;
+    }
+  }
+  if (exists_now && current_kind == KIND_DIRECTORY && it->descends_into(entry_path)) {
+    if (!subdir) {
+      subdir.reset(new DirectoryRecord(this, string(entry_name)));
+      subdirectories.emplace(entry_name, subdir);
+    }
+    it->push_directory(subdir);
+  } else if (subdir && !it->descends_into(entry_path)) {
+    // The subdirectory has been collapsed beyond the depth limit since it was recorded. Release its records, so that
+    // it's populated afresh if it's expanded again.
+    subdirectories.erase(entry_name);
+    subdir.reset();
+  }
+
+  bool changed = true;
   if (existed_before && exists_now) {
     // Modification or no change
-    uv_stat_t &previous_stat = previous->second;
-    uv_stat_t &current_stat = lstat_req.req.statbuf;
+    uv_stat_t &previous_stat = previous->second.stat;
 
     // TODO consider modifications to mode or ownership bits?
     if (kinds_are_different(previous_kind, current_kind) || previous_stat.st_ino != current_stat.st_ino) {
-      entry_deleted(it, entry_path, previous_kind);
-      entry_created(it, entry_path, current_kind);
-    } else if (previous_stat.st_mode != current_stat.st_mode || previous_stat.st_size != current_stat.st_size
-      || ts_not_equal(previous_stat.st_mtim, current_stat.st_mtim)
-      || ts_not_equal(previous_stat.st_ctim, current_stat.st_ctim)) {
+      // A directory that replaces another directory keeps the existing record, so only a newly created record may be
+      // transplanted.
+      bool fresh_subdir = previous_kind != KIND_DIRECTORY;
+      entry_deleted(it, entry_path, previous_kind, previous_stat, former_subdir);
+      entry_created(it, entry_path, current_kind, current_stat, fresh_subdir ? subdir : nullptr);
+    } else if (previous_stat.st_size != current_stat.st_size
+      || ts_not_equal(previous_stat.st_mtim, current_stat.st_mtim)) {
       entry_modified(it, entry_path, current_kind);
+    } else if (previous_stat.st_mode != current_stat.st_mode
+      || ts_not_equal(previous_stat.st_ctim, current_stat.st_ctim)) {
+      // Only the entry's attributes have changed, which some channels don't report.
+      if (it->get_buffer().wants(ACTIONS_ATTRIBUTES)) entry_modified(it, entry_path, current_kind);
+    } else {
+      changed = false;
     }
 
   } else if (existed_before && !exists_now) {
     // Deletion
 
-    entry_deleted(it, entry_path, previous_kind);
+    entry_deleted(it, entry_path, previous_kind, previous->second.stat, former_subdir);
 
   } else if (!existed_before && exists_now) {
     // Creation
@@ -203,7 +265,7 @@ void DirectoryRecord::entry(BoundPollingIterator *it,
       entry_created(it, entry_path, scan_kind);
       entry_deleted(it, entry_path, scan_kind);
     }
-    entry_created(it, entry_path, current_kind);
+    entry_created(it, entry_path, current_kind, current_stat, subdir);
 
   } else if (!existed_before && !exists_now) {
     // Entry was deleted between scan() and entry().
@@ -213,26 +275,68 @@ void DirectoryRecord::entry(BoundPollingIterator *it,
     entry_deleted(it, entry_path, current_kind);
   }
 
+  // Re-read the rules of an ignore file that has changed, so that the next scan of each directory beneath this one
+  // skips the entries they cover and discovers the entries they no longer do.
+  IgnoreRules *ignore_rules = it->get_ignore_rules();
+  if (changed && ignore_rules != nullptr && IgnoreRules::is_ignore_file(entry_name)) {
+    string dir = path();
+    if (ignore_rules->reload(dir)) LOGGER << "Ignore rules within " << dir << " have changed." << endl;
+  }
+
   // Update entries with the latest stat information
-  if (existed_before) entries.erase(previous);
-  if (exists_now) entries.emplace(entry_name, lstat_req.req.statbuf);
+  if (existed_before && exists_now) {
+    previous->second.stat = current_stat;
+    previous->second.generation = scan_generation;
+  } else if (existed_before) {
+    entries.erase(previous);
+  } else if (exists_now) {
+    entries.emplace(entry_name, EntryRecord{current_stat, scan_generation});
+  }
+}
 
-  // Update subdirectories if this is or was a subdirectory
-  auto dir = subdirectories.find(entry_name);
-  if (current_kind != KIND_DIRECTORY && current_kind != KIND_UNKNOWN && dir != subdirectories.end()) {
-    subdirectories.erase(dir);
+void DirectoryRecord::restore(const Snapshot &snapshot, const string &dir)
+{
+  bool found = snapshot.read_directory(dir, [this](string &&entry_name, const uv_stat_t &stat) {
+    entries.emplace(move(entry_name), EntryRecord{stat, scan_generation});
+  });
+
+  if (found) populated = true;
+}
+
+void DirectoryRecord::save(SnapshotWriter &writer, const string &dir) const
+{
+  if (!populated) return;
+
+  writer.add_directory(dir);
+  for (auto &pair : entries) {
+    writer.add_entry(pair.first, pair.second.stat);
   }
-  if (current_kind == KIND_DIRECTORY && it->is_recursive()) {
-    if (dir == subdirectories.end()) {
-      shared_ptr<DirectoryRecord> subdir(new DirectoryRecord(this, string(entry_name)));
-      subdirectories.emplace(entry_name, subdir);
-      it->push_directory(subdir);
-    } else {
-      it->push_directory(dir->second);
-    }
+
+  for (auto &pair : subdirectories) {
+    pair.second->save(writer, path_join(dir, pair.first));
   }
 }
 
+void DirectoryRecord::adopt(DirectoryRecord &other)
+{
+  if (&other == this || scan_generation > 0) return;
+  if (scan_reader || other.scan_reader) return;
+
+  subdirectories = move(other.subdirectories);
+  for (auto &pair : subdirectories) {
+    pair.second->parent = this;
+  }
+  entries = move(other.entries);
+  scan_generation = other.scan_generation;
+  populated = other.populated;
+
+  other.subdirectories.clear();
+  other.entries.clear();
+  other.scan_complete = false;
+  other.sweeping = false;
+  other.populated = false;
+}
+
 bool DirectoryRecord::all_populated()
 {
   if (!populated) return false;
@@ -249,28 +353,66 @@ bool DirectoryRecord::all_populated()
 DirectoryRecord::DirectoryRecord(DirectoryRecord *parent, string &&name) :
   parent{parent},
   name(move(name)),
+  scan_generation{0},
+  scan_complete{false},
+  sweeping{false},
   populated{false}
 {
   //
 }
 
+void DirectoryRecord::entry_found(BoundPollingIterator *it, string &&entry_name, uv_dirent_type_t type)
+{
+  EntryKind entry_kind = KIND_UNKNOWN;
+  if (type == UV_DIRENT_FILE) entry_kind = KIND_FILE;
+  if (type == UV_DIRENT_DIR) entry_kind = KIND_DIRECTORY;
+
+  auto previous = entries.find(entry_name);
+  if (previous != entries.end()) previous->second.generation = scan_generation;
+
+  it->push_entry(move(entry_name), entry_kind);
+}
+
 void DirectoryRecord::entry_deleted(BoundPollingIterator *it, const string &entry_path, EntryKind kind)
 {
-  if (!populated) return;
+  if (!populated || !it->reports_entries()) return;
 
   it->get_buffer().deleted(string(entry_path), kind);
 }
 
 void DirectoryRecord::entry_created(BoundPollingIterator *it, const string &entry_path, EntryKind kind)
 {
-  if (!populated) return;
+  if (!populated || !it->reports_entries()) return;
 
   it->get_buffer().created(string(entry_path), kind);
 }
 
+void DirectoryRecord::entry_deleted(BoundPollingIterator *it,
+  const string &entry_path,
+  EntryKind kind,
+  const uv_stat_t &stat,
+  const shared_ptr<DirectoryRecord> &record)
+{
+  if (kind == KIND_DIRECTORY && it->get_ignore_rules() != nullptr) it->get_ignore_rules()->forget(entry_path);
+  if (!populated || !it->reports_entries()) return;
+
+  it->get_inode_index().deleted(it->get_buffer(), string(entry_path), stat, kind, record);
+}
+
+void DirectoryRecord::entry_created(BoundPollingIterator *it,
+  const string &entry_path,
+  EntryKind kind,
+  const uv_stat_t &stat,
+  const shared_ptr<DirectoryRecord> &record)
+{
+  if (!populated || !it->reports_entries()) return;
+
+  it->get_inode_index().created(it->get_buffer(), string(entry_path), stat, kind, record);
+}
+
 void DirectoryRecord::entry_modified(BoundPollingIterator *it, const string &entry_path, EntryKind kind)
 {
-  if (!populated) return;
+  if (!populated || !it->reports_entries()) return;
 
   it->get_buffer().modified(string(entry_path), kind);
 }
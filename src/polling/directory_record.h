@@ -6,10 +6,18 @@
 #include <memory>
 #include <string>
 #include <uv.h>
+#include <vector>
 
 #include "../message.h"
+#include "filesystem.h"
 
 class BoundPollingIterator;
+class Snapshot;
+class SnapshotWriter;
+
+// Maximum number of directory entries read from the filesystem per throttle operation while scanning, and the maximum
+// number of stored entries checked for deletion per throttle operation once a scan is complete.
+const size_t SCAN_CHUNK_SIZE = 512;
 
 // Remembered stat() results from the previous time a polling cycle visited a subdirectory of a `PolledRoot`. Contains
 // a recursive substructure that mirrors the last-known state of the filesystem tree.
@@ -25,18 +33,26 @@ public:
 
   DirectoryRecord(const DirectoryRecord &) = delete;
   DirectoryRecord(DirectoryRecord &&) = delete;
-  ~DirectoryRecord() = default;
   DirectoryRecord &operator=(const DirectoryRecord &) = delete;
   DirectoryRecord &operator=(DirectoryRecord &&) = delete;
 
+  // Close any directory stream left open by an interrupted scan.
+  ~DirectoryRecord();
+
   // Access the full path of this directory by walking up the `DirectoryRecord` tree.
   //
   // This is reasonably expensive on deep filesystems, so you should probably cache it somewhere.
   std::string path() const;
 
-  // Perform a `scandir()` on this directories. If populated, emit deletion events for any entries that were found here
-  // before but are now missing. Store the discovered entries within `it` as part of the iteration state.
-  void scan(BoundPollingIterator *it);
+  // Read the next chunk of at most `SCAN_CHUNK_SIZE` entries from this directory, opening it first if a scan is not
+  // already in progress. Store the discovered entries within `it` as part of the iteration state. Return true if more
+  // entries remain to be read, or false once the directory has been read to the end or could not be read.
+  bool scan(BoundPollingIterator *it);
+
+  // Once a scan has read the directory to the end, check up to `SCAN_CHUNK_SIZE` recorded entries to see if they were
+  // missed by the scan. If populated, emit deletion events for any entries that were found here before but are now
+  // missing. Return true if more entries remain to be checked.
+  bool sweep(BoundPollingIterator *it);
 
   // Perform a single `lstat()` on an entry within this directory. If the DirectoryRecord is populated and the entry
   // has been created, deleted, or modified since the previous `DirectoryRecord::entry()` call, emit the appropriate
@@ -53,15 +69,44 @@ public:
   // Return true if all `DirectoryResults` beneath this one have been populated by an initial scan.
   bool all_populated();
 
+  // Seed this record with the entries saved for its directory in `snapshot` by a previous process, if there are any.
+  // A restored record is populated, so its first scan will report the changes that occurred since the snapshot was
+  // saved.
+  void restore(const Snapshot &snapshot, const std::string &dir);
+
+  // Add the recorded entries of this directory and its populated subdirectories to `writer`. `dir` is this record's
+  // full path.
+  void save(SnapshotWriter &writer, const std::string &dir) const;
+
+  // Take over the recorded entries and subdirectory records of `other`, the former record of a directory that has been
+  // renamed to this one's location. Has no effect if this record has already been scanned.
+  void adopt(DirectoryRecord &other);
+
 private:
   // Construct a `DirectoryRecord` for a child entry.
   DirectoryRecord(DirectoryRecord *parent, std::string &&name);
 
+  // Note an entry discovered by `scan()` within `it` and stamp its record, if any, as found by the current scan.
+  void entry_found(BoundPollingIterator *it, std::string &&entry_name, uv_dirent_type_t type);
+
   // Use an iterator to emit deletion, creation, or modification events.
   void entry_deleted(BoundPollingIterator *it, const std::string &entry_path, EntryKind kind);
   void entry_created(BoundPollingIterator *it, const std::string &entry_path, EntryKind kind);
   void entry_modified(BoundPollingIterator *it, const std::string &entry_path, EntryKind kind);
 
+  // Use an iterator's `InodeIndex` to report the deletion or creation of an entry with a known `lstat()` result, so that
+  // it may be paired with the other half of a rename. `record` is the subdirectory record of a directory entry.
+  void entry_deleted(BoundPollingIterator *it,
+    const std::string &entry_path,
+    EntryKind kind,
+    const uv_stat_t &stat,
+    const std::shared_ptr<DirectoryRecord> &record);
+  void entry_created(BoundPollingIterator *it,
+    const std::string &entry_path,
+    EntryKind kind,
+    const uv_stat_t &stat,
+    const std::shared_ptr<DirectoryRecord> &record);
+
   // The parent directory. May be `null` at the root `DirectoryRecord` of a subtree.
   DirectoryRecord *parent;
 
@@ -72,9 +117,30 @@ private:
   // Recursive subdirectory records.
   std::map<std::string, std::shared_ptr<DirectoryRecord>> subdirectories;
 
+  // A recorded stat result, stamped with the `scan_generation` of the most recent scan that found its entry.
+  struct EntryRecord
+  {
+    uv_stat_t stat;
+    size_t generation;
+  };
+
   // Recorded stat results from previous scans. Includes stat results for *all* entries within the directory that are
   // not `.` or `..`.
-  std::map<std::string, uv_stat_t> entries;
+  std::map<std::string, EntryRecord> entries;
+
+  // Incremented each time a new scan begins. Entries that are not stamped with the current generation by the time the
+  // scan completes have been deleted.
+  size_t scan_generation;
+
+  // Directory stream held open between the chunks of a scan. Empty while no scan is in progress.
+  std::unique_ptr<DirectoryReader> scan_reader;
+
+  // If true, a scan has read this directory to the end without error, so entries that it didn't find may be swept.
+  bool scan_complete;
+
+  // If true, a sweep is underway and `sweep_position` marks the next recorded entry to check.
+  bool sweeping;
+  std::map<std::string, EntryRecord>::iterator sweep_position;
 
   // If true, a complete pass has already filled `entries` and `subdirectories` with initial stat results to compare
   // against. Otherwise, we have nothing to compare against, so we shouldn't emit anything.
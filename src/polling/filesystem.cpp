@@ -0,0 +1,142 @@
+#include <memory>
+#include <string>
+#include <uv.h>
+#include <vector>
+
+#include "filesystem.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+struct FSReq
+{
+  uv_fs_t req{};
+
+  FSReq() = default;
+  FSReq(const FSReq &) = delete;
+  FSReq(FSReq &&) = delete;
+  ~FSReq() { uv_fs_req_cleanup(&req); }
+
+  FSReq &operator=(const FSReq &) = delete;
+  FSReq &operator=(FSReq &&) = delete;
+};
+
+#ifdef HAVE_UV_FS_OPENDIR
+// Read a directory in chunks from a directory stream held open between calls.
+class NativeDirectoryReader : public DirectoryReader
+{
+public:
+  explicit NativeDirectoryReader(uv_dir_t *dir) : dir{dir}
+  {
+    //
+  }
+
+  ~NativeDirectoryReader() override
+  {
+    FSReq close_req;
+    uv_fs_closedir(nullptr, &close_req.req, dir, nullptr);
+  }
+
+  int read(size_t max_entries, const EntryCallback &callback) override
+  {
+    if (dirents.size() < max_entries) dirents.resize(max_entries);
+    dir->dirents = dirents.data();
+    dir->nentries = max_entries;
+
+    FSReq read_req;
+    int read_count = uv_fs_readdir(nullptr, &read_req.req, dir, nullptr);
+    for (int i = 0; i < read_count; i++) {
+      callback(dirents[i].name, dirents[i].type);
+    }
+    return read_count;
+  }
+
+  NativeDirectoryReader(const NativeDirectoryReader &) = delete;
+  NativeDirectoryReader(NativeDirectoryReader &&) = delete;
+  NativeDirectoryReader &operator=(const NativeDirectoryReader &) = delete;
+  NativeDirectoryReader &operator=(NativeDirectoryReader &&) = delete;
+
+private:
+  uv_dir_t *dir;
+
+  // Buffer that receives each chunk of entries read from `dir`.
+  vector<uv_dirent_t> dirents;
+};
+#else
+// Read a directory with a single `uv_fs_scandir()` call, then hand out its entries in chunks.
+class NativeDirectoryReader : public DirectoryReader
+{
+public:
+  NativeDirectoryReader() = default;
+
+  ~NativeDirectoryReader() override = default;
+
+  int read(size_t max_entries, const EntryCallback &callback) override
+  {
+    int read_count = 0;
+    uv_dirent_t dirent{};
+    while (static_cast<size_t>(read_count) < max_entries) {
+      int next_err = uv_fs_scandir_next(&scan_req.req, &dirent);
+      if (next_err == UV_EOF) break;
+      if (next_err < 0) return next_err;
+
+      callback(dirent.name, dirent.type);
+      read_count++;
+    }
+    return read_count;
+  }
+
+  NativeDirectoryReader(const NativeDirectoryReader &) = delete;
+  NativeDirectoryReader(NativeDirectoryReader &&) = delete;
+  NativeDirectoryReader &operator=(const NativeDirectoryReader &) = delete;
+  NativeDirectoryReader &operator=(NativeDirectoryReader &&) = delete;
+
+  FSReq scan_req;
+};
+#endif
+
+class NativeFileSystem : public FileSystem
+{
+public:
+  NativeFileSystem() = default;
+
+  ~NativeFileSystem() override = default;
+
+  int open_directory(const string &path, unique_ptr<DirectoryReader> &reader) override
+  {
+#ifdef HAVE_UV_FS_OPENDIR
+    FSReq open_req;
+    int open_err = uv_fs_opendir(nullptr, &open_req.req, path.c_str(), nullptr);
+    if (open_err < 0) return open_err;
+
+    reader.reset(new NativeDirectoryReader(static_cast<uv_dir_t *>(open_req.req.ptr)));
+#else
+    unique_ptr<NativeDirectoryReader> scan(new NativeDirectoryReader());
+    int scan_err = uv_fs_scandir(nullptr, &scan->scan_req.req, path.c_str(), 0, nullptr);
+    if (scan_err < 0) return scan_err;
+
+    reader = std::move(scan);
+#endif
+    return 0;
+  }
+
+  int lstat(const string &path, uv_stat_t &stat) override
+  {
+    FSReq lstat_req;
+    int lstat_err = uv_fs_lstat(nullptr, &lstat_req.req, path.c_str(), nullptr);
+    if (lstat_err == 0) stat = lstat_req.req.statbuf;
+    return lstat_err;
+  }
+
+  NativeFileSystem(const NativeFileSystem &) = delete;
+  NativeFileSystem(NativeFileSystem &&) = delete;
+  NativeFileSystem &operator=(const NativeFileSystem &) = delete;
+  NativeFileSystem &operator=(NativeFileSystem &&) = delete;
+};
+
+FileSystem &FileSystem::native()
+{
+  static NativeFileSystem filesystem;
+  return filesystem;
+}
@@ -0,0 +1,60 @@
+#ifndef FILESYSTEM_H
+#define FILESYSTEM_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <uv.h>
+
+// Directory streams arrived in libuv 1.28. Older releases read each directory in a single `uv_fs_scandir()` call.
+#if UV_VERSION_HEX >= 0x011c00
+#define HAVE_UV_FS_OPENDIR 1
+#endif
+
+// Stream of the entries within a single directory, opened by `FileSystem::open_directory()`. Closed when destroyed.
+class DirectoryReader
+{
+public:
+  DirectoryReader() = default;
+
+  virtual ~DirectoryReader() = default;
+
+  using EntryCallback = std::function<void(const char *name, uv_dirent_type_t type)>;
+
+  // Read at most `max_entries` further entries, invoking `callback` with the name and type of each. Return the number
+  // of entries read, zero once the directory has been read to the end, or a negative libuv error code.
+  virtual int read(size_t max_entries, const EntryCallback &callback) = 0;
+
+  DirectoryReader(const DirectoryReader &) = delete;
+  DirectoryReader(DirectoryReader &&) = delete;
+  DirectoryReader &operator=(const DirectoryReader &) = delete;
+  DirectoryReader &operator=(DirectoryReader &&) = delete;
+};
+
+// The filesystem operations performed by the polling engine. `PolledRoots` use the real filesystem through libuv by
+// default; benchmarks substitute a simulated filesystem to exercise the engine at scale without a disk.
+class FileSystem
+{
+public:
+  FileSystem() = default;
+
+  virtual ~FileSystem() = default;
+
+  // Access the process-wide implementation that performs synchronous libuv calls against the real filesystem.
+  static FileSystem &native();
+
+  // Begin reading the entries of the directory at `path`. On success, store the stream in `reader` and return zero.
+  // Otherwise, return a negative libuv error code.
+  virtual int open_directory(const std::string &path, std::unique_ptr<DirectoryReader> &reader) = 0;
+
+  // Populate `stat` with the status of the entry at `path` without following symlinks. Return zero on success or a
+  // negative libuv error code.
+  virtual int lstat(const std::string &path, uv_stat_t &stat) = 0;
+
+  FileSystem(const FileSystem &) = delete;
+  FileSystem(FileSystem &&) = delete;
+  FileSystem &operator=(const FileSystem &) = delete;
+  FileSystem &operator=(FileSystem &&) = delete;
+};
+
+#endif
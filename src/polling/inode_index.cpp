@@ -0,0 +1,119 @@
+#include <memory>
+#include <string>
+#include <utility>
+#include <uv.h>
+
+#include "../message.h"
+#include "../message_buffer.h"
+#include "directory_record.h"
+#include "inode_index.h"
+
+using std::move;
+using std::shared_ptr;
+using std::string;
+
+void InodeIndex::deleted(ChannelMessageBuffer &buffer,
+  string &&path,
+  const uv_stat_t &stat,
+  EntryKind kind,
+  const shared_ptr<DirectoryRecord> &record)
+{
+  InodeKey key{stat.st_dev, stat.st_ino};
+  PendingEntry entry{key, window, false, move(path), kind, record, false, stat.st_mtim, stat.st_size};
+
+  PendingEntry *partner = claim_partner(key, entry);
+  if (partner != nullptr) {
+    pair(buffer, entry, *partner);
+    return;
+  }
+
+  push(key, move(entry));
+}
+
+void InodeIndex::created(ChannelMessageBuffer &buffer,
+  string &&path,
+  const uv_stat_t &stat,
+  EntryKind kind,
+  const shared_ptr<DirectoryRecord> &record)
+{
+  InodeKey key{stat.st_dev, stat.st_ino};
+  PendingEntry entry{key, window, true, move(path), kind, record, false, stat.st_mtim, stat.st_size};
+
+  PendingEntry *partner = claim_partner(key, entry);
+  if (partner != nullptr) {
+    pair(buffer, *partner, entry);
+    return;
+  }
+
+  push(key, move(entry));
+}
+
+void InodeIndex::expire(ChannelMessageBuffer &buffer)
+{
+  while (!pending.empty() && pending.front().window < window) {
+    emit_front(buffer);
+  }
+  window++;
+}
+
+void InodeIndex::flush(ChannelMessageBuffer &buffer)
+{
+  while (!pending.empty()) {
+    emit_front(buffer);
+  }
+  window++;
+}
+
+InodeIndex::PendingEntry *InodeIndex::claim_partner(const InodeKey &key, const PendingEntry &entry)
+{
+  auto &opposite = entry.created ? deletions : creations;
+
+  auto found = opposite.find(key);
+  if (found == opposite.end()) return nullptr;
+
+  // A freed inode may be reused at once for an unrelated entry, which is left unpaired.
+  PendingEntry &partner = pending[found->second - first_index];
+  if (partner.kind != entry.kind || partner.size != entry.size || partner.mtime.tv_sec != entry.mtime.tv_sec
+    || partner.mtime.tv_nsec != entry.mtime.tv_nsec) {
+    return nullptr;
+  }
+  opposite.erase(found);
+
+  partner.consumed = true;
+  return &partner;
+}
+
+void InodeIndex::push(const InodeKey &key, PendingEntry &&entry)
+{
+  auto &same = entry.created ? creations : deletions;
+
+  // If a second entry arrives with the same inode, such as a hard link, the earlier one stays unpaired.
+  same[key] = first_index + pending.size();
+  pending.emplace_back(move(entry));
+}
+
+void InodeIndex::pair(ChannelMessageBuffer &buffer, PendingEntry &from, PendingEntry &to)
+{
+  if (from.record && to.record) to.record->adopt(*from.record);
+
+  buffer.renamed(move(from.path), move(to.path), to.kind);
+}
+
+void InodeIndex::emit_front(ChannelMessageBuffer &buffer)
+{
+  PendingEntry &entry = pending.front();
+  if (!entry.consumed) {
+    auto &same = entry.created ? creations : deletions;
+    auto found = same.find(entry.key);
+    if (found != same.end() && found->second == first_index) same.erase(found);
+
+    if (entry.created) {
+      buffer.created(move(entry.path), entry.kind);
+    } else {
+      buffer.deleted(move(entry.path), entry.kind);
+    }
+  }
+
+  pending.pop_front();
+  first_index++;
+}
@@ -0,0 +1,125 @@
+#ifndef INODE_INDEX_H
+#define INODE_INDEX_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <uv.h>
+#include <vector>
+
+#include "../message.h"
+#include "../message_buffer.h"
+
+class DirectoryRecord;
+
+// Identify a filesystem entry independently of its path.
+struct InodeKey
+{
+  uint64_t dev;
+  uint64_t ino;
+
+  bool operator==(const InodeKey &other) const { return dev == other.dev && ino == other.ino; }
+};
+
+struct InodeKeyHash
+{
+  size_t operator()(const InodeKey &key) const
+  {
+    return std::hash<uint64_t>()(key.ino) ^ (std::hash<uint64_t>()(key.dev) << 1);
+  }
+};
+
+// Deletions and creations observed by a `PolledRoot` during a single polling pass, indexed by device and inode.
+// A deletion and a creation that share an inode, an entry kind, a modification time and a size are the two halves of a
+// rename, so they're reported as a single `renamed` event. A rename preserves all of them, while a new entry that
+// happens to reuse a freed inode almost never matches the old one's timestamp. When the renamed entry is a directory,
+// the records of its former subtree are transplanted into the `DirectoryRecord` at its new location, so the subtree
+// isn't reported or re-populated as if it were brand new.
+//
+// Entries are held for one further call to `BoundPollingIterator::advance()` after the one that observed them, so that
+// a rename between directories that are polled in consecutive cycles is still paired without delaying every other
+// creation and deletion until the whole pass completes. Those that remain unpaired are then reported as ordinary
+// deletions and creations by `expire()`, or by `flush()` at the end of the pass.
+class InodeIndex
+{
+public:
+  InodeIndex() = default;
+
+  InodeIndex(const InodeIndex &) = delete;
+  InodeIndex(InodeIndex &&) = delete;
+  ~InodeIndex() = default;
+  InodeIndex &operator=(const InodeIndex &) = delete;
+  InodeIndex &operator=(InodeIndex &&) = delete;
+
+  // Note the deletion of the entry at `path`, whose last recorded `lstat()` result was `stat`. If the entry was a
+  // directory, `record` should be its `DirectoryRecord` subtree.
+  void deleted(ChannelMessageBuffer &buffer,
+    std::string &&path,
+    const uv_stat_t &stat,
+    EntryKind kind,
+    const std::shared_ptr<DirectoryRecord> &record);
+
+  // Note the creation of the entry at `path` with the current `lstat()` result `stat`. If the entry is a directory,
+  // `record` should be the new `DirectoryRecord` that will track it.
+  void created(ChannelMessageBuffer &buffer,
+    std::string &&path,
+    const uv_stat_t &stat,
+    EntryKind kind,
+    const std::shared_ptr<DirectoryRecord> &record);
+
+  // Emit deletion and creation events for the unpaired entries observed before the previous call, in the order they
+  // were observed, and begin a new window. Called at the end of each advance.
+  void expire(ChannelMessageBuffer &buffer);
+
+  // Emit deletion and creation events for any entries that remain unpaired, in the order they were observed, and
+  // clear the index.
+  void flush(ChannelMessageBuffer &buffer);
+
+private:
+  struct PendingEntry
+  {
+    InodeKey key;
+    uint64_t window;
+    bool created;
+    std::string path;
+    EntryKind kind;
+    std::shared_ptr<DirectoryRecord> record;
+    bool consumed;
+
+    // Attributes that a rename leaves untouched.
+    uv_timespec_t mtime;
+    uint64_t size;
+  };
+
+  // Look for an unpaired entry on the opposite side of a rename from `entry` that shares its inode `key` and its
+  // attributes, and mark it as consumed. Return a pointer to it, or `nullptr` if there is none.
+  PendingEntry *claim_partner(const InodeKey &key, const PendingEntry &entry);
+
+  // Record an unpaired entry.
+  void push(const InodeKey &key, PendingEntry &&entry);
+
+  // Emit a `renamed` event from `from` to `to` and transplant any directory subtree.
+  void pair(ChannelMessageBuffer &buffer, PendingEntry &from, PendingEntry &to);
+
+  // Emit the event of the unpaired entry at the front of `pending` and remove it.
+  void emit_front(ChannelMessageBuffer &buffer);
+
+  // Window in which entries are currently being observed.
+  uint64_t window{0};
+
+  // Unpaired entries in the order in which they were observed. Consumed entries remain until they reach the front.
+  std::deque<PendingEntry> pending;
+
+  // Number of entries that have been removed from the front of `pending`.
+  uint64_t first_index{0};
+
+  // Indices of unpaired deletions and creations, counted from the first entry ever pushed to `pending`.
+  std::unordered_map<InodeKey, uint64_t, InodeKeyHash> deletions;
+  std::unordered_map<InodeKey, uint64_t, InodeKeyHash> creations;
+};
+
+#endif
@@ -1,33 +1,129 @@
+#include <chrono>
+#include <memory>
 #include <string>
 #include <utility>
 
+#include "../log.h"
 #include "../message.h"
 #include "../message_buffer.h"
+#include "../probes.h"
+#include "../trace.h"
 #include "directory_record.h"
 #include "polled_root.h"
+#include "snapshot.h"
 
+using std::endl;
 using std::move;
+using std::shared_ptr;
 using std::string;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
 
-PolledRoot::PolledRoot(string &&root_path, ChannelID channel_id, bool recursive) :
+PolledRoot::PolledRoot(string &&root_path,
+  ChannelID channel_id,
+  bool recursive,
+  milliseconds poll_interval,
+  milliseconds staleness_target,
+  string &&snapshot_path) :
   root(new DirectoryRecord(move(root_path))),
   channel_id{channel_id},
+  actions{ACTIONS_ALL},
   iterator(root, recursive),
-  all_populated{false}
+  all_populated{false},
+  poll_interval{poll_interval},
+  next_due{steady_clock::now()},
+  staleness_target{staleness_target},
+  current_pass_ops{0},
+  last_pass_ops{0},
+  pass_start{steady_clock::now()},
+  achieved_staleness{0},
+  sla_misses{0},
+  snapshot_path{move(snapshot_path)},
+  restored{false},
+  snapshot_dirty{true},
+  snapshot_saved{}
 {
-  //
+  if (this->snapshot_path.empty()) return;
+
+  shared_ptr<Snapshot> snapshot = Snapshot::load(this->snapshot_path, root->path());
+  if (snapshot) {
+    LOGGER << "Restoring " << snapshot->get_directory_count() << " directories beneath " << root->path() << " from "
+           << this->snapshot_path << "." << endl;
+    iterator.set_snapshot(snapshot);
+    restored = true;
+  }
 }
 
 size_t PolledRoot::advance(MessageBuffer &buffer, size_t throttle_allocation)
 {
-  ChannelMessageBuffer channel_buffer(buffer, channel_id);
+  TraceScope advance_trace("advance");
+  WATCHER_PROBE2(advance_start, channel_id, throttle_allocation);
+  ChannelMessageBuffer channel_buffer(buffer, channel_id, actions);
   BoundPollingIterator bound_iterator(iterator, channel_buffer);
 
+  size_t passes_before = iterator.get_completed_passes();
+  size_t events_before = buffer.size();
   size_t progress = bound_iterator.advance(throttle_allocation);
+  current_pass_ops += progress;
+  if (buffer.size() != events_before) snapshot_dirty = true;
+
+  advance_trace.arg("channel", channel_id);
+  advance_trace.arg("ops", progress);
+  advance_trace.arg("events", buffer.size() - events_before);
+  WATCHER_PROBE3(advance_end, channel_id, progress, buffer.size() - events_before);
+
+  if (iterator.get_completed_passes() != passes_before) {
+    steady_clock::time_point now = steady_clock::now();
+    achieved_staleness = duration_cast<milliseconds>(now - pass_start);
+    if (staleness_target.count() > 0 && achieved_staleness > staleness_target) sla_misses++;
+
+    last_pass_ops = current_pass_ops;
+    current_pass_ops = 0;
+    pass_start = now;
 
-  if (!all_populated && root->all_populated()) {
+    // Every record that will ever be restored has been visited by now. Release the mapping before the file is replaced.
+    // Writing the snapshot touches every directory of the tree, so it's charged like the scans that produced them.
+    iterator.set_snapshot(nullptr);
+    if (now - snapshot_saved >= SNAPSHOT_SAVE_INTERVAL) progress += save_snapshot();
+  }
+
+  // A restored root reports real changes from its very first scan, so there's no need to wait for a full pass.
+  if (!all_populated && (restored || root->all_populated())) {
     all_populated = true;
   }
 
   return progress;
 }
+
+size_t PolledRoot::desired_allotment(milliseconds interval, size_t fair_share) const
+{
+  if (staleness_target.count() <= 0 || last_pass_ops == 0) return fair_share;
+
+  // Advances available to complete a pass within the target. One interval is held back as slack for scheduling
+  // jitter, since a pass of N advances spans N intervals.
+  auto advances = static_cast<size_t>(staleness_target.count() / (interval.count() > 0 ? interval.count() : 1));
+  advances = advances > 1 ? advances - 1 : 1;
+
+  // Operations per advance, rounded up.
+  return (last_pass_ops + advances - 1) / advances;
+}
+
+size_t PolledRoot::save_snapshot()
+{
+  if (snapshot_path.empty() || !snapshot_dirty) return 0;
+
+  string root_path(root->path());
+  SnapshotWriter writer(root_path);
+  root->save(writer, root_path);
+
+  Result<> r = writer.write(snapshot_path);
+  if (r.is_error()) {
+    LOGGER << "Unable to save snapshot of " << root_path << ": " << r << "." << endl;
+    return writer.get_directory_count();
+  }
+
+  snapshot_dirty = false;
+  snapshot_saved = steady_clock::now();
+  return writer.get_directory_count();
+}
@@ -1,14 +1,20 @@
 #ifndef POLLED_ROOT_H
 #define POLLED_ROOT_H
 
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
 
 #include "../message.h"
 #include "directory_record.h"
+#include "filesystem.h"
 #include "polling_iterator.h"
 
+// Minimum time between successive saves of a root's snapshot while its tree keeps changing.
+const std::chrono::seconds SNAPSHOT_SAVE_INTERVAL = std::chrono::seconds(5);
+
 // Single root directory monitored by the `PollingThread`.
 class PolledRoot
 {
@@ -18,7 +24,20 @@ public:
   //
   // The newly constructed root does *not* contain any initial scan information, to avoid CPU usage spikes when
   // watching large directory trees. The subtree's records will be populated on the first scan.
-  PolledRoot(std::string &&root_path, ChannelID channel_id, bool recursive);
+  //
+  // If `poll_interval` is nonzero, it overrides the polling thread's default interval for this root only. If
+  // `staleness_target` is nonzero, the polling thread will try to re-check every entry beneath this root at least that
+  // often.
+  //
+  // If `snapshot_path` is not empty, the subtree's records are saved there as they change. If a snapshot saved by a
+  // previous process already exists, records are restored from it instead of starting unpopulated, so the first scan
+  // reports the changes that were made in the meantime.
+  PolledRoot(std::string &&root_path,
+    ChannelID channel_id,
+    bool recursive,
+    std::chrono::milliseconds poll_interval,
+    std::chrono::milliseconds staleness_target,
+    std::string &&snapshot_path);
 
   ~PolledRoot() = default;
 
@@ -30,9 +49,70 @@ public:
   // left ready to begin again at the root directory next time.
   size_t advance(MessageBuffer &buffer, size_t throttle_allocation);
 
-  // Return `true` once the first complete scan has been completed by calls to `PolledRoot::advance()`.
+  // Return `true` once the first complete scan has been completed by calls to `PolledRoot::advance()`, or after the
+  // first call if this root was restored from a snapshot.
   bool is_all_populated() { return all_populated; }
 
+  // Return the number of full passes over this root that have been completed.
+  size_t get_completed_passes() const { return iterator.get_completed_passes(); }
+
+  // Write this root's records to its snapshot file if they've changed since they were last saved. The whole tree is
+  // written at once, so return the number of directories written, to be charged against the polling throttle.
+  size_t save_snapshot();
+
+  // Scan this root through `filesystem` instead of the native filesystem, to benchmark the polling engine against a
+  // simulated tree. It must outlive this root.
+  void set_filesystem(FileSystem &filesystem) { iterator.set_filesystem(filesystem); }
+
+  // Neither examine nor report entries matched by `exclude`.
+  void set_exclude(const std::shared_ptr<const GlobSet> &exclude) { iterator.set_exclude(exclude); }
+
+  // Neither examine nor report entries ignored by the `.gitignore` and `.ignore` files beneath this root.
+  void set_ignore_rules(const std::shared_ptr<IgnoreRules> &ignore_rules) { iterator.set_ignore_rules(ignore_rules); }
+
+  // Neither examine nor report entries that aren't members of `files`.
+  void set_files(const std::shared_ptr<const FileSet> &files) { iterator.set_files(files); }
+
+  // Neither examine nor report entries within directories beyond `depth_limit`.
+  void set_depth_limit(const std::shared_ptr<DepthLimit> &depth_limit) { iterator.set_depth_limit(depth_limit); }
+
+  // Access this root's depth limit, or `nullptr` if it has none.
+  const std::shared_ptr<DepthLimit> &get_depth_limit() const { return iterator.get_depth_limit(); }
+
+  // Report only `actions`. Entries are still scanned to track the tree, but changes to their contents or attributes
+  // aren't compared unless they're reported.
+  void set_actions(ActionMask actions) { this->actions = actions; }
+
+  // Access the channel that this root's events are delivered to.
+  ChannelID get_channel_id() const { return channel_id; }
+
+  // Determine how long to wait between calls to `PolledRoot::advance()`. Roots without an interval of their own use
+  // `default_interval`.
+  std::chrono::milliseconds get_poll_interval(std::chrono::milliseconds default_interval) const
+  {
+    return poll_interval.count() > 0 ? poll_interval : default_interval;
+  }
+
+  // Time at which this root is next due to be advanced. Maintained by the `PollingThread`'s scheduler.
+  std::chrono::steady_clock::time_point get_next_due() const { return next_due; }
+
+  void set_next_due(std::chrono::steady_clock::time_point due) { next_due = due; }
+
+  // Estimate the number of operations that each call to `PolledRoot::advance()` should perform to meet this root's
+  // staleness target when it's advanced every `interval`. Roots without a target, or that haven't completed a full
+  // pass yet to measure their size, receive `fair_share` instead.
+  size_t desired_allotment(std::chrono::milliseconds interval, size_t fair_share) const;
+
+  // Wall-clock duration of the most recently completed full pass, which bounds the time between successive checks of
+  // any single entry. Zero if no pass has completed yet.
+  std::chrono::milliseconds get_achieved_staleness() const { return achieved_staleness; }
+
+  // Access the maximum acceptable duration of a full pass. Zero if this root has no target.
+  std::chrono::milliseconds get_staleness_target() const { return staleness_target; }
+
+  // Number of completed passes that took longer than this root's staleness target.
+  size_t get_sla_misses() const { return sla_misses; }
+
   PolledRoot(const PolledRoot &) = delete;
   PolledRoot(PolledRoot &&) = delete;
   PolledRoot &operator=(const PolledRoot &) = delete;
@@ -45,12 +125,46 @@ private:
   // Events produced by changes within this root should by targetted for this channel.
   ChannelID channel_id;
 
+  // Actions reported on this root's channel.
+  ActionMask actions;
+
   // Persistent iteration state.
   PollingIterator iterator;
 
   // Becomes `true` when the first full subtree scan has completed.
   bool all_populated;
 
+  // Per-root polling interval, or zero to follow the polling thread's default.
+  std::chrono::milliseconds poll_interval;
+
+  // Scheduled time of this root's next advance.
+  std::chrono::steady_clock::time_point next_due;
+
+  // Maximum acceptable duration of a full pass, or zero for none.
+  std::chrono::milliseconds staleness_target;
+
+  // Operations consumed by the pass in progress and by the most recently completed pass.
+  size_t current_pass_ops;
+  size_t last_pass_ops;
+
+  // Wall-clock time at which the pass in progress began.
+  std::chrono::steady_clock::time_point pass_start;
+
+  std::chrono::milliseconds achieved_staleness;
+  size_t sla_misses;
+
+  // Path of this root's snapshot file, or empty if snapshots are disabled.
+  std::string snapshot_path;
+
+  // `true` if this root's records are being restored from a snapshot.
+  bool restored;
+
+  // `true` if events have been produced since the snapshot was last saved.
+  bool snapshot_dirty;
+
+  // Time of the most recent snapshot save.
+  std::chrono::steady_clock::time_point snapshot_saved;
+
   // Diagnostics and logging are your friend.
   friend std::ostream &operator<<(std::ostream &out, const PolledRoot &root)
   {
@@ -6,6 +6,7 @@
 #include "../helper/common.h"
 #include "../message_buffer.h"
 #include "directory_record.h"
+#include "filesystem.h"
 #include "polling_iterator.h"
 
 using std::shared_ptr;
@@ -16,7 +17,10 @@ PollingIterator::PollingIterator(const shared_ptr<DirectoryRecord> &root, bool r
   recursive{recursive},
   current(root),
   current_path(root->path()),
-  phase{PollingIterator::SCAN}
+  scan_incomplete{false},
+  phase{PollingIterator::SCAN},
+  completed_passes{0},
+  filesystem{&FileSystem::native()}
 {
   //
 }
@@ -38,13 +42,22 @@ size_t BoundPollingIterator::advance(size_t throttle_allocation)
       advance_scan();
     } else if (iterator.phase == PollingIterator::ENTRIES) {
       advance_entry();
+    } else if (iterator.phase == PollingIterator::SWEEP) {
+      advance_sweep();
     } else if (iterator.phase == PollingIterator::RESET) {
       break;
     }
     count++;
   }
 
-  if (iterator.phase == PollingIterator::RESET) {
+  if (iterator.phase != PollingIterator::RESET) {
+    // Entries left unpaired since the previous advance are reported now, rather than waiting for the whole pass.
+    iterator.inodes.expire(buffer);
+  } else {
+    // Entries left unpaired by the whole pass weren't renamed within the root.
+    iterator.inodes.flush(buffer);
+
+    iterator.completed_passes++;
     iterator.current = iterator.root;
     iterator.current_path = iterator.current->path();
     iterator.phase = PollingIterator::SCAN;
@@ -55,7 +68,7 @@ size_t BoundPollingIterator::advance(size_t throttle_allocation)
 
 void BoundPollingIterator::advance_scan()
 {
-  iterator.current->scan(this);
+  iterator.scan_incomplete = iterator.current->scan(this);
 
   iterator.current_entry = iterator.entries.begin();
   iterator.phase = PollingIterator::ENTRIES;
@@ -76,10 +89,21 @@ void BoundPollingIterator::advance_entry()
     return;
   }
 
-  iterator.current->mark_populated();
   iterator.entries.clear();
   iterator.current_entry = iterator.entries.end();
 
+  iterator.phase = iterator.scan_incomplete ? PollingIterator::SCAN : PollingIterator::SWEEP;
+}
+
+void BoundPollingIterator::advance_sweep()
+{
+  if (iterator.current->sweep(this)) {
+    // Remain in SWEEP phase
+    return;
+  }
+
+  iterator.current->mark_populated();
+
   if (iterator.directories.empty()) {
     iterator.phase = PollingIterator::RESET;
     return;
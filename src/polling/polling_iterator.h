@@ -9,10 +9,16 @@
 #include <utility>
 #include <uv.h>
 
+#include "../depth_limit.h"
 #include "../message.h"
 #include "../message_buffer.h"
+#include "filesystem.h"
+#include "inode_index.h"
 
 class DirectoryRecord;
+class FileSet;
+class IgnoreRules;
+class Snapshot;
 
 // Persistent state of the iteration over the contents of a `PolledRoot`. This allows `PolledRoot` to partially scan
 // large filesystems, then resume after a pause.
@@ -31,6 +37,33 @@ public:
   PollingIterator &operator=(const PollingIterator &) = delete;
   PollingIterator &operator=(PollingIterator &&) = delete;
 
+  // Return the number of times that this iterator has traversed the entire tree and reset to its root.
+  size_t get_completed_passes() const { return completed_passes; }
+
+  // Restore unpopulated `DirectoryRecords` from `snapshot` as they're first scanned. Pass `nullptr` to stop.
+  void set_snapshot(const std::shared_ptr<Snapshot> &snapshot) { this->snapshot = snapshot; }
+
+  // Perform all filesystem operations through `filesystem` instead of the native filesystem. It must outlive this
+  // iterator.
+  void set_filesystem(FileSystem &filesystem) { this->filesystem = &filesystem; }
+
+  // Skip entries matched by `exclude` without examining them, and never descend into excluded directories. Pass
+  // `nullptr` to stop.
+  void set_exclude(const std::shared_ptr<const GlobSet> &exclude) { this->exclude = exclude; }
+
+  // Skip entries ignored by `ignore_rules` in the same way, re-reading the rules of any ignore file that changes. Pass
+  // `nullptr` to stop.
+  void set_ignore_rules(const std::shared_ptr<IgnoreRules> &ignore_rules) { this->ignore_rules = ignore_rules; }
+
+  // Skip every entry that isn't a member of `files`. Pass `nullptr` to stop.
+  void set_files(const std::shared_ptr<const FileSet> &files) { this->files = files; }
+
+  // Descend only into the directories covered by `depth_limit`. Pass `nullptr` to descend without limit.
+  void set_depth_limit(const std::shared_ptr<DepthLimit> &depth_limit) { this->depth_limit = depth_limit; }
+
+  // Access the limit that directories are descended into within, or `nullptr` if there is none.
+  const std::shared_ptr<DepthLimit> &get_depth_limit() const { return depth_limit; }
+
 private:
   // The top-level `DirectoryRecord` of the `PolledRoot`, so we know where to reset when we reach the end.
   std::shared_ptr<DirectoryRecord> root;
@@ -44,10 +77,13 @@ private:
   // Remember the current `DirectoryRecord`'s full, joined path to avoid recursing up the entire tree for each entry.
   std::string current_path;
 
-  // An entry name and `EntryKind` pair reported by a `scandir()` call. Populated by
-  // `BoundPollingIterator::advance_scan()` in the `SCAN` phase.
+  // Entry name and `EntryKind` pairs read from the current directory. Populated with at most one chunk of entries at a
+  // time by `BoundPollingIterator::advance_scan()` in the `SCAN` phase.
   std::vector<Entry> entries;
 
+  // If true, the current directory has more chunks of entries to read once `entries` has been consumed.
+  bool scan_incomplete;
+
   // Save our place within the `entries` vector during the `ENTRIES` phase.
   std::vector<Entry>::iterator current_entry;
 
@@ -58,11 +94,37 @@ private:
   // Phases of traversal.
   enum
   {
-    SCAN,  // Scan the current `DirectoryRecord` to populate `entries`,
+    SCAN,  // Read the next chunk of the current `DirectoryRecord` to populate `entries`.
     ENTRIES,  // Compare the next entry to an up-to-date `lstat()` result to see if an entry has changed.
+    SWEEP,  // Report recorded entries that were missing from a completed scan as deleted.
     RESET  // Loop back to the root directory.
   } phase;
 
+  // Number of full traversals completed so far.
+  size_t completed_passes;
+
+  // Deletions and creations observed recently, held for one further advance so that the halves of a rename can be
+  // paired.
+  InodeIndex inodes;
+
+  // Snapshot saved by a previous process that records should be restored from, if any.
+  std::shared_ptr<Snapshot> snapshot;
+
+  // Source of directory listings and `lstat()` results.
+  FileSystem *filesystem;
+
+  // Patterns matching entries that should be neither examined nor reported, if any.
+  std::shared_ptr<const GlobSet> exclude;
+
+  // Rules of the ignore files beneath the root that should be respected, if any.
+  std::shared_ptr<IgnoreRules> ignore_rules;
+
+  // Individual files that should be examined and reported instead of every entry, if any.
+  std::shared_ptr<const FileSet> files;
+
+  // Limit on the depth of the directories that are descended into, if any.
+  std::shared_ptr<DepthLimit> depth_limit;
+
   friend class BoundPollingIterator;
 
   // Always handy to have.
@@ -74,6 +136,7 @@ private:
     switch (iterator.phase) {
       case SCAN: out << "SCAN"; break;
       case ENTRIES: out << "ENTRIES"; break;
+      case SWEEP: out << "SWEEP"; break;
       case RESET: out << "RESET"; break;
       default: out << "!!phase=" << iterator.phase; break;
     }
@@ -112,26 +175,59 @@ public:
   // Access the message buffer to emit events from other classes.
   ChannelMessageBuffer &get_buffer() { return buffer; }
 
+  // Access the index used to pair deletions and creations into renames.
+  InodeIndex &get_inode_index() { return iterator.inodes; }
+
+  // Access the snapshot that records should be restored from, or `nullptr` if there is none.
+  const Snapshot *get_snapshot() { return iterator.snapshot.get(); }
+
+  // Access the filesystem that directories should be read and entries examined through.
+  FileSystem &get_filesystem() { return *iterator.filesystem; }
+
+  // Access the patterns matching entries that should be skipped, or `nullptr` if there are none.
+  const GlobSet *get_exclude() { return iterator.exclude.get(); }
+
+  // Access the ignore file rules that entries should be checked against, or `nullptr` if they aren't respected.
+  IgnoreRules *get_ignore_rules() { return iterator.ignore_rules.get(); }
+
+  // Access the individual files that entries should be members of, or `nullptr` if every entry is examined.
+  const FileSet *get_files() { return iterator.files.get(); }
+
   // Allow the `DirectoryRecord` to determine whether or not this iteration is recursive.
   bool is_recursive() { return iterator.recursive; }
 
+  // Allow the `DirectoryRecord` to determine whether or not the subdirectory at `path` should be recorded and
+  // traversed, which depends on the depth limit as well.
+  bool descends_into(const std::string &path)
+  {
+    return iterator.recursive && (!iterator.depth_limit || iterator.depth_limit->reaches(path));
+  }
+
+  // Return false if the current directory is only traversed to reach an expanded directory beneath the depth limit,
+  // so its entries shouldn't be reported.
+  bool reports_entries() { return !iterator.depth_limit || iterator.depth_limit->covers(iterator.current_path); }
+
   // Perform at most `throttle_allocation` filesystem operations, emitting events and updating records appropriately. If
   // the end of the filesystem tree is reached, the iteration will stop and leave the `PollingIterator` ready to resume
-  // at the root on the next call.
+  // at the root on the next call. Deletions and creations that could not be paired into renames are emitted before
+  // returning.
   //
   // Return the number of operations actually performed.
   size_t advance(size_t throttle_allocation);
 
 private:
-  // Scan the current directory with `DirectoryRecord::scan()`, populating our iterator's `entries` map. Leave the
-  // iterator ready to advance through the discovered entries.
+  // Read a chunk of the current directory with `DirectoryRecord::scan()`, populating our iterator's `entries` vector.
+  // Leave the iterator ready to advance through the discovered entries.
   void advance_scan();
 
   // Perform a single stat call with `DirectoryRecord::entry()`. Advance the `current_entry`. If no more entries
-  // remain, pop the next `DirectoryRecord` from the queue. If the queue is empty, reset the iterator back to its
-  // root.
+  // remain, scan the next chunk of the directory, or sweep it for deletions if it has been read completely.
   void advance_entry();
 
+  // Check a batch of recorded entries for deletion with `DirectoryRecord::sweep()`. Once the sweep is done, pop the
+  // next `DirectoryRecord` from the queue. If the queue is empty, reset the iterator back to its root.
+  void advance_sweep();
+
   ChannelMessageBuffer &buffer;
   PollingIterator &iterator;
 
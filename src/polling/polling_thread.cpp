@@ -2,33 +2,74 @@
 #include <cstdint>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
-#include <thread>
 #include <utility>
 #include <uv.h>
 #include <vector>
 
+#include "../depth_limit.h"
+#include "../file_set.h"
+#include "../helper/common.h"
+#include "../ignore_rules.h"
+#include "../lock.h"
 #include "../log.h"
 #include "../message_buffer.h"
 #include "../result.h"
 #include "../status.h"
 #include "../thread.h"
+#include "../trace.h"
 #include "polled_root.h"
 #include "polling_thread.h"
+#include "snapshot.h"
 
 using std::endl;
 using std::move;
 using std::ostream;
+using std::set;
+using std::shared_ptr;
 using std::string;
 using std::to_string;
 using std::vector;
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+using std::chrono::seconds;
 
 PollingThread::PollingThread(uv_async_t *main_callback) :
   Thread("polling thread", main_callback),
   poll_interval{DEFAULT_POLL_INTERVAL},
-  poll_throttle{DEFAULT_POLL_THROTTLE}
+  poll_throttle{DEFAULT_POLL_THROTTLE},
+  poll_cpu_budget{DEFAULT_POLL_CPU_BUDGET},
+  cpu_available{0},
+  cpu_refilled_at{Clock::now()},
+  cpu_per_op{0},
+  usage_window_cpu{0},
+  usage_window_start{Clock::now()},
+  status_cpu_usage{0},
+  status_staleness{0},
+  status_sla_misses{0},
+  woken{false}
 {
-  //
+  int err = uv_mutex_init(&wake_mutex);
+  if (err != 0) {
+    report_uv_error(err);
+    return;
+  }
+
+  err = uv_cond_init(&wake_cond);
+  if (err != 0) {
+    report_uv_error(err);
+  }
+}
+
+PollingThread::~PollingThread()
+{
+  uv_cond_destroy(&wake_cond);
+  uv_mutex_destroy(&wake_mutex);
 }
 
 void PollingThread::collect_status(Status &status)
@@ -39,6 +80,20 @@ void PollingThread::collect_status(Status &status)
   status.polling_in_ok = get_in_queue_error();
   status.polling_out_size = get_out_queue_size();
   status.polling_out_ok = get_out_queue_error();
+  status.polling_cpu_budget = poll_cpu_budget;
+  status.polling_cpu_usage = status_cpu_usage.load();
+  status.polling_staleness = status_staleness.load();
+  status.polling_sla_misses = status_sla_misses.load();
+  status.polling_in_high_water = get_in_queue_high_water_mark();
+  status.polling_out_high_water = get_out_queue_high_water_mark();
+  status.polling_cycle_duration = cycle_duration.summarize();
+  collect_hot_directories(status.polling_hot_directories);
+}
+
+void PollingThread::reset_status()
+{
+  Thread::reset_status();
+  cycle_duration.reset();
 }
 
 Result<> PollingThread::body()
@@ -59,44 +114,133 @@ Result<> PollingThread::body()
       return r.propagate_as_void();
     }
 
-    if (is_healthy()) {
-      LOGGER << "Sleeping for " << poll_interval.count() << "ms." << endl;
-      std::this_thread::sleep_for(poll_interval);
-    } else {
-      return health_err_result<>();
-    }
+    if (!is_healthy()) return health_err_result<>();
+
+    sleep_until_due();
   }
 }
 
+Result<> PollingThread::wake()
+{
+  if (!is_healthy()) return health_err_result();
+
+  Lock lock(wake_mutex);
+  woken = true;
+  uv_cond_signal(&wake_cond);
+  return ok_result();
+}
+
 Result<> PollingThread::cycle()
 {
   MessageBuffer buffer;
-  size_t remaining = poll_throttle;
+  Clock::time_point now = Clock::now();
+
+  // Collect the roots whose timers have expired.
+  vector<PolledRoot *> due;
+  while (!timers.empty() && timers.begin()->first <= now) {
+    due.push_back(timers.begin()->second);
+    timers.erase(timers.begin());
+  }
 
-  size_t roots_left = roots.size();
-  LOGGER << "Polling " << plural(roots_left, "root") << " with " << plural(poll_throttle, "throttle slot") << "."
-         << endl;
+  if (due.empty()) return ok_result();
+
+  TraceScope cycle_trace("polling cycle");
+  cycle_trace.arg("roots", due.size());
+
+  // Roots without a staleness target are entitled to an equal share of the throttle per interval. Slots left unused
+  // by one of them are passed along to the due roots after it. Roots with a staleness target ask for as much as
+  // their previous pass needs to meet it.
+  size_t fair_share = roots.empty() ? 0 : poll_throttle / roots.size();
+  size_t remaining = 0;
+  size_t roots_left = 0;
+  size_t targeted = 0;
+  vector<size_t> desired;
+  desired.reserve(due.size());
+  for (PolledRoot *root : due) {
+    size_t want = root->desired_allotment(root->get_poll_interval(poll_interval), fair_share);
+    desired.push_back(want);
+    if (root->get_staleness_target().count() > 0) {
+      targeted += want;
+    } else {
+      remaining += fair_share;
+      roots_left++;
+    }
+  }
 
-  for (auto &it : roots) {
-    PolledRoot &root = it.second;
-    size_t allotment = remaining / roots_left;
+  // Scale every allotment back if the processor budget can't afford them.
+  double scale = 1.0;
+  if (poll_cpu_budget > 0) {
+    refill_cpu_budget(now);
 
-    LOGGER << "Polling " << root << " with an allotment of " << plural(allotment, "throttle slot") << "." << endl;
+    size_t total = remaining + targeted;
+    if (cpu_available <= 0) {
+      scale = 0.0;
+    } else if (cpu_per_op > 0 && total > 0 && cpu_available < cpu_per_op * total) {
+      scale = cpu_available / (cpu_per_op * total);
+    }
+  }
+  remaining = static_cast<size_t>(remaining * scale);
 
-    size_t progress = root.advance(buffer, allotment);
-    remaining -= progress;
+  LOGGER << "Polling " << plural(due.size(), "due root") << " of " << roots.size() << " with "
+         << plural(remaining + static_cast<size_t>(targeted * scale), "throttle slot") << "." << endl;
+
+  uint64_t cpu_before = thread_cpu_time_us();
+  size_t ops = 0;
+  set<ChannelID> newly_populated;
+  for (size_t i = 0; i < due.size(); i++) {
+    PolledRoot *root = due[i];
+    bool has_target = root->get_staleness_target().count() > 0;
+    size_t allotment = has_target ? static_cast<size_t>(desired[i] * scale) : remaining / roots_left;
+    bool was_populated = root->is_all_populated();
+
+    schedule(*root, now + root->get_poll_interval(poll_interval));
+
+    if (scale <= 0.0) {
+      LOGGER << "Processor budget exhausted. Deferring " << *root << "." << endl;
+      continue;
+    }
+
+    LOGGER << "Polling " << *root << " with an allotment of " << plural(allotment, "throttle slot") << "." << endl;
+
+    size_t progress = root->advance(buffer, allotment);
+    ops += progress;
     if (progress != allotment) {
-      LOGGER << root << " only consumed " << plural(progress, "throttle slot") << "." << endl;
+      LOGGER << *root << " only consumed " << plural(progress, "throttle slot") << "." << endl;
     }
 
-    roots_left--;
+    if (!has_target) {
+      remaining -= progress < remaining ? progress : remaining;
+      roots_left--;
+    }
+
+    if (!was_populated && root->is_all_populated()) {
+      newly_populated.insert(root->get_channel_id());
+    }
+  }
+
+  cycle_trace.arg("ops", ops);
+  cycle_trace.arg("events", buffer.size());
+
+  Clock::time_point finished = Clock::now();
+  spend_cpu_budget(finished, thread_cpu_time_us() - cpu_before, ops);
+  cycle_duration.record(static_cast<uint64_t>(duration_cast<microseconds>(finished - now).count()));
+
+  uint_fast64_t worst_staleness = 0;
+  uint_fast64_t sla_misses = 0;
+  for (auto &pair : roots) {
+    auto staleness = static_cast<uint_fast64_t>(pair.second.get_achieved_staleness().count());
+    if (staleness > worst_staleness) worst_staleness = staleness;
+    sla_misses += pair.second.get_sla_misses();
   }
+  status_staleness.store(worst_staleness);
+  status_sla_misses.store(sla_misses);
 
-  // Ack any commands whose roots are now fully populated.
-  vector<ChannelID> to_erase;
-  for (auto &split : pending_splits) {
-    const ChannelID &channel_id = split.first;
-    const PendingSplit &pending_split = split.second;
+  // Ack any commands whose roots have become fully populated during this cycle.
+  for (const ChannelID &channel_id : newly_populated) {
+    auto split = pending_splits.find(channel_id);
+    if (split == pending_splits.end()) continue;
+
+    const PendingSplit &pending_split = split->second;
 
     size_t populated_roots = 0;
     auto channel_roots = roots.equal_range(channel_id);
@@ -106,16 +250,94 @@ Result<> PollingThread::cycle()
 
     if (populated_roots >= pending_split.second) {
       buffer.ack(pending_split.first, channel_id, true, "");
-      to_erase.push_back(channel_id);
+      pending_splits.erase(split);
     }
   }
-  for (ChannelID &channel_id : to_erase) {
-    pending_splits.erase(channel_id);
+
+  // Ack any expansions whose roots have completed a pass since they were made.
+  for (auto expansion = pending_expansions.begin(); expansion != pending_expansions.end();) {
+    bool complete = true;
+    for (auto &pass : expansion->passes) {
+      if (pass.first->get_completed_passes() < pass.second) complete = false;
+    }
+
+    if (complete) {
+      buffer.ack(expansion->command_id, expansion->channel_id, true, "");
+      expansion = pending_expansions.erase(expansion);
+    } else {
+      ++expansion;
+    }
   }
 
+  if (buffer.empty()) return ok_result();
+
   return emit_all(buffer.begin(), buffer.end());
 }
 
+void PollingThread::refill_cpu_budget(Clock::time_point now)
+{
+  double elapsed = duration<double>(now - cpu_refilled_at).count();
+  cpu_refilled_at = now;
+
+  // Allow at most one second's worth of budget to accumulate while idle.
+  cpu_available += poll_cpu_budget * elapsed;
+  if (cpu_available > poll_cpu_budget) cpu_available = poll_cpu_budget;
+}
+
+void PollingThread::spend_cpu_budget(Clock::time_point now, uint64_t cpu_us, size_t ops)
+{
+  if (poll_cpu_budget > 0) cpu_available -= cpu_us;
+
+  if (ops > 0) {
+    double sample = static_cast<double>(cpu_us) / ops;
+    cpu_per_op = cpu_per_op > 0 ? 0.8 * cpu_per_op + 0.2 * sample : sample;
+  }
+
+  usage_window_cpu += cpu_us;
+  auto window = duration_cast<microseconds>(now - usage_window_start);
+  if (window >= seconds(1)) {
+    status_cpu_usage.store(usage_window_cpu * 1000000u / static_cast<uint64_t>(window.count()));
+    usage_window_cpu = 0;
+    usage_window_start = now;
+  }
+}
+
+void PollingThread::sleep_until_due()
+{
+  Lock lock(wake_mutex);
+
+  while (!woken) {
+    if (timers.empty()) {
+      LOGGER << "Sleeping until woken." << endl;
+      uv_cond_wait(&wake_cond, &wake_mutex);
+      continue;
+    }
+
+    Clock::time_point now = Clock::now();
+    Clock::time_point next_due = timers.begin()->first;
+    if (next_due <= now) break;
+
+    auto timeout = duration_cast<nanoseconds>(next_due - now);
+    LOGGER << "Sleeping for " << duration_cast<milliseconds>(timeout).count() << "ms." << endl;
+    if (uv_cond_timedwait(&wake_cond, &wake_mutex, static_cast<uint64_t>(timeout.count())) == UV_ETIMEDOUT) {
+      break;
+    }
+  }
+
+  woken = false;
+}
+
+void PollingThread::schedule(PolledRoot &root, Clock::time_point due)
+{
+  root.set_next_due(due);
+  timers.emplace(due, &root);
+}
+
+void PollingThread::unschedule(PolledRoot &root)
+{
+  timers.erase(std::make_pair(root.get_next_due(), &root));
+}
+
 Result<Thread::OfflineCommandOutcome> PollingThread::handle_offline_command(const CommandPayload *command)
 {
   Result<OfflineCommandOutcome> r = Thread::handle_offline_command(command);
@@ -133,19 +355,43 @@ Result<Thread::OfflineCommandOutcome> PollingThread::handle_offline_command(cons
     handle_polling_throttle_command(command);
   }
 
+  if (command->get_action() == COMMAND_POLLING_CPU_BUDGET) {
+    handle_polling_cpu_budget_command(command);
+  }
+
+  if (command->get_action() == COMMAND_POLLING_SNAPSHOTS) {
+    handle_polling_snapshots_command(command);
+  }
+
   return ok_result(OFFLINE_ACK);
 }
 
 Result<Thread::CommandOutcome> PollingThread::handle_add_command(const CommandPayload *command)
 {
-  ostream &logline = LOGGER << "Adding poll root at path " << command->get_root();
-  if (!command->get_recursive()) logline << " (non-recursively)";
-  logline << " to channel " << command->get_channel_id() << " with " << plural(command->get_split_count(), "split")
-          << "." << endl;
+  const shared_ptr<const FileSet> &files = command->get_files();
+  size_t expected_roots = command->get_split_count();
 
-  roots.emplace(std::piecewise_construct,
-    std::forward_as_tuple(command->get_channel_id()),
-    std::forward_as_tuple(string(command->get_root()), command->get_channel_id(), command->get_recursive()));
+  if (files) {
+    LOGGER << "Adding poll roots for " << *files << " to channel " << command->get_channel_id() << " with "
+           << plural(command->get_split_count(), "split") << "." << endl;
+
+    // Poll each directory that holds a member of the file set as its own root, without recursing.
+    for (auto &directory : files->get_directories()) {
+      add_root(command, directory.first, false, files->subset(directory.first));
+    }
+    expected_roots *= files->get_directories().size();
+  } else {
+    LOGGER << "Adding poll root at path " << command->get_root()
+           << (command->get_recursive() ? "" : " (non-recursively)") << " to channel " << command->get_channel_id()
+           << " with " << plural(command->get_split_count(), "split") << "." << endl;
+
+    add_root(command, command->get_root(), command->get_recursive(), nullptr);
+  }
+
+  // As on the worker thread, watchers of files report every event for them.
+  if (command->get_burst_threshold() > 0 && !files) {
+    bursts.set_threshold(command->get_channel_id(), command->get_root(), command->get_burst_threshold());
+  }
 
   auto existing = pending_splits.find(command->get_channel_id());
   if (existing != pending_splits.end()) {
@@ -165,7 +411,7 @@ Result<Thread::CommandOutcome> PollingThread::handle_add_command(const CommandPa
       msg += ")";
     }
 
-    if (split_count != command->get_split_count()) {
+    if (split_count != expected_roots) {
       if (inconsistent) {
         msg += " and";
       }
@@ -173,7 +419,7 @@ Result<Thread::CommandOutcome> PollingThread::handle_add_command(const CommandPa
       msg += " split count (";
       msg += to_string(split_count);
       msg += " => ";
-      msg += to_string(command->get_split_count());
+      msg += to_string(expected_roots);
       msg += ")";
     }
 
@@ -187,9 +433,9 @@ Result<Thread::CommandOutcome> PollingThread::handle_add_command(const CommandPa
   if (command->get_id() != NULL_COMMAND_ID) {
     pending_splits.emplace(std::piecewise_construct,
       std::forward_as_tuple(command->get_channel_id()),
-      std::forward_as_tuple(command->get_id(), command->get_split_count()));
+      std::forward_as_tuple(command->get_id(), expected_roots));
 
-    if (command->get_split_count() == 0u) {
+    if (expected_roots == 0u) {
       return ok_result(ACK);
     }
   }
@@ -197,12 +443,88 @@ Result<Thread::CommandOutcome> PollingThread::handle_add_command(const CommandPa
   return ok_result(NOTHING);
 }
 
+void PollingThread::add_root(const CommandPayload *command,
+  const string &root_path,
+  bool recursive,
+  const shared_ptr<const FileSet> &files)
+{
+  // Exclusions, ignore files, file sets and depth limits all change the set of entries that's recorded, so a snapshot
+  // of a filtered root can't be shared with another poll of the same directory. Only unfiltered roots are snapshotted.
+  bool filtered = command->get_exclude() || command->get_respect_ignore_files() || files
+    || (recursive && command->get_max_depth() != UNLIMITED_DEPTH);
+  string snapshot_path;
+  if (!snapshot_dir.empty() && !filtered) snapshot_path = Snapshot::path_for(snapshot_dir, root_path, recursive);
+
+  auto inserted = roots.emplace(std::piecewise_construct,
+    std::forward_as_tuple(command->get_channel_id()),
+    std::forward_as_tuple(string(root_path),
+      command->get_channel_id(),
+      recursive,
+      milliseconds(command->get_poll_interval()),
+      milliseconds(command->get_poll_staleness()),
+      move(snapshot_path)));
+  inserted->second.set_exclude(command->get_exclude());
+  inserted->second.set_actions(command->get_actions());
+  inserted->second.set_files(files);
+  if (command->get_respect_ignore_files()) {
+    inserted->second.set_ignore_rules(shared_ptr<IgnoreRules>(new IgnoreRules(root_path)));
+  }
+  if (recursive && !files && command->get_max_depth() != UNLIMITED_DEPTH) {
+    inserted->second.set_depth_limit(shared_ptr<DepthLimit>(new DepthLimit(root_path, command->get_max_depth())));
+  }
+  schedule(inserted->second, Clock::now());
+}
+
+Result<Thread::CommandOutcome> PollingThread::handle_expand_command(const CommandPayload *command)
+{
+  LOGGER << "Expanding poll roots at channel " << command->get_channel_id() << " beneath " << command->get_root()
+         << " by " << plural(command->get_max_depth(), "level") << "." << endl;
+
+  PendingExpansion pending{command->get_id(), command->get_channel_id(), {}};
+
+  auto channel_roots = roots.equal_range(command->get_channel_id());
+  for (auto root = channel_roots.first; root != channel_roots.second; ++root) {
+    const shared_ptr<DepthLimit> &depth_limit = root->second.get_depth_limit();
+    if (!depth_limit) continue;
+
+    depth_limit->expand(command->get_root(), command->get_max_depth());
+
+    // The pass in progress may already have gone by the expanded directory, so wait for the one after it.
+    pending.passes.emplace_back(&root->second, root->second.get_completed_passes() + 2);
+  }
+
+  if (pending.passes.empty() || command->get_id() == NULL_COMMAND_ID) return ok_result(ACK);
+
+  pending_expansions.push_back(move(pending));
+  return ok_result(NOTHING);
+}
+
+Result<Thread::CommandOutcome> PollingThread::handle_collapse_command(const CommandPayload *command)
+{
+  LOGGER << "Collapsing poll roots at channel " << command->get_channel_id() << " beneath " << command->get_root()
+         << "." << endl;
+
+  auto channel_roots = roots.equal_range(command->get_channel_id());
+  for (auto root = channel_roots.first; root != channel_roots.second; ++root) {
+    const shared_ptr<DepthLimit> &depth_limit = root->second.get_depth_limit();
+    if (depth_limit) depth_limit->collapse(command->get_root());
+  }
+
+  return ok_result(ACK);
+}
+
 Result<Thread::CommandOutcome> PollingThread::handle_remove_command(const CommandPayload *command)
 {
   const ChannelID &channel_id = command->get_channel_id();
   LOGGER << "Removing poll roots at channel " << channel_id << "." << endl;
 
-  roots.erase(command->get_channel_id());
+  auto channel_roots = roots.equal_range(channel_id);
+  for (auto root = channel_roots.first; root != channel_roots.second; ++root) {
+    unschedule(root->second);
+    root->second.save_snapshot();
+  }
+  roots.erase(channel_id);
+  bursts.forget(channel_id);
 
   // Ensure that we ack the ADD command even if the REMOVE command arrives before all of its splits populate.
   auto pending = pending_splits.find(channel_id);
@@ -215,6 +537,18 @@ Result<Thread::CommandOutcome> PollingThread::handle_remove_command(const Comman
     if (r0.is_error()) return r0.propagate<CommandOutcome>();
   }
 
+  // Expansions of the channel have nothing left to wait for.
+  for (auto expansion = pending_expansions.begin(); expansion != pending_expansions.end();) {
+    if (expansion->channel_id != channel_id) {
+      ++expansion;
+      continue;
+    }
+
+    Result<> r1 = emit(Message(AckPayload(expansion->command_id, channel_id, true, "")));
+    expansion = pending_expansions.erase(expansion);
+    if (r1.is_error()) return r1.propagate<CommandOutcome>();
+  }
+
   if (roots.empty()) {
     LOGGER << "Final root removed." << endl;
     return ok_result(TRIGGER_STOP);
@@ -234,3 +568,17 @@ Result<Thread::CommandOutcome> PollingThread::handle_polling_throttle_command(co
   poll_throttle = command->get_arg();
   return ok_result(ACK);
 }
+
+Result<Thread::CommandOutcome> PollingThread::handle_polling_cpu_budget_command(const CommandPayload *command)
+{
+  poll_cpu_budget = command->get_arg();
+  cpu_available = poll_cpu_budget;
+  cpu_refilled_at = Clock::now();
+  return ok_result(ACK);
+}
+
+Result<Thread::CommandOutcome> PollingThread::handle_polling_snapshots_command(const CommandPayload *command)
+{
+  snapshot_dir = command->get_root();
+  return ok_result(ACK);
+}
@@ -1,13 +1,18 @@
 #ifndef POLLING_THREAD_H
 #define POLLING_THREAD_H
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <set>
+#include <string>
 #include <utility>
 #include <uv.h>
+#include <vector>
 
+#include "../histogram.h"
 #include "../result.h"
 #include "../status.h"
 #include "../thread.h"
@@ -15,6 +20,7 @@
 
 const std::chrono::milliseconds DEFAULT_POLL_INTERVAL = std::chrono::milliseconds(100);
 const uint_fast32_t DEFAULT_POLL_THROTTLE = 1000;
+const uint_fast32_t DEFAULT_POLL_CPU_BUDGET = 0;
 
 // The PollingThread observes filesystem changes by repeatedly calling scandir() and lstat() on registered root
 // directories. It runs automatically when a `COMMAND_ADD` message is sent to it, and stops automatically when a
@@ -23,25 +29,61 @@ const uint_fast32_t DEFAULT_POLL_THROTTLE = 1000;
 // It has a configurable "throttle" which roughly corresponds to the number of filesystem calls performed within each
 // polling cycle. The throttle is distributed among polled roots so that small directories won't be starved by large
 // ones.
+//
+// Optionally, polling may also be limited by a processor time budget, measured in microseconds of thread CPU time
+// per second. Roots may request a staleness target: the maximum time that may pass between successive checks of any
+// entry. Roots with a target are allotted as many operations as their last full pass needs to meet it, and all
+// allotments are scaled back when the CPU budget is exhausted.
+//
+// Each root is advanced on its own timer. Between cycles the thread sleeps on a condition variable until the next
+// root is due or until `wake()` reports that commands are waiting, so commands are handled promptly and a thread with
+// nothing due stays asleep.
 class PollingThread : public Thread
 {
 public:
   explicit PollingThread(uv_async_t *main_callback);
   PollingThread(const PollingThread &) = delete;
   PollingThread(PollingThread &&) = delete;
-  ~PollingThread() override = default;
+  ~PollingThread() override;
 
   void collect_status(Status &status) override;
 
+  void reset_status() override;
+
   PollingThread &operator=(const PollingThread &) = delete;
   PollingThread &operator=(PollingThread &&) = delete;
 
 private:
+  using Clock = std::chrono::steady_clock;
+
   Result<> body() override;
 
-  // Perform a single polling cycle.
+  // Interrupt a sleeping `body()` so that it handles incoming commands immediately.
+  Result<> wake() override;
+
+  // Perform a single polling cycle, advancing each root whose timer has expired.
   Result<> cycle();
 
+  // Accrue processor time to spend on polling since the last refill.
+  void refill_cpu_budget(Clock::time_point now);
+
+  // Record the processor time spent during a cycle that performed `ops` operations.
+  void spend_cpu_budget(Clock::time_point now, uint64_t cpu_us, size_t ops);
+
+  // Block until the earliest root timer expires or `wake()` is called, whichever comes first.
+  void sleep_until_due();
+
+  // Add or remove a root from the timer queue.
+  void schedule(PolledRoot &root, Clock::time_point due);
+  void unschedule(PolledRoot &root);
+
+  // Begin polling `root_path` on the channel of the ADD command `command`, reporting only the members of `files` if
+  // it's set.
+  void add_root(const CommandPayload *command,
+    const std::string &root_path,
+    bool recursive,
+    const std::shared_ptr<const FileSet> &files);
+
   // Wake up when a `COMMAND_ADD` message is received while stopped.
   Result<OfflineCommandOutcome> handle_offline_command(const CommandPayload *command) override;
 
@@ -49,19 +91,78 @@ private:
 
   Result<CommandOutcome> handle_remove_command(const CommandPayload *command) override;
 
+  // Descend further beneath a directory of a depth-limited root. Newly covered directories are populated silently by
+  // the root's next full pass, and the command is acknowledged once it completes.
+  Result<CommandOutcome> handle_expand_command(const CommandPayload *command) override;
+
+  // Stop descending into the directories of an earlier expansion. Their records are released by the root's next pass.
+  Result<CommandOutcome> handle_collapse_command(const CommandPayload *command) override;
+
   // Configure the sleep interval.
   Result<CommandOutcome> handle_polling_interval_command(const CommandPayload *command) override;
 
   // Configure the number of system calls to perform during each `cycle()`.
   Result<CommandOutcome> handle_polling_throttle_command(const CommandPayload *command) override;
 
+  // Configure the processor time that polling may consume each second.
+  Result<CommandOutcome> handle_polling_cpu_budget_command(const CommandPayload *command) override;
+
+  // Configure the directory that snapshots of polled roots are saved within. Roots added afterwards are restored from
+  // and saved to snapshots there.
+  Result<CommandOutcome> handle_polling_snapshots_command(const CommandPayload *command) override;
+
   std::chrono::milliseconds poll_interval;
   uint_fast32_t poll_throttle;
 
+  // Processor time budget in microseconds per second, or zero for no limit.
+  uint_fast32_t poll_cpu_budget;
+
+  // Microseconds of processor time currently available to spend, and the moment they were last topped up.
+  double cpu_available;
+  Clock::time_point cpu_refilled_at;
+
+  // Moving average of the processor time consumed by a single polling operation, in microseconds.
+  double cpu_per_op;
+
+  // Processor time consumed since `usage_window_start`, used to report usage once per second.
+  uint64_t usage_window_cpu;
+  Clock::time_point usage_window_start;
+
+  // Polling statistics published for `collect_status()`, which is called from the main thread.
+  std::atomic<uint_fast64_t> status_cpu_usage;
+  std::atomic<uint_fast64_t> status_staleness;
+  std::atomic<uint_fast64_t> status_sla_misses;
+
+  // Wall-clock duration of each polling cycle, in microseconds.
+  Histogram cycle_duration;
+
+  // Directory containing snapshots of polled roots, or empty if snapshots are disabled.
+  std::string snapshot_dir;
+
   std::multimap<ChannelID, PolledRoot> roots;
 
+  // Roots ordered by the time that they're next due to be advanced.
+  std::set<std::pair<Clock::time_point, PolledRoot *>> timers;
+
   using PendingSplit = std::pair<CommandID, size_t>;
   std::map<ChannelID, PendingSplit> pending_splits;
+
+  // An expansion is acknowledged once each of its channel's roots has completed a pass that began after it, so that the
+  // newly covered directories have been populated and changes within them are reported from then on.
+  struct PendingExpansion
+  {
+    CommandID command_id;
+    ChannelID channel_id;
+
+    // Each depth-limited root of the channel and the number of completed passes it must reach.
+    std::vector<std::pair<const PolledRoot *, size_t>> passes;
+  };
+  std::vector<PendingExpansion> pending_expansions;
+
+  // Signalled by `wake()` to interrupt `sleep_until_due()`.
+  uv_mutex_t wake_mutex{};
+  uv_cond_t wake_cond{};
+  bool woken;
 };
 
 #endif
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <uv.h>
+#include <vector>
+
+#include "../helper/common.h"
+#include "../result.h"
+#include "snapshot.h"
+
+using std::function;
+using std::hex;
+using std::move;
+using std::ofstream;
+using std::ostringstream;
+using std::setfill;
+using std::setw;
+using std::shared_ptr;
+using std::string;
+
+string Snapshot::path_for(const string &snapshot_dir, const string &root_path, bool recursive)
+{
+  // 64-bit FNV-1a over the root path, followed by the recursion flag.
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : root_path) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  hash ^= recursive ? 1u : 0u;
+  hash *= 1099511628211ull;
+
+  ostringstream name;
+  name << hex << setfill('0') << setw(16) << hash << ".snapshot";
+  return path_join(snapshot_dir, name.str());
+}
+
+shared_ptr<Snapshot> Snapshot::load(const string &snapshot_path, const string &root_path)
+{
+  size_t size = 0;
+  const char *data = map_file(snapshot_path, size);
+  if (data == nullptr) return nullptr;
+
+  shared_ptr<Snapshot> snapshot(new Snapshot(data, size));
+  const SnapshotHeader *header = snapshot->header;
+
+  if (size < sizeof(SnapshotHeader)) return nullptr;
+  if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) return nullptr;
+  if (header->version != SNAPSHOT_VERSION || header->entry_size != sizeof(SnapshotEntry)) return nullptr;
+
+  // Ensure that the tables and string pool exactly fill the file.
+  uint64_t remaining = size - sizeof(SnapshotHeader);
+  if (header->directory_count > remaining / sizeof(SnapshotDirectory)) return nullptr;
+  remaining -= header->directory_count * sizeof(SnapshotDirectory);
+  if (header->entry_count > remaining / sizeof(SnapshotEntry)) return nullptr;
+  remaining -= header->entry_count * sizeof(SnapshotEntry);
+  if (header->strings_size != remaining) return nullptr;
+
+  snapshot->directories = reinterpret_cast<const SnapshotDirectory *>(data + sizeof(SnapshotHeader));
+  snapshot->entries = reinterpret_cast<const SnapshotEntry *>(snapshot->directories + header->directory_count);
+  snapshot->strings = reinterpret_cast<const char *>(snapshot->entries + header->entry_count);
+
+  if (!snapshot->string_in_bounds(header->root_offset, header->root_length)) return nullptr;
+  if (root_path.compare(0, string::npos, snapshot->strings + header->root_offset, header->root_length) != 0) {
+    return nullptr;
+  }
+
+  return snapshot;
+}
+
+Snapshot::Snapshot(const char *data, size_t size) :
+  data{data},
+  size{size},
+  header{reinterpret_cast<const SnapshotHeader *>(data)},
+  directories{nullptr},
+  entries{nullptr},
+  strings{nullptr}
+{
+  //
+}
+
+Snapshot::~Snapshot()
+{
+  unmap_file(data, size);
+}
+
+bool Snapshot::read_directory(const string &dir_path,
+  const function<void(string &&, const uv_stat_t &)> &callback) const
+{
+  const SnapshotDirectory *begin = directories;
+  const SnapshotDirectory *end = directories + header->directory_count;
+
+  auto compare = [this](const SnapshotDirectory &directory, const string &path) {
+    if (!string_in_bounds(directory.path_offset, directory.path_length)) return false;
+    return path.compare(0, string::npos, strings + directory.path_offset, directory.path_length) > 0;
+  };
+  const SnapshotDirectory *found = std::lower_bound(begin, end, dir_path, compare);
+  if (found == end || !string_in_bounds(found->path_offset, found->path_length)) return false;
+  if (dir_path.compare(0, string::npos, strings + found->path_offset, found->path_length) != 0) return false;
+
+  if (found->first_entry > header->entry_count || found->entry_count > header->entry_count - found->first_entry) {
+    return false;
+  }
+
+  for (uint64_t i = found->first_entry; i < found->first_entry + found->entry_count; i++) {
+    const SnapshotEntry &entry = entries[i];
+    if (!string_in_bounds(entry.name_offset, entry.name_length)) continue;
+
+    uv_stat_t stat{};
+    stat.st_dev = entry.dev;
+    stat.st_ino = entry.ino;
+    stat.st_mode = entry.mode;
+    stat.st_size = entry.size;
+    stat.st_mtim.tv_sec = static_cast<long>(entry.mtim_sec);
+    stat.st_mtim.tv_nsec = static_cast<long>(entry.mtim_nsec);
+    stat.st_ctim.tv_sec = static_cast<long>(entry.ctim_sec);
+    stat.st_ctim.tv_nsec = static_cast<long>(entry.ctim_nsec);
+
+    callback(string(strings + entry.name_offset, static_cast<size_t>(entry.name_length)), stat);
+  }
+
+  return true;
+}
+
+SnapshotWriter::SnapshotWriter(const string &root_path) : header{}
+{
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  header.version = SNAPSHOT_VERSION;
+  header.entry_size = sizeof(SnapshotEntry);
+  header.root_offset = intern(root_path);
+  header.root_length = root_path.size();
+}
+
+void SnapshotWriter::add_directory(const string &dir_path)
+{
+  SnapshotDirectory directory{};
+  directory.path_offset = intern(dir_path);
+  directory.path_length = dir_path.size();
+  directory.first_entry = entries.size();
+  directories.push_back(directory);
+}
+
+void SnapshotWriter::add_entry(const string &entry_name, const uv_stat_t &stat)
+{
+  SnapshotEntry entry{};
+  entry.name_offset = intern(entry_name);
+  entry.name_length = entry_name.size();
+  entry.dev = stat.st_dev;
+  entry.ino = stat.st_ino;
+  entry.mode = stat.st_mode;
+  entry.size = stat.st_size;
+  entry.mtim_sec = stat.st_mtim.tv_sec;
+  entry.mtim_nsec = stat.st_mtim.tv_nsec;
+  entry.ctim_sec = stat.st_ctim.tv_sec;
+  entry.ctim_nsec = stat.st_ctim.tv_nsec;
+  entries.push_back(entry);
+
+  directories.back().entry_count++;
+}
+
+Result<> SnapshotWriter::write(const string &snapshot_path)
+{
+  // Directories are looked up by binary search. Their entries stay where they are.
+  std::sort(directories.begin(), directories.end(), [this](const SnapshotDirectory &a, const SnapshotDirectory &b) {
+    return strings.compare(a.path_offset, a.path_length, strings, b.path_offset, b.path_length) < 0;
+  });
+
+  header.directory_count = directories.size();
+  header.entry_count = entries.size();
+  header.strings_size = strings.size();
+
+  string temp_path(snapshot_path);
+  temp_path += ".tmp";
+
+  ofstream out(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(SnapshotHeader));
+  out.write(reinterpret_cast<const char *>(directories.data()), directories.size() * sizeof(SnapshotDirectory));
+  out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(SnapshotEntry));
+  out.write(strings.data(), strings.size());
+  out.close();
+
+  if (out.fail()) {
+    string msg("Unable to write snapshot ");
+    msg += temp_path;
+    return error_result(move(msg));
+  }
+
+  uv_fs_t rename_req{};
+  int rename_err = uv_fs_rename(nullptr, &rename_req, temp_path.c_str(), snapshot_path.c_str(), nullptr);
+  uv_fs_req_cleanup(&rename_req);
+  if (rename_err < 0) {
+    ostringstream msg;
+    msg << "Unable to move snapshot into place at " << snapshot_path << ": " << uv_strerror(rename_err);
+    return error_result(msg.str());
+  }
+
+  return ok_result();
+}
+
+uint64_t SnapshotWriter::intern(const string &str)
+{
+  uint64_t offset = strings.size();
+  strings += str;
+  return offset;
+}
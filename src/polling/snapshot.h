@@ -0,0 +1,138 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <uv.h>
+#include <vector>
+
+#include "../result.h"
+
+// On-disk layout of a polling snapshot. A snapshot file consists of a `SnapshotHeader`, followed by a table of
+// `SnapshotDirectory` records sorted by path, a table of `SnapshotEntry` records grouped by directory and sorted by
+// name, and finally a pool of the strings they reference. Integers are stored in native byte order, so snapshots are
+// only meaningful on the machine that wrote them.
+//
+// Bump `SNAPSHOT_VERSION` whenever any of these structures change. Snapshots written with any other version are
+// ignored.
+const char SNAPSHOT_MAGIC[8] = {'W', 'A', 'T', 'C', 'H', 'S', 'N', 'P'};
+
+const uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t entry_size;
+  uint64_t directory_count;
+  uint64_t entry_count;
+  uint64_t strings_size;
+  uint64_t root_offset;
+  uint64_t root_length;
+};
+
+struct SnapshotDirectory
+{
+  uint64_t path_offset;
+  uint64_t path_length;
+  uint64_t first_entry;
+  uint64_t entry_count;
+};
+
+struct SnapshotEntry
+{
+  uint64_t name_offset;
+  uint64_t name_length;
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t mode;
+  uint64_t size;
+  int64_t mtim_sec;
+  int64_t mtim_nsec;
+  int64_t ctim_sec;
+  int64_t ctim_nsec;
+};
+
+// Read-only view of a snapshot of the `DirectoryRecord` tree of a `PolledRoot`, as saved by a previous process. The
+// file is mapped into memory rather than parsed, so directories are only decoded as they're restored.
+class Snapshot
+{
+public:
+  // Compute the path of the snapshot file used for the polled root `root_path` within `snapshot_dir`. Recursive and
+  // non-recursive polls of the same root record different sets of entries, so each has a file of its own.
+  static std::string path_for(const std::string &snapshot_dir, const std::string &root_path, bool recursive);
+
+  // Map the snapshot file at `snapshot_path` if it exists, has the current version, and was written for the polled
+  // root `root_path`. Return `nullptr` otherwise.
+  static std::shared_ptr<Snapshot> load(const std::string &snapshot_path, const std::string &root_path);
+
+  Snapshot(const Snapshot &) = delete;
+  Snapshot(Snapshot &&) = delete;
+  ~Snapshot();
+  Snapshot &operator=(const Snapshot &) = delete;
+  Snapshot &operator=(Snapshot &&) = delete;
+
+  // Invoke `callback` with the name and recorded `lstat()` results of each entry saved within the directory at
+  // `dir_path`. Return false if the snapshot has no record of the directory.
+  bool read_directory(const std::string &dir_path,
+    const std::function<void(std::string &&, const uv_stat_t &)> &callback) const;
+
+  // Return the number of directories recorded in the snapshot.
+  size_t get_directory_count() const { return static_cast<size_t>(header->directory_count); }
+
+private:
+  Snapshot(const char *data, size_t size);
+
+  // Return true if the string at `offset` and `length` lies within the string pool.
+  bool string_in_bounds(uint64_t offset, uint64_t length) const
+  {
+    return offset <= header->strings_size && length <= header->strings_size - offset;
+  }
+
+  const char *data;
+  size_t size;
+
+  const SnapshotHeader *header;
+  const SnapshotDirectory *directories;
+  const SnapshotEntry *entries;
+  const char *strings;
+};
+
+// Accumulate the contents of a `DirectoryRecord` tree, then write them to a snapshot file.
+class SnapshotWriter
+{
+public:
+  explicit SnapshotWriter(const std::string &root_path);
+
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter(SnapshotWriter &&) = delete;
+  ~SnapshotWriter() = default;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+  SnapshotWriter &operator=(SnapshotWriter &&) = delete;
+
+  // Begin a new directory. Subsequent calls to `add_entry()` record entries within it. Entries must be added in
+  // sorted order.
+  void add_directory(const std::string &dir_path);
+
+  // Record an entry within the most recently added directory.
+  void add_entry(const std::string &entry_name, const uv_stat_t &stat);
+
+  // Write the accumulated snapshot to a temporary file beside `snapshot_path`, then atomically move it into place.
+  Result<> write(const std::string &snapshot_path);
+
+  // Return the number of directories accumulated so far.
+  size_t get_directory_count() const { return directories.size(); }
+
+private:
+  // Append `str` to the string pool and return its offset.
+  uint64_t intern(const std::string &str);
+
+  SnapshotHeader header;
+  std::vector<SnapshotDirectory> directories;
+  std::vector<SnapshotEntry> entries;
+  std::string strings;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+// Userspace statically defined tracepoints (USDT) at the boundaries of the watcher's hot paths, for profiling a
+// production process live with perf, bpftrace or SystemTap:
+//
+// ```sh
+// bpftrace -e 'usdt:./build/Release/watcher.node:watcher:emit { @[str(arg0)] = hist(arg1); }'
+// ```
+//
+// Each probe compiles to a single no-op instruction until a tracer attaches to it. Probes are present only in builds
+// compiled with `WATCHER_USDT` defined, which `binding.gyp` does automatically when `sys/sdt.h` is installed. When they
+// are absent, probe arguments are never evaluated.
+//
+// Probes and their arguments:
+//
+// * `inotify_read(bytes, events)`: a read() from the inotify descriptor returned `bytes` bytes holding `events` events.
+// * `crawl_visit(channel, path, wd)`: a directory beneath a new root was assigned the inotify watch descriptor `wd`.
+// * `rename_matched(channel, old_path, new_path)`: an IN_MOVED_FROM and IN_MOVED_TO pair was reported as a rename.
+// * `rename_expired(channel, old_path)`: an IN_MOVED_FROM found no partner in time and was reported as a deletion.
+// * `advance_start(channel, allotment)` and `advance_end(channel, ops, events)`: a polled root was advanced by up to
+//   `allotment` filesystem operations, performing `ops` of them and producing `events` events.
+// * `emit(thread, count, channel)`: a thread emitted `count` messages to the main thread. `channel` is the channel of
+//   the first filesystem event among them, or zero.
+// * `queue_enqueue(queue, count, size)` and `queue_accept(queue, count)`: messages were added to or taken from a
+//   `Queue`, which held `size` messages afterwards.
+// * `dispatch(channel, events)`: the main thread is about to deliver `events` events to a channel's callback.
+//
+// String arguments are `const char *`. Other arguments are integers.
+#ifdef WATCHER_USDT
+
+#include <sys/sdt.h>
+
+#define WATCHER_PROBE1(name, a) DTRACE_PROBE1(watcher, name, a)
+#define WATCHER_PROBE2(name, a, b) DTRACE_PROBE2(watcher, name, a, b)
+#define WATCHER_PROBE3(name, a, b, c) DTRACE_PROBE3(watcher, name, a, b, c)
+
+#else
+
+#define WATCHER_PROBE1(name, a) (void) sizeof(a)
+#define WATCHER_PROBE2(name, a, b) (void) sizeof(a), (void) sizeof(b)
+#define WATCHER_PROBE3(name, a, b, c) (void) sizeof(a), (void) sizeof(b), (void) sizeof(c)
+
+#endif
+
+#endif
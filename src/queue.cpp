@@ -6,6 +6,7 @@
 
 #include "lock.h"
 #include "message.h"
+#include "probes.h"
 #include "queue.h"
 #include "result.h"
 
@@ -35,6 +36,8 @@ Result<> Queue::enqueue(Message &&message)
 
   Lock lock(mutex);
   active->push_back(move(message));
+  high_water.observe(active->size());
+  WATCHER_PROBE3(queue_enqueue, get_source().c_str(), 1, active->size());
   return ok_result();
 }
 
@@ -51,6 +54,7 @@ Result<unique_ptr<vector<Message>>> Queue::accept_all()
 
   unique_ptr<vector<Message>> consumed = move(active);
   active.reset(new vector<Message>);
+  WATCHER_PROBE2(queue_accept, get_source().c_str(), consumed->size());
 
   return ok_result(move(consumed));
 }
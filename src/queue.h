@@ -10,8 +10,10 @@
 #include <vector>
 
 #include "errable.h"
+#include "histogram.h"
 #include "lock.h"
 #include "message.h"
+#include "probes.h"
 #include "result.h"
 
 // Primary channel of communication between threads.
@@ -38,7 +40,10 @@ public:
     if (!is_healthy()) return health_err_result();
 
     Lock lock(mutex);
+    size_t before = active->size();
     std::move(begin, end, std::back_inserter(*active));
+    high_water.observe(active->size());
+    WATCHER_PROBE3(queue_enqueue, get_source().c_str(), active->size() - before, active->size());
     return ok_result();
   }
 
@@ -51,12 +56,20 @@ public:
   // Atomically report the number of items waiting on the queue.
   size_t size();
 
+  // Report the greatest number of items that have been waiting on the queue at once since it was created or the
+  // mark was last reset.
+  size_t get_high_water_mark() { return static_cast<size_t>(high_water.get()); }
+
+  void reset_high_water_mark() { high_water.reset(); }
+
   Queue &operator=(const Queue &) = delete;
   Queue &operator=(Queue &&) = delete;
 
 private:
   uv_mutex_t mutex{};
   std::unique_ptr<std::vector<Message>> active;
+
+  HighWaterMark high_water;
 };
 
 #endif
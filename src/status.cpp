@@ -6,6 +6,17 @@
 
 using std::endl;
 using std::ostream;
+using std::vector;
+
+static void print_hot_directories(ostream &out, const vector<HotDirectory> &directories)
+{
+  out << "  - busiest directories:";
+  if (directories.empty()) out << " none";
+  out << "\n";
+  for (const HotDirectory &directory : directories) {
+    out << "    - " << directory << "\n";
+  }
+}
 
 ostream &operator<<(ostream &out, const Status &status)
 {
@@ -13,18 +24,40 @@ ostream &operator<<(ostream &out, const Status &status)
       << "* main thread:\n"
       << "  - " << plural(status.pending_callback_count, "pending callback") << "\n"
       << "  - " << plural(status.channel_callback_count, "channel callback") << "\n"
+      << "  - dispatch duration (us): " << status.dispatch_duration << "\n"
+      << "  - callback duration (us): " << status.callback_duration << "\n"
+      << "  - events per channel callback: " << status.channel_batch << "\n"
+      << "  - detection to emission latency (us): " << status.latency_emit << "\n"
+      << "  - queue latency (us): " << status.latency_queue << "\n"
+      << "  - dispatch latency (us): " << status.latency_dispatch << "\n"
+      << "  - total latency (us): " << status.latency_total << "\n"
       << "* worker thread:\n"
       << "  - state: " << status.worker_thread_state << "\n"
       << "  - health: " << status.worker_thread_ok << "\n"
       << "  - in queue health: " << status.worker_in_ok << "\n"
       << "  - " << plural(status.worker_in_size, "in queue message") << "\n"
       << "  - out queue health: " << status.worker_out_ok << "\n"
-      << "  - " << plural(status.worker_out_size, "out queue message") << "* polling thread\n"
+      << "  - " << plural(status.worker_out_size, "out queue message") << "\n"
+      << "  - queue high-water marks: " << status.worker_in_high_water << " in, " << status.worker_out_high_water
+      << " out\n"
+      << "  - events per read: " << status.worker_read_batch << "\n"
+      << "  - kernel queue depth (bytes): " << status.worker_kernel_queue_depth << "\n"
+      << "  - " << plural(status.worker_overflows, "kernel queue overflow") << "\n";
+  print_hot_directories(out, status.worker_hot_directories);
+  out << "* polling thread\n"
       << "  - state: " << status.polling_thread_state << "\n"
       << "  - health: " << status.polling_thread_ok << "\n"
       << "  - in queue health: " << status.worker_in_ok << "\n"
       << "  - " << plural(status.polling_in_size, "in queue message") << "\n"
       << "  - out queue health: " << status.worker_out_ok << "\n"
-      << "  - " << plural(status.polling_out_size, "out queue message") << endl;
+      << "  - " << plural(status.polling_out_size, "out queue message") << "\n"
+      << "  - CPU usage: " << status.polling_cpu_usage << "us/s of " << status.polling_cpu_budget << "us/s\n"
+      << "  - achieved staleness: " << status.polling_staleness << "ms\n"
+      << "  - " << plural(status.polling_sla_misses, "staleness target miss", "staleness target misses") << "\n"
+      << "  - queue high-water marks: " << status.polling_in_high_water << " in, " << status.polling_out_high_water
+      << " out\n"
+      << "  - cycle duration (us): " << status.polling_cycle_duration << "\n";
+  print_hot_directories(out, status.polling_hot_directories);
+  out << endl;
   return out;
 }
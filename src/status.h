@@ -1,8 +1,13 @@
 #ifndef STATUS_H
 #define STATUS_H
 
+#include <cstdint>
 #include <iostream>
 #include <string>
+#include <vector>
+
+#include "heavy_hitters.h"
+#include "histogram.h"
 
 // Summarize the module's health. This includes information like the health of all Errable and SyncErrable
 // resources and the sizes of internal queues and buffers.
@@ -12,6 +17,13 @@ public:
   // Main thread
   size_t pending_callback_count{0};
   size_t channel_callback_count{0};
+  HistogramSummary dispatch_duration{};
+  HistogramSummary callback_duration{};
+  HistogramSummary channel_batch{};
+  HistogramSummary latency_emit{};
+  HistogramSummary latency_queue{};
+  HistogramSummary latency_dispatch{};
+  HistogramSummary latency_total{};
 
   // Worker thread
   std::string worker_thread_state{};
@@ -20,6 +32,12 @@ public:
   std::string worker_in_ok{};
   size_t worker_out_size{0};
   std::string worker_out_ok{};
+  size_t worker_in_high_water{0};
+  size_t worker_out_high_water{0};
+  HistogramSummary worker_read_batch{};
+  HistogramSummary worker_kernel_queue_depth{};
+  uint_fast64_t worker_overflows{0};
+  std::vector<HotDirectory> worker_hot_directories{};
 
   // Polling thread
   std::string polling_thread_state{};
@@ -28,6 +46,14 @@ public:
   std::string polling_in_ok{};
   size_t polling_out_size{0};
   std::string polling_out_ok{};
+  uint_fast64_t polling_cpu_budget{0};
+  uint_fast64_t polling_cpu_usage{0};
+  uint_fast64_t polling_staleness{0};
+  uint_fast64_t polling_sla_misses{0};
+  size_t polling_in_high_water{0};
+  size_t polling_out_high_water{0};
+  HistogramSummary polling_cycle_duration{};
+  std::vector<HotDirectory> polling_hot_directories{};
 };
 
 std::ostream &operator<<(std::ostream &out, const Status &status);
@@ -10,6 +10,7 @@
 #include "message.h"
 #include "result.h"
 #include "thread.h"
+#include "trace.h"
 
 using std::bind;
 using std::endl;
@@ -31,12 +32,17 @@ Thread::DispatchTable::DispatchTable()
 {
   handlers[COMMAND_ADD] = &Thread::handle_add_command;
   handlers[COMMAND_REMOVE] = &Thread::handle_remove_command;
+  handlers[COMMAND_EXPAND] = &Thread::handle_expand_command;
+  handlers[COMMAND_COLLAPSE] = &Thread::handle_collapse_command;
   handlers[COMMAND_LOG_FILE] = &Thread::handle_log_file_command;
   handlers[COMMAND_LOG_STDERR] = &Thread::handle_log_stderr_command;
   handlers[COMMAND_LOG_STDOUT] = &Thread::handle_log_stdout_command;
   handlers[COMMAND_LOG_DISABLE] = &Thread::handle_log_disable_command;
   handlers[COMMAND_POLLING_INTERVAL] = &Thread::handle_polling_interval_command;
   handlers[COMMAND_POLLING_THROTTLE] = &Thread::handle_polling_throttle_command;
+  handlers[COMMAND_POLLING_CPU_BUDGET] = &Thread::handle_polling_cpu_budget_command;
+  handlers[COMMAND_POLLING_SNAPSHOTS] = &Thread::handle_polling_snapshots_command;
+  handlers[COMMAND_WORKER_CAPTURE] = &Thread::handle_worker_capture_command;
   handlers[COMMAND_DRAIN] = &Thread::handle_unknown_command;
 }
 
@@ -145,6 +151,7 @@ Result<bool> Thread::drain()
 void Thread::start()
 {
   mark_running();
+  trace_thread_name(get_source());
 
   // Artificially enqueue any messages that establish the thread's starting state.
   vector<Message> starter_messages = starter->get_messages();
@@ -176,6 +183,12 @@ Result<> Thread::emit(Message &&message)
 {
   if (!is_healthy()) return health_err_result();
 
+  if (is_latency_tracing()) message.mark_emitted(uv_hrtime());
+
+  const FileSystemPayload *fs = message.as_filesystem();
+  if (fs != nullptr) hot_directories.record(fs->get_path());
+  WATCHER_PROBE3(emit, get_source().c_str(), 1, fs != nullptr ? fs->get_channel_id() : NULL_CHANNEL_ID);
+
   Result<> qr = out.enqueue(move(message));
   if (qr.is_error()) return qr;
 
@@ -279,9 +292,21 @@ Result<Thread::CommandOutcome> Thread::handle_remove_command(const CommandPayloa
   return handle_unknown_command(payload);
 }
 
+Result<Thread::CommandOutcome> Thread::handle_expand_command(const CommandPayload *payload)
+{
+  return handle_unknown_command(payload);
+}
+
+Result<Thread::CommandOutcome> Thread::handle_collapse_command(const CommandPayload *payload)
+{
+  return handle_unknown_command(payload);
+}
+
 Result<Thread::CommandOutcome> Thread::handle_log_file_command(const CommandPayload *payload)
 {
-  Logger::to_file(payload->get_root().c_str());
+  if (!Logger::to_file(payload->get_root().c_str())) {
+    return Result<CommandOutcome>::make_error("Unable to open log file " + payload->get_root());
+  }
   starter->set_logging(payload);
   return ok_result(ACK);
 }
@@ -317,12 +342,34 @@ Result<Thread::CommandOutcome> Thread::handle_polling_throttle_command(const Com
   return handle_unknown_command(payload);
 }
 
+Result<Thread::CommandOutcome> Thread::handle_polling_cpu_budget_command(const CommandPayload *payload)
+{
+  return handle_unknown_command(payload);
+}
+
+Result<Thread::CommandOutcome> Thread::handle_polling_snapshots_command(const CommandPayload *payload)
+{
+  return handle_unknown_command(payload);
+}
+
+Result<Thread::CommandOutcome> Thread::handle_worker_capture_command(const CommandPayload *payload)
+{
+  return handle_unknown_command(payload);
+}
+
 Result<Thread::CommandOutcome> Thread::handle_unknown_command(const CommandPayload *payload)
 {
   LOGGER << "Received command with unexpected action " << *payload << "." << endl;
   return ok_result(ACK);
 }
 
+void Thread::reset_status()
+{
+  in.reset_high_water_mark();
+  out.reset_high_water_mark();
+  hot_directories.reset();
+}
+
 string Thread::state_name()
 {
   switch (state.load()) {
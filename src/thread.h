@@ -4,6 +4,7 @@
 #include <atomic>
 #include <functional>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -11,8 +12,11 @@
 #include <uv.h>
 #include <vector>
 
+#include "burst_collapser.h"
 #include "errable.h"
+#include "heavy_hitters.h"
 #include "message.h"
+#include "probes.h"
 #include "queue.h"
 #include "result.h"
 #include "status.h"
@@ -69,6 +73,13 @@ public:
   // Override to populate the appropriate fields within a `Status` structure.
   virtual void collect_status(Status &status) = 0;
 
+  // Clear the high-water marks and histograms reported by `Thread::collect_status()`. Subclasses that record their
+  // own statistics should override this and call the superclass implementation.
+  virtual void reset_status();
+
+  // Append the directories that have produced the most filesystem events emitted by this thread, busiest first.
+  void collect_hot_directories(std::vector<HotDirectory> &into) { hot_directories.collect(into); }
+
 protected:
   // Invoked on the newly created thread. Responsible for performing thread startup, consuming any `ThreadStart`
   // initialization and transitioning to the `RUNNING` phase. Calls `Thread::body()` to perform subclass-defined
@@ -94,6 +105,8 @@ protected:
   // The output queue and async notification are only triggered once, so this method is much more efficient than
   // calling `Thread::emit()` in a loop. See `MessageBuffer` and `ChannelMessageBuffer` for mechanisms to collect
   // `Messages` into batches.
+  //
+  // Bursts of events on channels with a burst threshold are collapsed across the batch by `Thread::bursts` first.
   template <class InputIt>
   Result<> emit_all(InputIt begin, InputIt end);
 
@@ -128,6 +141,12 @@ protected:
   // Override to remove a root directory. Optionally, trigger a possible thread shutdown by returning `TRIGGER_STOP`.
   virtual Result<CommandOutcome> handle_remove_command(const CommandPayload *payload);
 
+  // Override to watch more of a depth-limited root beneath a directory.
+  virtual Result<CommandOutcome> handle_expand_command(const CommandPayload *payload);
+
+  // Override to stop watching the directories that an earlier expansion watched.
+  virtual Result<CommandOutcome> handle_collapse_command(const CommandPayload *payload);
+
   // Configure this thread to log to a file.
   Result<CommandOutcome> handle_log_file_command(const CommandPayload *payload);
 
@@ -146,6 +165,15 @@ protected:
   // Configure the number of system calls to perform during each polling cycle.
   virtual Result<CommandOutcome> handle_polling_throttle_command(const CommandPayload *payload);
 
+  // Configure the processor time that the polling thread may consume each second.
+  virtual Result<CommandOutcome> handle_polling_cpu_budget_command(const CommandPayload *payload);
+
+  // Configure the directory that polled roots are snapshotted within.
+  virtual Result<CommandOutcome> handle_polling_snapshots_command(const CommandPayload *payload);
+
+  // Begin or end recording the native event stream consumed by the worker thread.
+  virtual Result<CommandOutcome> handle_worker_capture_command(const CommandPayload *payload);
+
   // Called when a `Message` with an unexpected command type is received. Logs the message and acknowledges.
   Result<CommandOutcome> handle_unknown_command(const CommandPayload *payload);
 
@@ -193,8 +221,18 @@ protected:
   size_t get_in_queue_size() { return in.size(); }
   std::string get_out_queue_error() { return out.get_error(); }
   size_t get_out_queue_size() { return out.size(); }
+  size_t get_in_queue_high_water_mark() { return in.get_high_water_mark(); }
+  size_t get_out_queue_high_water_mark() { return out.get_high_water_mark(); }
+
+  // Channels whose bursts of events are collapsed into summaries as they're emitted. Subclasses record each channel's
+  // threshold as its roots are added, and forget it as they're removed.
+  BurstCollapser bursts;
 
 private:
+  // Enqueue a batch of `Messages` that's ready to be sent back to the main thread, as `Thread::emit_all()`.
+  template <class InputIt>
+  Result<> emit_batch(InputIt begin, InputIt end);
+
   // Phases of a thread's lifecycle.
   enum State
   {
@@ -218,6 +256,9 @@ private:
   // `Thread::receive_all()`.
   uv_async_t *main_callback;
 
+  // Parent directories of the filesystem events emitted by this thread.
+  HeavyHitters hot_directories;
+
   // Running thread handle.
   uv_thread_t uv_handle{};
   std::function<void()> work_fn;
@@ -300,9 +341,38 @@ Result<bool> Thread::send_all(InputIt begin, InputIt end)
 
 template <class InputIt>
 Result<> Thread::emit_all(InputIt begin, InputIt end)
+{
+  if (bursts.empty()) return emit_batch(begin, end);
+
+  std::vector<Message> batch(std::make_move_iterator(begin), std::make_move_iterator(end));
+  bursts.collapse(batch, uv_hrtime());
+  return emit_batch(batch.begin(), batch.end());
+}
+
+template <class InputIt>
+Result<> Thread::emit_batch(InputIt begin, InputIt end)
 {
   if (!is_healthy()) return health_err_result();
 
+  if (is_latency_tracing()) {
+    uint64_t now = uv_hrtime();
+    for (InputIt it = begin; it != end; ++it) {
+      it->mark_emitted(now);
+    }
+  }
+
+  size_t count = 0;
+  ChannelID channel = NULL_CHANNEL_ID;
+  for (InputIt it = begin; it != end; ++it) {
+    count++;
+    const FileSystemPayload *fs = it->as_filesystem();
+    if (fs == nullptr) continue;
+
+    hot_directories.record(fs->get_path());
+    if (channel == NULL_CHANNEL_ID) channel = fs->get_channel_id();
+  }
+  WATCHER_PROBE3(emit, get_source().c_str(), count, channel);
+
   Result<> qr = out.enqueue_all(begin, end);
   if (qr.is_error()) return qr;
 
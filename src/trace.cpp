@@ -0,0 +1,234 @@
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <utility>
+#include <uv.h>
+#include <vector>
+
+#include "lock.h"
+#include "result.h"
+#include "trace.h"
+
+using std::endl;
+using std::ofstream;
+using std::ostream;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+struct TraceSpan
+{
+  const char *name;
+  uint64_t start;
+  uint64_t duration;
+  const char *arg_names[TRACE_MAX_ARGS];
+  uint64_t arg_values[TRACE_MAX_ARGS];
+  size_t arg_count;
+};
+
+// Spans recorded by a single thread. Only the owning thread appends spans, publishing each with a release store to
+// `count`, so the main thread may read every span up to `count` without blocking the writer. Stale spans from a prior
+// session are discarded by the owning thread the next time it records one.
+struct TraceBuffer
+{
+  TraceBuffer(string &&thread_name, uint64_t tid) :
+    thread_name(std::move(thread_name)),
+    tid{tid},
+    session{0},
+    count{0},
+    dropped{0}
+  {
+    //
+  }
+
+  TraceBuffer(const TraceBuffer &) = delete;
+  TraceBuffer(TraceBuffer &&) = delete;
+  ~TraceBuffer() = default;
+  TraceBuffer &operator=(const TraceBuffer &) = delete;
+  TraceBuffer &operator=(TraceBuffer &&) = delete;
+
+  string thread_name;
+  uint64_t tid;
+
+  // Allocated on first use while holding `registry_mutex`, so that threads that never record a span cost nothing.
+  unique_ptr<TraceSpan[]> spans;
+
+  std::atomic<uint64_t> session;
+  std::atomic<size_t> count;
+  std::atomic<size_t> dropped;
+};
+
+static std::atomic<bool> tracing{false};
+static std::atomic<uint64_t> current_session{0};
+
+// Every TraceBuffer ever created. Threads live as long as the process, so buffers are never released.
+static vector<unique_ptr<TraceBuffer>> registry;
+static uv_mutex_t registry_mutex;
+static uv_key_t current_buffer_key;
+static uv_once_t init_once = UV_ONCE_INIT;
+
+static void init()
+{
+  uv_mutex_init(&registry_mutex);
+  uv_key_create(&current_buffer_key);
+}
+
+// Access the calling thread's buffer, registering one if necessary. `registry_mutex` must be held.
+static TraceBuffer *current_buffer_locked()
+{
+  auto *buffer = static_cast<TraceBuffer *>(uv_key_get(&current_buffer_key));
+  if (buffer == nullptr) {
+    uint64_t tid = registry.size() + 1;
+    registry.emplace_back(new TraceBuffer("thread " + std::to_string(tid), tid));
+    buffer = registry.back().get();
+    uv_key_set(&current_buffer_key, buffer);
+  }
+  return buffer;
+}
+
+void trace_start()
+{
+  uv_once(&init_once, &init);
+
+  current_session.fetch_add(1, std::memory_order_release);
+  tracing.store(true, std::memory_order_release);
+}
+
+bool is_tracing()
+{
+  return tracing.load(std::memory_order_relaxed);
+}
+
+void trace_thread_name(const string &name)
+{
+  uv_once(&init_once, &init);
+
+  Lock lock(registry_mutex);
+  current_buffer_locked()->thread_name = name;
+}
+
+void trace_record(const char *name,
+  uint64_t start,
+  uint64_t duration,
+  const char *const *arg_names,
+  const uint64_t *arg_values,
+  size_t arg_count)
+{
+  uv_once(&init_once, &init);
+
+  auto *buffer = static_cast<TraceBuffer *>(uv_key_get(&current_buffer_key));
+  if (buffer == nullptr || !buffer->spans) {
+    Lock lock(registry_mutex);
+    buffer = current_buffer_locked();
+    if (!buffer->spans) buffer->spans.reset(new TraceSpan[TRACE_BUFFER_CAPACITY]);
+  }
+
+  uint64_t session = current_session.load(std::memory_order_acquire);
+  if (buffer->session.load(std::memory_order_relaxed) != session) {
+    buffer->count.store(0, std::memory_order_relaxed);
+    buffer->dropped.store(0, std::memory_order_relaxed);
+    buffer->session.store(session, std::memory_order_release);
+  }
+
+  size_t index = buffer->count.load(std::memory_order_relaxed);
+  if (index >= TRACE_BUFFER_CAPACITY) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  TraceSpan &span = buffer->spans[index];
+  span.name = name;
+  span.start = start;
+  span.duration = duration;
+  span.arg_count = arg_count < TRACE_MAX_ARGS ? arg_count : TRACE_MAX_ARGS;
+  for (size_t i = 0; i < span.arg_count; i++) {
+    span.arg_names[i] = arg_names[i];
+    span.arg_values[i] = arg_values[i];
+  }
+  buffer->count.store(index + 1, std::memory_order_release);
+}
+
+// Write `value` as a JSON string literal.
+static void write_json_string(ostream &out, const string &value)
+{
+  out << '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+// Write a timestamp or duration in nanoseconds as the fractional microseconds expected by the trace event format.
+static void write_microseconds(ostream &out, uint64_t ns)
+{
+  out << (ns / 1000) << '.' << std::setw(3) << std::setfill('0') << (ns % 1000);
+}
+
+Result<TraceSummary> trace_stop(const string &path)
+{
+  uv_once(&init_once, &init);
+
+  tracing.store(false, std::memory_order_release);
+  uint64_t session = current_session.load(std::memory_order_acquire);
+  int pid = static_cast<int>(uv_os_getpid());
+
+  ofstream out(path, std::ios::out | std::ios::trunc);
+  TraceSummary summary;
+
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  {
+    Lock lock(registry_mutex);
+    for (unique_ptr<TraceBuffer> &buffer : registry) {
+      if (first) {
+        first = false;
+      } else {
+        out << ",";
+      }
+      out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+          << ",\"args\":{\"name\":";
+      write_json_string(out, buffer->thread_name);
+      out << "}}";
+
+      if (buffer->session.load(std::memory_order_acquire) != session || !buffer->spans) continue;
+
+      size_t count = buffer->count.load(std::memory_order_acquire);
+      for (size_t i = 0; i < count; i++) {
+        const TraceSpan &span = buffer->spans[i];
+        out << ",\n{\"name\":\"" << span.name << "\",\"cat\":\"watcher\",\"ph\":\"X\",\"pid\":" << pid
+            << ",\"tid\":" << buffer->tid << ",\"ts\":";
+        write_microseconds(out, span.start);
+        out << ",\"dur\":";
+        write_microseconds(out, span.duration);
+        out << ",\"args\":{";
+        for (size_t a = 0; a < span.arg_count; a++) {
+          if (a > 0) out << ",";
+          out << "\"" << span.arg_names[a] << "\":" << span.arg_values[a];
+        }
+        out << "}}";
+      }
+
+      summary.span_count += count;
+      summary.dropped_count += buffer->dropped.load(std::memory_order_relaxed);
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedSpans\":" << summary.dropped_count << "}}" << endl;
+  out.close();
+
+  if (out.fail()) {
+    string msg("Unable to write trace to ");
+    msg += path;
+    return Result<TraceSummary>::make_error(std::move(msg));
+  }
+
+  return ok_result(std::move(summary));
+}
@@ -0,0 +1,86 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <uv.h>
+
+#include "result.h"
+
+// Maximum number of spans retained by each thread during a single trace session. Spans recorded by a thread after its
+// buffer has filled are counted and discarded.
+const size_t TRACE_BUFFER_CAPACITY = 1u << 16;
+
+// Maximum number of numeric arguments attached to a single span.
+const size_t TRACE_MAX_ARGS = 3;
+
+// Counts reported when a trace session is written out.
+struct TraceSummary
+{
+  size_t span_count{0};
+  size_t dropped_count{0};
+};
+
+// Begin a trace session. Spans recorded by any thread from now until `trace_stop()` are retained, and any spans from
+// a prior session are discarded.
+void trace_start();
+
+// End the current trace session and write every retained span to `path` in the Chrome trace event JSON format. Span
+// timestamps are read from the same monotonic clock as Node's own trace events, so the two can be loaded together in
+// chrome://tracing or Perfetto.
+Result<TraceSummary> trace_stop(const std::string &path);
+
+bool is_tracing();
+
+// Label the calling thread's spans with `name` in exported traces.
+void trace_thread_name(const std::string &name);
+
+// Retain a completed span on the calling thread. `name` and each argument name must be string literals.
+void trace_record(const char *name,
+  uint64_t start,
+  uint64_t duration,
+  const char *const *arg_names,
+  const uint64_t *arg_values,
+  size_t arg_count);
+
+// Record the lifetime of this instance as a span named `name` on the current thread. Costs a single relaxed atomic
+// load while tracing is disabled.
+class TraceScope
+{
+public:
+  explicit TraceScope(const char *name) : name{name}, start{is_tracing() ? uv_hrtime() : 0}, arg_count{0}
+  {
+    //
+  }
+
+  ~TraceScope()
+  {
+    if (start != 0) trace_record(name, start, uv_hrtime() - start, arg_names, arg_values, arg_count);
+  }
+
+  // Attach a numeric argument to the span, such as the number of events it processed. Arguments beyond
+  // `TRACE_MAX_ARGS` are ignored.
+  void arg(const char *arg_name, uint64_t value)
+  {
+    if (start == 0 || arg_count >= TRACE_MAX_ARGS) return;
+
+    arg_names[arg_count] = arg_name;
+    arg_values[arg_count] = value;
+    arg_count++;
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope(TraceScope &&) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+  TraceScope &operator=(TraceScope &&) = delete;
+
+private:
+  const char *name;
+  uint64_t start;
+
+  const char *arg_names[TRACE_MAX_ARGS]{};
+  uint64_t arg_values[TRACE_MAX_ARGS]{};
+  size_t arg_count;
+};
+
+#endif
@@ -7,13 +7,14 @@
 
 #include "../../message.h"
 #include "../../message_buffer.h"
+#include "../../probes.h"
 #include "cookie_jar.h"
 
 using std::move;
 using std::string;
 using std::unique_ptr;
 
-Cookie::Cookie(ChannelID channel_id, std::string &&from_path, EntryKind kind) noexcept :
+Cookie::Cookie(ChannelID channel_id, std::string &&from_path, EntryKind kind) :
   channel_id{channel_id},
   from_path(move(from_path)),
   kind{kind}
@@ -64,6 +65,7 @@ void CookieBatch::flush(MessageBuffer &messages)
 {
   for (auto &pair : from_paths) {
     Cookie dup(move(pair.second));
+    WATCHER_PROBE2(rename_expired, dup.get_channel_id(), dup.get_from_path().c_str());
     messages.deleted(dup.get_channel_id(), dup.get_from_path(), dup.get_kind());
   }
   from_paths.clear();
@@ -120,6 +122,7 @@ void CookieJar::moved_to(MessageBuffer &messages,
     return;
   }
 
+  WATCHER_PROBE3(rename_matched, channel_id, from->get_from_path().c_str(), new_path.c_str());
   messages.renamed(channel_id, from->get_from_path(), move(new_path), kind);
 }
 
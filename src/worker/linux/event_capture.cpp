@@ -0,0 +1,325 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <uv.h>
+#include <vector>
+
+#include "../../log.h"
+#include "../../message.h"
+#include "../../message_buffer.h"
+#include "../../result.h"
+#include "cookie_jar.h"
+#include "event_capture.h"
+#include "side_effect.h"
+#include "watch_registry.h"
+
+using std::endl;
+using std::ifstream;
+using std::move;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+// Round a payload length up to the alignment maintained between records.
+static size_t padded(size_t length)
+{
+  return (length + 7) & ~static_cast<size_t>(7);
+}
+
+static void put_u32(vector<char> &payload, uint32_t value)
+{
+  const char *bytes = reinterpret_cast<const char *>(&value);
+  payload.insert(payload.end(), bytes, bytes + sizeof(value));
+}
+
+static void put_string(vector<char> &payload, const string &value)
+{
+  put_u32(payload, static_cast<uint32_t>(value.size()));
+  payload.insert(payload.end(), value.begin(), value.end());
+}
+
+// Read the numbers and strings of a record's payload in order. Every read fails once the payload is exhausted.
+class PayloadReader
+{
+public:
+  PayloadReader(const vector<char> &payload) : payload{payload}, offset{0}
+  {
+    //
+  }
+
+  bool get_u32(uint32_t &value)
+  {
+    if (payload.size() - offset < sizeof(value)) return false;
+    memcpy(&value, payload.data() + offset, sizeof(value));
+    offset += sizeof(value);
+    return true;
+  }
+
+  bool get_string(string &value)
+  {
+    uint32_t length = 0;
+    if (!get_u32(length) || payload.size() - offset < length) return false;
+    value.assign(payload.data() + offset, length);
+    offset += length;
+    return true;
+  }
+
+  bool get_strings(vector<string> &values)
+  {
+    uint32_t count = 0;
+    if (!get_u32(count)) return false;
+    for (uint32_t i = 0; i < count; i++) {
+      values.emplace_back();
+      if (!get_string(values.back())) return false;
+    }
+    return true;
+  }
+
+private:
+  const vector<char> &payload;
+  size_t offset;
+};
+
+// Decode the payload of a `CAPTURE_WATCH` record. Return false if it's malformed.
+static bool decode_watch(const vector<char> &payload, string &path, CapturedChannel &channel)
+{
+  PayloadReader reader(payload);
+  uint32_t actions = 0, respect_ignore_files = 0, max_depth = 0, expansion_count = 0;
+  if (!reader.get_string(path) || !reader.get_u32(actions) || !reader.get_string(channel.root)
+    || !reader.get_u32(respect_ignore_files) || !reader.get_u32(max_depth) || !reader.get_strings(channel.exclude)
+    || !reader.get_strings(channel.files) || !reader.get_u32(expansion_count)) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < expansion_count; i++) {
+    string dir;
+    uint32_t depth = 0;
+    if (!reader.get_string(dir) || !reader.get_u32(depth)) return false;
+    channel.expansions[dir] = depth;
+  }
+
+  channel.actions = actions;
+  channel.respect_ignore_files = respect_ignore_files != 0;
+  channel.max_depth = max_depth == UINT32_MAX ? UNLIMITED_DEPTH : max_depth;
+  return true;
+}
+
+Result<> EventCapture::start(const string &capture_path)
+{
+  stop();
+
+  out.open(capture_path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out) {
+    return error_result("Unable to open capture file " + capture_path);
+  }
+
+  out.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+  out.write(reinterpret_cast<const char *>(&CAPTURE_VERSION), sizeof(CAPTURE_VERSION));
+
+  path = capture_path;
+  active = true;
+  started_at = uv_hrtime();
+
+  LOGGER << "Capturing inotify events to " << path << "." << endl;
+  return ok_result();
+}
+
+void EventCapture::stop()
+{
+  if (!active) return;
+
+  out.close();
+  active = false;
+
+  LOGGER << "Finished capturing inotify events to " << path << "." << endl;
+}
+
+void EventCapture::watched(int wd,
+  ChannelID channel_id,
+  const string &path,
+  bool recursive,
+  const CapturedChannel &channel)
+{
+  if (!active) return;
+
+  vector<char> payload;
+  put_string(payload, path);
+  put_u32(payload, static_cast<uint32_t>(channel.actions));
+  put_string(payload, channel.root);
+  put_u32(payload, channel.respect_ignore_files ? 1 : 0);
+  put_u32(payload, channel.max_depth == UNLIMITED_DEPTH ? UINT32_MAX : static_cast<uint32_t>(channel.max_depth));
+  put_u32(payload, static_cast<uint32_t>(channel.exclude.size()));
+  for (const string &pattern : channel.exclude) {
+    put_string(payload, pattern);
+  }
+  put_u32(payload, static_cast<uint32_t>(channel.files.size()));
+  for (const string &file : channel.files) {
+    put_string(payload, file);
+  }
+  put_u32(payload, static_cast<uint32_t>(channel.expansions.size()));
+  for (const auto &expansion : channel.expansions) {
+    put_string(payload, expansion.first);
+    put_u32(payload, static_cast<uint32_t>(expansion.second));
+  }
+
+  write_record(CAPTURE_WATCH, wd, channel_id, recursive, payload.data(), payload.size());
+}
+
+void EventCapture::unwatched(ChannelID channel_id)
+{
+  write_record(CAPTURE_UNWATCH, 0, channel_id, false, nullptr, 0);
+}
+
+void EventCapture::events(const char *buf, size_t length)
+{
+  write_record(CAPTURE_EVENTS, 0, NULL_CHANNEL_ID, false, buf, length);
+}
+
+void EventCapture::cycle()
+{
+  write_record(CAPTURE_CYCLE, 0, NULL_CHANNEL_ID, false, nullptr, 0);
+  if (active) out.flush();
+}
+
+void EventCapture::write_record(CaptureRecordType type,
+  int wd,
+  ChannelID channel_id,
+  bool recursive,
+  const char *payload,
+  size_t length)
+{
+  if (!active) return;
+
+  CaptureRecordHeader header{};
+  header.type = type;
+  header.recursive = recursive ? 1 : 0;
+  header.wd = wd;
+  header.timestamp = uv_hrtime() - started_at;
+  header.channel_id = channel_id;
+  header.length = static_cast<uint32_t>(length);
+
+  static const char zeroes[8] = {0};
+
+  out.write(reinterpret_cast<const char *>(&header), sizeof(CaptureRecordHeader));
+  if (length > 0) out.write(payload, static_cast<std::streamsize>(length));
+  out.write(zeroes, static_cast<std::streamsize>(padded(length) - length));
+
+  if (!out) {
+    LOGGER << "Unable to write to capture file " << path << ". Capture stopped." << endl;
+    stop();
+  }
+}
+
+EventReplay::EventReplay(const string &capture_path) : Errable("inotify event replay")
+{
+  ifstream in(capture_path, std::ios::in | std::ios::binary);
+  if (!in) {
+    report_error("Unable to open capture file " + capture_path);
+    return;
+  }
+
+  char magic[sizeof(CAPTURE_MAGIC)] = {0};
+  uint32_t version = 0;
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char *>(&version), sizeof(version));
+  if (!in || memcmp(magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0) {
+    report_error(capture_path + " is not an inotify capture file");
+    return;
+  }
+  if (version != CAPTURE_VERSION) {
+    report_error("Unsupported capture file version " + std::to_string(version) + " in " + capture_path);
+    return;
+  }
+
+  CaptureRecordHeader header{};
+  while (in.read(reinterpret_cast<char *>(&header), sizeof(CaptureRecordHeader))) {
+    records.emplace_back();
+    Record &record = records.back();
+    record.header = header;
+
+    size_t stored = padded(header.length);
+    record.payload.resize(stored);
+    if (stored > 0 && !in.read(record.payload.data(), static_cast<std::streamsize>(stored))) {
+      // A capture that was cut short by a crash ends with a partial record. Keep everything before it.
+      LOGGER << "Capture file " << capture_path << " ends with a truncated record." << endl;
+      records.pop_back();
+      break;
+    }
+    record.payload.resize(header.length);
+  }
+
+  LOGGER << "Loaded " << plural(static_cast<long>(records.size()), "record") << " from " << capture_path << "."
+         << endl;
+}
+
+Result<ReplayStats> EventReplay::run(bool real_time, const Sink &sink)
+{
+  if (!is_healthy()) return health_err_result<ReplayStats>();
+
+  ReplayStats stats;
+  WatchRegistry registry;
+  CookieJar jar;
+  unique_ptr<MessageBuffer> messages(new MessageBuffer());
+
+  uint64_t start = uv_hrtime();
+
+  for (Record &record : records) {
+    const CaptureRecordHeader &header = record.header;
+
+    if (real_time) {
+      uint64_t elapsed = uv_hrtime() - start;
+      if (header.timestamp > elapsed) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(header.timestamp - elapsed));
+      }
+    }
+
+    switch (header.type) {
+      case CAPTURE_WATCH: {
+        string path;
+        CapturedChannel channel;
+        if (!decode_watch(record.payload, path, channel)) {
+          LOGGER << "Skipping malformed watch record for descriptor " << header.wd << "." << endl;
+          break;
+        }
+        ChannelID channel_id = static_cast<ChannelID>(header.channel_id);
+        registry.adopt(header.wd, channel_id, move(path), header.recursive != 0, channel);
+        stats.watches++;
+        break;
+      }
+      case CAPTURE_UNWATCH: registry.disown(static_cast<ChannelID>(header.channel_id)); break;
+      case CAPTURE_EVENTS: {
+        // Subdirectories created during the capture were watched by records of their own, so side effects are
+        // collected and discarded.
+        SideEffect side;
+        stats.batches++;
+        stats.events += registry.interpret(*messages, jar, side, record.payload.data(), record.payload.size());
+        break;
+      }
+      case CAPTURE_CYCLE:
+        jar.flush_oldest_batch(*messages);
+        registry.settle(*messages);
+        stats.cycles++;
+        stats.messages += messages->size();
+        if (sink) sink(*messages);
+        messages.reset(new MessageBuffer());
+        break;
+      default: LOGGER << "Skipping capture record with unknown type " << static_cast<int>(header.type) << "." << endl;
+    }
+  }
+
+  // Expire any renames left unpaired at the end of the capture.
+  jar.flush_oldest_batch(*messages);
+  jar.flush_oldest_batch(*messages);
+  registry.settle(*messages);
+  if (!messages->empty()) {
+    stats.messages += messages->size();
+    if (sink) sink(*messages);
+  }
+
+  stats.elapsed_ns = uv_hrtime() - start;
+  return ok_result(std::move(stats));
+}
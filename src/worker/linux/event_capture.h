@@ -0,0 +1,169 @@
+#ifndef EVENT_CAPTURE_H
+#define EVENT_CAPTURE_H
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../../errable.h"
+#include "../../message.h"
+#include "../../message_buffer.h"
+#include "../../result.h"
+
+// Capture files begin with these four bytes, followed by a `uint32_t` format version.
+const char CAPTURE_MAGIC[4] = {'W', 'C', 'A', 'P'};
+
+const uint32_t CAPTURE_VERSION = 2;
+
+// Kinds of record stored within a capture file.
+enum CaptureRecordType : uint8_t
+{
+  // A watch descriptor was assigned to a directory. The payload is the directory's path followed by the filters of its
+  // channel, encoded as described by `CapturedChannel`.
+  CAPTURE_WATCH = 1,
+
+  // Every watch descriptor belonging to a channel was removed. No payload.
+  CAPTURE_UNWATCH = 2,
+
+  // A single read() from the inotify descriptor. The payload is the raw sequence of `inotify_event` structs returned.
+  CAPTURE_EVENTS = 3,
+
+  // The inotify descriptor had no further events to read, ending a notification cycle. No payload.
+  CAPTURE_CYCLE = 4
+};
+
+// Fixed-size header that precedes each record's payload. Payloads are padded to a multiple of eight bytes so that
+// every header, and every captured `inotify_event`, remains aligned.
+struct CaptureRecordHeader
+{
+  uint8_t type;
+  uint8_t recursive;
+  uint16_t reserved;
+  int32_t wd;
+
+  // Nanoseconds since the capture began.
+  uint64_t timestamp;
+
+  uint64_t channel_id;
+
+  // Length of the payload in bytes, excluding padding.
+  uint32_t length;
+  uint32_t padding;
+};
+
+// The options of a channel that decide which of its directories' events are reported, as recorded with each directory
+// it watches so that a replay discards the same events as the live worker did. Within a payload, every number is a
+// `uint32_t` and every string is its length followed by its bytes: the actions, the root, whether ignore files are
+// respected, the depth limit or `UINT32_MAX`, then the counts and contents of the exclusions, the file set's paths,
+// and the depth limit's expansions as pairs of a directory and its depth.
+struct CapturedChannel
+{
+  ActionMask actions{ACTIONS_ALL};
+
+  // Root against which exclusions, ignore files and the depth limit are evaluated.
+  std::string root;
+
+  bool respect_ignore_files{false};
+  uint_fast32_t max_depth{UNLIMITED_DEPTH};
+  std::vector<std::string> exclude;
+  std::vector<std::string> files;
+  std::map<std::string, uint_fast32_t> expansions;
+};
+
+// Record the raw inotify stream consumed by a `WatchRegistry`, along with the watch descriptor assignments needed to
+// interpret it, to a compact binary file. Captures can be replayed later by an `EventReplay` without a live filesystem.
+class EventCapture
+{
+public:
+  EventCapture() = default;
+
+  ~EventCapture() { stop(); }
+
+  // Begin writing a new capture to `capture_path`, truncating it if it already exists.
+  Result<> start(const std::string &capture_path);
+
+  // Finish the current capture, if any, and close its file.
+  void stop();
+
+  bool is_active() const { return active; }
+
+  void watched(int wd, ChannelID channel_id, const std::string &path, bool recursive, const CapturedChannel &channel);
+
+  void unwatched(ChannelID channel_id);
+
+  void events(const char *buf, size_t length);
+
+  // Mark the end of a notification cycle and flush the records written so far, so that a capture remains useful if
+  // the process exits unexpectedly.
+  void cycle();
+
+  EventCapture(const EventCapture &) = delete;
+  EventCapture(EventCapture &&) = delete;
+  EventCapture &operator=(const EventCapture &) = delete;
+  EventCapture &operator=(EventCapture &&) = delete;
+
+private:
+  void write_record(CaptureRecordType type,
+    int wd,
+    ChannelID channel_id,
+    bool recursive,
+    const char *payload,
+    size_t length);
+
+  std::ofstream out;
+  std::string path;
+  bool active{false};
+  uint64_t started_at{0};
+};
+
+// Totals accumulated by a single `EventReplay::run()`.
+struct ReplayStats
+{
+  uint64_t cycles{0};
+  uint64_t batches{0};
+  uint64_t events{0};
+  uint64_t messages{0};
+  uint64_t watches{0};
+  uint64_t elapsed_ns{0};
+};
+
+// Load a capture file written by an `EventCapture` and feed it through the same `WatchedDirectory`, `CookieJar` and
+// `SideEffect` logic used by the worker thread, without making any inotify calls. Watch descriptors and the filters of
+// their channels are re-created from the capture's own records, so side effects that would have added watches are not
+// enacted. Ignore rules are the exception: they're read from the ignore files present when the capture is replayed.
+class EventReplay : public Errable
+{
+public:
+  // Read every record from `capture_path`. Enter an error state if it can't be read or isn't a capture.
+  explicit EventReplay(const std::string &capture_path);
+
+  ~EventReplay() override = default;
+
+  // Called with the messages produced by each notification cycle.
+  using Sink = std::function<void(MessageBuffer &)>;
+
+  // Interpret every record in order. If `real_time` is `true`, sleep between records to reproduce the timing of the
+  // original capture; otherwise, run as quickly as possible.
+  Result<ReplayStats> run(bool real_time, const Sink &sink);
+
+  size_t get_record_count() const { return records.size(); }
+
+  EventReplay(const EventReplay &) = delete;
+  EventReplay(EventReplay &&) = delete;
+  EventReplay &operator=(const EventReplay &) = delete;
+  EventReplay &operator=(EventReplay &&) = delete;
+
+private:
+  struct Record
+  {
+    CaptureRecordHeader header;
+    std::vector<char> payload;
+  };
+
+  std::vector<Record> records;
+};
+
+#endif
@@ -3,18 +3,24 @@
 #include <string>
 #include <vector>
 
+#include "../../depth_limit.h"
+#include "../../file_set.h"
 #include "../../helper/linux/helper.h"
+#include "../../ignore_rules.h"
 #include "../../log.h"
 #include "../../message.h"
 #include "../../result.h"
+#include "../../trace.h"
 #include "../worker_platform.h"
 #include "../worker_thread.h"
 #include "cookie_jar.h"
+#include "event_capture.h"
 #include "pipe.h"
 #include "side_effect.h"
 #include "watch_registry.h"
 
 using std::endl;
+using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 using std::vector;
@@ -53,6 +59,8 @@ public:
         return error_result("Unexpected poll() timeout");
       }
 
+      TraceScope wakeup_trace("worker wakeup");
+
       if ((to_poll[0].revents & (POLLIN | POLLERR)) != 0u) {
         Result<> cr = pipe.consume();
         if (cr.is_error()) return cr;
@@ -65,10 +73,12 @@ public:
         MessageBuffer messages;
         SideEffect side;
 
+        TraceScope consume_trace("consume");
         Result<> cr = registry.consume(messages, jar, side);
         if (cr.is_error()) LOGGER << cr << endl;
 
-        side.enact_in(&registry, messages);
+        side.enact_in(&registry, get_bursts(), messages);
+        consume_trace.arg("events", messages.size());
 
         if (!messages.empty()) {
           Result<> er = emit_all(messages.begin(), messages.end());
@@ -84,11 +94,36 @@ public:
   Result<bool> handle_add_command(CommandID /*command*/,
     ChannelID channel,
     const string &root_path,
-    bool recursive) override
+    bool recursive,
+    const shared_ptr<const GlobSet> &exclude,
+    bool respect_ignore_files,
+    ActionMask actions,
+    const shared_ptr<const FileSet> &files,
+    uint_fast32_t max_depth) override
   {
     vector<string> poll;
-
-    Result<> r = registry.add(channel, string(root_path), recursive, poll);
+    shared_ptr<IgnoreRules> ignore_rules;
+    if (respect_ignore_files) ignore_rules.reset(new IgnoreRules(root_path));
+
+    TraceScope crawl_trace("crawl");
+    size_t watches_before = registry.get_watch_count();
+    registry.set_actions(channel, actions);
+    if (recursive && !files && max_depth != UNLIMITED_DEPTH) {
+      registry.set_depth_limit(channel, shared_ptr<DepthLimit>(new DepthLimit(root_path, max_depth)));
+    }
+    Result<> r = ok_result();
+    if (files) {
+      // Watch each directory that holds a member of the file set on its own, without recursing.
+      registry.set_files(channel, files);
+      for (auto &directory : files->get_directories()) {
+        r = registry.add(channel, string(directory.first), false, exclude, ignore_rules, poll);
+        if (r.is_error()) break;
+      }
+    } else {
+      r = registry.add_root(channel, string(root_path), recursive, exclude, ignore_rules, poll);
+    }
+    crawl_trace.arg("channel", channel);
+    crawl_trace.arg("directories", registry.get_watch_count() - watches_before);
     if (r.is_error()) return r.propagate<bool>();
 
     if (!poll.empty()) {
@@ -96,8 +131,17 @@ public:
       poll_messages.reserve(poll.size());
 
       for (string &poll_root : poll) {
-        poll_messages.emplace_back(
-          CommandPayloadBuilder::add(channel, move(poll_root), recursive, poll.size()).build());
+        shared_ptr<const FileSet> poll_files = files ? files->subset(poll_root) : nullptr;
+        bool poll_recursive = files ? false : recursive;
+        uint_fast32_t poll_depth = registry.get_max_depth(channel, poll_root);
+        poll_messages.emplace_back(CommandPayloadBuilder::add(channel, move(poll_root), poll_recursive, poll.size())
+                                     .set_exclude(exclude)
+                                     .set_respect_ignore_files(respect_ignore_files)
+                                     .set_actions(actions)
+                                     .set_files(poll_files)
+                                     .set_max_depth(poll_depth)
+                                     .set_burst_threshold(get_bursts().get_threshold(channel))
+                                     .build());
       }
 
       return emit_all(poll_messages.begin(), poll_messages.end()).propagate(false);
@@ -112,6 +156,47 @@ public:
     return registry.remove(channel).propagate(true);
   }
 
+  // Watch more of a depth-limited tree.
+  Result<bool> handle_expand_command(CommandID /*command*/,
+    ChannelID channel,
+    const string &dir,
+    uint_fast32_t depth) override
+  {
+    vector<string> poll;
+    Result<> r = registry.expand(channel, dir, depth, poll);
+    if (r.is_error()) return r.propagate<bool>();
+    if (poll.empty()) return ok_result(true);
+
+    // The expansion is acknowledged right away. Directories beyond the inotify watch limit are polled from now on.
+    shared_ptr<WatchedDirectory> sample = registry.find_directory(channel);
+    vector<Message> poll_messages;
+    poll_messages.reserve(poll.size());
+    for (string &poll_root : poll) {
+      uint_fast32_t poll_depth = registry.get_max_depth(channel, poll_root);
+      poll_messages.emplace_back(CommandPayloadBuilder::add(channel, move(poll_root), true, 1)
+                                   .set_exclude(sample ? sample->get_exclude() : nullptr)
+                                   .set_respect_ignore_files(sample && sample->get_ignore_rules() != nullptr)
+                                   .set_actions(registry.get_actions(channel))
+                                   .set_max_depth(poll_depth)
+                                   .set_burst_threshold(get_bursts().get_threshold(channel))
+                                   .build());
+    }
+    return emit_all(poll_messages.begin(), poll_messages.end()).propagate(true);
+  }
+
+  // Stop watching an expanded part of a depth-limited tree.
+  Result<bool> handle_collapse_command(CommandID /*command*/, ChannelID channel, const string &dir) override
+  {
+    return registry.collapse(channel, dir).propagate(true);
+  }
+
+  // Begin or end an inotify event capture.
+  Result<> handle_capture_command(const string &capture_path) override { return registry.capture_to(capture_path); }
+
+  void collect_status(Status &status) override { registry.collect_status(status); }
+
+  void reset_status() override { registry.reset_status(); }
+
 private:
   Pipe pipe;
   WatchRegistry registry;
@@ -122,3 +207,11 @@ unique_ptr<WorkerPlatform> WorkerPlatform::for_worker(WorkerThread *thread)
 {
   return unique_ptr<WorkerPlatform>(new LinuxWorkerPlatform(thread));
 }
+
+Result<> WorkerPlatform::replay_capture(const string &capture_path, const std::function<void(MessageBuffer &)> &sink)
+{
+  EventReplay replay(capture_path);
+  if (!replay.is_healthy()) return replay.health_err_result();
+
+  return replay.run(false, sink).propagate_as_void();
+}
@@ -1,31 +1,80 @@
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "../../burst_collapser.h"
+#include "../../ignore_rules.h"
+#include "../../log.h"
 #include "../../message.h"
 #include "../../message_buffer.h"
 #include "../../result.h"
 #include "side_effect.h"
 #include "watch_registry.h"
 
+using std::endl;
 using std::move;
+using std::shared_ptr;
 using std::string;
 using std::vector;
 
-void SideEffect::track_subdirectory(string subdir, ChannelID channel_id)
+void SideEffect::track_subdirectory(string subdir,
+  ChannelID channel_id,
+  const shared_ptr<const GlobSet> &exclude,
+  const shared_ptr<IgnoreRules> &ignore_rules)
 {
-  subdirectories.emplace_back(move(subdir), channel_id);
+  subdirectories.emplace_back(move(subdir), channel_id, exclude, ignore_rules);
 }
 
-void SideEffect::enact_in(WatchRegistry *registry, MessageBuffer &messages)
+void SideEffect::reload_ignore_rules(const string &dir,
+  ChannelID channel_id,
+  bool recursive,
+  const shared_ptr<const GlobSet> &exclude,
+  const shared_ptr<IgnoreRules> &ignore_rules)
+{
+  // Writing an ignore file usually produces several events in a row.
+  for (IgnoreReload &reload : ignore_reloads) {
+    if (reload.channel_id == channel_id && reload.dir == dir) return;
+  }
+  ignore_reloads.push_back(IgnoreReload{dir, channel_id, recursive, exclude, ignore_rules});
+}
+
+void SideEffect::enact_in(WatchRegistry *registry, const BurstCollapser &bursts, MessageBuffer &messages)
 {
   for (Subdirectory &subdir : subdirectories) {
     vector<string> poll_roots;
-    Result<> r = registry->add(subdir.channel_id, subdir.path, true, poll_roots);
+    Result<> r = registry->add(subdir.channel_id, subdir.path, true, subdir.exclude, subdir.ignore_rules, poll_roots);
     if (r.is_error()) messages.error(subdir.channel_id, string(r.get_error()), false);
 
     for (string &poll_root : poll_roots) {
-      messages.add(Message(CommandPayloadBuilder::add(subdir.channel_id, move(poll_root), true, 1).build()));
+      messages.add(Message(
+        CommandPayloadBuilder::add(subdir.channel_id, move(poll_root), true, 1)
+          .set_exclude(subdir.exclude)
+          .set_respect_ignore_files(subdir.ignore_rules != nullptr)
+          .set_actions(registry->get_actions(subdir.channel_id))
+          .set_burst_threshold(bursts.get_threshold(subdir.channel_id))
+          .build()));
+    }
+  }
+
+  // Re-evaluate ignore files after new subdirectories are watched, so that a subdirectory created alongside an edit
+  // to an ignore file isn't watched twice.
+  for (IgnoreReload &reload : ignore_reloads) {
+    if (!reload.ignore_rules->reload(reload.dir) || !reload.recursive) continue;
+
+    LOGGER << "Ignore rules within " << reload.dir << " have changed." << endl;
+
+    vector<string> poll_roots;
+    Result<> r = registry->rescan(reload.channel_id, reload.dir, reload.exclude, reload.ignore_rules, poll_roots);
+    if (r.is_error()) messages.error(reload.channel_id, string(r.get_error()), false);
+
+    for (string &poll_root : poll_roots) {
+      messages.add(Message(CommandPayloadBuilder::add(reload.channel_id, move(poll_root), true, 1)
+                             .set_exclude(reload.exclude)
+                             .set_respect_ignore_files(true)
+                             .set_actions(registry->get_actions(reload.channel_id))
+                             .set_burst_threshold(bursts.get_threshold(reload.channel_id))
+                             .build()));
     }
   }
 }
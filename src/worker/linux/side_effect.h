@@ -1,6 +1,7 @@
 #ifndef SIDE_EFFECT_H
 #define SIDE_EFFECT_H
 
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -9,6 +10,8 @@
 #include "../../result.h"
 
 // Forward declaration for pointer access.
+class BurstCollapser;
+class IgnoreRules;
 class WatchRegistry;
 
 class MessageBuffer;
@@ -21,11 +24,23 @@ public:
   SideEffect() = default;
   ~SideEffect() = default;
 
-  // Recursively watch a newly created subdirectory.
-  void track_subdirectory(std::string subdir, ChannelID channel_id);
+  // Recursively watch a newly created subdirectory, skipping any of its descendants matched by `exclude` or ignored by
+  // `ignore_rules`.
+  void track_subdirectory(std::string subdir,
+    ChannelID channel_id,
+    const std::shared_ptr<const GlobSet> &exclude,
+    const std::shared_ptr<IgnoreRules> &ignore_rules);
 
-  // Perform all enqueued actions.
-  void enact_in(WatchRegistry *registry, MessageBuffer &messages);
+  // Re-read the ignore files within `dir` after one has changed. If its rules have changed and the watch is recursive,
+  // stop watching the subdirectories they now ignore and begin watching those they no longer do.
+  void reload_ignore_rules(const std::string &dir,
+    ChannelID channel_id,
+    bool recursive,
+    const std::shared_ptr<const GlobSet> &exclude,
+    const std::shared_ptr<IgnoreRules> &ignore_rules);
+
+  // Perform all enqueued actions. Directories that fall back to polling keep the burst thresholds in `bursts`.
+  void enact_in(WatchRegistry *registry, const BurstCollapser &bursts, MessageBuffer &messages);
 
   SideEffect(const SideEffect &other) = delete;
   SideEffect(SideEffect &&other) = delete;
@@ -35,16 +50,36 @@ public:
 private:
   struct Subdirectory
   {
-    Subdirectory(std::string &&path, ChannelID channel_id) : path(std::move(path)), channel_id{channel_id}
+    Subdirectory(std::string &&path,
+      ChannelID channel_id,
+      const std::shared_ptr<const GlobSet> &exclude,
+      const std::shared_ptr<IgnoreRules> &ignore_rules) :
+      path(std::move(path)),
+      channel_id{channel_id},
+      exclude(exclude),
+      ignore_rules(ignore_rules)
     {
       //
     }
 
     std::string path;
     ChannelID channel_id;
+    std::shared_ptr<const GlobSet> exclude;
+    std::shared_ptr<IgnoreRules> ignore_rules;
+  };
+
+  struct IgnoreReload
+  {
+    std::string dir;
+    ChannelID channel_id;
+    bool recursive;
+    std::shared_ptr<const GlobSet> exclude;
+    std::shared_ptr<IgnoreRules> ignore_rules;
   };
 
   std::vector<Subdirectory> subdirectories;
+
+  std::vector<IgnoreReload> ignore_reloads;
 };
 
 #endif
@@ -1,30 +1,43 @@
 #include <cerrno>
+#include <cstdint>
 #include <dirent.h>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <set>
 #include <string>
 #include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <unordered_map>
 #include <vector>
 
+#include "../../depth_limit.h"
+#include "../../file_set.h"
+#include "../../glob.h"
+#include "../../helper/common.h"
 #include "../../helper/linux/helper.h"
+#include "../../ignore_rules.h"
 #include "../../log.h"
 #include "../../message.h"
 #include "../../message_buffer.h"
+#include "../../probes.h"
 #include "../../result.h"
+#include "../../status.h"
 #include "cookie_jar.h"
 #include "side_effect.h"
 #include "watch_registry.h"
 #include "watched_directory.h"
 
 using std::endl;
+using std::move;
 using std::ostream;
 using std::set;
 using std::shared_ptr;
 using std::string;
+using std::unordered_map;
 using std::unordered_multimap;
 using std::vector;
 
@@ -58,7 +71,40 @@ static ostream &operator<<(ostream &out, const inotify_event *event)
   return out;
 }
 
-WatchRegistry::WatchRegistry() : Errable("inotify watcher registry")
+// Choose the inotify events to request for a directory on a channel that reports `actions`. Entries created, deleted
+// and renamed are always requested together so that renames are still paired, and a recursive watch needs creations
+// to follow new subdirectories even when it doesn't report them. Likewise, edits to ignore files must be seen when
+// `ignore_files` is true.
+static uint32_t inotify_mask(ActionMask actions, bool recursive, bool ignore_files)
+{
+  uint32_t mask = IN_DELETE_SELF | IN_MOVE_SELF | IN_DONT_FOLLOW | IN_EXCL_UNLINK | IN_ONLYDIR;
+
+  ActionMask structural = action_mask(ACTION_CREATED) | action_mask(ACTION_DELETED) | action_mask(ACTION_RENAMED);
+  if ((actions & structural) != 0) {
+    mask |= IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+  } else if (recursive) {
+    mask |= IN_CREATE | IN_MOVED_TO;
+  }
+
+  if ((actions & action_mask(ACTION_MODIFIED)) != 0) {
+    mask |= IN_MODIFY;
+    if ((actions & ACTIONS_ATTRIBUTES) != 0) mask |= IN_ATTRIB;
+  }
+
+  if (ignore_files) mask |= IN_CREATE | IN_MODIFY | IN_MOVED_TO;
+
+  return mask;
+}
+
+// Return true if `path` and `other` name the same directory, such as through a bind mount.
+static bool same_directory(const string &path, const string &other)
+{
+  struct stat path_stat, other_stat;
+  if (stat(path.c_str(), &path_stat) != 0 || stat(other.c_str(), &other_stat) != 0) return false;
+  return path_stat.st_dev == other_stat.st_dev && path_stat.st_ino == other_stat.st_ino;
+}
+
+WatchRegistry::WatchRegistry() : Errable("inotify watcher registry"), overflows{0}
 {
   inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
 
@@ -74,16 +120,25 @@ WatchRegistry::~WatchRegistry()
   }
 }
 
-Result<> WatchRegistry::add(ChannelID channel_id, const string &root, bool recursive, vector<string> &poll)
+Result<> WatchRegistry::add(ChannelID channel_id,
+  const string &root,
+  bool recursive,
+  const shared_ptr<const GlobSet> &exclude,
+  const shared_ptr<IgnoreRules> &ignore_rules,
+  vector<string> &poll)
 {
   if (!is_healthy()) return health_err_result<>();
 
-  uint32_t mask = IN_ATTRIB | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM
-    | IN_MOVED_TO | IN_DONT_FOLLOW | IN_EXCL_UNLINK | IN_ONLYDIR;
+  int_fast64_t levels = levels_below(channel_id, root);
+  if (levels < 0) {
+    LOGGER << "Directory [" << root << "] lies beyond the depth limit of channel " << channel_id << "." << endl;
+    return ok_result();
+  }
+
+  // Another channel may already watch this directory, so add to its mask rather than replacing it.
+  uint32_t mask = inotify_mask(get_actions(channel_id), recursive, ignore_rules != nullptr) | IN_MASK_ADD;
 
-  ostream &logline = LOGGER << "Watching path [" << root << "]";
-  if (!recursive) logline << " (non-recursively)";
-  logline << "." << endl;
+  LOGGER << "Watching path [" << root << "]" << (recursive ? "" : " (non-recursively)") << "." << endl;
 
   int wd = inotify_add_watch(inotify_fd, root.c_str(), mask);
   if (wd == -1) {
@@ -97,20 +152,41 @@ Result<> WatchRegistry::add(ChannelID channel_id, const string &root, bool recur
     if (watch_errno == ENOSPC) {
       LOGGER << "Falling back to polling for directory " << root << "." << endl;
       poll.push_back(root);
+      complete_roots.erase(channel_id);
       return ok_result();
     }
 
     return errno_result("Unable to watch directory", watch_errno);
   }
 
+  // inotify assigns one watch descriptor to each (device, inode) pair, so a descriptor that's already watched on this
+  // channel under a path that still leads to it is a directory that's been reached twice, like a bind mount within
+  // its own tree. Its events are already reported, and its subdirectories already watched. A directory that's moved
+  // within the tree keeps its descriptor as well, but no longer answers to its former path.
+  auto same_wd = by_wd.equal_range(wd);
+  for (auto it = same_wd.first; it != same_wd.second; ++it) {
+    const shared_ptr<WatchedDirectory> &existing = it->second;
+    if (existing->get_channel_id() != channel_id) continue;
+
+    const string &existing_path = existing->get_directory();
+    if (existing_path == root || same_directory(existing_path, root)) {
+      LOGGER << "Directory [" << root << "] is already watched as [" << existing_path << "] under watch descriptor "
+             << wd << "." << endl;
+      return ok_result();
+    }
+  }
+
   LOGGER << "Assigned watch descriptor " << wd << " at [" << root << "] on channel " << channel_id << "." << endl;
 
-  shared_ptr<WatchedDirectory> watched_dir(new WatchedDirectory(wd, channel_id, string(root), recursive));
+  shared_ptr<WatchedDirectory> watched_dir(
+    new WatchedDirectory(wd, channel_id, string(root), recursive, exclude, ignore_rules, files_for(channel_id)));
 
   by_wd.insert({wd, watched_dir});
   by_channel.insert({channel_id, watched_dir});
+  capture_watch(*watched_dir);
+  WATCHER_PROBE3(crawl_visit, channel_id, root.c_str(), wd);
 
-  if (recursive) {
+  if (recursive && levels > 0 && !share_crawl(channel_id, wd, root, exclude, ignore_rules)) {
     DIR *dir = opendir(root.c_str());
     if (dir == nullptr) {
       int open_errno = errno;
@@ -131,25 +207,35 @@ Result<> WatchRegistry::add(ChannelID channel_id, const string &root, bool recur
         subdir += "/";
         subdir += basename;
 
+        if (exclude && exclude->matches(subdir)) {
+          entry = readdir(dir);
+          continue;
+        }
+
 #ifdef _DIRENT_HAVE_D_TYPE
-        if (entry->d_type == DT_DIR || entry->d_type == DT_UNKNOWN) {
-          Result<> add_r = add(channel_id, subdir, recursive, poll);
+        if ((entry->d_type == DT_DIR || entry->d_type == DT_UNKNOWN)
+          && !(ignore_rules && ignore_rules->ignores(subdir, true))) {
+          Result<> add_r = add(channel_id, subdir, recursive, exclude, ignore_rules, poll);
           if (add_r.is_error()) {
             LOGGER << "Unable to recurse into " << subdir << ": " << add_r << "." << endl;
           }
         }
 #else
-        Result<> add_r = add(channel_id, subdir, recursive, poll);
-        if (add_r.is_error()) {
-          LOGGER << "Unable to recurse into " << subdir << ": " << add_r << "." << endl;
+        if (!(ignore_rules && ignore_rules->ignores(subdir, true))) {
+          Result<> add_r = add(channel_id, subdir, recursive, exclude, ignore_rules, poll);
+          if (add_r.is_error()) {
+            LOGGER << "Unable to recurse into " << subdir << ": " << add_r << "." << endl;
+          }
         }
 #endif
 
         errno = 0;
         entry = readdir(dir);
       }
-      if (errno != 0) {
-        return errno_result("Unable to iterate entries of directory " + root);
+      int read_errno = errno;
+      closedir(dir);
+      if (read_errno != 0) {
+        return errno_result("Unable to iterate entries of directory " + root, read_errno);
       }
     }
   }
@@ -157,12 +243,66 @@ Result<> WatchRegistry::add(ChannelID channel_id, const string &root, bool recur
   return ok_result();
 }
 
-Result<> WatchRegistry::remove(ChannelID channel_id)
+Result<> WatchRegistry::add_root(ChannelID channel_id,
+  const string &root,
+  bool recursive,
+  const shared_ptr<const GlobSet> &exclude,
+  const shared_ptr<IgnoreRules> &ignore_rules,
+  vector<string> &poll)
 {
-  using WatchedDirectoryPtr = shared_ptr<WatchedDirectory>;
-  using WDMap = unordered_multimap<int, WatchedDirectoryPtr>;
-  using WDIter = WDMap::iterator;
+  bool filtered = exclude != nullptr || ignore_rules != nullptr || files_for(channel_id) != nullptr
+    || channel_depths.count(channel_id) > 0;
+  if (recursive && !filtered) complete_roots[channel_id] = root;
+
+  Result<> r = add(channel_id, root, recursive, exclude, ignore_rules, poll);
+  if (r.is_error()) complete_roots.erase(channel_id);
+  return r;
+}
+
+Result<> WatchRegistry::rescan(ChannelID channel_id,
+  const string &dir,
+  const shared_ptr<const GlobSet> &exclude,
+  const shared_ptr<IgnoreRules> &ignore_rules,
+  vector<string> &poll)
+{
+  if (!is_healthy()) return health_err_result<>();
+
+  string prefix(dir + "/");
+  set<string> watched;
+  set<int> released;
+
+  auto its = by_channel.equal_range(channel_id);
+  auto it = its.first;
+  while (it != its.second) {
+    const string &path = it->second->get_directory();
+    if (path.compare(0, prefix.size(), prefix) != 0) {
+      ++it;
+      continue;
+    }
+
+    if (ignore_rules->ignores_within(path, true)) {
+      released.insert(it->second->get_descriptor());
+      it = by_channel.erase(it);
+      continue;
+    }
+
+    watched.insert(path);
+    ++it;
+  }
+
+  // Captures don't record released descriptors. The kernel doesn't reuse them promptly, so a replay only keeps a few
+  // idle entries around.
+  for (int wd : released) {
+    release(channel_id, wd);
+  }
 
+  LOGGER << "Released " << plural(released.size(), "watch descriptor") << " newly ignored beneath " << dir << "."
+         << endl;
+  return add_unwatched(channel_id, dir, exclude, ignore_rules, watched, poll);
+}
+
+Result<> WatchRegistry::remove(ChannelID channel_id)
+{
   if (!is_healthy()) return health_err_result<>();
 
   auto its = by_channel.equal_range(channel_id);
@@ -174,31 +314,405 @@ Result<> WatchRegistry::remove(ChannelID channel_id)
   LOGGER << "Stopping " << plural(wds.size(), "inotify watch descriptor") << "." << endl;
 
   by_channel.erase(channel_id);
+  capture.unwatched(channel_id);
   for (auto &wd : wds) {
-    auto wd_matches = by_wd.equal_range(wd);
+    release(channel_id, wd);
+  }
+  channel_actions.erase(channel_id);
+  channel_files.erase(channel_id);
+  channel_depths.erase(channel_id);
+  complete_roots.erase(channel_id);
 
-    vector<WDIter> to_erase;
-    for (auto each_wd = wd_matches.first; each_wd != wd_matches.second; ++each_wd) {
-      if (each_wd->second->get_channel_id() == channel_id) {
-        to_erase.push_back(each_wd);
+  LOGGER << "Channel " << channel_id << " has been unwatched." << endl;
+  return ok_result();
+}
+
+Result<> WatchRegistry::expand(ChannelID channel_id, const string &dir, uint_fast32_t depth, vector<string> &poll)
+{
+  if (!is_healthy()) return health_err_result<>();
+
+  auto limit = channel_depths.find(channel_id);
+  if (limit == channel_depths.end()) return ok_result();
+
+  shared_ptr<WatchedDirectory> sample = find_directory(channel_id);
+  if (!sample) return error_result("Channel " + std::to_string(channel_id) + " is not being watched");
+
+  limit->second->expand(dir, depth);
+  LOGGER << "Expanding [" << dir << "] on channel " << channel_id << " to " << *limit->second << "." << endl;
+
+  // Directories that were already watched don't need to be read again, but the deepest of them may have
+  // subdirectories that are now within reach.
+  set<string> watched;
+  auto its = by_channel.equal_range(channel_id);
+  for (auto it = its.first; it != its.second; ++it) {
+    const string &path = it->second->get_directory();
+    if (path_within(path, dir)) watched.insert(path);
+  }
+
+  if (watched.count(dir) == 0) {
+    return add(channel_id, dir, true, sample->get_exclude(), sample->get_ignore_rules(), poll);
+  }
+  return add_unwatched(channel_id, dir, sample->get_exclude(), sample->get_ignore_rules(), watched, poll);
+}
+
+Result<> WatchRegistry::collapse(ChannelID channel_id, const string &dir)
+{
+  if (!is_healthy()) return health_err_result<>();
+
+  auto limit = channel_depths.find(channel_id);
+  if (limit == channel_depths.end() || !limit->second->collapse(dir)) return ok_result();
+
+  set<int> released;
+  auto its = by_channel.equal_range(channel_id);
+  auto it = its.first;
+  while (it != its.second) {
+    if (limit->second->covers(it->second->get_directory())) {
+      ++it;
+      continue;
+    }
+
+    released.insert(it->second->get_descriptor());
+    it = by_channel.erase(it);
+  }
+
+  for (int wd : released) {
+    release(channel_id, wd);
+  }
+
+  LOGGER << "Released " << plural(released.size(), "watch descriptor") << " after collapsing [" << dir
+         << "] on channel " << channel_id << "." << endl;
+  return ok_result();
+}
+
+void WatchRegistry::release(ChannelID channel_id, int wd)
+{
+  using WatchedDirectoryPtr = shared_ptr<WatchedDirectory>;
+  using WDMap = unordered_multimap<int, WatchedDirectoryPtr>;
+  using WDIter = WDMap::iterator;
+
+  auto wd_matches = by_wd.equal_range(wd);
+
+  vector<WDIter> to_erase;
+  for (auto each_wd = wd_matches.first; each_wd != wd_matches.second; ++each_wd) {
+    if (each_wd->second->get_channel_id() == channel_id) {
+      to_erase.push_back(each_wd);
+    }
+  }
+  for (WDIter &it : to_erase) {
+    by_wd.erase(it);
+  }
+
+  auto remaining = by_wd.equal_range(wd);
+  if (remaining.first == remaining.second) {
+    int err = inotify_rm_watch(inotify_fd, wd);
+    if (err == -1) {
+      LOGGER << "Unable to remove watch descriptor " << wd << ": " << errno_result<>("") << "." << endl;
+    }
+    return;
+  }
+
+  // Without IN_MASK_ADD, the merged mask of the remaining channels replaces the current one.
+  uint32_t mask = 0;
+  for (auto it = remaining.first; it != remaining.second; ++it) {
+    const shared_ptr<WatchedDirectory> &watched = it->second;
+    mask |= inotify_mask(
+      get_actions(watched->get_channel_id()), watched->is_recursive(), watched->get_ignore_rules() != nullptr);
+  }
+  const string &path = remaining.first->second->get_directory();
+  int narrowed = inotify_add_watch(inotify_fd, path.c_str(), mask);
+  if (narrowed == -1) {
+    LOGGER << "Unable to narrow watch descriptor " << wd << ": " << errno_result<>("") << "." << endl;
+  } else if (narrowed != wd) {
+    // The directory has been replaced since it was watched. Its deletion will arrive on the original descriptor.
+    inotify_rm_watch(inotify_fd, narrowed);
+  }
+}
+
+void WatchRegistry::set_actions(ChannelID channel_id, ActionMask actions)
+{
+  if (actions == ACTIONS_ALL) {
+    channel_actions.erase(channel_id);
+  } else {
+    channel_actions[channel_id] = actions;
+  }
+}
+
+ActionMask WatchRegistry::get_actions(ChannelID channel_id) const
+{
+  auto found = channel_actions.find(channel_id);
+  return found == channel_actions.end() ? ACTIONS_ALL : found->second;
+}
+
+void WatchRegistry::set_files(ChannelID channel_id, const shared_ptr<const FileSet> &files)
+{
+  if (files) {
+    channel_files[channel_id] = files;
+  } else {
+    channel_files.erase(channel_id);
+  }
+}
+
+bool WatchRegistry::share_crawl(ChannelID channel_id,
+  int wd,
+  const string &dir,
+  const shared_ptr<const GlobSet> &exclude,
+  const shared_ptr<IgnoreRules> &ignore_rules)
+{
+  // Find a channel that watches everything beneath the same physical directory, by whatever path it knows it.
+  ChannelID donor_id = NULL_CHANNEL_ID;
+  string donor_dir;
+  auto same_wd = by_wd.equal_range(wd);
+  for (auto it = same_wd.first; it != same_wd.second; ++it) {
+    ChannelID candidate = it->second->get_channel_id();
+    if (candidate != channel_id && complete_roots.count(candidate) > 0) {
+      donor_id = candidate;
+      donor_dir = it->second->get_directory();
+      break;
+    }
+  }
+  if (donor_id == NULL_CHANNEL_ID) return false;
+
+  vector<shared_ptr<WatchedDirectory>> shared;
+  auto its = by_channel.equal_range(donor_id);
+  for (auto it = its.first; it != its.second; ++it) {
+    const string &path = it->second->get_directory();
+    if (path != donor_dir && path_within(path, donor_dir)) shared.push_back(it->second);
+  }
+
+  // Only ask the kernel for each directory again if this channel needs events that the other doesn't.
+  uint32_t mask = inotify_mask(get_actions(channel_id), true, ignore_rules != nullptr);
+  bool widen = (mask & ~inotify_mask(get_actions(donor_id), true, false)) != 0;
+
+  LOGGER << "Sharing the crawl of " << plural(shared.size(), "directory", "directories") << " beneath [" << dir
+         << "] with channel " << donor_id << "." << endl;
+
+  for (shared_ptr<WatchedDirectory> &existing : shared) {
+    // Translate the other channel's path into this one's, which differ when the directory is reached through a
+    // different mount or symlink.
+    string path(dir);
+    path.append(existing->get_directory(), donor_dir.size(), string::npos);
+    if ((exclude && exclude->matches(path)) || (ignore_rules && ignore_rules->ignores_within(path, true))) continue;
+    if (levels_below(channel_id, path) < 0) continue;
+
+    int shared_wd = existing->get_descriptor();
+    if (widen) {
+      shared_wd = inotify_add_watch(inotify_fd, path.c_str(), mask | IN_MASK_ADD);
+      if (shared_wd == -1) continue;
+    }
+
+    shared_ptr<WatchedDirectory> watched_dir(
+      new WatchedDirectory(shared_wd, channel_id, string(path), true, exclude, ignore_rules, nullptr));
+    by_wd.insert({shared_wd, watched_dir});
+    by_channel.insert({channel_id, watched_dir});
+    capture_watch(*watched_dir);
+    WATCHER_PROBE3(crawl_visit, channel_id, path.c_str(), shared_wd);
+  }
+
+  return true;
+}
+
+void WatchRegistry::set_depth_limit(ChannelID channel_id, const shared_ptr<DepthLimit> &limit)
+{
+  if (limit) {
+    channel_depths[channel_id] = limit;
+  } else {
+    channel_depths.erase(channel_id);
+  }
+}
+
+uint_fast32_t WatchRegistry::get_max_depth(ChannelID channel_id, const string &dir) const
+{
+  if (channel_depths.count(channel_id) == 0) return UNLIMITED_DEPTH;
+
+  int_fast64_t levels = levels_below(channel_id, dir);
+  return levels < 0 ? 0 : static_cast<uint_fast32_t>(levels);
+}
+
+shared_ptr<WatchedDirectory> WatchRegistry::find_directory(ChannelID channel_id) const
+{
+  auto found = by_channel.find(channel_id);
+  return found == by_channel.end() ? nullptr : found->second;
+}
+
+shared_ptr<const FileSet> WatchRegistry::files_for(ChannelID channel_id) const
+{
+  auto found = channel_files.find(channel_id);
+  return found == channel_files.end() ? nullptr : found->second;
+}
+
+int_fast64_t WatchRegistry::levels_below(ChannelID channel_id, const string &dir) const
+{
+  auto limit = channel_depths.find(channel_id);
+  if (limit == channel_depths.end()) return INT_FAST64_MAX;
+  return limit->second->levels_below(dir);
+}
+
+Result<> WatchRegistry::add_unwatched(ChannelID channel_id,
+  const string &dir,
+  const shared_ptr<const GlobSet> &exclude,
+  const shared_ptr<IgnoreRules> &ignore_rules,
+  const set<string> &watched,
+  vector<string> &poll)
+{
+  DIR *listing = opendir(dir.c_str());
+  if (listing == nullptr) {
+    int open_errno = errno;
+    if (open_errno == EACCES || open_errno == ENOENT || open_errno == ENOTDIR) return ok_result();
+    return errno_result("Unable to recurse into directory " + dir, open_errno);
+  }
+
+  vector<string> subdirs;
+  errno = 0;
+  dirent *entry = readdir(listing);
+  while (entry != nullptr) {
+    string basename(entry->d_name);
+    bool candidate = basename != "." && basename != "..";
+#ifdef _DIRENT_HAVE_D_TYPE
+    candidate = candidate && (entry->d_type == DT_DIR || entry->d_type == DT_UNKNOWN);
+#endif
+    if (candidate) subdirs.push_back(dir + "/" + basename);
+
+    errno = 0;
+    entry = readdir(listing);
+  }
+  int read_errno = errno;
+  closedir(listing);
+  if (read_errno != 0) return errno_result("Unable to iterate entries of directory " + dir, read_errno);
+
+  for (string &subdir : subdirs) {
+    if (exclude && exclude->matches(subdir)) continue;
+    if (ignore_rules && ignore_rules->ignores(subdir, true)) continue;
+
+    Result<> r = watched.count(subdir) > 0 ? add_unwatched(channel_id, subdir, exclude, ignore_rules, watched, poll)
+                                           : add(channel_id, subdir, true, exclude, ignore_rules, poll);
+    if (r.is_error()) {
+      LOGGER << "Unable to recurse into " << subdir << ": " << r << "." << endl;
+    }
+  }
+
+  return ok_result();
+}
+
+void WatchRegistry::adopt(int wd, ChannelID channel_id, string &&path, bool recursive, const CapturedChannel &channel)
+{
+  // Every directory of a channel shares its filters, so they're only rebuilt for the first one adopted.
+  shared_ptr<const GlobSet> exclude;
+  shared_ptr<IgnoreRules> ignore_rules;
+  shared_ptr<WatchedDirectory> sample = find_directory(channel_id);
+  if (sample) {
+    exclude = sample->get_exclude();
+    ignore_rules = sample->get_ignore_rules();
+  } else {
+    if (!channel.exclude.empty()) {
+      Result<shared_ptr<const GlobSet>> r = GlobSet::compile(channel.root, channel.exclude);
+      if (r.is_ok()) {
+        exclude = r.get_value();
+      } else {
+        LOGGER << "Unable to rebuild the exclusions of channel " << channel_id << ": " << r << "." << endl;
       }
     }
-    for (WDIter &it : to_erase) {
-      by_wd.erase(it);
+    if (channel.respect_ignore_files) ignore_rules.reset(new IgnoreRules(channel.root));
+
+    set_actions(channel_id, channel.actions);
+
+    if (!channel.files.empty()) {
+      Result<shared_ptr<const FileSet>> r = FileSet::create(channel.files);
+      if (r.is_ok()) {
+        set_files(channel_id, r.get_value());
+      } else {
+        LOGGER << "Unable to rebuild the file set of channel " << channel_id << ": " << r << "." << endl;
+      }
     }
 
-    if (by_wd.count(wd) == 0) {
-      int err = inotify_rm_watch(inotify_fd, wd);
-      if (err == -1) {
-        LOGGER << "Unable to remove watch descriptor " << wd << ": " << errno_result<>("") << "." << endl;
+    if (channel.max_depth != UNLIMITED_DEPTH) {
+      shared_ptr<DepthLimit> limit(new DepthLimit(channel.root, channel.max_depth));
+      for (const auto &expansion : channel.expansions) {
+        limit->expand(expansion.first, expansion.second);
       }
+      set_depth_limit(channel_id, limit);
     }
   }
 
-  LOGGER << "Channel " << channel_id << " has been unwatched." << endl;
+  shared_ptr<WatchedDirectory> watched_dir(
+    new WatchedDirectory(wd, channel_id, move(path), recursive, exclude, ignore_rules, files_for(channel_id)));
+
+  by_wd.insert({wd, watched_dir});
+  by_channel.insert({channel_id, watched_dir});
+}
+
+void WatchRegistry::disown(ChannelID channel_id)
+{
+  by_channel.erase(channel_id);
+  for (auto it = by_wd.begin(); it != by_wd.end();) {
+    if (it->second->get_channel_id() == channel_id) {
+      it = by_wd.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  channel_actions.erase(channel_id);
+  channel_files.erase(channel_id);
+  channel_depths.erase(channel_id);
+  complete_roots.erase(channel_id);
+}
+
+Result<> WatchRegistry::capture_to(const string &capture_path)
+{
+  if (capture_path.empty()) {
+    capture.stop();
+    return ok_result();
+  }
+
+  Result<> r = capture.start(capture_path);
+  if (r.is_error()) return r;
+
+  for (auto &pair : by_wd) {
+    capture_watch(*pair.second);
+  }
   return ok_result();
 }
 
+void WatchRegistry::capture_watch(const WatchedDirectory &watched_dir)
+{
+  if (!capture.is_active()) return;
+
+  ChannelID channel_id = watched_dir.get_channel_id();
+  CapturedChannel channel;
+  channel.actions = get_actions(channel_id);
+
+  const shared_ptr<const GlobSet> &exclude = watched_dir.get_exclude();
+  if (exclude) {
+    channel.root = exclude->get_root();
+    channel.exclude = exclude->get_patterns();
+  }
+
+  const shared_ptr<IgnoreRules> &ignore_rules = watched_dir.get_ignore_rules();
+  if (ignore_rules) {
+    channel.root = ignore_rules->get_root();
+    channel.respect_ignore_files = true;
+  }
+
+  shared_ptr<const FileSet> files = files_for(channel_id);
+  if (files) {
+    for (const auto &directory : files->get_directories()) {
+      for (const string &name : directory.second) {
+        channel.files.push_back(path_join(directory.first, name));
+      }
+    }
+  }
+
+  auto limit = channel_depths.find(channel_id);
+  if (limit != channel_depths.end()) {
+    channel.root = limit->second->get_root();
+    channel.max_depth = limit->second->get_max_depth();
+    channel.expansions = limit->second->get_expansions();
+  }
+
+  capture.watched(
+    watched_dir.get_descriptor(), channel_id, watched_dir.get_directory(), watched_dir.is_recursive(), channel);
+}
+
 Result<> WatchRegistry::consume(MessageBuffer &messages, CookieJar &jar, SideEffect &side)
 {
   if (!is_healthy()) return health_err_result<>();
@@ -207,10 +721,19 @@ Result<> WatchRegistry::consume(MessageBuffer &messages, CookieJar &jar, SideEff
   char buf[BUFSIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
   ssize_t result = 0;
 
+  messages.set_actions(&channel_actions);
+
+  int pending = 0;
+  if (ioctl(inotify_fd, FIONREAD, &pending) == 0) queue_depth.record(static_cast<uint64_t>(pending));
+
   while (true) {
     result = read(inotify_fd, &buf, BUFSIZE);
 
-    if (result <= 0) jar.flush_oldest_batch(messages);
+    if (result <= 0) {
+      jar.flush_oldest_batch(messages);
+      settle(messages);
+      capture.cycle();
+    }
 
     if (result < 0) {
       int read_errno = errno;
@@ -228,33 +751,113 @@ Result<> WatchRegistry::consume(MessageBuffer &messages, CookieJar &jar, SideEff
     }
 
     // At least one inotify event to read.
-    char *current = buf;
-    inotify_event *event = nullptr;
-    while (current < buf + result) {
-      event = reinterpret_cast<inotify_event *>(current);
-      current += sizeof(inotify_event) + event->len;
+    capture.events(buf, static_cast<size_t>(result));
+    size_t interpreted = interpret(messages, jar, side, buf, static_cast<size_t>(result));
+    read_batch.record(interpreted);
+    WATCHER_PROBE2(inotify_read, result, interpreted);
+  }
+}
+
+size_t WatchRegistry::interpret(MessageBuffer &messages,
+  CookieJar &jar,
+  SideEffect &side,
+  const char *buf,
+  size_t length)
+{
+  messages.set_actions(&channel_actions);
+
+  const char *current = buf;
+  size_t count = 0;
+  while (current < buf + length) {
+    const auto *event = reinterpret_cast<const inotify_event *>(current);
+    current += sizeof(inotify_event) + event->len;
+    count++;
+
+    TRACE_LOGGER << "Received inotify event: " << event << "." << endl;
+
+    if ((event->mask & IN_Q_OVERFLOW) == IN_Q_OVERFLOW) {
+      overflows.fetch_add(1, std::memory_order_relaxed);
+      LOGGER << "Event queue overflow. Some events have been missed." << endl;
+      continue;
+    }
 
-      LOGGER << "Received inotify event: " << event << "." << endl;
+    auto its = by_wd.equal_range(event->wd);
+    if (its.first == by_wd.end() && its.second == by_wd.end()) {
+      LOGGER << "Received event for unknown watch descriptor " << event->wd << "." << endl;
+      continue;
+    }
 
-      if ((event->mask & IN_Q_OVERFLOW) == IN_Q_OVERFLOW) {
-        LOGGER << "Event queue overflow. Some events have been missed." << endl;
-        continue;
+    // Channels that share a watch descriptor usually know its directory by the same path. Build the absolute path of
+    // the event's entry once, hand a copy of it to each channel, and move it into the last.
+    string path;
+    const string *path_directory = nullptr;
+    for (auto it = its.first; it != its.second; ++it) {
+      WatchedDirectory &watched_directory = *it->second;
+      if (!watched_directory.accepts(*event)) continue;
+
+      if (path_directory == nullptr || *path_directory != watched_directory.get_directory()) {
+        path = watched_directory.get_absolute_path(*event);
+        path_directory = &watched_directory.get_directory();
       }
 
-      auto its = by_wd.equal_range(event->wd);
-      if (its.first == by_wd.end() && its.second == by_wd.end()) {
-        LOGGER << "Received event for unknown watch descriptor " << event->wd << "." << endl;
-        continue;
+      bool last = std::next(it) == its.second;
+      Result<> r = watched_directory.accept_event(messages, jar, side, *event, last ? move(path) : string(path));
+      if (r.is_error()) {
+        LOGGER << "Unable to process event: " << r << "." << endl;
       }
+    }
 
-      for (auto it = its.first; it != its.second; ++it) {
-        shared_ptr<WatchedDirectory> watched_directory = it->second;
+    // The directory is gone, or its watch was removed. Its records are erased along with the rest of the batch's.
+    if ((event->mask & IN_IGNORED) == IN_IGNORED) dropped_descriptors.push_back(event->wd);
+  }
 
-        Result<> r = watched_directory->accept_event(messages, jar, side, *event);
-        if (r.is_error()) {
-          LOGGER << "Unable to process event: " << r << "." << endl;
-        }
+  return count;
+}
+
+void WatchRegistry::settle(MessageBuffer &messages)
+{
+  size_t folded = messages.fold_deletions();
+  if (folded > 0) LOGGER << "Folded " << plural(folded, "deletion") << " into their directories' own." << endl;
+
+  if (dropped_descriptors.empty()) return;
+
+  set<int> dropped(dropped_descriptors.begin(), dropped_descriptors.end());
+  dropped_descriptors.clear();
+
+  set<ChannelID> channels;
+  for (int wd : dropped) {
+    auto its = by_wd.equal_range(wd);
+    for (auto it = its.first; it != its.second; ++it) {
+      channels.insert(it->second->get_channel_id());
+    }
+    by_wd.erase(wd);
+  }
+
+  for (ChannelID channel_id : channels) {
+    auto its = by_channel.equal_range(channel_id);
+    auto it = its.first;
+    while (it != its.second) {
+      if (dropped.count(it->second->get_descriptor()) > 0) {
+        it = by_channel.erase(it);
+      } else {
+        ++it;
       }
     }
   }
+
+  LOGGER << "Forgot " << plural(dropped.size(), "watch descriptor") << " dropped by the kernel." << endl;
+}
+
+void WatchRegistry::collect_status(Status &status)
+{
+  status.worker_read_batch = read_batch.summarize();
+  status.worker_kernel_queue_depth = queue_depth.summarize();
+  status.worker_overflows = overflows.load(std::memory_order_relaxed);
+}
+
+void WatchRegistry::reset_status()
+{
+  read_batch.reset();
+  queue_depth.reset();
+  overflows.store(0, std::memory_order_relaxed);
 }
@@ -1,16 +1,24 @@
 #ifndef WATCHER_REGISTRY_H
 #define WATCHER_REGISTRY_H
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <set>
 #include <string>
 #include <sys/inotify.h>
 #include <unordered_map>
 #include <vector>
 
+#include "../../depth_limit.h"
 #include "../../errable.h"
+#include "../../file_set.h"
+#include "../../histogram.h"
 #include "../../message_buffer.h"
 #include "../../result.h"
+#include "../../status.h"
 #include "cookie_jar.h"
+#include "event_capture.h"
 #include "side_effect.h"
 #include "watched_directory.h"
 
@@ -28,30 +36,181 @@ public:
   // watch descriptors are exhausted before the entire directory tree can be watched, the unsuccessfully watched roots
   // will be accumulated into the `poll` vector.
   //
+  // Directories are identified by device and inode, so each one is watched once per channel however many paths lead
+  // to it, and the subdirectories of one that another channel already watches completely aren't read again.
+  // Directories beyond the channel's depth limit, if it has one, are neither watched nor read.
+  //
+  // Subdirectories matched by `exclude` or ignored by `ignore_rules`, if they're non-null, are neither watched nor
+  // recursed into, and events within them are discarded.
+  //
   // `root` must name a directory if `recursive` is `true`.
-  Result<> add(ChannelID channel_id, const std::string &root, bool recursive, std::vector<std::string> &poll);
+  Result<> add(ChannelID channel_id,
+    const std::string &root,
+    bool recursive,
+    const std::shared_ptr<const GlobSet> &exclude,
+    const std::shared_ptr<IgnoreRules> &ignore_rules,
+    std::vector<std::string> &poll);
+
+  // Begin watching the root of a channel, as `add()` does, and remember whether the channel watches every directory
+  // beneath it, so that later crawls of the same directories may re-use its own.
+  Result<> add_root(ChannelID channel_id,
+    const std::string &root,
+    bool recursive,
+    const std::shared_ptr<const GlobSet> &exclude,
+    const std::shared_ptr<IgnoreRules> &ignore_rules,
+    std::vector<std::string> &poll);
+
+  // Re-evaluate the directories beneath `dir` on a recursive channel after the rules of its ignore files have changed.
+  // Stop watching those that are now ignored and begin watching those that no longer are, without reporting events for
+  // either. Roots that could not be watched are accumulated into `poll`.
+  Result<> rescan(ChannelID channel_id,
+    const std::string &dir,
+    const std::shared_ptr<const GlobSet> &exclude,
+    const std::shared_ptr<IgnoreRules> &ignore_rules,
+    std::vector<std::string> &poll);
 
   // Uninstall inotify watchers used to deliver events on a specified channel.
   Result<> remove(ChannelID channel_id);
 
+  // Watch the directories up to `depth` levels beneath `dir` on a depth-limited channel as well, reading only those
+  // that weren't already watched. Roots that could not be watched are accumulated into `poll`. Channels without a
+  // depth limit already watch everything.
+  Result<> expand(ChannelID channel_id, const std::string &dir, uint_fast32_t depth, std::vector<std::string> &poll);
+
+  // Forget an earlier expansion of `dir` on a channel, and stop watching the directories that are no longer within its
+  // depth limit.
+  Result<> collapse(ChannelID channel_id, const std::string &dir);
+
+  // Watch only the directories within `limit` on a channel. Call before adding its root.
+  void set_depth_limit(ChannelID channel_id, const std::shared_ptr<DepthLimit> &limit);
+
+  // Return the number of levels of directories beneath `dir` that are watched on a channel, or `UNLIMITED_DEPTH` if it
+  // has no depth limit.
+  uint_fast32_t get_max_depth(ChannelID channel_id, const std::string &dir) const;
+
+  // Access any directory watched on a channel, or null if it watches none. Every directory watched on a channel
+  // shares its root's exclusions and ignore rules.
+  std::shared_ptr<WatchedDirectory> find_directory(ChannelID channel_id) const;
+
+  // Report only `actions` on a channel. Directories it watches from now on request only the inotify events that those
+  // actions need, merged with the events requested by any other channel watching the same directory.
+  void set_actions(ChannelID channel_id, ActionMask actions);
+
+  // Access the actions reported on a channel.
+  ActionMask get_actions(ChannelID channel_id) const;
+
+  // Report only the events of the members of `files` on a channel. Call before adding the directories that hold them.
+  void set_files(ChannelID channel_id, const std::shared_ptr<const FileSet> &files);
+
+  // Register a directory under a watch descriptor that was assigned elsewhere, such as one recorded in a capture file,
+  // without installing an inotify watch. The first directory adopted on a channel rebuilds the channel's filters from
+  // `channel`.
+  void adopt(int wd, ChannelID channel_id, std::string &&path, bool recursive, const CapturedChannel &channel);
+
+  // Forget every directory watched on a channel, and its filters, as `remove()` does, but without releasing or
+  // narrowing any inotify watch. Used to replay captures, whose watch descriptors belong to another inotify instance.
+  void disown(ChannelID channel_id);
+
+  // Begin recording every event batch consumed, along with every watch descriptor assigned, to `capture_path`. The
+  // watch descriptors already in use are recorded first. An empty path stops any capture in progress.
+  Result<> capture_to(const std::string &capture_path);
+
   // Interpret all inotify events created since the previous call to consume(), until the
   // read() call would block. Buffer messages corresponding to each inotify event. Use the
   // CookieJar to match pairs of rename events and the SideEffect to enqueue side effects.
   Result<> consume(MessageBuffer &messages, CookieJar &jar, SideEffect &side);
 
+  // Interpret `length` bytes of raw inotify events in `buf`, as returned by a read() from the inotify descriptor.
+  // Return the number of events that were interpreted.
+  size_t interpret(MessageBuffer &messages, CookieJar &jar, SideEffect &side, const char *buf, size_t length);
+
+  // Finish a batch of events once the inotify descriptor has been drained. Fold the deletions beneath each deleted
+  // directory into its own, and forget every directory whose watch descriptor the kernel dropped during the batch in
+  // a single pass over the channels that watched them.
+  void settle(MessageBuffer &messages);
+
   // Return the file descriptor that should be polled to wake up when inotify events are
   // available.
   int get_read_fd() { return inotify_fd; }
 
+  // Return the number of inotify watch descriptors currently held.
+  size_t get_watch_count() const { return by_wd.size(); }
+
+  // Report statistics about the inotify events consumed so far. Called from the main thread.
+  void collect_status(Status &status);
+
+  void reset_status();
+
   WatchRegistry(const WatchRegistry &) = delete;
   WatchRegistry(WatchRegistry &&) = delete;
   WatchRegistry &operator=(const WatchRegistry &) = delete;
   WatchRegistry &operator=(WatchRegistry &&) = delete;
 
 private:
+  // Forget the directory watched on a channel under `wd`, and release the watch descriptor itself if no other channel
+  // shares it. Otherwise, narrow its inotify mask to the events that the remaining channels need. The channel's own
+  // record must already have been removed from `by_channel`.
+  void release(ChannelID channel_id, int wd);
+
+  // Watch the directories beneath `dir`, which has just been watched under `wd`, on `channel_id` by copying them from
+  // another channel that already watches everything beneath the same directory, skipping those matched by `exclude`
+  // or ignored by `ignore_rules`. Return false without watching anything if no channel does.
+  bool share_crawl(ChannelID channel_id,
+    int wd,
+    const std::string &dir,
+    const std::shared_ptr<const GlobSet> &exclude,
+    const std::shared_ptr<IgnoreRules> &ignore_rules);
+
+  // Record the assignment of `watched_dir`'s watch descriptor, and the filters of its channel, to the capture in
+  // progress, if there is one.
+  void capture_watch(const WatchedDirectory &watched_dir);
+
+  // Access the file set watched on a channel, or null if it watches whole directories.
+  std::shared_ptr<const FileSet> files_for(ChannelID channel_id) const;
+
+  // Return the number of levels of subdirectories beneath `dir` that may be watched on a channel, or -1 if `dir`
+  // itself may not be.
+  int_fast64_t levels_below(ChannelID channel_id, const std::string &dir) const;
+
+  // Watch every directory beneath `dir` that's neither matched by `exclude`, ignored by `ignore_rules`, nor already a
+  // member of `watched`, and search the members of `watched` for more.
+  Result<> add_unwatched(ChannelID channel_id,
+    const std::string &dir,
+    const std::shared_ptr<const GlobSet> &exclude,
+    const std::shared_ptr<IgnoreRules> &ignore_rules,
+    const std::set<std::string> &watched,
+    std::vector<std::string> &poll);
+
   int inotify_fd;
   std::unordered_multimap<int, std::shared_ptr<WatchedDirectory>> by_wd;
   std::unordered_multimap<ChannelID, std::shared_ptr<WatchedDirectory>> by_channel;
+
+  // Actions reported by each channel that doesn't report them all.
+  std::unordered_map<ChannelID, ActionMask> channel_actions;
+
+  // Roots of the channels that watch every directory beneath their root, with neither exclusions, ignore files nor
+  // directories left to the polling thread. Their watched directories can stand in for a crawl of any subtree.
+  std::unordered_map<ChannelID, std::string> complete_roots;
+
+  // File sets watched by each channel that watches one.
+  std::unordered_map<ChannelID, std::shared_ptr<const FileSet>> channel_files;
+
+  // Depth limits of the channels that don't watch every directory beneath their root.
+  std::unordered_map<ChannelID, std::shared_ptr<DepthLimit>> channel_depths;
+
+  // Number of events returned by each read() from the inotify descriptor.
+  Histogram read_batch;
+
+  // Bytes of events waiting in the kernel's queue each time it's consumed, as reported by FIONREAD.
+  Histogram queue_depth;
+
+  // Number of times the kernel's queue has overflowed and discarded events.
+  std::atomic<uint64_t> overflows;
+
+  // Watch descriptors that the kernel has dropped since the last `settle()`, announced by IN_IGNORED.
+  std::vector<int> dropped_descriptors;
+
+  EventCapture capture;
 };
 
 #endif
@@ -1,7 +1,11 @@
+#include <memory>
 #include <string>
 #include <sys/inotify.h>
 #include <utility>
 
+#include "../../file_set.h"
+#include "../../glob.h"
+#include "../../ignore_rules.h"
 #include "../../message.h"
 #include "../../message_buffer.h"
 #include "../../result.h"
@@ -10,31 +14,63 @@
 #include "watched_directory.h"
 
 using std::move;
+using std::shared_ptr;
 using std::string;
 
-WatchedDirectory::WatchedDirectory(int wd, ChannelID channel_id, string &&directory, bool recursive) :
+WatchedDirectory::WatchedDirectory(int wd,
+  ChannelID channel_id,
+  string &&directory,
+  bool recursive,
+  const shared_ptr<const GlobSet> &exclude,
+  const shared_ptr<IgnoreRules> &ignore_rules,
+  const shared_ptr<const FileSet> &files) :
   wd{wd},
   channel_id{channel_id},
   directory{move(directory)},
-  recursive{recursive}
+  recursive{recursive},
+  exclude{exclude},
+  ignore_rules{ignore_rules},
+  files{files},
+  names{files ? files->names_in(this->directory) : nullptr}
 {
   //
 }
 
+bool WatchedDirectory::accepts(const inotify_event &event) const
+{
+  // A directory watched for a file set reports only the events of its members. Dropping one half of a rename
+  // reports an atomic save that renames a temporary file over a member as its creation.
+  return !files || (event.len > 0 && names != nullptr && names->count(event.name) > 0);
+}
+
 Result<> WatchedDirectory::accept_event(MessageBuffer &buffer,
   CookieJar &jar,
   SideEffect &side,
-  const inotify_event &event)
+  const inotify_event &event,
+  string path)
 {
   EntryKind kind = (event.mask & IN_ISDIR) == IN_ISDIR ? KIND_DIRECTORY : KIND_FILE;
-  string path = get_absolute_path(event);
+
+  // Discard events within excluded subtrees before they're buffered. A rename into or out of one is left without its
+  // other half, so it's reported as a deletion or creation.
+  if (event.len > 0 && exclude && exclude->matches(path)) return ok_result();
+
+  if (event.len > 0 && ignore_rules) {
+    if (IgnoreRules::is_ignore_file(event.name)) {
+      side.reload_ignore_rules(directory, channel_id, recursive, exclude, ignore_rules);
+    }
+    if (ignore_rules->ignores(path, kind == KIND_DIRECTORY)) return ok_result();
+
+    // A directory that's gone takes its cached rules with it.
+    if (kind == KIND_DIRECTORY && (event.mask & (IN_DELETE | IN_MOVED_FROM)) != 0u) ignore_rules->forget(path);
+  }
 
   if ((event.mask & IN_CREATE) == IN_CREATE) {
     // create entry inside directory
 
     if (kind == KIND_DIRECTORY) {
       // subdirectory created
-      if (recursive) side.track_subdirectory(path, channel_id);
+      if (recursive) side.track_subdirectory(path, channel_id, exclude, ignore_rules);
       buffer.created(channel_id, move(path), kind);
       return ok_result();
     }
@@ -51,7 +87,9 @@ Result<> WatchedDirectory::accept_event(MessageBuffer &buffer,
   }
 
   if ((event.mask & (IN_MODIFY | IN_ATTRIB)) != 0u) {
-    // modify entry inside directory or attribute change for directory or entry inside directory
+    // modify entry inside directory or attribute change for directory or entry inside directory. Another channel may
+    // have requested attribute changes on a shared watch descriptor.
+    if ((event.mask & IN_MODIFY) == 0u && !buffer.wants(channel_id, ACTIONS_ATTRIBUTES)) return ok_result();
     buffer.modified(channel_id, move(path), kind);
     return ok_result();
   }
@@ -76,7 +114,7 @@ Result<> WatchedDirectory::accept_event(MessageBuffer &buffer,
   if ((event.mask & IN_MOVED_TO) == IN_MOVED_TO) {
     // rename destination for directory or entry inside directory
     if (kind == KIND_DIRECTORY && recursive) {
-      side.track_subdirectory(path, channel_id);
+      side.track_subdirectory(path, channel_id, exclude, ignore_rules);
     }
     jar.moved_to(buffer, channel_id, event.cookie, move(path), kind);
     return ok_result();
@@ -87,7 +125,7 @@ Result<> WatchedDirectory::accept_event(MessageBuffer &buffer,
   return ok_result();
 }
 
-string WatchedDirectory::get_absolute_path(const inotify_event &event)
+string WatchedDirectory::get_absolute_path(const inotify_event &event) const
 {
   if (event.len == 0) {
     // Return a copy because the path gets moved
@@ -1,10 +1,12 @@
 #ifndef WATCHED_DIRECTORY
 #define WATCHED_DIRECTORY
 
+#include <memory>
 #include <string>
 #include <sys/inotify.h>
 #include <vector>
 
+#include "../../file_set.h"
 #include "../../message_buffer.h"
 #include "../../result.h"
 #include "cookie_jar.h"
@@ -14,19 +16,52 @@
 class WatchedDirectory
 {
 public:
-  WatchedDirectory(int wd, ChannelID channel_id, std::string &&directory, bool recursive);
+  WatchedDirectory(int wd,
+    ChannelID channel_id,
+    std::string &&directory,
+    bool recursive,
+    const std::shared_ptr<const GlobSet> &exclude,
+    const std::shared_ptr<IgnoreRules> &ignore_rules,
+    const std::shared_ptr<const FileSet> &files);
 
   ~WatchedDirectory() = default;
 
-  // Interpret a single inotify event. Buffer messages, store or resolve rename Cookies from the CookieJar, and
-  // enqueue SideEffects based on the event's mask.
-  Result<> accept_event(MessageBuffer &buffer, CookieJar &jar, SideEffect &side, const inotify_event &event);
+  // Return false if `event` concerns an entry outside of the file set this directory was watched for, and should be
+  // discarded without being interpreted.
+  bool accepts(const inotify_event &event) const;
+
+  // Interpret a single inotify event that this directory accepts, concerning the entry at the absolute path `path`.
+  // Buffer messages, store or resolve rename Cookies from the CookieJar, and enqueue SideEffects based on the event's
+  // mask. Events for entries matched by the exclusion patterns of the watch root, or ignored by the ignore files
+  // beneath it, are discarded. Changes to an ignore file are enqueued to be re-evaluated.
+  Result<> accept_event(MessageBuffer &buffer,
+    CookieJar &jar,
+    SideEffect &side,
+    const inotify_event &event,
+    std::string path);
+
+  // Translate the relative path within an inotify event into an absolute path within this directory.
+  std::string get_absolute_path(const inotify_event &event) const;
 
   // Access the Channel ID this WatchedDirectory will broadcast on.
-  ChannelID get_channel_id() { return channel_id; }
+  ChannelID get_channel_id() const { return channel_id; }
 
   // Access the watch descriptor that corresponds to this directory.
-  int get_descriptor() { return wd; }
+  int get_descriptor() const { return wd; }
+
+  // Access the absolute path of this directory.
+  const std::string &get_directory() const { return directory; }
+
+  bool is_recursive() const { return recursive; }
+
+  // Access the exclusion patterns of the watch root this directory was found beneath, or null if there are none.
+  const std::shared_ptr<const GlobSet> &get_exclude() const { return exclude; }
+
+  // Access the ignore file rules respected beneath the watch root, or null if they aren't.
+  const std::shared_ptr<IgnoreRules> &get_ignore_rules() const { return ignore_rules; }
+
+  // Access the file set that this directory was watched for, or null if it was watched as a whole.
+  const std::shared_ptr<const FileSet> &get_files() const { return files; }
 
   WatchedDirectory(const WatchedDirectory &other) = delete;
   WatchedDirectory(WatchedDirectory &&other) = delete;
@@ -34,13 +69,16 @@ public:
   WatchedDirectory &operator=(WatchedDirectory &&other) = delete;
 
 private:
-  // Translate the relative path within an inotify event into an absolute path within this directory.
-  std::string get_absolute_path(const inotify_event &event);
-
   int wd;
   ChannelID channel_id;
   std::string directory;
   bool recursive;
+  std::shared_ptr<const GlobSet> exclude;
+  std::shared_ptr<IgnoreRules> ignore_rules;
+  std::shared_ptr<const FileSet> files;
+
+  // Names of the members of `files` within this directory, or null if it has none.
+  const FileSet::Names *names;
 };
 
 #endif
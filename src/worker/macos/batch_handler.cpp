@@ -83,7 +83,9 @@ void Event::collect_info()
 
 void Event::report()
 {
-  ostream &logline = LOGGER;
+  if (!Logger::enabled()) return;
+
+  ostream &logline = LOGGER_STREAM;
   logline << "Event at [" << event_path << "] flags " << hex << flags << dec << " [";
 
   if ((flags & kFSEventStreamEventFlagMustScanSubDirs) != 0) logline << " MustScanSubDirs";
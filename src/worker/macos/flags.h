@@ -13,6 +13,10 @@ const FSEventStreamEventFlags MODIFY_FLAGS = kFSEventStreamEventFlagItemInodeMet
   | kFSEventStreamEventFlagItemFinderInfoMod | kFSEventStreamEventFlagItemChangeOwner
   | kFSEventStreamEventFlagItemXattrMod | kFSEventStreamEventFlagItemModified;
 
+const FSEventStreamEventFlags ATTRIBUTE_FLAGS = kFSEventStreamEventFlagItemInodeMetaMod
+  | kFSEventStreamEventFlagItemFinderInfoMod | kFSEventStreamEventFlagItemChangeOwner
+  | kFSEventStreamEventFlagItemXattrMod;
+
 const FSEventStreamEventFlags RENAME_FLAGS = kFSEventStreamEventFlagItemRenamed;
 
 const FSEventStreamEventFlags IS_FILE = kFSEventStreamEventFlagItemIsFile;
@@ -11,11 +11,16 @@
 #include <unordered_map>
 #include <utility>
 
+#include "../../depth_limit.h"
+#include "../../file_set.h"
+#include "../../glob.h"
 #include "../../helper/macos/helper.h"
+#include "../../ignore_rules.h"
 #include "../../log.h"
 #include "../../message.h"
 #include "../../message_buffer.h"
 #include "../../result.h"
+#include "../../trace.h"
 #include "../worker_platform.h"
 #include "../worker_thread.h"
 #include "batch_handler.h"
@@ -89,15 +94,23 @@ public:
   Result<bool> handle_add_command(CommandID command_id,
     ChannelID channel_id,
     const string &root_path,
-    bool recursive) override
+    bool recursive,
+    const shared_ptr<const GlobSet> &exclude,
+    bool respect_ignore_files,
+    ActionMask actions,
+    const shared_ptr<const FileSet> &files,
+    uint_fast32_t max_depth) override
   {
     if (!is_healthy()) return health_err_result().propagate<bool>();
 
-    ostream &logline = LOGGER << "Adding watcher for path " << root_path;
-    if (!recursive) {
-      logline << " (non-recursively)";
-    }
-    logline << " at channel " << channel_id << "." << endl;
+    // A file set is watched through the deepest directory that contains all of its members, and events for other
+    // entries are dropped as each batch arrives.
+    string watch_path(files ? files->common_root() : root_path);
+    bool watch_recursive = files ? files->get_directories().size() > 1 : recursive;
+    if (watch_path.empty()) return Result<bool>::make_error("Unable to find a common directory for the watched files");
+
+    LOGGER << "Adding watcher for path " << watch_path << (watch_recursive ? "" : " (non-recursively)")
+           << " at channel " << channel_id << "." << endl;
 
     FSEventStreamContext stream_context{
       0,  // version
@@ -109,13 +122,13 @@ public:
     };
 
     RefHolder<CFStringRef> watch_root(CFStringCreateWithBytes(kCFAllocatorDefault,
-      reinterpret_cast<const UInt8 *>(root_path.c_str()),
-      root_path.size(),
+      reinterpret_cast<const UInt8 *>(watch_path.c_str()),
+      watch_path.size(),
       kCFStringEncodingUTF8,
       0u));
     if (watch_root.empty()) {
       string msg("Unable to allocate string for root path: ");
-      msg += root_path;
+      msg += watch_path;
       return Result<bool>::make_error(move(msg));
     }
 
@@ -123,7 +136,7 @@ public:
       CFArrayCreate(kCFAllocatorDefault, reinterpret_cast<const void **>(&watch_root), 1, nullptr));
     if (watch_roots.empty()) {
       string msg("Unable to allocate array for watch root: ");
-      msg += root_path;
+      msg += watch_path;
       return Result<bool>::make_error(move(msg));
     }
 
@@ -137,22 +150,48 @@ public:
       ));
     if (event_stream.empty()) {
       string msg("Unable to create event stream for watch root: ");
-      msg += root_path;
+      msg += watch_path;
       return Result<bool>::make_error(move(msg));
     }
 
     FSEventStreamScheduleWithRunLoop(event_stream.get(), run_loop.get(), kCFRunLoopDefaultMode);
     if (FSEventStreamStart(event_stream.get()) == 0u) {
-      LOGGER << "Falling back to polling for watch root " << root_path << "." << endl;
+      LOGGER << "Falling back to polling for watch root " << watch_path << "." << endl;
 
       // Emit an Add command for the polling thread to pick up
-      emit(Message(CommandPayloadBuilder::add(channel_id, string(root_path), true, 1).set_id(command_id).build()));
+      emit(Message(CommandPayloadBuilder::add(channel_id, string(watch_path), !files, 1)
+                     .set_id(command_id)
+                     .set_exclude(exclude)
+                     .set_respect_ignore_files(respect_ignore_files)
+                     .set_actions(actions)
+                     .set_files(files)
+                     .set_max_depth(max_depth)
+                     .set_burst_threshold(get_bursts().get_threshold(channel_id))
+                     .build()));
       return ok_result(false);
     }
 
-    subscriptions.emplace(channel_id, Subscription(channel_id, recursive, string(root_path), move(event_stream)));
+    shared_ptr<IgnoreRules> ignore_rules;
+    if (respect_ignore_files) ignore_rules.reset(new IgnoreRules(watch_path));
+
+    // FSEvents streams always cover the whole tree, so a depth limit only filters the events that arrive.
+    shared_ptr<DepthLimit> depth_limit;
+    if (watch_recursive && !files && max_depth != UNLIMITED_DEPTH) {
+      depth_limit.reset(new DepthLimit(watch_path, max_depth));
+    }
 
-    cache.prepopulate(root_path, 4096);
+    subscriptions.emplace(channel_id,
+      Subscription(channel_id,
+        watch_recursive,
+        string(watch_path),
+        exclude,
+        ignore_rules,
+        actions,
+        files,
+        depth_limit,
+        move(event_stream)));
+
+    cache.prepopulate(watch_path, 4096);
     return ok_result(true);
   }
 
@@ -170,6 +209,33 @@ public:
     return ok_result(true);
   }
 
+  Result<bool> handle_expand_command(CommandID /*command_id*/,
+    ChannelID channel_id,
+    const string &dir,
+    uint_fast32_t depth) override
+  {
+    if (!is_healthy()) return health_err_result().propagate<bool>();
+
+    auto sub = subscriptions.find(channel_id);
+    if (sub == subscriptions.end() || !sub->second.get_depth_limit()) return ok_result(true);
+
+    sub->second.get_depth_limit()->expand(dir, depth);
+    LOGGER << "Expanding [" << dir << "] on channel " << channel_id << " to " << *sub->second.get_depth_limit() << "."
+           << endl;
+    return ok_result(true);
+  }
+
+  Result<bool> handle_collapse_command(CommandID /*command_id*/, ChannelID channel_id, const string &dir) override
+  {
+    if (!is_healthy()) return health_err_result().propagate<bool>();
+
+    auto sub = subscriptions.find(channel_id);
+    if (sub == subscriptions.end() || !sub->second.get_depth_limit()) return ok_result(true);
+
+    sub->second.get_depth_limit()->collapse(dir);
+    return ok_result(true);
+  }
+
   FnRegistryAction source_triggered()
   {
     Result<> r = handle_commands();
@@ -184,9 +250,9 @@ public:
     const FSEventStreamEventFlags *event_flags,
     const FSEventStreamEventId * /*event_ids*/)
   {
+    TraceScope consume_trace("consume");
+    consume_trace.arg("channel", channel_id);
     auto **paths = reinterpret_cast<char **>(event_paths);
-    MessageBuffer buffer;
-    ChannelMessageBuffer message_buffer(buffer, channel_id);
 
     LOGGER << "Filesystem event batch of size " << num_events << " received." << endl;
     auto sub = subscriptions.find(channel_id);
@@ -195,11 +261,51 @@ public:
       return FN_KEEP;
     }
 
+    MessageBuffer buffer;
+    ChannelMessageBuffer message_buffer(buffer, channel_id, sub->second.get_actions());
+    bool attributes = message_buffer.wants(ACTIONS_ATTRIBUTES);
+
     message_buffer.reserve(num_events);
 
     BatchHandler handler(message_buffer, cache, rename_buffer, sub->second.get_recursive(), sub->second.get_root());
+    const shared_ptr<const GlobSet> &exclude = sub->second.get_exclude();
+    IgnoreRules *ignore_rules = sub->second.get_ignore_rules().get();
+    const shared_ptr<const FileSet> &files = sub->second.get_files();
+    const shared_ptr<DepthLimit> &depth_limit = sub->second.get_depth_limit();
     for (size_t i = 0; i < num_events; i++) {
-      handler.event(string(paths[i]), event_flags[i]);
+      string event_path(paths[i]);
+
+      // Drop events within excluded subtrees before they reach the cache. A rename into or out of one is left without
+      // its other half, so it's reported as a creation or deletion.
+      if (exclude && exclude->matches(event_path)) continue;
+
+      // Likewise, only the members of a watched file set are reported. An atomic save that renames a temporary file
+      // over a member is reported as the member's creation.
+      if (files && !files->contains(event_path)) continue;
+
+      // Events beneath the directories that a depth limit covers are dropped in the same way.
+      if (depth_limit && !depth_limit->reports(event_path)) continue;
+
+      // FSEvents watches the whole tree regardless, so ignored subtrees are only filtered here. An edited ignore file
+      // takes effect from the next event onward.
+      if (ignore_rules != nullptr) {
+        size_t separator = event_path.find_last_of('/');
+        if (separator != string::npos && IgnoreRules::is_ignore_file(event_path.substr(separator + 1))) {
+          ignore_rules->reload(event_path.substr(0, separator));
+        }
+        if (ignore_rules->ignores_within(event_path, (event_flags[i] & kFSEventStreamEventFlagItemIsDir) != 0)) {
+          continue;
+        }
+      }
+
+      // An event that only reports attribute changes is of no interest to a channel that doesn't report them.
+      FSEventStreamEventFlags flags = event_flags[i];
+      if (!attributes) {
+        flags &= ~ATTRIBUTE_FLAGS;
+        if ((flags & (CREATE_FLAGS | DELETED_FLAGS | MODIFY_FLAGS | RENAME_FLAGS)) == 0) continue;
+      }
+
+      handler.event(move(event_path), flags);
     }
     cache.apply();
 
@@ -230,6 +336,7 @@ public:
       CFRunLoopAddTimer(run_loop.get(), timer, kCFRunLoopDefaultMode);
     }
 
+    consume_trace.arg("events", message_buffer.size());
     Result<> er = emit_all(message_buffer.begin(), message_buffer.end());
     if (er.is_error()) {
       LOGGER << "Unable to emit filesystem event messages: " << er << "." << endl;
@@ -250,8 +357,10 @@ public:
     LOGGER << "Expiring " << plural(keys->size(), "rename entry", "rename entries") << " on channel " << channel_id
            << "." << endl;
 
+    auto sub = subscriptions.find(channel_id);
+    ActionMask actions = sub != subscriptions.end() ? sub->second.get_actions() : ACTIONS_ALL;
     MessageBuffer buffer;
-    ChannelMessageBuffer message_buffer(buffer, channel_id);
+    ChannelMessageBuffer message_buffer(buffer, channel_id, actions);
 
     shared_ptr<set<RenameBuffer::Key>> next = rename_buffer.flush_unmatched(message_buffer, keys);
     assert(next->empty());
@@ -287,3 +396,9 @@ unique_ptr<WorkerPlatform> WorkerPlatform::for_worker(WorkerThread *thread)
 {
   return unique_ptr<WorkerPlatform>(new MacOSWorkerPlatform(thread));
 }
+
+Result<> WorkerPlatform::replay_capture(const string & /*capture_path*/,
+  const std::function<void(MessageBuffer &)> & /*sink*/)
+{
+  return error_result("Event capture is not supported on this platform");
+}
@@ -67,15 +67,13 @@ bool RenameBuffer::observe_present_entry(ChannelMessageBuffer &message_buffer,
   const shared_ptr<PresentEntry> &present,
   bool current)
 {
-  ostream &logline = LOGGER << "Rename ";
-
   auto maybe_entry = observed_by_inode.find(present->get_inode());
   if (maybe_entry == observed_by_inode.end()) {
     // The first-seen half of this rename event. Buffer a new entry to be paired with the second half when or if it's
     // observed.
     RenameBufferEntry entry(present, current);
     observed_by_inode.emplace(present->get_inode(), move(entry));
-    logline << "first half " << *present << ": Remembering for later." << endl;
+    LOGGER << "Rename first half " << *present << ": Remembering for later." << endl;
     return true;
   }
   RenameBufferEntry &existing = maybe_entry->second;
@@ -87,7 +85,8 @@ bool RenameBuffer::observe_present_entry(ChannelMessageBuffer &message_buffer,
 
     if (!existing.current && current) {
       // The former end is the "from" end and the current end is the "to" end.
-      logline << "completed pair " << *existing.entry << " => " << *present << ": Emitting rename event." << endl;
+      LOGGER << "Rename completed pair " << *existing.entry << " => " << *present << ": Emitting rename event."
+             << endl;
 
       cache.evict(existing.entry);
       message_buffer.renamed(
@@ -95,7 +94,7 @@ bool RenameBuffer::observe_present_entry(ChannelMessageBuffer &message_buffer,
       handled = true;
     } else if (existing.current && !current) {
       // The former end is the "to" end and the current end is the "from" end.
-      logline << "completed pair " << *present << " => " << *existing.entry << ": Emitting rename event." << endl;
+      LOGGER << "Rename completed pair " << *present << " => " << *existing.entry << ": Emitting rename event." << endl;
 
       cache.evict(present);
       message_buffer.renamed(
@@ -107,8 +106,8 @@ bool RenameBuffer::observe_present_entry(ChannelMessageBuffer &message_buffer,
       string existing_desc = existing.current ? " (current) " : " (former) ";
       string incoming_desc = current ? " (current) " : " (former) ";
 
-      logline << "conflicting pair " << *present << incoming_desc << " =/= " << *(existing.entry) << existing_desc
-              << "are both present." << endl;
+      LOGGER << "Rename conflicting pair " << *present << incoming_desc << " =/= " << *(existing.entry) << existing_desc
+             << "are both present." << endl;
       handled = false;
     }
 
@@ -119,8 +118,8 @@ bool RenameBuffer::observe_present_entry(ChannelMessageBuffer &message_buffer,
   string existing_desc = existing.current ? " (current) " : " (former) ";
   string incoming_desc = current ? " (current) " : " (former) ";
 
-  logline << "conflicting pair " << *present << incoming_desc << " =/= " << *(existing.entry) << existing_desc
-          << "have conflicting entry kinds." << endl;
+  LOGGER << "Rename conflicting pair " << *present << incoming_desc << " =/= " << *(existing.entry) << existing_desc
+         << "have conflicting entry kinds." << endl;
   return false;
 }
 
@@ -1,20 +1,35 @@
 #include <CoreServices/CoreServices.h>
+#include <memory>
 #include <utility>
 
+#include "../../depth_limit.h"
+#include "../../file_set.h"
 #include "../../helper/macos/helper.h"
+#include "../../ignore_rules.h"
 #include "../../message.h"
 #include "subscription.h"
 
 using std::move;
+using std::shared_ptr;
 using std::string;
 
 Subscription::Subscription(ChannelID channel_id,
   bool recursive,
   string &&root,
+  const shared_ptr<const GlobSet> &exclude,
+  const shared_ptr<IgnoreRules> &ignore_rules,
+  ActionMask actions,
+  const shared_ptr<const FileSet> &files,
+  const shared_ptr<DepthLimit> &depth_limit,
   RefHolder<FSEventStreamRef> &&event_stream) :
   channel_id{channel_id},
   root{move(root)},
   recursive{recursive},
+  exclude{exclude},
+  ignore_rules{ignore_rules},
+  actions{actions},
+  files{files},
+  depth_limit{depth_limit},
   event_stream{move(event_stream)}
 {
   //
@@ -24,6 +39,11 @@ Subscription::Subscription(Subscription &&original) noexcept :
   channel_id{original.channel_id},
   root{move(original.root)},
   recursive{original.recursive},
+  exclude{move(original.exclude)},
+  ignore_rules{move(original.ignore_rules)},
+  actions{original.actions},
+  files{move(original.files)},
+  depth_limit{move(original.depth_limit)},
   event_stream{move(original.event_stream)}
 {
   //
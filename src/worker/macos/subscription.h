@@ -1,15 +1,27 @@
 #ifndef SUBSCRIPTION_H
 #define SUBSCRIPTION_H
 
+#include "../../depth_limit.h"
+#include "../../file_set.h"
 #include "../../helper/macos/helper.h"
+#include "../../ignore_rules.h"
 #include "../../message.h"
 #include <CoreServices/CoreServices.h>
+#include <memory>
 #include <string>
 
 class Subscription
 {
 public:
-  Subscription(ChannelID channel_id, bool recursive, std::string &&root, RefHolder<FSEventStreamRef> &&event_stream);
+  Subscription(ChannelID channel_id,
+    bool recursive,
+    std::string &&root,
+    const std::shared_ptr<const GlobSet> &exclude,
+    const std::shared_ptr<IgnoreRules> &ignore_rules,
+    ActionMask actions,
+    const std::shared_ptr<const FileSet> &files,
+    const std::shared_ptr<DepthLimit> &depth_limit,
+    RefHolder<FSEventStreamRef> &&event_stream);
 
   Subscription(Subscription &&original) noexcept;
 
@@ -21,6 +33,16 @@ public:
 
   const bool &get_recursive() { return recursive; }
 
+  const std::shared_ptr<const GlobSet> &get_exclude() { return exclude; }
+
+  const std::shared_ptr<IgnoreRules> &get_ignore_rules() { return ignore_rules; }
+
+  ActionMask get_actions() { return actions; }
+
+  const std::shared_ptr<const FileSet> &get_files() { return files; }
+
+  const std::shared_ptr<DepthLimit> &get_depth_limit() { return depth_limit; }
+
   const RefHolder<FSEventStreamRef> &get_event_stream() { return event_stream; }
 
   Subscription(const Subscription &) = delete;
@@ -31,6 +53,11 @@ private:
   ChannelID channel_id;
   std::string root;
   bool recursive;
+  std::shared_ptr<const GlobSet> exclude;
+  std::shared_ptr<IgnoreRules> ignore_rules;
+  ActionMask actions;
+  std::shared_ptr<const FileSet> files;
+  std::shared_ptr<DepthLimit> depth_limit;
   RefHolder<FSEventStreamRef> event_stream;
 };
 
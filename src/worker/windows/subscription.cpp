@@ -4,7 +4,10 @@
 #include <string>
 #include <windows.h>
 
+#include "../../depth_limit.h"
+#include "../../file_set.h"
 #include "../../helper/windows/helper.h"
+#include "../../ignore_rules.h"
 #include "../../log.h"
 #include "../../result.h"
 #include "subscription.h"
@@ -12,6 +15,7 @@
 using std::endl;
 using std::ostream;
 using std::ostringstream;
+using std::shared_ptr;
 using std::string;
 using std::wostringstream;
 using std::wstring;
@@ -23,6 +27,11 @@ Subscription::Subscription(ChannelID channel,
   HANDLE root,
   const wstring &path,
   bool recursive,
+  const shared_ptr<const GlobSet> &exclude,
+  const shared_ptr<IgnoreRules> &ignore_rules,
+  ActionMask actions,
+  const shared_ptr<const FileSet> &files,
+  const shared_ptr<DepthLimit> &depth_limit,
   WindowsWorkerPlatform *platform) :
   command{0},
   channel{channel},
@@ -31,6 +40,11 @@ Subscription::Subscription(ChannelID channel,
   root{root},
   terminating{false},
   recursive{recursive},
+  exclude{exclude},
+  ignore_rules{ignore_rules},
+  actions{actions},
+  files{files},
+  depth_limit{depth_limit},
   buffer_size{DEFAULT_BUFFER_SIZE},
   buffer{new BYTE[buffer_size]},
   written{new BYTE[buffer_size]}
@@ -52,17 +66,25 @@ Result<bool> Subscription::schedule(LPOVERLAPPED_COMPLETION_ROUTINE fn)
     return ok_result(true);
   }
 
-  ostream &logline = LOGGER << "Scheduling the next change callback for channel " << channel;
-  if (!recursive) logline << " (non-recursively)";
-  logline << "." << endl;
+  LOGGER << "Scheduling the next change callback for channel " << channel << (recursive ? "" : " (non-recursively)")
+         << "." << endl;
+
+  // Request only the changes that this subscription reports. Names are always needed to track renames, and writes
+  // are needed to notice edited ignore files.
+  DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME;
+  if ((actions & action_mask(ACTION_MODIFIED)) != 0) {
+    filter |= FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+    if ((actions & ACTIONS_ATTRIBUTES) != 0) {
+      filter |= FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_LAST_ACCESS | FILE_NOTIFY_CHANGE_SECURITY;
+    }
+  }
+  if (ignore_rules) filter |= FILE_NOTIFY_CHANGE_LAST_WRITE;
 
   int success = ReadDirectoryChangesW(root,  // root directory handle
     buffer.get(),  // result buffer
     buffer_size,  // result buffer size
     recursive,  // recursive
-    FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE
-      | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_LAST_ACCESS | FILE_NOTIFY_CHANGE_CREATION
-      | FILE_NOTIFY_CHANGE_SECURITY,  // change flags
+    filter,  // change flags
     NULL,  // bytes returned
     &overlapped,  // overlapped
     fn  // completion routine
@@ -5,6 +5,9 @@
 #include <sstream>
 #include <string>
 
+#include "../../depth_limit.h"
+#include "../../file_set.h"
+#include "../../ignore_rules.h"
 #include "../../message.h"
 #include "../../result.h"
 
@@ -17,6 +20,11 @@ public:
     HANDLE root,
     const std::wstring &path,
     bool recursive,
+    const std::shared_ptr<const GlobSet> &exclude,
+    const std::shared_ptr<IgnoreRules> &ignore_rules,
+    ActionMask actions,
+    const std::shared_ptr<const FileSet> &files,
+    const std::shared_ptr<DepthLimit> &depth_limit,
     WindowsWorkerPlatform *platform);
 
   ~Subscription();
@@ -41,6 +49,16 @@ public:
 
   const bool &is_recursive() const { return recursive; }
 
+  const std::shared_ptr<const GlobSet> &get_exclude() const { return exclude; }
+
+  IgnoreRules *get_ignore_rules() const { return ignore_rules.get(); }
+
+  ActionMask get_actions() const { return actions; }
+
+  const std::shared_ptr<const FileSet> &get_files() const { return files; }
+
+  DepthLimit *get_depth_limit() const { return depth_limit.get(); }
+
   const bool &is_terminating() const { return terminating; }
 
 private:
@@ -53,6 +71,11 @@ private:
   OVERLAPPED overlapped;
   bool recursive;
   bool terminating;
+  std::shared_ptr<const GlobSet> exclude;
+  std::shared_ptr<IgnoreRules> ignore_rules;
+  ActionMask actions;
+  std::shared_ptr<const FileSet> files;
+  std::shared_ptr<DepthLimit> depth_limit;
 
   DWORD buffer_size;
   std::unique_ptr<BYTE[]> buffer;
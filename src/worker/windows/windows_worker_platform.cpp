@@ -10,7 +10,11 @@
 #include <vector>
 #include <windows.h>
 
+#include "../../depth_limit.h"
+#include "../../file_set.h"
+#include "../../glob.h"
 #include "../../helper/windows/helper.h"
+#include "../../ignore_rules.h"
 #include "../../lock.h"
 #include "../../log.h"
 #include "../../message.h"
@@ -105,12 +109,25 @@ public:
   Result<bool> handle_add_command(CommandID command,
     ChannelID channel,
     const string &root_path,
-    bool recursive) override
+    bool recursive,
+    const shared_ptr<const GlobSet> &exclude,
+    bool respect_ignore_files,
+    ActionMask actions,
+    const shared_ptr<const FileSet> &files,
+    uint_fast32_t max_depth) override
   {
     if (!is_healthy()) return health_err_result().propagate<bool>();
 
+    // A file set is watched through the deepest directory that contains all of its members, and events for other
+    // entries are dropped as they're read.
+    string watch_path(files ? files->common_root() : root_path);
+    bool watch_recursive = files ? files->get_directories().size() > 1 : recursive;
+    if (watch_path.empty()) {
+      return Result<bool>::make_error("Unable to find a common directory for the watched files");
+    }
+
     // Convert the path to a wide-character string
-    Result<wstring> convr = to_wchar(root_path);
+    Result<wstring> convr = to_wchar(watch_path);
     if (convr.is_error()) return convr.propagate<bool>();
     wstring &root_path_w = convr.get_value();
 
@@ -128,7 +145,17 @@ public:
     }
 
     // Allocate and persist the subscription
-    Subscription *sub = new Subscription(channel, root, root_path_w, recursive, this);
+    shared_ptr<IgnoreRules> ignore_rules;
+    if (respect_ignore_files) ignore_rules.reset(new IgnoreRules(watch_path));
+
+    // ReadDirectoryChangesW watches the whole tree regardless, so a depth limit only filters the events that are read.
+    shared_ptr<DepthLimit> depth_limit;
+    if (watch_recursive && !files && max_depth != UNLIMITED_DEPTH) {
+      depth_limit.reset(new DepthLimit(watch_path, max_depth));
+    }
+
+    Subscription *sub = new Subscription(
+      channel, root, root_path_w, watch_recursive, exclude, ignore_rules, actions, files, depth_limit, this);
     auto insert_result = subscriptions.insert(make_pair(channel, sub));
     if (!insert_result.second) {
       delete sub;
@@ -138,22 +165,55 @@ public:
       return Result<bool>::make_error(msg.str());
     }
 
-    ostream &logline = LOGGER << "Added directory root " << root_path;
-    if (!recursive) logline << " (non-recursive)";
-    logline << " at channel " << channel << "." << endl;
+    LOGGER << "Added directory root " << watch_path << (watch_recursive ? "" : " (non-recursive)") << " at channel "
+           << channel << "." << endl;
 
     Result<bool> schedr = sub->schedule(&event_helper);
     if (schedr.is_error()) return schedr.propagate<bool>();
     if (!schedr.get_value()) {
-      LOGGER << "Falling back to polling for watch root " << root_path << "." << endl;
-
-      return emit(Message(CommandPayloadBuilder::add(channel, string(root_path), recursive, 1).build()))
+      LOGGER << "Falling back to polling for watch root " << watch_path << "." << endl;
+
+      return emit(Message(CommandPayloadBuilder::add(channel, string(watch_path), watch_recursive, 1)
+                            .set_exclude(exclude)
+                            .set_respect_ignore_files(respect_ignore_files)
+                            .set_actions(actions)
+                            .set_files(files)
+                            .set_max_depth(max_depth)
+                            .set_burst_threshold(get_bursts().get_threshold(channel))
+                            .build()))
         .propagate(false);
     }
 
     return ok_result(true);
   }
 
+  Result<bool> handle_expand_command(CommandID /*command*/,
+    ChannelID channel,
+    const string &dir,
+    uint_fast32_t depth) override
+  {
+    if (!is_healthy()) return health_err_result().propagate<bool>();
+
+    auto it = subscriptions.find(channel);
+    if (it == subscriptions.end() || it->second->get_depth_limit() == nullptr) return ok_result(true);
+
+    it->second->get_depth_limit()->expand(dir, depth);
+    LOGGER << "Expanding [" << dir << "] on channel " << channel << " to " << *it->second->get_depth_limit() << "."
+           << endl;
+    return ok_result(true);
+  }
+
+  Result<bool> handle_collapse_command(CommandID /*command*/, ChannelID channel, const string &dir) override
+  {
+    if (!is_healthy()) return health_err_result().propagate<bool>();
+
+    auto it = subscriptions.find(channel);
+    if (it == subscriptions.end() || it->second->get_depth_limit() == nullptr) return ok_result(true);
+
+    it->second->get_depth_limit()->collapse(dir);
+    return ok_result(true);
+  }
+
   Result<bool> handle_remove_command(CommandID command, ChannelID channel) override
   {
     if (!is_healthy()) return health_err_result().propagate<bool>();
@@ -218,7 +278,7 @@ public:
 
     // Process received events.
     MessageBuffer buffer;
-    ChannelMessageBuffer messages(buffer, channel);
+    ChannelMessageBuffer messages(buffer, channel, sub->get_actions());
     bool old_path_seen = false;
     string old_path;
 
@@ -257,9 +317,15 @@ private:
       LOGGER << "Falling back to polling for path " << root.get_value() << " at channel " << sub->get_channel() << "."
              << endl;
 
+      DepthLimit *depth_limit = sub->get_depth_limit();
+      uint_fast32_t max_depth = depth_limit != nullptr ? depth_limit->get_max_depth() : UNLIMITED_DEPTH;
+
       Result<> rem = remove(sub);
-      rem &= emit(Message(
-        CommandPayloadBuilder::add(sub->get_channel(), move(root.get_value()), sub->is_recursive(), 1).build()));
+      rem &= emit(Message(CommandPayloadBuilder::add(sub->get_channel(), move(root.get_value()), sub->is_recursive(), 1)
+                            .set_files(sub->get_files())
+                            .set_max_depth(max_depth)
+                            .set_burst_threshold(get_bursts().get_threshold(sub->get_channel()))
+                            .build()));
       return rem;
     }
 
@@ -307,6 +373,56 @@ private:
     wstring relpathw{info->FileName, info->FileNameLength / sizeof(WCHAR)};
     wstring pathw = sub->make_absolute(move(relpathw));
 
+    Result<string> u8r = to_utf8(pathw);
+    if (u8r.is_error()) {
+      LOGGER << "Unable to convert path to utf-8: " << u8r << "." << endl;
+      return ok_result();
+    }
+    string &path = u8r.get_value();
+
+    // Drop events within excluded or ignored subtrees. An excluded rename source is remembered as an empty `old_path`
+    // so that its destination is reported as a creation, and a rename into an excluded subtree is reported as a
+    // deletion.
+    auto drop = [&]() {
+      if (info->Action == FILE_ACTION_RENAMED_OLD_NAME) {
+        old_path_seen = true;
+        old_path.clear();
+      } else if (info->Action == FILE_ACTION_RENAMED_NEW_NAME && old_path_seen) {
+        if (!old_path.empty()) messages.deleted(move(old_path), kind);
+        old_path_seen = false;
+      }
+    };
+    const shared_ptr<const GlobSet> &exclude = sub->get_exclude();
+    if (exclude && exclude->matches(path)) {
+      drop();
+      return ok_result();
+    }
+
+    // Only the members of a watched file set are reported, so an atomic save that renames a temporary file over a
+    // member is reported as the member's creation.
+    const shared_ptr<const FileSet> &files = sub->get_files();
+    if (files && !files->contains(path)) {
+      drop();
+      return ok_result();
+    }
+
+    // Likewise, only events within the directories that a depth limit covers are reported.
+    DepthLimit *depth_limit = sub->get_depth_limit();
+    if (depth_limit != nullptr && !depth_limit->reports(path)) {
+      drop();
+      return ok_result();
+    }
+
+    // ReadDirectoryChangesW watches the whole tree regardless, so ignored subtrees are only filtered here. An edited
+    // ignore file takes effect from the next event onward.
+    IgnoreRules *ignore_rules = sub->get_ignore_rules();
+    if (ignore_rules != nullptr) {
+      size_t separator = path.find_last_of("\\/");
+      if (separator != string::npos && IgnoreRules::is_ignore_file(path.substr(separator + 1))) {
+        ignore_rules->reload(path.substr(0, separator));
+      }
+    }
+
     if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME) {
       DWORD attrs = GetFileAttributesW(pathw.c_str());
       if (attrs == INVALID_FILE_ATTRIBUTES) {
@@ -322,12 +438,10 @@ private:
       // TODO check against FILE_ATTRIBUTE_REPARSE_POINT to identify symlinks
     }
 
-    Result<string> u8r = to_utf8(pathw);
-    if (u8r.is_error()) {
-      LOGGER << "Unable to convert path to utf-8: " << u8r << "." << endl;
+    if (ignore_rules != nullptr && ignore_rules->ignores_within(path, kind == KIND_DIRECTORY)) {
+      drop();
       return ok_result();
     }
-    string &path = u8r.get_value();
 
     switch (info->Action) {
       case FILE_ACTION_ADDED: messages.created(move(path), kind); break;
@@ -338,13 +452,14 @@ private:
         old_path = move(path);
         break;
       case FILE_ACTION_RENAMED_NEW_NAME:
-        if (old_path_seen) {
+        if (old_path_seen && !old_path.empty()) {
           // Old name received first
           messages.renamed(move(old_path), move(path), kind);
           old_path_seen = false;
         } else {
-          // No old name. Treat it as a creation
+          // No old name, or an excluded one. Treat it as a creation
           messages.created(move(path), kind);
+          old_path_seen = false;
         }
         break;
       default: {
@@ -368,6 +483,12 @@ unique_ptr<WorkerPlatform> WorkerPlatform::for_worker(WorkerThread *thread)
   return unique_ptr<WorkerPlatform>(new WindowsWorkerPlatform(thread));
 }
 
+Result<> WorkerPlatform::replay_capture(const string & /*capture_path*/,
+  const std::function<void(MessageBuffer &)> & /*sink*/)
+{
+  return error_result("Event capture is not supported on this platform");
+}
+
 void CALLBACK command_perform_helper(__in ULONG_PTR payload)
 {
   WindowsWorkerPlatform *platform = reinterpret_cast<WindowsWorkerPlatform *>(payload);
@@ -1,13 +1,16 @@
 #ifndef WORKER_PLATFORM_H
 #define WORKER_PLATFORM_H
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
 
 #include "../errable.h"
 #include "../message.h"
+#include "../message_buffer.h"
 #include "../result.h"
+#include "../status.h"
 #include "worker_thread.h"
 
 class WorkerPlatform : public Errable
@@ -15,6 +18,11 @@ class WorkerPlatform : public Errable
 public:
   static std::unique_ptr<WorkerPlatform> for_worker(WorkerThread *thread);
 
+  // Feed a capture recorded by `handle_capture_command()` through this platform's event handling code on the calling
+  // thread, without a live filesystem, passing the messages of each notification cycle to `sink`. Only supported on
+  // Linux.
+  static Result<> replay_capture(const std::string &capture_path, const std::function<void(MessageBuffer &)> &sink);
+
   WorkerPlatform() : Errable("platform"){};
 
   ~WorkerPlatform() override = default;
@@ -25,9 +33,35 @@ public:
   virtual Result<bool> handle_add_command(CommandID command,
     ChannelID channel,
     const std::string &root_path,
-    bool recursive) = 0;
+    bool recursive,
+    const std::shared_ptr<const GlobSet> &exclude,
+    bool respect_ignore_files,
+    ActionMask actions,
+    const std::shared_ptr<const FileSet> &files,
+    uint_fast32_t max_depth) = 0;
   virtual Result<bool> handle_remove_command(CommandID command, ChannelID channel) = 0;
 
+  // Watch the directories up to `depth` levels beneath `dir` on a depth-limited channel as well.
+  virtual Result<bool> handle_expand_command(CommandID command,
+    ChannelID channel,
+    const std::string &dir,
+    uint_fast32_t depth) = 0;
+
+  // Forget an earlier expansion of `dir` on a depth-limited channel.
+  virtual Result<bool> handle_collapse_command(CommandID command, ChannelID channel, const std::string &dir) = 0;
+
+  // Record the raw native event stream to `capture_path`, or stop recording if it's empty. Only supported on Linux.
+  virtual Result<> handle_capture_command(const std::string & /*capture_path*/)
+  {
+    return error_result("Event capture is not supported on this platform");
+  }
+
+  // Populate any platform-specific fields within a `Status` structure. Called from the main thread.
+  virtual void collect_status(Status & /*status*/) {}
+
+  // Clear any platform-specific statistics reported by `collect_status()`.
+  virtual void reset_status() {}
+
   Result<> handle_commands()
   {
     if (!is_healthy()) return health_err_result();
@@ -61,6 +95,9 @@ protected:
     return thread->emit_all(begin, end);
   }
 
+  // Access the burst thresholds that channels were added with, so that polling fallback ADDs can carry the same ones.
+  const BurstCollapser &get_bursts() const { return thread->bursts; }
+
   WorkerThread *thread{};
 };
 
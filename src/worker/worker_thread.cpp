@@ -37,17 +37,49 @@ Result<> WorkerThread::body()
 
 Result<Thread::CommandOutcome> WorkerThread::handle_add_command(const CommandPayload *payload)
 {
-  Result<bool> r = platform->handle_add_command(
-    payload->get_id(), payload->get_channel_id(), payload->get_root(), payload->get_recursive());
+  // Watchers of files report every event for them, because a summary would name a directory that they don't watch.
+  if (payload->get_burst_threshold() > 0 && !payload->get_files()) {
+    bursts.set_threshold(payload->get_channel_id(), payload->get_root(), payload->get_burst_threshold());
+  }
+
+  Result<bool> r = platform->handle_add_command(payload->get_id(),
+    payload->get_channel_id(),
+    payload->get_root(),
+    payload->get_recursive(),
+    payload->get_exclude(),
+    payload->get_respect_ignore_files(),
+    payload->get_actions(),
+    payload->get_files(),
+    payload->get_max_depth());
+  return r.propagate(r.get_value() ? ACK : NOTHING);
+}
+
+Result<Thread::CommandOutcome> WorkerThread::handle_expand_command(const CommandPayload *payload)
+{
+  Result<bool> r = platform->handle_expand_command(
+    payload->get_id(), payload->get_channel_id(), payload->get_root(), payload->get_max_depth());
+  return r.propagate(r.get_value() ? ACK : NOTHING);
+}
+
+Result<Thread::CommandOutcome> WorkerThread::handle_collapse_command(const CommandPayload *payload)
+{
+  Result<bool> r = platform->handle_collapse_command(payload->get_id(), payload->get_channel_id(), payload->get_root());
   return r.propagate(r.get_value() ? ACK : NOTHING);
 }
 
 Result<Thread::CommandOutcome> WorkerThread::handle_remove_command(const CommandPayload *payload)
 {
+  bursts.forget(payload->get_channel_id());
+
   Result<bool> r = platform->handle_remove_command(payload->get_id(), payload->get_channel_id());
   return r.propagate(r.get_value() ? ACK : NOTHING);
 }
 
+Result<Thread::CommandOutcome> WorkerThread::handle_worker_capture_command(const CommandPayload *payload)
+{
+  return platform->handle_capture_command(payload->get_root()).propagate(ACK);
+}
+
 void WorkerThread::collect_status(Status &status)
 {
   status.worker_thread_state = state_name();
@@ -56,4 +88,14 @@ void WorkerThread::collect_status(Status &status)
   status.worker_in_ok = get_in_queue_error();
   status.worker_out_size = get_out_queue_size();
   status.worker_out_ok = get_out_queue_error();
+  status.worker_in_high_water = get_in_queue_high_water_mark();
+  status.worker_out_high_water = get_out_queue_high_water_mark();
+  collect_hot_directories(status.worker_hot_directories);
+  platform->collect_status(status);
+}
+
+void WorkerThread::reset_status()
+{
+  Thread::reset_status();
+  platform->reset_status();
 }
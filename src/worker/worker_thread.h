@@ -20,6 +20,8 @@ public:
 
   void collect_status(Status &status) override;
 
+  void reset_status() override;
+
   WorkerThread(const WorkerThread &) = delete;
   WorkerThread(WorkerThread &&) = delete;
   WorkerThread &operator=(const WorkerThread &) = delete;
@@ -34,6 +36,12 @@ private:
 
   Result<CommandOutcome> handle_remove_command(const CommandPayload *payload) override;
 
+  Result<CommandOutcome> handle_expand_command(const CommandPayload *payload) override;
+
+  Result<CommandOutcome> handle_collapse_command(const CommandPayload *payload) override;
+
+  Result<CommandOutcome> handle_worker_capture_command(const CommandPayload *payload) override;
+
   std::unique_ptr<WorkerPlatform> platform;
 
   friend WorkerPlatform;
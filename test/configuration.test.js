@@ -1,9 +1,18 @@
 /* eslint-dev mocha */
 const fs = require('fs-extra')
 
-const {configure} = require('../lib/binding')
+const {configure, replayCapture, DISABLE} = require('../lib/binding')
 const {Fixture} = require('./helper')
 
+// Native action and entry kind codes, in the order of their enums.
+const ACTIONS = ['created', 'deleted', 'modified', 'renamed', 'changed']
+const KINDS = ['file', 'directory', 'unknown', 'subtree']
+
+// Loggers announce themselves through the log writer thread, so the record may land shortly after `configure()`.
+function isOpened (logFile) {
+  return async () => /FileLogger opened/.test(await fs.readFile(logFile, 'utf8'))
+}
+
 describe('configuration', function () {
   let fixture
 
@@ -23,17 +32,71 @@ describe('configuration', function () {
   it('configures the main thread logger', async function () {
     await configure({mainLog: fixture.mainLogFile})
 
-    const contents = await fs.readFile(fixture.mainLogFile)
-    assert.match(contents, /FileLogger opened/)
+    await until('the logger is opened', isOpened(fixture.mainLogFile))
   })
 
   it('configures the worker thread logger', async function () {
     await configure({workerLog: fixture.workerLogFile})
 
-    const contents = await fs.readFile(fixture.workerLogFile)
-    assert.match(contents, /FileLogger opened/)
+    await until('the logger is opened', isOpened(fixture.workerLogFile))
+  })
+
+  it('rejects log files that cannot be opened', async function () {
+    const unopenable = fixture.fixturePath('missing', 'directory', 'log.txt')
+
+    await assert.isRejected(configure({mainLog: unopenable}), /Unable to open log file/)
+    await assert.isRejected(configure({workerLog: unopenable}), /Unable to open log file/)
   })
 
+  if (process.platform === 'linux') {
+    it('captures the inotify event stream', async function () {
+      const captureFile = fixture.fixturePath('events.capture')
+      await configure({workerCapture: captureFile})
+
+      await fixture.watch([], {}, () => {})
+      await fs.writeFile(fixture.watchPath('file.txt'), 'contents\n')
+      await until('events are captured', async () => (await fs.stat(captureFile)).size > 8)
+
+      await configure({workerCapture: DISABLE})
+
+      const contents = await fs.readFile(captureFile)
+      assert.strictEqual(contents.toString('ascii', 0, 4), 'WCAP')
+    })
+
+    it('replays a capture into the events that were delivered live', async function () {
+      const captureFile = fixture.fixturePath('events.capture')
+      await Promise.all([fs.mkdirs(fixture.watchPath('sub')), fs.mkdirs(fixture.watchPath('logs'))])
+      await configure({workerCapture: captureFile})
+
+      const live = []
+      const watcher = await fixture.watch([], {exclude: ['logs', '*.log']}, (err, events) => {
+        if (!err) live.push(...events)
+      })
+      const channel = watcher.channel
+
+      const movedFile = fixture.watchPath('moved.txt')
+      await fs.writeFile(fixture.watchPath('file.txt'), 'contents\n')
+      await fs.writeFile(fixture.watchPath('debug.log'), 'excluded\n')
+      await fs.writeFile(fixture.watchPath('logs', 'inner.txt'), 'excluded\n')
+      await fs.writeFile(fixture.watchPath('sub', 'inner.txt'), 'contents\n')
+      await fs.rename(fixture.watchPath('file.txt'), movedFile)
+      await until('the rename arrives', () => live.some(event => event.path === movedFile))
+
+      // Replaying the unwatch must only drop the channel's records.
+      await watcher.stop(false)
+      await configure({workerCapture: DISABLE})
+
+      const replayed = (replayCapture(captureFile)[channel] || []).map(event => {
+        const n = {action: ACTIONS[event.action], kind: KINDS[event.kind], path: event.path}
+        if (event.oldPath !== '') n.oldPath = event.oldPath
+        return n
+      })
+      const excluded = event => event.path.endsWith('.log') || event.path.startsWith(fixture.watchPath('logs'))
+      assert.isFalse(live.some(excluded))
+      assert.deepEqual(replayed, live)
+    })
+  }
+
   describe('for the polling thread', function () {
     describe("while it's stopped", function () {
       it('configures the logger', async function () {
@@ -43,8 +106,7 @@ describe('configuration', function () {
 
         await fixture.watch([], {poll: true}, () => {})
 
-        const contents = await fs.readFile(fixture.pollingLogFile)
-        assert.match(contents, /FileLogger opened/)
+        await until('the logger is opened', isOpened(fixture.pollingLogFile))
       })
     })
 
@@ -54,8 +116,18 @@ describe('configuration', function () {
 
         await configure({pollingLog: fixture.pollingLogFile})
 
+        await until('the logger is opened', isOpened(fixture.pollingLogFile))
+      })
+
+      it('writes pending records before the logger is replaced', async function () {
+        await configure({pollingLog: fixture.pollingLogFile})
+
+        await fixture.watch([], {poll: true}, () => {})
+
+        await configure({pollingLog: DISABLE})
+
         const contents = await fs.readFile(fixture.pollingLogFile)
-        assert.match(contents, /FileLogger opened/)
+        assert.match(contents, /Adding poll root at path/)
       })
     })
   })
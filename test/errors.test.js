@@ -24,4 +24,8 @@ describe('error reporting', function () {
   it('rejects the promise if the path does not exist', async function () {
     await assert.isRejected(matcher.watch(['nope'], {}))
   })
+
+  it('rejects the promise if an exclude pattern is malformed', async function () {
+    await assert.isRejected(matcher.watch([], {exclude: ['[unterminated']}), /unterminated character class/)
+  })
 })
@@ -0,0 +1,57 @@
+const fs = require('fs-extra')
+
+const {Fixture} = require('../helper')
+const {EventMatcher} = require('../matcher');
+
+[false, true].forEach(poll => {
+  describe(`action filtering with poll = ${poll}`, function () {
+    let fixture, matcher, existingFile
+
+    beforeEach(async function () {
+      fixture = new Fixture()
+      await fixture.before()
+      await fixture.log()
+
+      existingFile = fixture.watchPath('existing.txt')
+      await fs.writeFile(existingFile, 'before\n')
+
+      matcher = new EventMatcher(fixture)
+    })
+
+    afterEach(async function () {
+      await fixture.after(this.currentTest)
+    })
+
+    it('reports only the requested actions', async function () {
+      await matcher.watch([], {poll, actions: ['created', 'deleted']})
+
+      const flagFile = fixture.watchPath('flag.txt')
+
+      await fs.appendFile(existingFile, 'after\n')
+      await fs.writeFile(flagFile, 'yes\n')
+      await until('the creation event arrives', matcher.allEvents(
+        {action: 'created', kind: 'file', path: flagFile}
+      ))
+
+      await fs.unlink(flagFile)
+      await until('the deletion event arrives', matcher.allEvents(
+        {action: 'deleted', path: flagFile}
+      ))
+      assert.isTrue(matcher.noEvents({path: existingFile}))
+    })
+
+    it('ignores changes to attributes alone', async function () {
+      await matcher.watch([], {poll, ignoreAttrib: true})
+
+      const flagFile = fixture.watchPath('flag.txt')
+
+      await fs.chmod(existingFile, 0o600)
+      await fs.writeFile(flagFile, 'yes\n')
+
+      await until('the creation event arrives', matcher.allEvents(
+        {action: 'created', kind: 'file', path: flagFile}
+      ))
+      assert.isTrue(matcher.noEvents({path: existingFile}))
+    })
+  })
+})
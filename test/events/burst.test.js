@@ -0,0 +1,130 @@
+const fs = require('fs-extra')
+
+const {Fixture} = require('../helper')
+const {EventMatcher} = require('../matcher');
+
+[false, true].forEach(poll => {
+  describe(`burst-collapsing watchers with poll = ${poll}`, function () {
+    let fixture, matcher
+
+    beforeEach(async function () {
+      fixture = new Fixture()
+      await fixture.before()
+      await fixture.log()
+
+      await fs.mkdirs(fixture.watchPath('build'))
+
+      matcher = new EventMatcher(fixture)
+    })
+
+    afterEach(async function () {
+      await fixture.after(this.currentTest)
+    })
+
+    it('replaces a burst of events beneath a directory with a summary of its subtree', async function () {
+      await matcher.watch([], {poll, burstThreshold: 10})
+
+      const buildDir = fixture.watchPath('build')
+      const written = []
+      for (let i = 0; i < 100; i++) {
+        written.push(fixture.watchPath('build', `output-${i}.js`))
+      }
+      await Promise.all(written.map(filePath => fs.writeFile(filePath, 'output\n')))
+
+      await until('the burst is summarized', matcher.allEvents(
+        {action: 'changed', kind: 'subtree', path: buildDir}
+      ))
+      const individual = matcher.events.filter(event => written.includes(event.path))
+      assert.isBelow(individual.length, written.length)
+    })
+
+    it('reports events below the threshold individually', async function () {
+      await matcher.watch([], {poll, burstThreshold: 10})
+
+      const oneFile = fixture.watchPath('build', 'one.js')
+      const twoFile = fixture.watchPath('build', 'two.js')
+
+      await fs.writeFile(oneFile, 'one\n')
+      await fs.writeFile(twoFile, 'two\n')
+
+      await until('each event arrives', matcher.allEvents(
+        {action: 'created', kind: 'file', path: oneFile},
+        {action: 'created', kind: 'file', path: twoFile}
+      ))
+      assert.isTrue(matcher.noEvents({action: 'changed'}))
+    })
+
+    it('keeps summarizing a directory across batches until it has been quiet for a second', async function () {
+      this.timeout(5000)
+      await matcher.watch([], {poll, burstThreshold: 10})
+
+      const buildDir = fixture.watchPath('build')
+      const written = []
+      for (let i = 0; i < 100; i++) {
+        written.push(fixture.watchPath('build', `output-${i}.js`))
+      }
+      await Promise.all(written.map(filePath => fs.writeFile(filePath, 'output\n')))
+      await until('the burst is summarized', matcher.allEvents(
+        {action: 'changed', kind: 'subtree', path: buildDir}
+      ))
+
+      matcher.reset()
+      const lateFile = fixture.watchPath('build', 'late.js')
+      await fs.writeFile(lateFile, 'late\n')
+      await until('the late event is summarized', matcher.allEvents(
+        {action: 'changed', kind: 'subtree', path: buildDir}
+      ))
+      assert.isTrue(matcher.noEvents({path: lateFile}))
+
+      await new Promise(resolve => setTimeout(resolve, 1500))
+
+      matcher.reset()
+      const quietFile = fixture.watchPath('build', 'quiet.js')
+      await fs.writeFile(quietFile, 'quiet\n')
+      await until('the event after the quiet period arrives', matcher.allEvents(
+        {action: 'created', kind: 'file', path: quietFile}
+      ))
+      assert.isTrue(matcher.noEvents({action: 'changed'}))
+    })
+
+    it('reports every event of a watcher of files', async function () {
+      const written = []
+      for (let i = 0; i < 20; i++) {
+        written.push(fixture.watchPath('build', `output-${i}.js`))
+      }
+      await matcher.watch([], {poll, burstThreshold: 5, files: written})
+
+      await Promise.all(written.map(filePath => fs.writeFile(filePath, 'output\n')))
+
+      await until('each event arrives', matcher.allEvents(
+        ...written.map(filePath => ({action: 'created', kind: 'file', path: filePath}))
+      ))
+      assert.isTrue(matcher.noEvents({action: 'changed'}))
+    })
+
+    if (!poll) {
+      it('counts a rename against the deepest directory that holds both of its paths', async function () {
+        const buildDir = fixture.watchPath('build')
+        const fromDir = fixture.watchPath('build', 'from')
+        const toDir = fixture.watchPath('build', 'to')
+        await Promise.all([fs.mkdirs(fromDir), fs.mkdirs(toDir)])
+
+        const names = []
+        for (let i = 0; i < 10; i++) names.push(`output-${i}.js`)
+        await Promise.all(names.map(name => fs.writeFile(fixture.watchPath('build', 'from', name), 'output\n')))
+
+        await matcher.watch([], {poll, burstThreshold: 3})
+
+        await Promise.all(names.map(name => fs.rename(
+          fixture.watchPath('build', 'from', name),
+          fixture.watchPath('build', 'to', name)
+        )))
+
+        await until('the renames are summarized', matcher.allEvents(
+          {action: 'changed', kind: 'subtree', path: buildDir}
+        ))
+        assert.isTrue(matcher.noEvents({action: 'changed', path: fromDir}, {action: 'changed', path: toDir}))
+      })
+    }
+  })
+})
@@ -0,0 +1,71 @@
+const fs = require('fs-extra')
+
+const {Fixture} = require('../helper')
+const {EventMatcher} = require('../matcher');
+
+[false, true].forEach(poll => {
+  describe(`excluded paths with poll = ${poll}`, function () {
+    let fixture, matcher
+
+    beforeEach(async function () {
+      fixture = new Fixture()
+      await fixture.before()
+      await fixture.log()
+
+      await Promise.all([
+        fs.mkdirs(fixture.watchPath('node_modules', 'package')),
+        fs.mkdirs(fixture.watchPath('build', 'out'))
+      ])
+
+      matcher = new EventMatcher(fixture)
+      await matcher.watch([], {poll, exclude: ['node_modules', 'build/out', '*.log']})
+    })
+
+    afterEach(async function () {
+      await fixture.after(this.currentTest)
+    })
+
+    it('ignores events within excluded subtrees', async function () {
+      const flagFile = fixture.watchPath('file.txt')
+      const keptFile = fixture.watchPath('build', 'kept.txt')
+      const packageFile = fixture.watchPath('node_modules', 'package', 'index.js')
+      const newPackage = fixture.watchPath('node_modules', 'created')
+      const outFile = fixture.watchPath('build', 'out', 'bundle.js')
+      const logFile = fixture.watchPath('build', 'debug.log')
+
+      await Promise.all([
+        fs.writeFile(packageFile, 'nope\n'),
+        fs.mkdir(newPackage),
+        fs.writeFile(outFile, 'nope\n'),
+        fs.writeFile(logFile, 'nope\n')
+      ])
+      await fs.writeFile(fixture.watchPath('node_modules', 'created', 'index.js'), 'nope\n')
+      await fs.writeFile(keptFile, 'yes\n')
+      await fs.writeFile(flagFile, 'yes\n')
+
+      await until('unexcluded creation events arrive', matcher.allEvents(
+        {action: 'created', kind: 'file', path: keptFile},
+        {action: 'created', kind: 'file', path: flagFile}
+      ))
+      assert.isTrue(matcher.noEvents(
+        {path: packageFile},
+        {path: newPackage},
+        {path: outFile},
+        {path: logFile}
+      ))
+    })
+
+    it('reports entries renamed out of an excluded subtree as created', async function () {
+      const excludedFile = fixture.watchPath('node_modules', 'package', 'moved.txt')
+      const includedFile = fixture.watchPath('moved.txt')
+
+      await fs.writeFile(excludedFile, 'contents\n')
+      await fs.rename(excludedFile, includedFile)
+
+      await until('the creation event arrives', matcher.allEvents(
+        {action: 'created', kind: 'file', path: includedFile}
+      ))
+      assert.isTrue(matcher.noEvents({path: excludedFile}))
+    })
+  })
+})
@@ -0,0 +1,70 @@
+const fs = require('fs-extra')
+
+const {Fixture} = require('../helper')
+const {EventMatcher} = require('../matcher');
+
+[false, true].forEach(poll => {
+  describe(`file sets with poll = ${poll}`, function () {
+    let fixture, matcher, watchedFile, otherWatchedFile, siblingFile
+
+    beforeEach(async function () {
+      fixture = new Fixture()
+      await fixture.before()
+      await fixture.log()
+
+      await fs.mkdirs(fixture.watchPath('subdir'))
+      watchedFile = fixture.watchPath('watched.txt')
+      otherWatchedFile = fixture.watchPath('subdir', 'other.txt')
+      siblingFile = fixture.watchPath('sibling.txt')
+      await Promise.all([
+        fs.writeFile(watchedFile, 'before\n'),
+        fs.writeFile(otherWatchedFile, 'before\n'),
+        fs.writeFile(siblingFile, 'before\n')
+      ])
+
+      matcher = new EventMatcher(fixture)
+    })
+
+    afterEach(async function () {
+      await fixture.after(this.currentTest)
+    })
+
+    it('reports only the watched files', async function () {
+      await matcher.watch([], {poll, files: [watchedFile, otherWatchedFile]})
+
+      await fs.appendFile(siblingFile, 'after\n')
+      await fs.appendFile(watchedFile, 'after\n')
+      await fs.appendFile(otherWatchedFile, 'after\n')
+
+      await until('modification events arrive', matcher.allEvents(
+        {action: 'modified', kind: 'file', path: watchedFile},
+        {action: 'modified', kind: 'file', path: otherWatchedFile}
+      ))
+      assert.isTrue(matcher.noEvents({path: siblingFile}))
+    })
+
+    it('reports a file replaced by an atomic save as created', async function () {
+      await matcher.watch([], {poll, files: [watchedFile]})
+
+      const tempFile = fixture.watchPath('.watched.txt.tmp')
+      await fs.writeFile(tempFile, 'saved\n')
+      await fs.rename(tempFile, watchedFile)
+
+      await until('the creation event arrives', matcher.allEvents(
+        {action: 'created', path: watchedFile}
+      ))
+      assert.isTrue(matcher.noEvents({path: tempFile}))
+    })
+
+    it('watches a file that does not exist yet', async function () {
+      const newFile = fixture.watchPath('subdir', 'new.txt')
+      await matcher.watch([], {poll, files: [newFile]})
+
+      await fs.writeFile(newFile, 'hello\n')
+
+      await until('the creation event arrives', matcher.allEvents(
+        {action: 'created', kind: 'file', path: newFile}
+      ))
+    })
+  })
+})
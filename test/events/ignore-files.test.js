@@ -0,0 +1,76 @@
+const fs = require('fs-extra')
+
+const {Fixture} = require('../helper')
+const {EventMatcher} = require('../matcher');
+
+[false, true].forEach(poll => {
+  describe(`ignore files with poll = ${poll}`, function () {
+    let fixture, matcher
+
+    beforeEach(async function () {
+      fixture = new Fixture()
+      await fixture.before()
+      await fixture.log()
+
+      await Promise.all([
+        fs.mkdirs(fixture.watchPath('node_modules', 'package')),
+        fs.mkdirs(fixture.watchPath('src', 'generated')),
+        fs.mkdirs(fixture.watchPath('docs'))
+      ])
+      await Promise.all([
+        fs.writeFile(fixture.watchPath('.gitignore'), '# dependencies\nnode_modules/\n*.log\n!keep.log\n'),
+        fs.writeFile(fixture.watchPath('src', '.ignore'), 'generated\n')
+      ])
+
+      matcher = new EventMatcher(fixture)
+      await matcher.watch([], {poll, respectIgnoreFiles: true})
+    })
+
+    afterEach(async function () {
+      await fixture.after(this.currentTest)
+    })
+
+    it('ignores events within ignored subtrees', async function () {
+      const flagFile = fixture.watchPath('src', 'index.js')
+      const keptLog = fixture.watchPath('keep.log')
+      const packageFile = fixture.watchPath('node_modules', 'package', 'index.js')
+      const generatedFile = fixture.watchPath('src', 'generated', 'parser.js')
+      const logFile = fixture.watchPath('src', 'debug.log')
+
+      await Promise.all([
+        fs.writeFile(packageFile, 'nope\n'),
+        fs.writeFile(generatedFile, 'nope\n'),
+        fs.writeFile(logFile, 'nope\n')
+      ])
+      await fs.writeFile(keptLog, 'yes\n')
+      await fs.writeFile(flagFile, 'yes\n')
+
+      await until('unignored creation events arrive', matcher.allEvents(
+        {action: 'created', kind: 'file', path: keptLog},
+        {action: 'created', kind: 'file', path: flagFile}
+      ))
+      assert.isTrue(matcher.noEvents(
+        {path: packageFile},
+        {path: generatedFile},
+        {path: logFile}
+      ))
+    })
+
+    it('applies the rules of an edited ignore file', async function () {
+      const docsFile = fixture.watchPath('docs', 'index.md')
+      const logFile = fixture.watchPath('debug.log')
+      const ignoreFile = fixture.watchPath('.gitignore')
+
+      await fs.writeFile(ignoreFile, 'docs/\n')
+      await until('the ignore file modification arrives', matcher.allEvents({path: ignoreFile}))
+
+      await fs.writeFile(docsFile, 'nope\n')
+      await fs.writeFile(logFile, 'yes\n')
+
+      await until('the unignored creation event arrives', matcher.allEvents(
+        {action: 'created', kind: 'file', path: logFile}
+      ))
+      assert.isTrue(matcher.noEvents({path: docsFile}))
+    })
+  })
+})
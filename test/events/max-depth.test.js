@@ -0,0 +1,75 @@
+const fs = require('fs-extra')
+
+const {Fixture} = require('../helper')
+const {EventMatcher} = require('../matcher');
+
+[false, true].forEach(poll => {
+  describe(`depth-limited watchers with poll = ${poll}`, function () {
+    let fixture, matcher
+
+    beforeEach(async function () {
+      fixture = new Fixture()
+      await fixture.before()
+      await fixture.log()
+
+      await fs.mkdirs(fixture.watchPath('a', 'b', 'c', 'd'))
+
+      matcher = new EventMatcher(fixture)
+    })
+
+    afterEach(async function () {
+      await fixture.after(this.currentTest)
+    })
+
+    it('reports the entries of the deepest watched directories, but nothing within them', async function () {
+      await matcher.watch([], {poll, maxDepth: 1})
+
+      const shallowFile = fixture.watchPath('a', 'shallow.txt')
+      const deepFile = fixture.watchPath('a', 'b', 'deep.txt')
+      const flagFile = fixture.watchPath('flag.txt')
+
+      await fs.writeFile(deepFile, 'nope\n')
+      await fs.writeFile(shallowFile, 'yes\n')
+      await fs.writeFile(flagFile, 'yes\n')
+
+      await until('events within the limit arrive', matcher.allEvents(
+        {action: 'created', kind: 'file', path: shallowFile},
+        {action: 'created', kind: 'file', path: flagFile}
+      ))
+      assert.isTrue(matcher.noEvents({path: deepFile}))
+    })
+
+    it('watches an expanded directory to its own depth', async function () {
+      const watcher = await matcher.watch([], {poll, maxDepth: 1})
+      await watcher.expand(fixture.watchPath('a', 'b'), 1)
+
+      const expandedFile = fixture.watchPath('a', 'b', 'c', 'expanded.txt')
+      const deeperFile = fixture.watchPath('a', 'b', 'c', 'd', 'deeper.txt')
+
+      await fs.writeFile(deeperFile, 'nope\n')
+      await fs.writeFile(expandedFile, 'yes\n')
+
+      await until('events within the expansion arrive', matcher.allEvents(
+        {action: 'created', kind: 'file', path: expandedFile}
+      ))
+      assert.isTrue(matcher.noEvents({path: deeperFile}))
+    })
+
+    it('stops watching a collapsed directory', async function () {
+      const watcher = await matcher.watch([], {poll, maxDepth: 1})
+      await watcher.expand('a/b', 1)
+      await watcher.collapse('a/b')
+
+      const collapsedFile = fixture.watchPath('a', 'b', 'c', 'collapsed.txt')
+      const flagFile = fixture.watchPath('a', 'flag.txt')
+
+      await fs.writeFile(collapsedFile, 'nope\n')
+      await fs.writeFile(flagFile, 'yes\n')
+
+      await until('events within the limit arrive', matcher.allEvents(
+        {action: 'created', kind: 'file', path: flagFile}
+      ))
+      assert.isTrue(matcher.noEvents({path: collapsedFile}))
+    })
+  })
+})
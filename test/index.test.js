@@ -83,6 +83,34 @@ describe('exported functions', function () {
       assert.isTrue(childMatcher.noEvents({path: rootFile}))
     })
 
+    it('splits renames across the edge of a child watcher sharing a native watcher', async function () {
+      const subDir = fixture.watchPath('subdir')
+      const insideFile = fixture.watchPath('subdir', 'inside.txt')
+      const outsideFile = fixture.watchPath('outside.txt')
+
+      await fs.mkdir(subDir)
+      await fs.writeFile(insideFile, 'inside\n', {encoding: 'utf8'})
+
+      const rootMatcher = new EventMatcher(fixture)
+      const rootWatcher = await rootMatcher.watch([], {})
+      const childMatcher = new EventMatcher(fixture)
+      const childWatcher = await childMatcher.watch(['subdir'], {})
+
+      assert.strictEqual(rootWatcher.native, childWatcher.native)
+
+      await fs.rename(insideFile, outsideFile)
+      await Promise.all([
+        until('root rename arrives', rootMatcher.allEvents(
+          {action: 'renamed', oldPath: insideFile, path: outsideFile}
+        )),
+        until('child deletion arrives', childMatcher.allEvents({action: 'deleted', path: insideFile}))
+      ])
+
+      await fs.rename(outsideFile, insideFile)
+      await until('child creation arrives', childMatcher.allEvents({action: 'created', path: insideFile}))
+      assert.isTrue(childMatcher.noEvents({path: outsideFile}))
+    })
+
     it('adopts existing child watchers and filters events appropriately to them', async function () {
       // Create the directory tree
       const rootFile = fixture.watchPath('rootfile.txt')
@@ -1,5 +1,8 @@
-const {status} = require('../lib/binding')
+const fs = require('fs-extra')
+
+const {configure, status, DISABLE} = require('../lib/binding')
 const {Fixture} = require('./helper')
+const {EventMatcher} = require('./matcher')
 
 describe('polling', function () {
   let fixture
@@ -27,4 +30,192 @@ describe('polling', function () {
       await until(() => status().pollingThreadState === 'stopped')
     })
   })
+
+  describe('per-root intervals', function () {
+    it('polls a root on its own interval', async function () {
+      this.timeout(10000)
+
+      // Far from the default of 100ms in both directions, so that neither bound holds by accident.
+      const interval = 1000
+      const matcher = new EventMatcher(fixture)
+      await matcher.watch([], {poll: true, pollingInterval: interval})
+
+      const firstFile = fixture.watchPath('first.txt')
+      const firstWritten = Date.now()
+      await fs.writeFile(firstFile, 'contents')
+      await until('the first creation event arrives', matcher.allEvents(
+        {action: 'created', kind: 'file', path: firstFile}
+      ), interval * 3)
+      assert.isAtMost(Date.now() - firstWritten, interval * 2)
+
+      // The pass that found the first file has only just run, so the second one waits for the next.
+      const secondFile = fixture.watchPath('second.txt')
+      const secondWritten = Date.now()
+      await fs.writeFile(secondFile, 'contents')
+      await until('the second creation event arrives', matcher.allEvents(
+        {action: 'created', kind: 'file', path: secondFile}
+      ), interval * 3)
+      const elapsed = Date.now() - secondWritten
+      assert.isAtLeast(elapsed, interval / 2)
+      assert.isAtMost(elapsed, interval * 2)
+    })
+
+    it('polls a new root without waiting for the timers of the others', async function () {
+      this.timeout(10000)
+      await Promise.all([fs.mkdirs(fixture.watchPath('slow')), fs.mkdirs(fixture.watchPath('new'))])
+
+      // Leave the polling thread asleep on a long timer.
+      const interval = 5000
+      await fixture.watch(['slow'], {poll: true, pollingInterval: interval}, () => {})
+
+      // A watch resolves once its root has been scanned, which takes the polling thread's next cycle.
+      const started = Date.now()
+      await fixture.watch(['new'], {poll: true, pollingInterval: interval}, () => {})
+      assert.isBelow(Date.now() - started, interval / 5)
+    })
+  })
+
+  describe('staleness targets', function () {
+    it('reports the achieved staleness of targeted roots', async function () {
+      const matcher = new EventMatcher(fixture)
+      await matcher.watch([], {poll: true, pollingInterval: 10, pollingStaleness: 50})
+
+      const createdFile = fixture.watchPath('file.txt')
+      await fs.writeFile(createdFile, 'contents')
+
+      await until('the creation event arrives', matcher.allEvents(
+        {action: 'created', kind: 'file', path: createdFile}
+      ))
+      await until('a full pass completes', () => status().pollingStaleness > 0)
+    })
+
+    describe('that cannot be met', function () {
+      afterEach(async function () {
+        // Restore the default, which disables the cap.
+        await configure({pollingCpuBudget: 0})
+      })
+
+      it('counts the passes that miss their target', async function () {
+        const fileNames = []
+        for (let i = 0; i < 1000; i++) fileNames.push(`file-${i}.txt`)
+        await Promise.all(fileNames.map(fileName => fs.writeFile(fixture.watchPath(fileName), '')))
+
+        await configure({pollingCpuBudget: 1000})
+        await fixture.watch([], {poll: true, pollingInterval: 10, pollingStaleness: 1}, () => {})
+
+        await until('a pass misses its target', () => status().pollingSlaMisses >= 1)
+      })
+
+      it('lifts the cap with a budget of 0', async function () {
+        await fixture.watch([], {poll: true}, () => {})
+
+        await configure({pollingCpuBudget: 1000})
+        await until('the budget is applied', () => status().pollingCpuBudget === 1000)
+
+        await configure({pollingCpuBudget: 0})
+        await until('the cap is lifted', () => status().pollingCpuBudget === 0)
+      })
+    })
+  })
+
+  describe('large directories', function () {
+    it('reports changes across more entries than a single scan chunk', async function () {
+      const fileNames = []
+      for (let i = 0; i < 1200; i++) fileNames.push(`file-${i}.txt`)
+      await Promise.all(fileNames.map(fileName => fs.writeFile(fixture.watchPath(fileName), '')))
+
+      const matcher = new EventMatcher(fixture)
+      await matcher.watch([], {poll: true})
+
+      const deletedFile = fixture.watchPath('file-10.txt')
+      const modifiedFile = fixture.watchPath('file-1100.txt')
+      const createdFile = fixture.watchPath('file-new.txt')
+      await fs.unlink(deletedFile)
+      await fs.writeFile(modifiedFile, 'changed')
+      await fs.writeFile(createdFile, '')
+
+      await until('all events arrive', matcher.allEvents(
+        {action: 'deleted', path: deletedFile},
+        {action: 'modified', kind: 'file', path: modifiedFile},
+        {action: 'created', kind: 'file', path: createdFile}
+      ))
+    })
+  })
+
+  describe('rename detection', function () {
+    it('tracks the contents of a renamed directory at its new location', async function () {
+      const oldDir = fixture.watchPath('old-dir')
+      const newDir = fixture.watchPath('new-dir')
+      await fs.mkdirs(fixture.watchPath('old-dir', 'subdir'))
+      await fs.writeFile(fixture.watchPath('old-dir', 'subdir', 'file.txt'), 'original\n')
+
+      const matcher = new EventMatcher(fixture)
+      await matcher.watch([], {poll: true})
+
+      await fs.rename(oldDir, newDir)
+      await until('the rename event arrives', matcher.allEvents(
+        {action: 'renamed', kind: 'directory', oldPath: oldDir, path: newDir}
+      ))
+
+      const movedFile = fixture.watchPath('new-dir', 'subdir', 'file.txt')
+      await fs.appendFile(movedFile, 'changed\n')
+      await until('the modification event arrives', matcher.allEvents(
+        {action: 'modified', kind: 'file', path: movedFile}
+      ))
+      assert.isFalse(matcher.events.some(event => event.action === 'created' && event.path === movedFile))
+    })
+
+    it('keeps a deletion and an unrelated creation apart when the inode is reused', async function () {
+      const deletedFile = fixture.watchPath('a.txt')
+      const createdFile = fixture.watchPath('b.txt')
+      await fs.writeFile(deletedFile, 'original\n')
+      await fs.utimes(deletedFile, new Date(2000, 0, 1), new Date(2000, 0, 1))
+
+      const matcher = new EventMatcher(fixture)
+      await matcher.watch([], {poll: true})
+
+      await fs.unlink(deletedFile)
+      await fs.writeFile(createdFile, '')
+
+      await until('both events arrive', matcher.allEvents(
+        {action: 'deleted', kind: 'file', path: deletedFile},
+        {action: 'created', kind: 'file', path: createdFile}
+      ))
+      assert.isTrue(matcher.noEvents({action: 'renamed'}))
+    })
+  })
+
+  describe('snapshots', function () {
+    afterEach(async function () {
+      await configure({pollingSnapshots: DISABLE})
+    })
+
+    it('reports changes made while a root was not being watched', async function () {
+      const snapshotDir = fixture.fixturePath('snapshots')
+      await fs.mkdirs(snapshotDir)
+      await configure({pollingSnapshots: snapshotDir})
+
+      const modifiedFile = fixture.watchPath('file.txt')
+      const deletedFile = fixture.watchPath('deleted.txt')
+      await Promise.all([
+        fs.writeFile(modifiedFile, 'original\n'),
+        fs.writeFile(deletedFile, 'original\n')
+      ])
+
+      const first = await fixture.watch([], {poll: true}, () => {})
+      await first.stop()
+      await until('the snapshot is saved', async () => (await fs.readdir(snapshotDir)).length > 0)
+
+      await fs.appendFile(modifiedFile, 'changed while unwatched\n')
+      await fs.unlink(deletedFile)
+
+      const matcher = new EventMatcher(fixture)
+      await matcher.watch([], {poll: true})
+
+      await until('the catch-up events arrive', matcher.allEvents(
+        {action: 'modified', kind: 'file', path: modifiedFile},
+        {action: 'deleted', kind: 'file', path: deletedFile}
+      ))
+    })
+  })
 })
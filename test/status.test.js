@@ -0,0 +1,109 @@
+const fs = require('fs-extra')
+const path = require('path')
+
+const {configure, status} = require('../lib/binding')
+const {Fixture} = require('./helper')
+const {EventMatcher} = require('./matcher')
+
+describe('status', function () {
+  let fixture, matcher
+
+  beforeEach(async function () {
+    fixture = new Fixture()
+    await fixture.before()
+    await fixture.log()
+
+    matcher = new EventMatcher(fixture)
+  })
+
+  afterEach(async function () {
+    await fixture.after(this.currentTest)
+  })
+
+  it('reports the distribution of delivered events', async function () {
+    await matcher.watch([], {})
+
+    const createdFile = fixture.watchPath('file.txt')
+    await fs.writeFile(createdFile, 'contents')
+    await until('the creation event arrives', matcher.allEvents({action: 'created', path: createdFile}))
+
+    const summary = status()
+    assert.isAtLeast(summary.channelBatchSize.count, 1)
+    assert.isAtLeast(summary.channelBatchSize.max, 1)
+    assert.isAtLeast(summary.callbackDuration.count, 1)
+    assert.isAtLeast(summary.dispatchDuration.count, 1)
+    assert.isAtLeast(summary.workerOutHighWater, 1)
+  })
+
+  it('reports polling cycle durations', async function () {
+    await matcher.watch([], {poll: true})
+
+    await until('a polling cycle completes', () => status().pollingCycleDuration.count > 0)
+    const {pollingCycleDuration} = status()
+    assert.isAtMost(pollingCycleDuration.min, pollingCycleDuration.p50)
+    assert.isAtMost(pollingCycleDuration.p50, pollingCycleDuration.max)
+  })
+
+  it('reports the directories producing the most events', async function () {
+    await matcher.watch([], {})
+
+    const subdir = fixture.watchPath('subdir')
+    await fs.mkdir(subdir)
+    const files = ['a.txt', 'b.txt', 'c.txt'].map(name => path.join(subdir, name))
+    for (const file of files) {
+      await fs.writeFile(file, 'contents')
+    }
+    await until('the creation events arrive', matcher.allEvents(...files.map(file => ({action: 'created', path: file}))))
+
+    const {workerHotDirectories} = status()
+    const hottest = workerHotDirectories.find(directory => directory.path === subdir)
+    assert.isDefined(hottest)
+    assert.isAtLeast(hottest.events, files.length)
+    assert.isAbove(hottest.rate, 0)
+    assert.isAbove(hottest.recentRate, 0)
+  })
+
+  it('resets its distributions on request', async function () {
+    await matcher.watch([], {})
+
+    const createdFile = fixture.watchPath('file.txt')
+    await fs.writeFile(createdFile, 'contents')
+    await until('the creation event arrives', matcher.allEvents({action: 'created', path: createdFile}))
+
+    assert.isAtLeast(status({reset: true}).channelBatchSize.count, 1)
+    assert.equal(status().channelBatchSize.count, 0)
+  })
+
+  describe('with latency tracing', function () {
+    beforeEach(async function () {
+      await configure({latencyTracing: true})
+      status({reset: true})
+    })
+
+    afterEach(async function () {
+      await configure({latencyTracing: false})
+    })
+
+    it('attaches stage latencies to delivered events', async function () {
+      const events = []
+      await fixture.watch([], {}, (err, batch) => {
+        if (err) throw err
+        events.push(...batch)
+      })
+
+      const createdFile = fixture.watchPath('file.txt')
+      await fs.writeFile(createdFile, 'contents')
+      await until('the creation event arrives', () => events.some(event => event.path === createdFile))
+
+      const event = events.find(event => event.path === createdFile)
+      assert.isDefined(event.latency)
+      assert.isAtLeast(event.latency.total, event.latency.emit)
+      assert.isAtLeast(event.latency.total, event.latency.queue)
+      assert.isAtLeast(event.latency.total, event.latency.dispatch)
+
+      const summary = status()
+      assert.isAtLeast(summary.latencyTotal.count, 1)
+      assert.isAtLeast(summary.latencyQueue.count, 1)
+    })
+  })
+})
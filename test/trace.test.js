@@ -0,0 +1,66 @@
+const fs = require('fs-extra')
+
+const {status, traceStart, traceStop} = require('../lib/binding')
+const {Fixture} = require('./helper')
+const {EventMatcher} = require('./matcher')
+
+describe('tracing', function () {
+  let fixture, matcher, tracePath
+
+  beforeEach(async function () {
+    fixture = new Fixture()
+    await fixture.before()
+    await fixture.log()
+
+    matcher = new EventMatcher(fixture)
+    tracePath = fixture.fixturePath('trace.json')
+  })
+
+  afterEach(async function () {
+    await fixture.after(this.currentTest)
+  })
+
+  it('writes spans from each thread as Chrome trace events', async function () {
+    traceStart()
+    await matcher.watch([], {})
+
+    const createdFile = fixture.watchPath('file.txt')
+    await fs.writeFile(createdFile, 'contents')
+    await until('the creation event arrives', matcher.allEvents({action: 'created', path: createdFile}))
+
+    const {spanCount, droppedCount} = traceStop(tracePath)
+    assert.isAtLeast(spanCount, 1)
+    assert.equal(droppedCount, 0)
+
+    const {traceEvents} = await fs.readJson(tracePath)
+    const names = new Set(traceEvents.filter(event => event.ph === 'X').map(event => event.name))
+    assert.isTrue(names.has('dispatch'))
+    assert.isTrue(names.has('callback'))
+
+    const threadNames = traceEvents.filter(event => event.ph === 'M').map(event => event.args.name)
+    assert.include(threadNames, 'main thread')
+    assert.include(threadNames, 'worker thread')
+
+    const callback = traceEvents.find(event => event.name === 'callback')
+    assert.isAtLeast(callback.args.events, 1)
+  })
+
+  it('records polling cycles', async function () {
+    traceStart()
+    status({reset: true})
+    await matcher.watch([], {poll: true})
+    await until('a polling cycle completes', () => status().pollingCycleDuration.count > 0)
+    traceStop(tracePath)
+
+    const {traceEvents} = await fs.readJson(tracePath)
+    const advance = traceEvents.find(event => event.name === 'advance')
+    assert.isDefined(advance)
+    assert.isAtLeast(advance.args.ops, 1)
+    assert.isTrue(traceEvents.some(event => event.name === 'polling cycle'))
+  })
+
+  it('fails if the trace cannot be written', function () {
+    traceStart()
+    assert.throws(() => traceStop(fixture.fixturePath('missing', 'trace.json')), /Unable to write trace/)
+  })
+})
@@ -0,0 +1,81 @@
+const fs = require('fs-extra')
+
+const {watchMany} = require('../lib')
+const {Fixture} = require('./helper')
+
+describe('watching many roots at once', function () {
+  let fixture, events
+
+  beforeEach(async function () {
+    fixture = new Fixture()
+    await fixture.before()
+    await fixture.log()
+
+    await Promise.all(['dir_a', 'dir_b', 'dir_c'].map(subdir => fs.mkdirs(fixture.watchPath(subdir, 'nested'))))
+
+    events = []
+  })
+
+  afterEach(async function () {
+    await fixture.after(this.currentTest)
+  })
+
+  async function watchRoots (rootPaths, options = {}) {
+    const watchers = await watchMany(rootPaths, options, batch => events.push(...batch))
+    fixture.watchers.push(...watchers)
+    return watchers
+  }
+
+  it('resolves with a started watcher for each root, in order', async function () {
+    const roots = ['dir_c', 'dir_a', 'dir_b'].map(subdir => fixture.watchPath(subdir))
+    const watchers = await watchRoots(roots)
+
+    assert.lengthOf(watchers, 3)
+    watchers.forEach((watcher, i) => {
+      assert.strictEqual(watcher.watchedPath, roots[i])
+      assert.isTrue(watcher.getNativeWatcher().isRunning())
+    })
+  })
+
+  it('delivers the events beneath every root', async function () {
+    await watchRoots(['dir_a', 'dir_b', 'dir_c'].map(subdir => fixture.watchPath(subdir)))
+
+    const files = ['dir_a', 'dir_b', 'dir_c'].map(subdir => fixture.watchPath(subdir, 'nested', 'file.txt'))
+    await Promise.all(files.map(file => fs.writeFile(file, 'contents\n')))
+
+    await until('an event arrives from each root', () => {
+      return files.every(file => events.some(event => event.action === 'created' && event.path === file))
+    })
+  })
+
+  it('maps a repeated root to a single watcher', async function () {
+    const root = fixture.watchPath('dir_a')
+    const watchers = await watchRoots([root, fixture.watchPath('dir_b'), root])
+
+    assert.strictEqual(watchers[0], watchers[2])
+  })
+
+  it('rejects when any root cannot be watched', async function () {
+    let error = null
+    try {
+      await watchRoots([fixture.watchPath('dir_a'), fixture.watchPath('nope')])
+    } catch (err) {
+      error = err
+    }
+
+    assert.isNotNull(error)
+    assert.match(error.message, /nope/)
+  })
+
+  it('rejects the files option', async function () {
+    let error = null
+    try {
+      await watchRoots([fixture.watchPath('dir_a')], {files: [fixture.watchPath('dir_a', 'file.txt')]})
+    } catch (err) {
+      error = err
+    }
+
+    assert.isNotNull(error)
+    assert.match(error.message, /files/)
+  })
+})
@@ -150,4 +150,59 @@ describe('watching a directory', function () {
       {path: subFile}
     ))
   })
+
+  if (process.platform === 'linux') {
+    describe('with overlapping roots on separate channels', function () {
+      // Filtered watchers are never consolidated, so each of these has a native watcher and a channel of its own,
+      // and the worker shares their inotify watches instead.
+      const options = {exclude: ['*.unmatched']}
+      let subFile, outer, twin, inner, outerWatcher, innerWatcher
+
+      beforeEach(async function () {
+        subFile = fixture.watchPath('subdir', 'sub-file.txt')
+        await fs.mkdir(fixture.watchPath('subdir'))
+
+        outer = new EventMatcher(fixture)
+        outerWatcher = await outer.watch([], options)
+        twin = new EventMatcher(fixture)
+        await twin.watch([], options)
+        inner = new EventMatcher(fixture)
+        innerWatcher = await inner.watch(['subdir'], options)
+      })
+
+      it('delivers exactly one copy of each event to each watcher', async function () {
+        await fs.writeFile(subFile, 'sub\n')
+
+        // Each channel's events arrive in order, so once the sentinel has arrived, every copy of the first event has.
+        const sentinel = fixture.watchPath('subdir', 'sentinel.txt')
+        await fs.writeFile(sentinel, 'sentinel\n')
+        const arrived = matcher => matcher.allEvents({path: sentinel})()
+        await until('the sentinel arrives', () => [outer, twin, inner].every(arrived))
+
+        for (const matcher of [outer, twin, inner]) {
+          const copies = matcher.events.filter(event => event.action === 'created' && event.path === subFile)
+          assert.lengthOf(copies, 1)
+        }
+      })
+
+      it('keeps delivering events to the other watchers once the outer one is stopped', async function () {
+        await outerWatcher.getNativeWatcher().stop(false)
+        await fs.writeFile(subFile, 'sub\n')
+
+        await until('the inner watcher sees the event', inner.allEvents({action: 'created', path: subFile}))
+        assert.isTrue(outer.noEvents({path: subFile}))
+        await until('the twin watcher sees the event', twin.allEvents({action: 'created', path: subFile}))
+      })
+
+      it('keeps delivering events to the outer watchers once the inner one is stopped', async function () {
+        await innerWatcher.getNativeWatcher().stop(false)
+        await fs.writeFile(subFile, 'sub\n')
+
+        await until('the outer watchers see the event', () =>
+          outer.allEvents({action: 'created', path: subFile})() && twin.allEvents({action: 'created', path: subFile})()
+        )
+        assert.isTrue(inner.noEvents({path: subFile}))
+      })
+    })
+  }
 })